@@ -69,6 +69,14 @@ LemniTypeSet lemniModuleTypeSet(LemniModuleConst mod);
 
 LemniTypecheckStateConst lemniModuleTypecheckState(LemniModuleConst mod);
 
+/**
+ * @brief Enable or disable profiling of typechecking for a module.
+ * Reports are available from the module's typecheck state through \ref lemniTypecheckProfileReport .
+ * @param mod handle of the module to modify
+ * @param enabled whether to collect profiling data
+ */
+void lemniModuleSetProfiling(LemniModule mod, const bool enabled);
+
 typedef enum LemniModuleResultTypeT{
 	LEMNI_MODULE_RESULT_MODULE = 0,
 	LEMNI_MODULE_LEX_ERROR,
@@ -102,6 +110,27 @@ LemniTypedExtFnDeclExpr lemniModuleCreateExtFn(
 size_t lemniModuleNumExprs(LemniModule mod);
 LemniTypedExpr *lemniModuleExprs(LemniModule mod);
 
+/**
+ * @brief Get the number of top-level definitions of a lazily loaded module that have not been typechecked yet.
+ * @param mod handle of the module to query
+ * @returns number of pending definitions
+ */
+LemniNat64 lemniModuleNumPending(LemniModuleConst mod);
+
+/**
+ * @brief Typecheck every pending definition of a lazily loaded module in source order.
+ * @param mod handle of the module to typecheck
+ * @returns the first error or a result without an expression
+ */
+LemniTypecheckResult lemniModuleTypecheckPending(LemniModule mod);
+
+/**
+ * @brief Get the error from typechecking the definition for the last name resolved in a lazily loaded module.
+ * @param mod handle of the module to query
+ * @returns error message, empty if no definition failed
+ */
+LemniStr lemniModuleLazyError(LemniModuleConst mod);
+
 /**
  * @brief JIT compile a module.
  * @note the returned runtime must be destroyed with \ref lemniDestroyRuntime .
@@ -130,6 +159,15 @@ void lemniDestroyModuleMap(LemniModuleMap mods);
  */
 LemniTypeSet lemniModuleMapTypes(LemniModuleMap mods);
 
+/**
+ * @brief Set whether modules are loaded lazily.
+ * Lazily loaded modules only index their top-level definitions by name, each definition is typechecked the
+ * first time it is resolved and cached in the module. Other top-level expressions are typechecked on load.
+ * @param mods module map to modify
+ * @param lazy whether to load modules lazily
+ */
+void lemniModuleMapSetLazy(LemniModuleMap mods, const bool lazy);
+
 /**
  * @brief Load a module from lemni source.
  * @param pathStr path to the source file
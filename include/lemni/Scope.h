@@ -47,6 +47,27 @@ LemniTypedLValueExpr lemniScopeFind(LemniScopeConst s, LemniStr name);
 
 bool lemniScopeSet(LemniScope s, LemniTypedLValueExpr expr);
 
+/**
+ * @brief Function resolving names missing from a scope's own table.
+ * @param user pointer given to \ref lemniScopeSetResolver
+ * @param name name to resolve
+ * @returns the resolved expression or ``NULL`` to continue searching the parent scope
+ */
+typedef LemniTypedLValueExpr(*LemniScopeResolveFn)(void *user, LemniStr name);
+
+/**
+ * @brief Set a function that resolves names on demand, e.g. to typecheck definitions lazily.
+ * The resolver is called before the parent scope is searched and should add what it resolves to the scope.
+ * @param s scope to modify
+ * @param fn resolver function or ``NULL`` to remove the resolver
+ * @param user pointer passed to every call of \p fn
+ */
+void lemniScopeSetResolver(LemniScope s, LemniScopeResolveFn fn, void *user);
+
+typedef void(*LemniScopeVisitFn)(void *user, LemniTypedLValueExpr expr);
+
+void lemniScopeVisit(LemniScopeConst s, LemniScopeVisitFn fn, void *user);
+
 #ifdef __cplusplus
 }
 #ifndef LEMNI_NO_CPP
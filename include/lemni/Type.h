@@ -86,22 +86,67 @@ typedef struct {
 	LemniType type;
 } LemniRecordTypeField;
 
+/**
+ * @brief Kind of a type.
+ * Every type stores its kind, so code inspecting types can switch on it instead of trying ``lemniTypeAs*`` in turn.
+ */
+typedef enum LemniTypeKindT{
+	LEMNI_TYPE_KIND_TOP = 0,
+	LEMNI_TYPE_KIND_BOTTOM,
+	LEMNI_TYPE_KIND_PSEUDO,
+	LEMNI_TYPE_KIND_ERROR,
+	LEMNI_TYPE_KIND_MODULE,
+	LEMNI_TYPE_KIND_EXPR,
+	LEMNI_TYPE_KIND_META,
+
+	LEMNI_TYPE_KIND_UNIT,
+	LEMNI_TYPE_KIND_BOOL,
+	LEMNI_TYPE_KIND_NUMBER,
+	LEMNI_TYPE_KIND_REAL,
+	LEMNI_TYPE_KIND_RATIO,
+	LEMNI_TYPE_KIND_INT,
+	LEMNI_TYPE_KIND_NAT,
+
+	LEMNI_TYPE_KIND_STRING,
+	LEMNI_TYPE_KIND_STRING_ASCII,
+	LEMNI_TYPE_KIND_STRING_UTF8,
+
+	LEMNI_TYPE_KIND_ARRAY,
+	LEMNI_TYPE_KIND_FUNCTION,
+	LEMNI_TYPE_KIND_CLOSURE,
+	LEMNI_TYPE_KIND_SUM,
+	LEMNI_TYPE_KIND_PRODUCT,
+	LEMNI_TYPE_KIND_RECORD,
+
+	LEMNI_TYPE_KIND_C_PTR,
+	LEMNI_TYPE_KIND_C_CONST,
+	LEMNI_TYPE_KIND_C_VOID,
+
+	LEMNI_TYPE_KIND_COUNT
+} LemniTypeKind;
+
 #ifdef LEMNI_CPP
 struct LemniTypeT{
 	virtual ~LemniTypeT() = default;
 
+	LemniTypeKind kind() const noexcept{ return m_kind; }
+	LemniNat32 numBits() const noexcept{ return m_numBits; }
+
 	virtual LemniStr str() const noexcept = 0;
 	virtual LemniStr mangled() const noexcept = 0;
 
 	virtual LemniType base() const noexcept = 0;
 	virtual LemniType abstract() const noexcept = 0;
 
-	virtual LemniNat32 numBits() const noexcept = 0;
-
 	virtual LemniNat64 typeIdx() const noexcept = 0;
 
 	virtual bool isSame(LemniType other) const noexcept = 0;
 	virtual bool isCastable(LemniType to) const noexcept = 0;
+
+	protected:
+		// set once on construction, read without a virtual call
+		LemniTypeKind m_kind = LEMNI_TYPE_KIND_TOP;
+		LemniNat32 m_numBits = 0;
 };
 
 struct LemniPseudoTypeT: LemniTypeT{};
@@ -283,6 +328,20 @@ LemniStr lemniTypeMangled(LemniType type);
 LemniType lemniTypeBase(LemniType type);
 LemniType lemniTypeAbstract(LemniType type);
 uint32_t lemniTypeNumBits(LemniType type);
+
+/**
+ * @brief Get the kind of a type.
+ * @param type type to query
+ * @returns kind of \p type
+ */
+LemniTypeKind lemniTypeKind(LemniType type);
+
+/**
+ * @brief Get the id of a type within its type set.
+ * Ids are small integers handed out in creation order and never reused, so they can index tables of per type data.
+ * @param type type to query
+ * @returns stable id of \p type
+ */
 uint64_t lemniTypeInfoIndex(LemniType type);
 
 LemniTopType lemniTypeAsTop(LemniType type);
@@ -426,6 +485,8 @@ typedef struct LemniIOT{
 
 /**
  * @brief Create a new set of types.
+ * Type sets may be queried and extended from multiple threads at once, looking up existing types doesn't lock.
+ * Functions documenting otherwise need exclusive access to the type set.
  * @note The result must be destroyed with \ref lemniDestroyTypeSet .
  * @returns newly created type set
  */
@@ -439,12 +500,25 @@ LemniTypeSet lemniCreateTypeSet(void);
 void lemniDestroyTypeSet(LemniTypeSet types);
 
 /**
- * @brief Serialize a typeset.
+ * @brief Serialize a typeset to a compact binary snapshot.
+ * Snapshots are versioned and refer to types only by id. A type set restored with \ref lemniDeserializeTypeSet
+ * gives every type the id it has in \p types , so ids stored in other cached data stay valid.
+ * Pseudo types only keep their usage flags and scalar usage info.
  * @warning ``NULL`` must not be passed to this function.
+ * @note Types created by other threads while serializing may be left out of the snapshot.
  * @param types the type set to serialize
  * @param io the IO stream to serialize to
+ * @returns whether the whole snapshot was written
  */
-void lemniSerializeTypeSet(LemniTypeSet types, LemniIO *io);
+bool lemniSerializeTypeSet(LemniTypeSet types, LemniIO *io);
+
+/**
+ * @brief Restore a type set from a snapshot written by \ref lemniSerializeTypeSet .
+ * @note The result must be destroyed with \ref lemniDestroyTypeSet .
+ * @param io the IO stream to read the snapshot from
+ * @returns newly created type set or ``NULL`` if the snapshot is malformed or from another format version
+ */
+LemniTypeSet lemniDeserializeTypeSet(LemniIO *io);
 
 void lemniTypeSetSerializeInfo(LemniTypeSet types, LemniIO *io, const LemniTypeInfo *info);
 
@@ -482,6 +556,64 @@ LemniModuleType lemniTypeSetGetModule(LemniTypeSet types);
  */
 LemniPseudoType lemniTypeSetGetPseudo(LemniTypeSet types, const LemniTypeInfo usageInfo);
 
+/**
+ * @brief Get a type by its id.
+ * @param types type set to query
+ * @param id id previously returned by \ref lemniTypeInfoIndex
+ * @returns the type or ``NULL`` if no type with \p id exists or it has been reclaimed
+ */
+LemniType lemniTypeSetGetById(LemniTypeSetConst types, const LemniNat64 id);
+
+/**
+ * @brief Get the number of pseudo types ever created in a type set, including reclaimed ones.
+ * @param types type set to query
+ * @returns number of pseudo types created
+ */
+LemniNat64 lemniTypeSetNumPseudosCreated(LemniTypeSetConst types);
+
+/**
+ * @brief Register an owner that reclaims pseudo types from a type set, e.g. a typechecking state.
+ * @param types type set to modify
+ * @returns number of registered owners including the new one
+ */
+LemniNat64 lemniTypeSetAddOwner(LemniTypeSet types);
+
+/**
+ * @brief Unregister an owner previously registered with \ref lemniTypeSetAddOwner .
+ * @param types type set to modify
+ * @returns number of owners still registered
+ */
+LemniNat64 lemniTypeSetRemoveOwner(LemniTypeSet types);
+
+/**
+ * @brief Get the number of owners registered with \ref lemniTypeSetAddOwner .
+ * A type set with more than one owner is shared and may be in use by other threads.
+ * @param types type set to query
+ * @returns number of registered owners
+ */
+LemniNat64 lemniTypeSetNumOwners(LemniTypeSetConst types);
+
+/**
+ * @brief Set the owner recorded in pseudo types created from now on by the calling thread.
+ * @param types type set to modify
+ * @param owner opaque owner tag or ``NULL`` for pseudo types that are never reclaimed
+ * @returns the previous owner tag
+ */
+const void *lemniTypeSetPseudoOwner(LemniTypeSet types, const void *owner);
+
+/**
+ * @brief Reclaim pseudo types owned by \p owner that are not reachable from \p liveTypes .
+ * Composite types referencing a reclaimed pseudo type are reclaimed with it.
+ * Interning and cache fills wait for the call to finish, but lookups don't take locks.
+ * @warning This needs exclusive access to \p types , no other thread may use it during the call.
+ * @param types type set to modify
+ * @param owner owner tag previously passed to \ref lemniTypeSetPseudoOwner
+ * @param liveTypes types that must be kept alive
+ * @param numLive number of types in \p liveTypes
+ * @returns approximate number of bytes reclaimed
+ */
+LemniNat64 lemniTypeSetReclaimPseudos(LemniTypeSet types, const void *owner, LemniType *const liveTypes, const LemniNat64 numLive);
+
 /**
  * @brief Get the macro expression type.
  * @param types type set to query
@@ -600,8 +732,68 @@ LemniRecordType lemniTypeSetGetRecord(LemniTypeSet types, const LemniRecordTypeF
  */
 LemniType lemniTypeMakeSigned(LemniTypeSet types, LemniType type);
 
+/**
+ * @brief Get the type both of two types can be promoted to.
+ * Answers for pairs of scalar types are memoized in \p types .
+ * @param types type set to get types from
+ * @param a first type
+ * @param b second type
+ * @returns the promoted type, a sum of both types if neither promotes to the other
+ */
 LemniType lemniTypePromote(LemniTypeSet types, LemniType a, LemniType b);
 
+/**
+ * @brief Get the result type of an arithmetic operation.
+ * Answers for pairs of scalar types are memoized in \p types .
+ * @param types type set to get types from
+ * @param lhs type of the left operand
+ * @param rhs type of the right operand
+ * @param op arithmetic operator
+ * @returns the result type or ``NULL`` if the operation is not arithmetic on the promoted type
+ */
+LemniType lemniTypeSetArithmeticResult(LemniTypeSet types, LemniType lhs, LemniType rhs, LemniBinaryOp op);
+
+/**
+ * @brief Check if a type is castable to another, see \ref lemniTypeIsCastable .
+ * Answers for pairs of scalar types are memoized in \p types .
+ * @param types type set both types belong to
+ * @param from the type to cast from
+ * @param to the type to cast to
+ * @returns whether the conversion would be lossless
+ */
+bool lemniTypeSetIsCastable(LemniTypeSet types, LemniType from, LemniType to);
+
+/**
+ * @}
+ */
+
+/**
+ * @defgroup TypeLayout Data layout of types
+ * @{
+ */
+
+/**
+ * @brief In-memory layout of a sized type, following the C ABI of the host.
+ * Aggregates are flat: product components and record fields in declaration order with padding for alignment,
+ * array elements back to back.
+ */
+typedef struct LemniTypeLayoutT{
+	uint64_t size; //!< size in bytes, a multiple of the alignment
+	uint64_t alignment; //!< alignment in bytes, always a power of 2
+	uint64_t padding; //!< bytes of padding within the size, including padding in nested aggregates
+	uint64_t numFields; //!< number of product components or record fields, 0 for any other type
+	const uint64_t *fieldOffsets; //!< byte offset of each field, ``NULL`` if there are no fields
+} LemniTypeLayout;
+
+/**
+ * @brief Get the data layout of a type.
+ * Layouts are computed on first use and cached in \p types .
+ * @param types type set \p type belongs to
+ * @param type the type to get the layout of
+ * @returns the layout, or ``NULL`` if \p type has no fixed size (abstract, arbitrary precision or pseudo types)
+ */
+const LemniTypeLayout *lemniTypeSetGetLayout(LemniTypeSet types, LemniType type);
+
 /**
  * @}
  */
@@ -629,6 +821,10 @@ namespace lemni{
 			LemniTypeSet handle() noexcept{ return types; }
 			LemniTypeSetConst handle() const noexcept{ return types; }
 
+			bool serialize(LemniIO *io) const noexcept{ return lemniSerializeTypeSet(types, io); }
+
+			const LemniTypeLayout *layout(Type type) const noexcept{ return lemniTypeSetGetLayout(types, type); }
+
 			LemniPseudoType pseudo(const LemniTypeInfo usageInfo) const noexcept{
 				return lemniTypeSetGetPseudo(types, usageInfo);
 			}
@@ -669,6 +865,8 @@ namespace lemni{
 				return lemniTypeSetGetRecord(types, fields, numFields);
 			}
 
+			Type byId(const LemniNat64 id) const noexcept{ return lemniTypeSetGetById(types, id); }
+
 		private:
 			LemniTypeSet types;
 	};
@@ -54,9 +54,11 @@ typedef struct LemniCompileResultT{
 /**
  * @brief Create new compile state.
  * @note the returned handle must be destroyed with \ref lemniDestroyCompileState .
+ * @param types type set the compiled expressions were typechecked with
+ * @param parent parent state or ``NULL``
  * @returns handle to newly created state
  */
-LemniCompileState lemniCreateCompileState(LemniCompileState parent);
+LemniCompileState lemniCreateCompileState(LemniTypeSet types, LemniCompileState parent);
 
 /**
  * @brief Destroy state previously created with \ref lemniCreateCompileState .
@@ -95,8 +97,8 @@ LemniFn lemniObjectFunction(LemniObject obj, const LemniStr mangledName);
 namespace lemni{
 	class CompileState{
 		public:
-			explicit CompileState(LemniCompileState parent_ = nullptr) noexcept
-				: m_state(lemniCreateCompileState(parent_)){}
+			explicit CompileState(LemniTypeSet types, LemniCompileState parent_ = nullptr) noexcept
+				: m_state(lemniCreateCompileState(types, parent_)){}
 
 			~CompileState(){ if(m_state) lemniDestroyCompileState(m_state); }
 
@@ -0,0 +1,109 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_EFFECT_H
+#define LEMNI_EFFECT_H 1
+
+/**
+ * @defgroup Effects Purity and effect analysis
+ * @{
+ */
+
+#include "TypedExpr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Effect of evaluating an expression, ordered from least to most restrictive.
+ */
+typedef enum LemniEffectT{
+	LEMNI_EFFECT_PURE = 0, /** result depends only on the inputs */
+	LEMNI_EFFECT_READS_EXTERNAL, /** may observe external state, but never modifies it */
+	LEMNI_EFFECT_EFFECTFUL, /** may modify external state */
+	LEMNI_EFFECT_COUNT
+} LemniEffect;
+
+typedef struct LemniEffectStateT *LemniEffectState;
+typedef const struct LemniEffectStateT *LemniEffectStateConst;
+
+/**
+ * @brief Create new effect analysis state.
+ * @returns newly created state or ``NULL`` on error
+ */
+LemniEffectState lemniCreateEffectState();
+
+/**
+ * @brief Destroy effect analysis state.
+ * @param state state to destroy
+ */
+void lemniDestroyEffectState(LemniEffectState state);
+
+/**
+ * @brief Declare the effect of calling an external function.
+ * External functions are assumed to be effectful unless declared otherwise.
+ * @note this must be called before any expressions that call \p fn are analysed.
+ * @param state state to modify
+ * @param fn external function to declare
+ * @param effect effect of calling \p fn
+ */
+void lemniEffectStateDeclare(LemniEffectState state, LemniTypedExtFnDeclExpr fn, const LemniEffect effect);
+
+/**
+ * @brief Get the effect of evaluating an expression.
+ * Evaluating a function definition or lambda is pure, use \ref lemniEffectOfCall to get the effect of calling one.
+ * @param state state to modify
+ * @param expr expression to analyse
+ * @returns effect of evaluating \p expr
+ */
+LemniEffect lemniEffectOf(LemniEffectState state, LemniTypedExpr expr);
+
+/**
+ * @brief Get the effect of calling a function.
+ * Functions that can not be resolved statically are assumed to be effectful.
+ * @param state state to modify
+ * @param fn function expression to analyse
+ * @returns effect of applying \p fn
+ */
+LemniEffect lemniEffectOfCall(LemniEffectState state, LemniTypedExpr fn);
+
+/**
+ * @brief Get the combination of two effects.
+ * @param a first effect
+ * @param b second effect
+ * @returns the most restrictive of \p a and \p b
+ */
+LemniEffect lemniEffectJoin(const LemniEffect a, const LemniEffect b);
+
+/**
+ * @brief Get a string representation of an effect.
+ * @param effect effect to get the string for
+ * @returns string representation of \p effect
+ */
+LemniStr lemniEffectStr(const LemniEffect effect);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif // !LEMNI_EFFECT_H
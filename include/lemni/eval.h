@@ -61,6 +61,55 @@ LemniEvalState lemniCreateEvalState(LemniTypeSet types);
  */
 void lemniDestroyEvalState(LemniEvalState state);
 
+/**
+ * @brief Get the number of typed expressions referenced by an evaluation state.
+ * @param state state to query
+ * @returns number of referenced expressions
+ */
+LemniNat64 lemniEvalStateNumRoots(LemniEvalState state);
+
+/**
+ * @brief Get the typed expressions referenced by an evaluation state.
+ * These must be kept alive when reclaiming typechecking memory with \ref lemniTypecheckReclaim .
+ * @param state state to query
+ * @param out array with room for at least \ref lemniEvalStateNumRoots expressions
+ */
+void lemniEvalStateRoots(LemniEvalState state, LemniTypedExpr *const out);
+
+/**
+ * @brief Limit the amount of work done by future evaluations.
+ * Once a limit is reached evaluation stops with an error, this also resets the call counter.
+ * @param state state to modify
+ * @param maxCalls maximum number of function calls or ``0`` for no limit
+ * @param maxDepth maximum call nesting depth or ``0`` for no limit
+ */
+void lemniEvalStateSetBudget(LemniEvalState state, const LemniNat64 maxCalls, const LemniNat32 maxDepth);
+
+/**
+ * @brief Type representing the strategy used to evaluate expressions.
+ */
+typedef enum LemniEvalModeT{
+	LEMNI_EVAL_TREE = 0, //!< walk typed expressions directly
+	LEMNI_EVAL_BYTECODE, //!< compile expressions to register bytecode before running them
+	LEMNI_EVAL_SPECIALIZING, //!< walk typed expressions, specializing operators and calls to the values they see
+	LEMNI_EVAL_MODE_COUNT
+} LemniEvalMode;
+
+/**
+ * @brief Set the strategy used by future evaluations.
+ * Expressions that can not be compiled to bytecode are always evaluated by walking the tree.
+ * @param state state to modify
+ * @param mode new evaluation mode
+ */
+void lemniEvalStateSetMode(LemniEvalState state, const LemniEvalMode mode);
+
+/**
+ * @brief Get the strategy used by evaluations.
+ * @param state state to query
+ * @returns the current evaluation mode
+ */
+LemniEvalMode lemniEvalStateMode(LemniEvalState state);
+
 /**
  * @brief Get all globally bound identifiers that have been evaluated.
  * @warning \p state must be a valid pointer.
@@ -83,6 +132,7 @@ LemniEvalResult lemniEval(LemniEvalState state, LemniTypedExpr expr);
 
 #ifndef LEMNI_NO_CPP
 #include <variant>
+#include <vector>
 
 namespace lemni{
 	class EvalState{
@@ -107,6 +157,16 @@ namespace lemni{
 
 			LemniEvalState handle() noexcept{ return m_state; }
 
+			void setMode(const LemniEvalMode mode) noexcept{ lemniEvalStateSetMode(m_state, mode); }
+
+			LemniEvalMode mode() const noexcept{ return lemniEvalStateMode(m_state); }
+
+			std::vector<LemniTypedExpr> roots() const noexcept{
+				std::vector<LemniTypedExpr> ret(lemniEvalStateNumRoots(m_state));
+				lemniEvalStateRoots(m_state, ret.data());
+				return ret;
+			}
+
 		private:
 			LemniEvalState m_state;
 	};
@@ -0,0 +1,201 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_IR_H
+#define LEMNI_IR_H 1
+
+/**
+ * @defgroup IR Mid-level SSA intermediate representation
+ * @{
+ */
+
+#include "TypedExpr.h"
+#include "effect.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Opaque type owning functions lowered to IR.
+typedef struct LemniIRModuleT *LemniIRModule;
+typedef const struct LemniIRModuleT *LemniIRModuleConst;
+
+//! Opaque type representing a single function in SSA form.
+typedef struct LemniIRFunctionT *LemniIRFunction;
+typedef const struct LemniIRFunctionT *LemniIRFunctionConst;
+
+//! Opaque type representing an ordered list of IR passes.
+typedef struct LemniIRPassManagerT *LemniIRPassManager;
+
+/**
+ * @brief Built-in IR passes.
+ */
+typedef enum LemniIRPassT{
+	LEMNI_IR_PASS_SIMPLIFY = 0, /** fold constant branches, single input phis and algebraic identities */
+	LEMNI_IR_PASS_COPY_PROP, /** replace uses of copies with their source */
+	LEMNI_IR_PASS_DCE, /** remove unused pure instructions and unreachable blocks */
+	LEMNI_IR_PASS_COUNT
+} LemniIRPass;
+
+/**
+ * @brief Custom IR pass.
+ * @param fn function to transform
+ * @param user user pointer given when the pass was added
+ * @returns whether \p fn was changed
+ */
+typedef bool(*LemniIRPassFn)(LemniIRFunction fn, void *user);
+
+typedef struct LemniIRLowerErrorT{
+	LemniStr msg;
+} LemniIRLowerError;
+
+typedef struct LemniIRLowerResultT{
+	bool hasError;
+	union {
+		LemniIRFunction fn;
+		LemniIRLowerError error;
+	};
+} LemniIRLowerResult;
+
+/**
+ * @brief Create a new IR module.
+ * @note the returned module must be destroyed with \ref lemniDestroyIRModule .
+ * @param effects optional effect analysis used to mark pure calls, may be ``NULL``
+ * @returns newly created module
+ */
+LemniIRModule lemniCreateIRModule(LemniEffectState effects);
+
+/**
+ * @brief Destroy a module previously created with \ref lemniCreateIRModule .
+ * @param mod module to destroy
+ */
+void lemniDestroyIRModule(LemniIRModule mod);
+
+/**
+ * @brief Lower a typed expression to IR.
+ * Function definitions become named functions, any other expression becomes a function without parameters
+ * that returns its value. Lambdas become separate functions constructed as closures, and every function
+ * definition referenced by \p expr is lowered as well.
+ * @param mod module to lower into
+ * @param expr expression to lower
+ * @returns the function for \p expr or an error
+ */
+LemniIRLowerResult lemniIRLower(LemniIRModule mod, LemniTypedExpr expr);
+
+/**
+ * @brief Get the number of functions in a module.
+ * @param mod module to query
+ * @returns number of functions
+ */
+LemniNat64 lemniIRModuleNumFunctions(LemniIRModuleConst mod);
+
+/**
+ * @brief Get a function from a module.
+ * @param mod module to query
+ * @param idx index of the function
+ * @returns the function or ``NULL`` if \p idx is out of range
+ */
+LemniIRFunction lemniIRModuleFunction(LemniIRModule mod, const LemniNat64 idx);
+
+/**
+ * @brief Get the name of a function.
+ * @param fn function to query
+ * @returns name of \p fn
+ */
+LemniStr lemniIRFunctionName(LemniIRFunctionConst fn);
+
+/**
+ * @brief Get the number of instructions in a function, not counting terminators.
+ * @param fn function to query
+ * @returns number of instructions
+ */
+LemniNat64 lemniIRFunctionNumInsts(LemniIRFunctionConst fn);
+
+/**
+ * @brief Get the number of basic blocks in a function.
+ * @param fn function to query
+ * @returns number of blocks
+ */
+LemniNat64 lemniIRFunctionNumBlocks(LemniIRFunctionConst fn);
+
+/**
+ * @brief Get a textual representation of a function.
+ * @param fn function to print
+ * @returns string that stays valid until \p fn is printed again or changed
+ */
+LemniStr lemniIRFunctionStr(LemniIRFunction fn);
+
+/**
+ * @brief Create a new pass manager without any passes.
+ * @note the returned pass manager must be destroyed with \ref lemniDestroyIRPassManager .
+ * @returns newly created pass manager
+ */
+LemniIRPassManager lemniCreateIRPassManager();
+
+/**
+ * @brief Destroy a pass manager previously created with \ref lemniCreateIRPassManager .
+ * @param pm pass manager to destroy
+ */
+void lemniDestroyIRPassManager(LemniIRPassManager pm);
+
+/**
+ * @brief Append a built-in pass.
+ * @param pm pass manager to modify
+ * @param pass pass to append
+ */
+void lemniIRPassManagerAdd(LemniIRPassManager pm, const LemniIRPass pass);
+
+/**
+ * @brief Append a custom pass.
+ * @param pm pass manager to modify
+ * @param fn pass function
+ * @param user pointer passed to every call of \p fn
+ */
+void lemniIRPassManagerAddCustom(LemniIRPassManager pm, LemniIRPassFn fn, void *user);
+
+/**
+ * @brief Append the default pipeline: simplification, copy propagation then dead code elimination.
+ * @param pm pass manager to modify
+ */
+void lemniIRPassManagerAddDefaults(LemniIRPassManager pm);
+
+/**
+ * @brief Run every pass in order, repeating the pipeline until no pass changes the function.
+ * @param pm passes to run
+ * @param fn function to transform
+ * @returns whether \p fn was changed
+ */
+bool lemniIRPassManagerRun(LemniIRPassManager pm, LemniIRFunction fn);
+
+/**
+ * @brief Run the passes of \p pm on every function in a module.
+ * @param pm passes to run
+ * @param mod module to transform
+ * @returns whether any function was changed
+ */
+bool lemniIRPassManagerRunModule(LemniIRPassManager pm, LemniIRModule mod);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif // !LEMNI_IR_H
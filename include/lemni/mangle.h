@@ -21,18 +21,53 @@
 
 #include "Interop.h"
 #include "Macros.h"
+#include "Type.h"
 #include "Module.h"
 
+/**
+ * @defgroup Mangling Symbol name mangling and demangling
+ * @{
+ */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 LEMNI_OPAQUE_T(LemniMangler);
 
-LemniMangler lemniCreateMangler();
+/** @brief A symbol mapped back from its mangled name */
+typedef struct LemniDemangledT{
+	LemniModule module; /** module the symbol belongs to, or ``NULL`` */
+	LemniStr name; /** unqualified name of the symbol */
+	LemniStr qualified; /** name qualified by the module id */
+	LemniFunctionType type; /** type of the function */
+} LemniDemangled;
+
+/**
+ * @brief Create a new mangler.
+ * A mangler interns symbols by module, name and function type; each symbol is only ever formatted once.
+ * @note the returned handle must be destroyed with \ref lemniDestroyMangler .
+ * @param types type set to get function types from
+ * @returns handle to the newly created mangler
+ */
+LemniMangler lemniCreateMangler(LemniTypeSet types);
 
+/**
+ * @brief Destroy a mangler previously created with \ref lemniCreateMangler .
+ * @param mangler handle of the mangler to destroy
+ */
 void lemniDestroyMangler(LemniMangler mangler);
 
+/**
+ * @brief Get the mangled name of a function.
+ * @param mangler mangler to intern the symbol in
+ * @param module module the function belongs to, or ``NULL``
+ * @param name unqualified name of the function
+ * @param result result type of the function
+ * @param numParams number of parameters
+ * @param params parameter types of the function
+ * @returns the mangled name, valid for the lifetime of \p mangler
+ */
 LemniStr lemniMangle(
 	LemniMangler mangler,
 	LemniModule module, const LemniStr name,
@@ -40,8 +75,37 @@ LemniStr lemniMangle(
 	LemniNat32 numParams, LemniType *const params
 );
 
+/**
+ * @brief Get the mangled name of a function by its type, see \ref lemniMangle .
+ * @param mangler mangler to intern the symbol in
+ * @param module module the function belongs to, or ``NULL``
+ * @param name unqualified name of the function
+ * @param fnType type of the function
+ * @returns the mangled name, valid for the lifetime of \p mangler
+ */
+LemniStr lemniMangleFn(LemniMangler mangler, LemniModule module, const LemniStr name, LemniFunctionType fnType);
+
+/**
+ * @brief Map a mangled name back to its symbol.
+ * @param mangler mangler the name was created with
+ * @param mangled mangled name to look up
+ * @returns the demangled symbol, or ``NULL`` if \p mangled was not created by \p mangler
+ */
+const LemniDemangled *lemniDemangle(LemniManglerConst mangler, const LemniStr mangled);
+
+/**
+ * @brief Get the number of symbols interned in a mangler.
+ * @param mangler mangler to query
+ * @returns number of distinct symbols
+ */
+LemniNat64 lemniManglerNumSymbols(LemniManglerConst mangler);
+
 #ifdef __cplusplus
 }
 #endif
 
+/**
+ * @}
+ */
+
 #endif // !LEMNI_MANGLE_H
@@ -54,10 +54,11 @@ typedef const struct LemniMemCheckStateT *LemniMemCheckStateConst;
 
 /**
  * @brief Create new memory checking state.
+ * @param types type set to get storage layouts from
  * @param global region to use as a global pool. pass ``NULL`` to create new regions for all globals.
  * @returns
  */
-LemniMemCheckState lemniCreateMemCheckState(LemniRegion global);
+LemniMemCheckState lemniCreateMemCheckState(LemniTypeSet types, LemniRegion global);
 
 /**
  * @brief Destroy memory checking state.
@@ -0,0 +1,83 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_OPTIMIZE_H
+#define LEMNI_OPTIMIZE_H 1
+
+/**
+ * @defgroup Optimize Optimization passes over typed expressions
+ * @{
+ */
+
+#include "typecheck.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Eliminate repeated pure subexpressions.
+ * Repeated subtrees within the same function body or branch arm are bound once and referenced afterwards.
+ * Function definitions and bindings are rewritten in place, so existing references see the optimized value.
+ * @param state typechecking state that created \p expr
+ * @param expr expression to optimize
+ * @returns the optimized expression, may be \p expr
+ */
+LemniTypedExpr lemniOptimizeCSE(LemniTypecheckState state, LemniTypedExpr expr);
+
+/**
+ * @brief Inline calls of small, non-recursive, pure functions.
+ * The body of the callee is specialized for the arguments of each call site, arguments used more than once are bound first.
+ * Function definitions and bindings are rewritten in place, so existing references see the optimized value.
+ * @param state typechecking state that created \p expr
+ * @param expr expression to optimize
+ * @returns the optimized expression, may be \p expr
+ */
+LemniTypedExpr lemniOptimizeInline(LemniTypecheckState state, LemniTypedExpr expr);
+
+/**
+ * @brief Fuse chains of nested single argument calls such as ``f (g (h x))`` into one call.
+ * Each distinct chain of known, non-recursive, pure functions gets a synthesized definition whose body nests
+ * the bodies of every function in the chain, which later partial evaluation can fold further.
+ * Function definitions and bindings are rewritten in place, so existing references see the optimized value.
+ * @param state typechecking state that created \p expr
+ * @param expr expression to optimize
+ * @returns the optimized expression, may be \p expr
+ */
+LemniTypedExpr lemniOptimizeFuseChains(LemniTypecheckState state, LemniTypedExpr expr);
+
+/**
+ * @brief Flatten chains of one associative operator such as ``a + b + c`` into n-ary operations.
+ * N-ary operations evaluate by accumulating into a single value. Where the result type makes the operator
+ * exact, nested chains are reassociated and constant operands are gathered and folded at compile time.
+ * Function definitions and bindings are rewritten in place, so existing references see the optimized value.
+ * @param state typechecking state that created \p expr
+ * @param expr expression to optimize
+ * @returns the optimized expression, may be \p expr
+ */
+LemniTypedExpr lemniOptimizeFlatten(LemniTypecheckState state, LemniTypedExpr expr);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif // !LEMNI_OPTIMIZE_H
@@ -0,0 +1,168 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_QUERY_H
+#define LEMNI_QUERY_H 1
+
+/**
+ * @defgroup Query Demand-driven, memoized compilation queries
+ * @{
+ */
+
+#include "Token.h"
+#include "Expr.h"
+#include "typecheck.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque type memoizing the results of compilation queries.
+ * Every query records the queries it demanded while running. When an input changes, a cached result is reused
+ * if none of its dependencies changed, and a recomputed result equal to the previous one does not invalidate
+ * the queries depending on it.
+ */
+typedef struct LemniQueryEngineT *LemniQueryEngine;
+typedef const struct LemniQueryEngineT *LemniQueryEngineConst;
+
+typedef struct LemniQueryErrorT{
+	LemniLocation loc;
+	LemniStr msg;
+} LemniQueryError;
+
+typedef struct LemniQueryTokensResultT{
+	bool hasError;
+	union {
+		struct {
+			LemniNat64 numTokens;
+			const LemniToken *tokens;
+		};
+		LemniQueryError error;
+	};
+} LemniQueryTokensResult;
+
+typedef struct LemniQueryNamesResultT{
+	bool hasError;
+	union {
+		struct {
+			LemniNat64 numNames;
+			const LemniStr *names;
+		};
+		LemniQueryError error;
+	};
+} LemniQueryNamesResult;
+
+typedef struct LemniQueryExprResultT{
+	bool hasError;
+	union {
+		LemniExpr expr;
+		LemniQueryError error;
+	};
+} LemniQueryExprResult;
+
+//! Counters of the work done by a query engine.
+typedef struct LemniQueryStatsT{
+	LemniNat64 numExecuted; //! queries computed
+	LemniNat64 numReused; //! cached results reused after checking their dependencies
+	LemniNat64 numCutoff; //! recomputed results that were unchanged
+} LemniQueryStats;
+
+/**
+ * @brief Create a new query engine.
+ * @note the returned engine must be destroyed with \ref lemniDestroyQueryEngine .
+ * @param mods module map used for typechecking
+ * @returns newly created engine
+ */
+LemniQueryEngine lemniCreateQueryEngine(LemniModuleMap mods);
+
+/**
+ * @brief Destroy an engine previously created with \ref lemniCreateQueryEngine .
+ * @param engine engine to destroy
+ */
+void lemniDestroyQueryEngine(LemniQueryEngine engine);
+
+/**
+ * @brief Set the source text of a file, the only input of the engine.
+ * Setting the same text again does not invalidate anything.
+ * @param engine engine to modify
+ * @param file name of the file
+ * @param src source text
+ */
+void lemniQuerySetSource(LemniQueryEngine engine, const LemniStr file, const LemniStr src);
+
+/**
+ * @brief Get the current revision, incremented every time an input changes.
+ * @param engine engine to query
+ * @returns current revision
+ */
+LemniNat64 lemniQueryRevision(LemniQueryEngineConst engine);
+
+/**
+ * @brief Get the work done by an engine so far.
+ * @param engine engine to query
+ * @returns engine counters
+ */
+LemniQueryStats lemniQueryEngineStats(LemniQueryEngineConst engine);
+
+/**
+ * @brief Query the tokens of a file, see \ref lemniLex .
+ * @param engine engine to query
+ * @param file name of the file
+ * @returns tokens valid until the file changes, or an error
+ */
+LemniQueryTokensResult lemniQueryTokens(LemniQueryEngine engine, const LemniStr file);
+
+/**
+ * @brief Query the names of the top-level expressions of a file in source order.
+ * Definitions are named by their identifier, any other expression by ``$`` followed by its index.
+ * @param engine engine to query
+ * @param file name of the file
+ * @returns names valid until the file changes, or an error
+ */
+LemniQueryNamesResult lemniQueryDefinitionNames(LemniQueryEngine engine, const LemniStr file);
+
+/**
+ * @brief Query the expression of a top-level definition, see \ref lemniParse .
+ * @param engine engine to query
+ * @param file name of the file
+ * @param name name of the definition
+ * @returns the definition or an error
+ */
+LemniQueryExprResult lemniQueryDefinitionExpr(LemniQueryEngine engine, const LemniStr file, const LemniStr name);
+
+/**
+ * @brief Query the typed expression of a top-level definition, see \ref lemniTypecheck .
+ * Names referenced by the definition are resolved through the same query, so only the definitions it depends on
+ * are typechecked.
+ * @param engine engine to query
+ * @param file name of the file
+ * @param name name of the definition
+ * @returns result of typechecking the definition
+ */
+LemniTypecheckResult lemniQueryTypedDefinition(LemniQueryEngine engine, const LemniStr file, const LemniStr name);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif // !LEMNI_QUERY_H
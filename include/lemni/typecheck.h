@@ -22,6 +22,7 @@
 #include "Expr.h"
 #include "TypedExpr.h"
 #include "Scope.h"
+#include "effect.h"
 
 /**
  * @defgroup Typechecking Typechecking related types and functions.
@@ -79,6 +80,96 @@ LemniScope lemniTypecheckStateScope(LemniTypecheckStateConst state);
 
 LemniTypedPlaceholderExpr lemniTypecheckPlaceholder(LemniTypecheckState state);
 
+//! Statistics reported by \ref lemniTypecheckReclaim .
+typedef struct {
+	LemniNat64 numExprs; //! number of typed expressions released
+	LemniNat64 numBytes; //! approximate number of bytes released, including pseudo types
+} LemniTypecheckReclaimStats;
+
+/**
+ * @brief Keep a typed expression and everything it references alive across reclamation.
+ * Pins are counted, every call must be matched by \ref lemniTypecheckStateUnpin .
+ * @param state state owning the expression
+ * @param expr expression to pin
+ */
+void lemniTypecheckStatePin(LemniTypecheckState state, LemniTypedExpr expr);
+
+/**
+ * @brief Release a pin previously made with \ref lemniTypecheckStatePin .
+ * @param state state owning the expression
+ * @param expr expression to unpin
+ */
+void lemniTypecheckStateUnpin(LemniTypecheckState state, LemniTypedExpr expr);
+
+/**
+ * @brief Set the number of newly allocated bytes after which \ref lemniTypecheck reclaims memory by itself.
+ * Automatic reclamation is skipped while other typechecking states share the type set of \p state ,
+ * see \ref lemniTypeSetNumOwners .
+ * @warning automatic reclamation only keeps the global scope, pinned expressions and the expression just typechecked alive.
+ * @param state state to modify
+ * @param numBytes allocation threshold or ``0`` to disable automatic reclamation
+ */
+void lemniTypecheckStateSetReclaimThreshold(LemniTypecheckState state, const LemniNat64 numBytes);
+
+/**
+ * @brief Set the budget for evaluating calls of pure functions on constant arguments while typechecking.
+ * Calls that exceed the budget are left for runtime evaluation.
+ * @param state state to modify
+ * @param maxCalls maximum number of calls per evaluation or ``0`` to disable compile-time evaluation
+ * @param maxDepth maximum call nesting depth per evaluation
+ */
+void lemniTypecheckStateSetComptimeBudget(LemniTypecheckState state, const LemniNat64 maxCalls, const LemniNat32 maxDepth);
+
+/**
+ * @brief Declare the effect of calling an external function for optimizations done while typechecking.
+ * External functions are assumed to be effectful unless declared otherwise.
+ * @param state state to modify
+ * @param fn external function to declare
+ * @param effect effect of calling \p fn
+ */
+void lemniTypecheckStateDeclareEffect(LemniTypecheckState state, LemniTypedExtFnDeclExpr fn, const LemniEffect effect);
+
+/**
+ * @brief Enable or disable profiling of \ref lemniTypecheck .
+ * While enabled, wall time, allocations, pseudo types created and scope lookups are recorded per top-level
+ * expression, and specializations are counted per function. Disabling profiling discards the recorded data.
+ * @param state typechecking state to modify
+ * @param enabled whether to collect profiling data
+ */
+void lemniTypecheckStateSetProfiling(LemniTypecheckState state, const bool enabled);
+
+/**
+ * @brief Clear profiling data recorded so far, keeping profiling enabled.
+ * @param state typechecking state to modify
+ */
+void lemniTypecheckStateResetProfile(LemniTypecheckState state);
+
+/**
+ * @brief Get a human readable profiling report, definitions sorted by time taken.
+ * @param state typechecking state to query
+ * @returns report that stays valid until the next report is created or \p state is destroyed, empty if profiling is disabled
+ */
+LemniStr lemniTypecheckProfileReport(LemniTypecheckStateConst state);
+
+/**
+ * @brief Get the profiling data as a JSON object, definitions sorted by time taken.
+ * @param state typechecking state to query
+ * @returns JSON that stays valid until the next report is created or \p state is destroyed, empty if profiling is disabled
+ */
+LemniStr lemniTypecheckProfileJSON(LemniTypecheckStateConst state);
+
+/**
+ * @brief Release typed expressions and pseudo types that are no longer reachable.
+ * Expressions reachable from the global scope, pinned expressions or \p roots are kept.
+ * @warning pseudo types are reclaimed from the type set of \p state , no other thread may use that type set during the call,
+ * including through other states sharing it.
+ * @param state state to reclaim memory from
+ * @param roots additional expressions to keep alive, e.g. from \ref lemniEvalStateRoots
+ * @param numRoots number of expressions in \p roots
+ * @returns statistics about the released memory
+ */
+LemniTypecheckReclaimStats lemniTypecheckReclaim(LemniTypecheckState state, LemniTypedExpr *const roots, const LemniNat64 numRoots);
+
 /**
  * @brief Evaluate \p expr optionally applied to \p args .
  * The passed expression may be partially evaluated i.e. \p numArgs may be less than the number of params for \p expr .
@@ -153,6 +244,7 @@ LemniType lemniBinaryOpResultType(LemniTypeSet types, LemniType lhs, LemniType r
 }
 
 #ifndef LEMNI_NO_CPP
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -186,6 +278,19 @@ namespace lemni{
 			operator LemniTypecheckState() noexcept{ return m_state; }
 			operator LemniTypecheckStateConst() const noexcept{ return m_state; }
 
+			void pin(TypedExpr expr) noexcept{ lemniTypecheckStatePin(m_state, expr); }
+			void unpin(TypedExpr expr) noexcept{ lemniTypecheckStateUnpin(m_state, expr); }
+
+			LemniTypecheckReclaimStats reclaim(std::vector<TypedExpr> roots = {}) noexcept{
+				return lemniTypecheckReclaim(m_state, roots.data(), roots.size());
+			}
+
+			void setProfiling(const bool enabled) noexcept{ lemniTypecheckStateSetProfiling(m_state, enabled); }
+			void resetProfile() noexcept{ lemniTypecheckStateResetProfile(m_state); }
+
+			std::string profileReport() const{ return lemni::toStdStr(lemniTypecheckProfileReport(m_state)); }
+			std::string profileJSON() const{ return lemni::toStdStr(lemniTypecheckProfileJSON(m_state)); }
+
 		private:
 			LemniTypecheckState m_state;
 
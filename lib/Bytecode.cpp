@@ -0,0 +1,809 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <typeinfo>
+
+#include "lemni/Value.h"
+
+#include "Bytecode.hpp"
+#include "eval.hpp"
+
+using namespace lemni::bc;
+
+namespace {
+	LemniEvalResult makeResult(LemniValue val){
+		LemniEvalResult res;
+		res.hasError = false;
+		res.value = val;
+		return res;
+	}
+
+	LemniEvalResult litError(LemniStr str){
+		LemniEvalResult res;
+		res.hasError = true;
+		res.error.msg = str;
+		return res;
+	}
+
+	//! Call \p fn with \p reg as a ``LemniValue``, scalars are boxed on the stack
+	template<typename Fn>
+	auto withValue(const Reg &reg, Fn &&fn){
+		switch(reg.tag){
+#define LEMNI_BC_WITH_VALUE(type, tag_, member, boxed)\
+			case Tag::tag_:{\
+				boxed tmp(reg.member);\
+				return fn(static_cast<LemniValue>(&tmp));\
+			}
+
+			LEMNI_BC_SCALARS(LEMNI_BC_WITH_VALUE)
+
+#undef LEMNI_BC_WITH_VALUE
+
+			case Tag::value: return fn(reg.val);
+
+			default:{
+				LemniValueUnitT tmp;
+				return fn(static_cast<LemniValue>(&tmp));
+			}
+		}
+	}
+
+	//! Store ``lhs op rhs`` in the empty register \p out , returns ``false`` for invalid operands
+	inline bool binaryOp(const LemniBinaryOp op, const Reg &lhs, const Reg &rhs, Reg &out) noexcept{
+		if(fastBinary(op, lhs, rhs, out)) return true;
+
+		auto res = withValue(lhs, [op, &rhs](LemniValue lhsVal){
+			return withValue(rhs, [op, lhsVal](LemniValue rhsVal){
+				return lemniValueBinaryOp(op, lhsVal, rhsVal);
+			});
+		});
+
+		if(!res) return false;
+
+		unbox(out, res);
+		return true;
+	}
+
+	//! Get the truth of a condition and clear it, ``-1`` if it is not a boolean
+	inline LemniInt16 truth(Reg &cond) noexcept{
+		if(cond.tag == Tag::bool_) return cond.b;
+		auto res = withValue(cond, [](LemniValue val){ return lemniValueIsTrue(val); });
+		clear(cond);
+		return res;
+	}
+
+	/**
+	 * Take ownership of a value that a returning frame refers to.
+	 * Values owned by the frame's registers are moved out of them instead of copied.
+	 */
+	LemniValue detach(LemniValue val, Reg *const regs, const std::uint32_t numRegs) noexcept{
+		auto refed = val->deref();
+		if(refed == val) return val;
+
+		for(std::uint32_t i = 0; i < numRegs; i++){
+			auto &&reg = regs[i];
+			if(reg.tag == Tag::value && reg.val == refed){
+				reg.tag = Tag::empty;
+				lemniDestroyValue(val);
+				return refed;
+			}
+		}
+
+		return val;
+	}
+
+	//! Account for a call, returns an error if the evaluation budget is spent
+	inline std::optional<LemniEvalResult> enterCall(LemniEvalState state) noexcept{
+		if(state->maxCalls && (++state->numCalls > state->maxCalls)){
+			return litError(LEMNICSTR("evaluation call budget exhausted"));
+		}
+		else if(state->maxDepth && (state->depth >= state->maxDepth)){
+			return litError(LEMNICSTR("maximum evaluation depth exceeded"));
+		}
+
+		++state->depth;
+		return std::nullopt;
+	}
+
+	//! Call the value in \p fn , the argument registers are left empty
+	LemniValueCallResult callValue(const Reg &fn, Reg *const args, const std::uint32_t numArgs) noexcept{
+		LemniValue argsBuf[8];
+		std::unique_ptr<LemniValue[]> argsAlloc;
+
+		auto argVals = argsBuf;
+		if(numArgs > std::size(argsBuf)){
+			argsAlloc = std::make_unique<LemniValue[]>(numArgs);
+			argVals = argsAlloc.get();
+		}
+
+		for(std::uint32_t i = 0; i < numArgs; i++){
+			argVals[i] = take(args[i]);
+		}
+
+		// copy the register, nested evaluations may move the register stack
+		const Reg fnReg = fn;
+
+		auto res = withValue(fnReg, [argVals, numArgs](LemniValue fnVal){ return lemniValueCall(fnVal, argVals, numArgs); });
+
+		for(std::uint32_t i = 0; i < numArgs; i++){
+			lemniDestroyValue(argVals[i]);
+		}
+
+		return res;
+	}
+
+	//! Create a product of the values in \p elems , which are left empty
+	LemniValue makeProduct(Reg *const elems, const std::uint32_t numElems){
+		std::vector<LemniValue> vals;
+		vals.reserve(numElems);
+
+		for(std::uint32_t i = 0; i < numElems; i++){
+			vals.emplace_back(take(elems[i]));
+		}
+
+		auto res = lemniCreateValueProduct(vals.data(), vals.size());
+
+		for(auto val : vals) lemniDestroyValue(val);
+
+		return res;
+	}
+
+	bool isComparison(const LemniBinaryOp op) noexcept{
+		switch(op){
+			case LEMNI_BINARY_LT:
+			case LEMNI_BINARY_GT:
+			case LEMNI_BINARY_LTEQ:
+			case LEMNI_BINARY_GTEQ:
+			case LEMNI_BINARY_EQ:
+			case LEMNI_BINARY_NEQ:
+				return true;
+
+			default: return false;
+		}
+	}
+}
+
+namespace lemni::bc{
+	struct Compiler{
+		Compiler(Machine &m_, Function &fn_) noexcept
+			: m(m_), fn(fn_){}
+
+		RegId alloc() noexcept{ return fn.numRegs++; }
+
+		std::size_t emit(const Op op, const std::uint32_t imm = 0, const std::uint32_t a = 0, const std::uint32_t b = 0, const std::uint32_t c = 0){
+			fn.code.push_back(Inst{op, static_cast<std::uint16_t>(imm), a, b, c});
+			return fn.code.size() - 1;
+		}
+
+		//! Make the jump at \p idx target the next instruction
+		void patch(const std::size_t idx) noexcept{ fn.code[idx].c = static_cast<std::uint32_t>(fn.code.size()); }
+
+		void tree(LemniTypedExpr expr, const RegId dst){
+			const auto idx = static_cast<std::uint32_t>(m.m_trees.size());
+			m.m_trees.emplace_back(expr);
+			emit(Op::tree, 0, dst, idx);
+		}
+
+		//! Get the constant pool index for a scalar literal
+		std::optional<std::uint32_t> constant(LemniTypedExpr expr){
+			Reg reg;
+
+			if(auto lit = dynamic_cast<const LemniTypedBoolExprT*>(expr)) set<LemniBool>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedNat16Expr>(expr)) set<LemniNat16>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedNat32Expr>(expr)) set<LemniNat32>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedNat64Expr>(expr)) set<LemniNat64>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedInt16Expr>(expr)) set<LemniInt16>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedInt32Expr>(expr)) set<LemniInt32>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedInt64Expr>(expr)) set<LemniInt64>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedReal32Expr>(expr)) set<LemniReal32>(reg, lit->value);
+			else if(auto lit = dynamic_cast<LemniTypedReal64Expr>(expr)) set<LemniReal64>(reg, lit->value);
+			else return std::nullopt;
+
+			const auto idx = static_cast<std::uint32_t>(m.m_consts.size());
+			m.m_consts.emplace_back(reg);
+			return idx;
+		}
+
+		//! Get the register bound to \p expr if it names a parameter or local
+		std::optional<RegId> slot(LemniTypedExpr expr){
+			if(auto ref = dynamic_cast<LemniTypedRefExpr>(expr)) expr = ref->refed;
+
+			auto lval = dynamic_cast<LemniTypedLValueExpr>(expr);
+			if(!lval) return std::nullopt;
+
+			auto res = slots.find(lval);
+			if(res != end(slots)) return res->second;
+
+			return std::nullopt;
+		}
+
+		//! Get a register holding the value of \p expr , avoiding a copy for parameters and locals
+		RegId operand(LemniTypedExpr expr){
+			if(auto reg = slot(expr)) return *reg;
+			auto dst = alloc();
+			compileInto(expr, dst);
+			return dst;
+		}
+
+		void compileArgs(const std::vector<LemniTypedExpr> &args, const RegId base){
+			for(std::size_t i = 0; i < args.size(); i++){
+				compileInto(args[i], base + static_cast<RegId>(i));
+			}
+		}
+
+		RegId allocRange(const std::size_t n) noexcept{
+			const auto base = fn.numRegs;
+			fn.numRegs += static_cast<std::uint32_t>(n);
+			return base;
+		}
+
+		void compileBranch(LemniTypedBranchExpr branch, const RegId dst){
+			std::size_t skipTrue;
+
+			auto cmp = dynamic_cast<LemniTypedBinaryOpExpr>(branch->cond);
+			if(cmp && isComparison(cmp->op)){
+				auto lhs = operand(cmp->lhs);
+				if(auto k = constant(cmp->rhs)){
+					skipTrue = emit(Op::cmpKJmp, cmp->op, lhs, *k);
+				}
+				else{
+					auto rhs = operand(cmp->rhs);
+					skipTrue = emit(Op::cmpJmp, cmp->op, lhs, rhs);
+				}
+			}
+			else{
+				auto cond = operand(branch->cond);
+				skipTrue = emit(Op::jmpFalse, 0, 0, cond);
+			}
+
+			compileInto(branch->true_, dst);
+			auto skipFalse = emit(Op::jmp);
+			patch(skipTrue);
+			compileInto(branch->false_, dst);
+			patch(skipFalse);
+		}
+
+		void compileApplication(LemniTypedApplicationExpr app, const RegId dst){
+			auto def = dynamic_cast<LemniTypedFnDefExpr>(app->fn->deref());
+
+			if(def && (def->lambda->params.size() == app->args.size())){
+				if(app->fn == def && fn.def){
+					// local function definitions may capture parameters
+					failed = true;
+					return;
+				}
+
+				auto callee = m.function(def);
+				if(callee == noFn){
+					failed = true;
+					return;
+				}
+
+				auto base = allocRange(app->args.size());
+				compileArgs(app->args, base);
+				emit(Op::call, static_cast<std::uint32_t>(app->args.size()), dst, callee, base);
+			}
+			else{
+				auto fnReg = operand(app->fn);
+				auto base = allocRange(app->args.size());
+				compileArgs(app->args, base);
+				emit(Op::callV, static_cast<std::uint32_t>(app->args.size()), dst, fnReg, base);
+			}
+		}
+
+		void compileInto(LemniTypedExpr expr, const RegId dst){
+			if(failed) return;
+
+			if(auto k = constant(expr)){
+				emit(Op::loadK, 0, dst, *k);
+			}
+			else if(auto reg = slot(expr)){
+				if(*reg != dst) emit(Op::move, 0, dst, *reg);
+			}
+			else if(auto ref = dynamic_cast<LemniTypedRefExpr>(expr)){
+				if(fn.def && dynamic_cast<LemniTypedParamBindingExpr>(ref->refed)){
+					// parameter of an enclosing function
+					failed = true;
+					return;
+				}
+
+				tree(expr, dst);
+			}
+			else if(dynamic_cast<LemniTypedParamBindingExpr>(expr)){
+				failed = true;
+			}
+			else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+				if(!fn.def){
+					// top level bindings are stored globally
+					tree(expr, dst);
+					return;
+				}
+
+				auto reg = alloc();
+				compileInto(binding->value, reg);
+				slots[binding] = reg;
+				emit(Op::move, 0, dst, reg);
+			}
+			else if(auto unary = dynamic_cast<LemniTypedUnaryOpExpr>(expr)){
+				auto val = operand(unary->value);
+				emit(Op::unary, unary->op, dst, val);
+			}
+			else if(auto binary = dynamic_cast<LemniTypedBinaryOpExpr>(expr)){
+				auto lhs = operand(binary->lhs);
+				if(auto k = constant(binary->rhs)){
+					emit(Op::binaryK, binary->op, dst, lhs, *k);
+				}
+				else{
+					auto rhs = operand(binary->rhs);
+					emit(Op::binary, binary->op, dst, lhs, rhs);
+				}
+			}
+			else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)){
+				auto acc = operand(nary->operands[0]);
+
+				if(nary->operands.size() == 1){
+					if(acc != dst) emit(Op::move, 0, dst, acc);
+					return;
+				}
+
+				for(std::size_t i = 1; i < nary->operands.size(); i++){
+					if(auto k = constant(nary->operands[i])){
+						emit(Op::binaryK, nary->op, dst, acc, *k);
+					}
+					else{
+						auto rhs = operand(nary->operands[i]);
+						emit(Op::binary, nary->op, dst, acc, rhs);
+					}
+
+					acc = dst;
+				}
+			}
+			else if(auto branch = dynamic_cast<LemniTypedBranchExpr>(expr)){
+				compileBranch(branch, dst);
+			}
+			else if(auto block = dynamic_cast<LemniTypedBlockExpr>(expr)){
+				if(block->exprs.empty()){
+					tree(expr, dst);
+					return;
+				}
+
+				for(auto blockExpr : block->exprs){
+					if(auto ret = dynamic_cast<LemniTypedReturnExpr>(blockExpr)){
+						compileInto(ret->value, dst);
+						break;
+					}
+
+					compileInto(blockExpr, dst);
+				}
+			}
+			else if(auto product = dynamic_cast<LemniTypedProductExpr>(expr)){
+				auto base = allocRange(product->elems.size());
+				compileArgs(product->elems, base);
+				emit(Op::product, static_cast<std::uint32_t>(product->elems.size()), dst, base);
+			}
+			else if(auto app = dynamic_cast<LemniTypedApplicationExpr>(expr)){
+				compileApplication(app, dst);
+			}
+			else if(fn.def && (dynamic_cast<LemniTypedFnDefExpr>(expr) || dynamic_cast<LemniTypedLambdaExpr>(expr))){
+				// closures capture the frame, which trees can't see
+				failed = true;
+			}
+			else if(fn.def && usesFrame(expr)){
+				failed = true;
+			}
+			else{
+				tree(expr, dst);
+			}
+		}
+
+		//! Whether \p expr refers to a parameter or local, trees are evaluated with only the global bindings
+		bool usesFrame(LemniTypedExpr expr){
+			if(auto ref = dynamic_cast<LemniTypedRefExpr>(expr)){
+				return dynamic_cast<LemniTypedParamBindingExpr>(ref->refed) || slots.count(ref->refed);
+			}
+
+			std::vector<LemniTypedExpr> children;
+			expr->children(children);
+
+			return std::any_of(begin(children), end(children), [this](LemniTypedExpr child){ return usesFrame(child); });
+		}
+
+		Machine &m;
+		Function &fn;
+		std::unordered_map<LemniTypedLValueExpr, RegId> slots;
+		bool failed = false;
+	};
+}
+
+Machine::~Machine(){
+	for(auto &&reg : m_regs){
+		clear(reg);
+	}
+}
+
+FnId Machine::function(LemniTypedFnDefExpr def){
+	auto res = m_fnIds.find(def);
+	if(res != end(m_fnIds)) return res->second;
+
+	const auto id = static_cast<FnId>(m_fns.size());
+	auto &&fn = *m_fns.emplace_back(std::make_unique<Function>());
+	fn.def = def;
+	m_fnIds[def] = id;
+
+	Compiler compiler(*this, fn);
+
+	for(auto param : def->lambda->params){
+		compiler.slots[param] = compiler.alloc();
+	}
+
+	fn.numParams = fn.numRegs;
+
+	auto result = compiler.alloc();
+	compiler.compileInto(def->lambda->body, result);
+	compiler.emit(Op::ret, 0, result);
+
+	return compiler.failed ? noFn : id;
+}
+
+FnId Machine::compile(LemniTypedExpr expr){
+	auto res = m_programs.find(expr);
+	if(res != end(m_programs)) return res->second;
+
+	const auto numFns = m_fns.size();
+
+	auto fn = std::make_unique<Function>();
+
+	Compiler compiler(*this, *fn);
+
+	auto result = compiler.alloc();
+	compiler.compileInto(expr, result);
+	compiler.emit(Op::ret, 0, result);
+
+	if(compiler.failed){
+		// drop every function compiled along the way, they may call the ones that failed
+		for(auto i = numFns; i < m_fns.size(); i++){
+			m_fnIds.erase(m_fns[i]->def);
+		}
+
+		m_fns.resize(numFns);
+		m_programs[expr] = noFn;
+		return noFn;
+	}
+
+	const auto id = static_cast<FnId>(m_fns.size());
+	m_fns.emplace_back(std::move(fn));
+	m_programs[expr] = id;
+	return id;
+}
+
+std::size_t Machine::numRoots() const noexcept{
+	return std::count_if(begin(m_programs), end(m_programs), [](auto &&program){ return program.second != noFn; });
+}
+
+void Machine::roots(LemniTypedExpr *const out) const noexcept{
+	auto it = out;
+
+	for(auto &&program : m_programs){
+		if(program.second != noFn) *(it++) = program.first;
+	}
+}
+
+// computed gotos don't run destructors, so instructions keep non-trivial locals in helper functions
+#if defined(__GNUC__)
+#define LEMNI_BC_COMPUTED_GOTO 1
+#endif
+
+LemniEvalResult Machine::run(LemniEvalState state, LemniEvalBindings bindings, const FnId entry) noexcept{
+	const auto entryTop = m_top;
+	const auto entryDepth = state->depth;
+	const auto entryFrames = m_frames.size();
+
+	const Function *fn = m_fns[entry].get();
+	auto base = entryTop;
+
+	auto reserve = [this](const std::uint32_t n){
+		if(m_regs.size() < n) m_regs.resize(std::max<std::size_t>(n, m_regs.size() * 2));
+	};
+
+	reserve(base + fn->numRegs);
+	m_top = base + fn->numRegs;
+
+	auto R = m_regs.data() + base;
+	const Inst *pc = fn->code.data();
+
+	LemniEvalResult err;
+
+#ifdef LEMNI_BC_COMPUTED_GOTO
+	static const void *const labels[] = {
+		&&op_loadK, &&op_move, &&op_unary, &&op_binary, &&op_binaryK,
+		&&op_jmp, &&op_jmpFalse, &&op_cmpJmp, &&op_cmpKJmp,
+		&&op_call, &&op_callV, &&op_product, &&op_tree, &&op_ret
+	};
+
+	static_assert(std::size(labels) == static_cast<std::size_t>(Op::count));
+
+#define LEMNI_BC_OP(name) op_##name:
+#define LEMNI_BC_DISPATCH() goto *labels[static_cast<std::size_t>(pc->op)]
+#else
+#define LEMNI_BC_OP(name) case Op::name:
+#define LEMNI_BC_DISPATCH() goto dispatch
+#endif
+
+#define LEMNI_BC_NEXT() ++pc; LEMNI_BC_DISPATCH()
+
+#define LEMNI_BC_FAIL(res) err = (res); goto error
+
+#ifdef LEMNI_BC_COMPUTED_GOTO
+	LEMNI_BC_DISPATCH();
+#else
+dispatch:
+	switch(pc->op){
+#endif
+
+	LEMNI_BC_OP(loadK){
+		auto &&dst = R[pc->a];
+		clear(dst);
+		dst = m_consts[pc->b];
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(move){
+		auto &&src = R[pc->b];
+		Reg tmp = src;
+		if(tmp.tag == Tag::value) tmp.val = lemniCreateValueRef(src.val->deref());
+		clear(R[pc->a]);
+		R[pc->a] = tmp;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(unary){
+		const auto op = static_cast<LemniUnaryOp>(pc->imm);
+
+		Reg res;
+
+		if(!fastUnary(op, R[pc->b], res)){
+			auto val = withValue(R[pc->b], [op](LemniValue operand){ return lemniValueUnaryOp(op, operand); });
+			if(!val){
+				LEMNI_BC_FAIL(litError(LEMNICSTR("invalid operand for unary op")));
+			}
+
+			unbox(res, val);
+		}
+
+		clear(R[pc->a]);
+		R[pc->a] = res;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(binary){
+		Reg res;
+
+		if(!binaryOp(static_cast<LemniBinaryOp>(pc->imm), R[pc->b], R[pc->c], res)){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("invalid operands for binary op")));
+		}
+
+		clear(R[pc->a]);
+		R[pc->a] = res;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(binaryK){
+		Reg res;
+
+		if(!binaryOp(static_cast<LemniBinaryOp>(pc->imm), R[pc->b], m_consts[pc->c], res)){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("invalid operands for binary op")));
+		}
+
+		clear(R[pc->a]);
+		R[pc->a] = res;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(jmp){
+		pc = fn->code.data() + pc->c;
+		LEMNI_BC_DISPATCH();
+	}
+
+	LEMNI_BC_OP(jmpFalse){
+		auto cond = R[pc->b];
+		const auto isTrue = cond.tag == Tag::bool_ ? LemniInt16(cond.b) : withValue(cond, [](LemniValue val){ return lemniValueIsTrue(val); });
+
+		if(isTrue < 0){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("branch has non-boolean condition")));
+		}
+		else if(!isTrue){
+			pc = fn->code.data() + pc->c;
+			LEMNI_BC_DISPATCH();
+		}
+
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(cmpJmp){
+		Reg res;
+
+		if(!binaryOp(static_cast<LemniBinaryOp>(pc->imm), R[pc->a], R[pc->b], res)){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("invalid operands for binary op")));
+		}
+
+		const auto isTrue = truth(res);
+
+		if(isTrue < 0){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("branch has non-boolean condition")));
+		}
+		else if(!isTrue){
+			pc = fn->code.data() + pc->c;
+			LEMNI_BC_DISPATCH();
+		}
+
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(cmpKJmp){
+		Reg res;
+
+		if(!binaryOp(static_cast<LemniBinaryOp>(pc->imm), R[pc->a], m_consts[pc->b], res)){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("invalid operands for binary op")));
+		}
+
+		const auto isTrue = truth(res);
+
+		if(isTrue < 0){
+			LEMNI_BC_FAIL(litError(LEMNICSTR("branch has non-boolean condition")));
+		}
+		else if(!isTrue){
+			pc = fn->code.data() + pc->c;
+			LEMNI_BC_DISPATCH();
+		}
+
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(call){
+		if(auto budgetErr = enterCall(state)){
+			LEMNI_BC_FAIL(*budgetErr);
+		}
+
+		auto callee = m_fns[pc->b].get();
+		const auto calleeBase = base + fn->numRegs;
+
+		reserve(calleeBase + callee->numRegs);
+
+		auto args = m_regs.data() + base + pc->c;
+		auto params = m_regs.data() + calleeBase;
+
+		// argument registers are temporaries, so their values are moved
+		for(std::uint32_t i = 0; i < pc->imm; i++){
+			params[i] = args[i];
+			args[i].tag = Tag::empty;
+		}
+
+		m_frames.push_back(Frame{fn, pc + 1, base, pc->a});
+
+		fn = callee;
+		base = calleeBase;
+		m_top = base + fn->numRegs;
+		R = params;
+		pc = fn->code.data();
+		LEMNI_BC_DISPATCH();
+	}
+
+	LEMNI_BC_OP(callV){
+		if(auto budgetErr = enterCall(state)){
+			for(std::uint32_t i = 0; i < pc->imm; i++) clear(R[pc->c + i]);
+			LEMNI_BC_FAIL(*budgetErr);
+		}
+
+		auto callRes = callValue(R[pc->b], R + pc->c, pc->imm);
+		--state->depth;
+
+		// nested evaluations may have grown the register stack
+		R = m_regs.data() + base;
+
+		if(callRes.hasError){
+			LEMNI_BC_FAIL(callRes);
+		}
+
+		Reg res;
+		unbox(res, callRes.value);
+		clear(R[pc->a]);
+		R[pc->a] = res;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(product){
+		auto val = makeProduct(R + pc->b, pc->imm);
+		clear(R[pc->a]);
+		R[pc->a].tag = Tag::value;
+		R[pc->a].val = val;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(tree){
+		auto res = m_trees[pc->b]->eval(state, bindings);
+
+		R = m_regs.data() + base;
+
+		if(res.hasError){
+			LEMNI_BC_FAIL(res);
+		}
+
+		Reg val;
+		unbox(val, res.value);
+		clear(R[pc->a]);
+		R[pc->a] = val;
+		LEMNI_BC_NEXT();
+	}
+
+	LEMNI_BC_OP(ret){
+		Reg res = R[pc->a];
+		R[pc->a].tag = Tag::empty;
+
+		if(res.tag == Tag::value) res.val = detach(res.val, R, fn->numRegs);
+
+		for(std::uint32_t i = 0; i < fn->numRegs; i++) clear(R[i]);
+
+		if(m_frames.size() == entryFrames){
+			m_top = entryTop;
+			return makeResult(take(res));
+		}
+
+		auto frame = m_frames.back();
+		m_frames.pop_back();
+
+		--state->depth;
+
+		fn = frame.fn;
+		base = frame.base;
+		m_top = base + fn->numRegs;
+		R = m_regs.data() + base;
+		pc = frame.ret;
+
+		clear(R[frame.dst]);
+		R[frame.dst] = res;
+		LEMNI_BC_DISPATCH();
+	}
+
+#ifndef LEMNI_BC_COMPUTED_GOTO
+		default: break;
+	}
+
+	err = litError(LEMNICSTR("invalid bytecode instruction"));
+#endif
+
+#undef LEMNI_BC_FAIL
+#undef LEMNI_BC_NEXT
+#undef LEMNI_BC_DISPATCH
+#undef LEMNI_BC_OP
+
+error:
+	for(auto i = entryTop; i < m_top; i++){
+		clear(m_regs[i]);
+	}
+
+	m_frames.resize(entryFrames);
+	m_top = entryTop;
+	state->depth = entryDepth;
+
+	return err;
+}
@@ -0,0 +1,126 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_BYTECODE_HPP
+#define LEMNI_LIB_BYTECODE_HPP 1
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "lemni/eval.h"
+#include "lemni/Operator.h"
+
+#include "Scalar.hpp"
+
+/**
+ * Register bytecode used by \ref LEMNI_EVAL_BYTECODE .
+ *
+ * Each function gets a fixed window of registers on a shared register stack.
+ * Registers hold system sized scalars unboxed, anything else is kept as an owned ``LemniValue``.
+ * Operators on matching scalar registers are performed inline, everything else goes through the value API.
+ */
+namespace lemni::bc{
+	using RegId = std::uint32_t;
+	using FnId = std::uint32_t;
+
+	inline constexpr FnId noFn = std::numeric_limits<FnId>::max();
+
+	enum class Op: std::uint8_t{
+		loadK, //! ``a = consts[b]``
+		move, //! ``a = b``
+		unary, //! ``a = imm b``
+		binary, //! ``a = b imm c``
+		binaryK, //! ``a = b imm consts[c]``
+		jmp, //! ``pc = c``
+		jmpFalse, //! ``if !b: pc = c``
+		cmpJmp, //! ``if !(a imm b): pc = c``
+		cmpKJmp, //! ``if !(a imm consts[b]): pc = c``
+		call, //! ``a = fns[b](c, ..., c + imm)``
+		callV, //! ``a = b(c, ..., c + imm)``
+		product, //! ``a = (b, ..., b + imm)``
+		tree, //! ``a = eval(trees[b])``
+		ret, //! return ``a``
+		count
+	};
+
+	struct Inst{
+		Op op;
+		std::uint16_t imm; //! operator or argument count
+		std::uint32_t a, b, c;
+	};
+
+	struct Function{
+		LemniTypedFnDefExpr def; //! ``nullptr`` for top level expressions
+		std::uint32_t numParams = 0, numRegs = 0;
+		std::vector<Inst> code;
+	};
+
+	struct Frame{
+		const Function *fn;
+		const Inst *ret; //! where to resume the caller
+		std::uint32_t base; //! start of the caller's registers
+		RegId dst; //! caller register receiving the result
+	};
+
+	class Machine{
+		public:
+			Machine() = default;
+
+			Machine(const Machine&) = delete;
+
+			~Machine();
+
+			Machine &operator=(const Machine&) = delete;
+
+			/**
+			 * Compile \p expr to be run at the top level, results are cached per expression.
+			 * Returns \ref noFn if \p expr can not be compiled.
+			 */
+			FnId compile(LemniTypedExpr expr);
+
+			/**
+			 * Run the compiled top level expression \p fn .
+			 * Expressions that were left to the tree walker are evaluated with \p bindings .
+			 */
+			LemniEvalResult run(LemniEvalState state, LemniEvalBindings bindings, const FnId fn) noexcept;
+
+			//! Expressions that compiled code refers to
+			std::size_t numRoots() const noexcept;
+
+			void roots(LemniTypedExpr *const out) const noexcept;
+
+		private:
+			FnId function(LemniTypedFnDefExpr def);
+
+			friend struct Compiler;
+
+			std::vector<std::unique_ptr<Function>> m_fns;
+			std::unordered_map<LemniTypedFnDefExpr, FnId> m_fnIds;
+			std::unordered_map<LemniTypedExpr, FnId> m_programs;
+			std::vector<Reg> m_consts;
+			std::vector<LemniTypedExpr> m_trees;
+			std::vector<Reg> m_regs;
+			std::vector<Frame> m_frames;
+			std::uint32_t m_top = 0;
+	};
+}
+
+#endif // !LEMNI_LIB_BYTECODE_HPP
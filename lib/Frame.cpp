@@ -0,0 +1,160 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "TypedExpr.hpp"
+#include "Frame.hpp"
+
+using namespace lemni::frame;
+
+namespace {
+	constexpr std::uint32_t chunkSize = 4096;
+
+	void destroySlots(LemniValue *const first, LemniValue *const last) noexcept{
+		for(auto it = first; it != last; ++it){
+			if(*it){
+				lemniDestroyValue(*it);
+				*it = nullptr;
+			}
+		}
+	}
+}
+
+Layout::Layout(LemniTypedLambdaExpr lambda){
+	slots.reserve(lambda->params.size());
+
+	for(SlotId i = 0; i < lambda->params.size(); i++){
+		auto param = lambda->params[i];
+		param->slot = i;
+		slots.emplace_back(param);
+	}
+
+	std::vector<std::pair<LemniTypedExpr, bool>> pending{ { lambda->body, false } };
+	std::vector<LemniTypedExpr> children;
+
+	while(!pending.empty()){
+		auto [expr, inNested] = pending.back();
+		pending.pop_back();
+
+		// references lead out of the body
+		if(dynamic_cast<LemniTypedRefExpr>(expr)) continue;
+
+		if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(expr)){
+			// nested functions bind their locals in their own frames
+			nested.emplace_back(fnDef);
+			inNested = true;
+		}
+		else if(dynamic_cast<LemniTypedLambdaExpr>(expr)){
+			inNested = true;
+		}
+		else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr); binding && !inNested){
+			if(find(binding, binding->slot) == noSlot){
+				binding->slot = numSlots();
+				slots.emplace_back(binding);
+			}
+		}
+
+		children.clear();
+		expr->children(children);
+
+		for(auto child : children){
+			pending.emplace_back(child, inNested);
+		}
+	}
+}
+
+Stack::~Stack(){
+	for(auto &&chunk : m_chunks){
+		destroySlots(chunk.slots.get(), chunk.slots.get() + chunk.top);
+	}
+}
+
+LemniValue *Stack::push(const std::uint32_t n){
+	if(m_chunks.empty()){
+		const auto size = std::max(n, chunkSize);
+		m_chunks.emplace_back(Chunk{ std::make_unique<LemniValue[]>(size), size, 0 });
+	}
+	else if(m_chunks[m_chunk].size - m_chunks[m_chunk].top < n){
+		// windows don't straddle chunks, so continue in the next one
+		++m_chunk;
+
+		if(m_chunk == m_chunks.size() || m_chunks[m_chunk].size < n){
+			const auto size = std::max(n, chunkSize);
+			m_chunks.emplace_back(Chunk{ std::make_unique<LemniValue[]>(size), size, 0 });
+
+			// chunks past the top are empty, but may still hold arguments being moved by \ref replace
+			std::swap(m_chunks[m_chunk], m_chunks.back());
+		}
+	}
+
+	auto &&chunk = m_chunks[m_chunk];
+	auto slots = chunk.slots.get() + chunk.top;
+	chunk.top += n;
+	return slots;
+}
+
+void Stack::pop(const Mark m) noexcept{
+	if(m_chunks.empty()) return;
+
+	for(; m_chunk > m.chunk; --m_chunk){
+		auto &&chunk = m_chunks[m_chunk];
+		destroySlots(chunk.slots.get(), chunk.slots.get() + chunk.top);
+		chunk.top = 0;
+	}
+
+	auto &&chunk = m_chunks[m_chunk];
+	destroySlots(chunk.slots.get() + m.top, chunk.slots.get() + chunk.top);
+	chunk.top = m.top;
+}
+
+LemniValue *Stack::replace(const Mark m, LemniValue *const args, const std::uint32_t numArgs, const std::uint32_t n){
+	const auto isArg = [args, argsEnd = args + numArgs](LemniValue *const slot){
+		return !std::less<LemniValue*>()(slot, args) && std::less<LemniValue*>()(slot, argsEnd);
+	};
+
+	const auto release = [&isArg](Chunk &chunk, const std::uint32_t from){
+		for(auto it = chunk.slots.get() + from; it != chunk.slots.get() + chunk.top; ++it){
+			if(!isArg(it) && *it){
+				lemniDestroyValue(*it);
+				*it = nullptr;
+			}
+		}
+
+		chunk.top = from;
+	};
+
+	for(; m_chunk > m.chunk; --m_chunk){
+		release(m_chunks[m_chunk], 0);
+	}
+
+	release(m_chunks[m_chunk], m.top);
+
+	// the new window never starts after the arguments, so moving them forwards is safe
+	auto slots = push(n);
+
+	for(std::uint32_t i = 0; i < numArgs; i++){
+		auto val = args[i];
+		args[i] = nullptr;
+		slots[i] = val;
+	}
+
+	return slots;
+}
@@ -0,0 +1,110 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_FRAME_HPP
+#define LEMNI_LIB_FRAME_HPP 1
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "lemni/Value.h"
+#include "lemni/TypedExpr.h"
+
+/**
+ * Call frames of the tree walker.
+ *
+ * Parameters and local bindings of a function are resolved to slots once, on its first call.
+ * Frames are windows of slots on a \ref Stack that is reused between calls,
+ * so calls pass their arguments without allocating.
+ */
+namespace lemni::frame{
+	using SlotId = std::uint32_t;
+
+	inline constexpr SlotId noSlot = std::numeric_limits<SlotId>::max();
+
+	//! Slots of the frames of a function, its parameters followed by the local bindings of its body
+	struct Layout{
+		explicit Layout(LemniTypedLambdaExpr lambda);
+
+		/**
+		 * Get the slot of \p lval , or \ref noSlot if it isn't part of the frame.
+		 * \p hint is checked first, it should be the slot stored with \p lval .
+		 */
+		SlotId find(LemniTypedLValueExpr lval, const SlotId hint) const noexcept{
+			if(hint < slots.size() && slots[hint] == lval) return hint;
+
+			for(SlotId i = 0; i < slots.size(); i++){
+				if(slots[i] == lval) return i;
+			}
+
+			return noSlot;
+		}
+
+		SlotId numSlots() const noexcept{ return static_cast<SlotId>(slots.size()); }
+
+		std::vector<LemniTypedLValueExpr> slots;
+		std::vector<LemniTypedFnDefExpr> nested; //! function definitions within the body
+	};
+
+	/**
+	 * Stack of owned value slots.
+	 * Slots are kept in chunks that are never moved or freed while the stack lives,
+	 * so a pushed window stays valid until it is popped.
+	 */
+	class Stack{
+		public:
+			struct Mark{
+				std::uint32_t chunk, top;
+			};
+
+			Stack() = default;
+
+			Stack(const Stack&) = delete;
+
+			~Stack();
+
+			Stack &operator=(const Stack&) = delete;
+
+			Mark mark() const noexcept{ return { m_chunk, m_chunks.empty() ? 0 : m_chunks[m_chunk].top }; }
+
+			//! Push \p n contiguous empty slots
+			LemniValue *push(const std::uint32_t n);
+
+			//! Destroy the values in every slot pushed since \p m and pop them
+			void pop(const Mark m) noexcept;
+
+			/**
+			 * Pop every slot pushed since \p m , then push \p n slots starting with the \p numArgs values at \p args .
+			 * \p args must have been pushed after \p m , the other popped values are destroyed.
+			 */
+			LemniValue *replace(const Mark m, LemniValue *const args, const std::uint32_t numArgs, const std::uint32_t n);
+
+		private:
+			struct Chunk{
+				std::unique_ptr<LemniValue[]> slots;
+				std::uint32_t size, top;
+			};
+
+			std::vector<Chunk> m_chunks;
+			std::uint32_t m_chunk = 0;
+	};
+}
+
+#endif // !LEMNI_LIB_FRAME_HPP
@@ -0,0 +1,599 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <new>
+
+#include "fmt/format.h"
+
+#include "lemni/ir.h"
+
+#include "TypedExpr.hpp"
+#include "IR.hpp"
+
+using namespace lemni::ir;
+
+namespace {
+	/**
+	 * Lowering of typed expressions into a single IR function.
+	 *
+	 * Values of bindings and parameters are tracked in ``env``, names the function can not resolve are looked
+	 * up in the enclosing function and captured, anything else is a reference to a top-level definition.
+	 */
+	class Lowerer{
+		public:
+			Lowerer(LemniIRModule mod_, LemniIRFunction fn_, Lowerer *parent_ = nullptr)
+				: mod(mod_), fn(fn_), parent(parent_), current(fn_->addBlock()){}
+
+			bool lowerFunction(LemniTypedLambdaExpr lambda){
+				auto fnType = lambda->type();
+
+				fn->resultType = fnType->result();
+
+				for(std::uint32_t i = 0; i < lambda->params.size(); i++){
+					auto param = lambda->params[i];
+
+					Inst inst{ Op::param, param->type() };
+					inst.index = i;
+
+					fn->paramTypes.emplace_back(param->type());
+					env[param] = fn->add(current, std::move(inst));
+				}
+
+				return lowerValue(lambda->body);
+			}
+
+			bool lowerValue(LemniTypedExpr expr){
+				if(!fn->resultType) fn->resultType = expr->type();
+
+				auto value = lower(expr);
+				if(value == noValue) return false;
+
+				ret(value);
+				return true;
+			}
+
+			std::string error;
+			std::vector<ValueId> captured; //! captured values from the enclosing function
+
+		private:
+			ValueId emit(Inst inst){ return fn->add(current, std::move(inst)); }
+
+			void ret(ValueId value){
+				auto &&block = fn->blocks[current];
+				block.term = Term::ret;
+				block.value = value;
+			}
+
+			void jump(BlockId target){
+				auto &&block = fn->blocks[current];
+				block.term = Term::jump;
+				block.targets[0] = target;
+			}
+
+			ValueId fail(std::string msg){
+				if(error.empty()) error = std::move(msg);
+				return noValue;
+			}
+
+			//! Get the value of a binding or parameter in this function, capturing it if needed
+			ValueId lookup(LemniTypedExpr target){
+				auto res = env.find(target);
+				if(res != end(env)) return res->second;
+
+				auto captureRes = captures.find(target);
+				if(captureRes != end(captures)) return captureRes->second;
+
+				if(!parent) return noValue;
+
+				auto outer = parent->lookup(target);
+				if(outer == noValue) return noValue;
+
+				Inst inst{ Op::capture, target->type() };
+				inst.index = fn->numCaptures++;
+
+				auto id = ValueId(fn->insts.size());
+				fn->insts.emplace_back(std::move(inst));
+
+				auto &&entry = fn->blocks[0].insts;
+				entry.insert(begin(entry) + fn->paramTypes.size(), id);
+
+				captured.emplace_back(outer);
+				captures[target] = id;
+				return id;
+			}
+
+			ValueId lowerGlobal(LemniTypedLValueExpr target){
+				if(dynamic_cast<LemniTypedParamBindingExpr>(target)){
+					return fail(fmt::format("unbound parameter '{}'", target->id()));
+				}
+
+				Inst inst{ Op::global, target->type() };
+				inst.expr = target;
+
+				if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(target)){
+					inst.fn = lowerDef(fnDef);
+					if(!inst.fn) return noValue;
+				}
+
+				return emit(std::move(inst));
+			}
+
+			LemniIRFunction lowerDef(LemniTypedFnDefExpr fnDef);
+
+			ValueId lowerClosure(LemniTypedLambdaExpr lambda, std::string name){
+				mod->fns.emplace_back(std::make_unique<LemniIRFunctionT>());
+
+				auto closureFn = mod->fns.back().get();
+				closureFn->name = std::move(name);
+
+				auto inner = Lowerer(mod, closureFn, this);
+				if(!inner.lowerFunction(lambda)) return fail(std::move(inner.error));
+
+				Inst inst{ Op::closure, lambda->type() };
+				inst.fn = closureFn;
+				inst.args = std::move(inner.captured);
+
+				return emit(std::move(inst));
+			}
+
+			ValueId lowerRef(LemniTypedLValueExpr target){
+				while(auto ref = dynamic_cast<LemniTypedRefExpr>(target)){
+					target = ref->refed;
+				}
+
+				auto value = lookup(target);
+				if(value != noValue) return value;
+
+				return lowerGlobal(target);
+			}
+
+			ValueId lower(LemniTypedExpr expr){
+				if(auto ref = dynamic_cast<LemniTypedRefExpr>(expr)){
+					return lowerRef(ref);
+				}
+				else if(auto param = dynamic_cast<LemniTypedParamBindingExpr>(expr)){
+					return lowerRef(param);
+				}
+				else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+					auto value = lower(binding->value);
+					if(value == noValue) return noValue;
+
+					env[binding] = value;
+					return value;
+				}
+				else if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(expr)){
+					auto value = lowerClosure(fnDef->lambda, fmt::format("{}.{}", fn->name, fnDef->id()));
+					if(value == noValue) return noValue;
+
+					env[fnDef] = value;
+					return value;
+				}
+				else if(auto lambda = dynamic_cast<LemniTypedLambdaExpr>(expr)){
+					return lowerClosure(lambda, fmt::format("{}.$lambda{}", fn->name, mod->nextAnon++));
+				}
+				else if(auto extFn = dynamic_cast<LemniTypedExtFnDeclExpr>(expr)){
+					return lowerGlobal(extFn);
+				}
+				else if(auto export_ = dynamic_cast<LemniTypedExportExpr>(expr)){
+					return lower(export_->value);
+				}
+				else if(auto product = dynamic_cast<LemniTypedProductExpr>(expr)){
+					if(product->isConstant){
+						Inst inst{ Op::constant, product->type() };
+						inst.expr = product;
+						return emit(std::move(inst));
+					}
+
+					Inst inst{ Op::product, product->type() };
+					inst.args.reserve(product->elems.size());
+
+					for(auto elem : product->elems){
+						auto value = lower(elem);
+						if(value == noValue) return noValue;
+						inst.args.emplace_back(value);
+					}
+
+					return emit(std::move(inst));
+				}
+				else if(auto unary = dynamic_cast<LemniTypedUnaryOpExpr>(expr)){
+					auto value = lower(unary->value);
+					if(value == noValue) return noValue;
+
+					Inst inst{ Op::unary, unary->resultType };
+					inst.unaryOp = unary->op;
+					inst.args = { value };
+
+					return emit(std::move(inst));
+				}
+				else if(auto binary = dynamic_cast<LemniTypedBinaryOpExpr>(expr)){
+					auto lhs = lower(binary->lhs);
+					if(lhs == noValue) return noValue;
+
+					auto rhs = lower(binary->rhs);
+					if(rhs == noValue) return noValue;
+
+					Inst inst{ Op::binary, binary->resultType };
+					inst.binaryOp = binary->op;
+					inst.args = { lhs, rhs };
+
+					return emit(std::move(inst));
+				}
+				else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)){
+					// n-ary ops become a left-deep chain of binary ops
+					auto acc = lower(nary->operands[0]);
+					if(acc == noValue) return noValue;
+
+					for(std::size_t i = 1; i < nary->operands.size(); i++){
+						auto rhs = lower(nary->operands[i]);
+						if(rhs == noValue) return noValue;
+
+						Inst inst{ Op::binary, nary->resultType };
+						inst.binaryOp = nary->op;
+						inst.args = { acc, rhs };
+
+						acc = emit(std::move(inst));
+					}
+
+					return acc;
+				}
+				else if(auto app = dynamic_cast<LemniTypedApplicationExpr>(expr)){
+					Inst inst{ Op::call, app->resultType };
+					inst.args.reserve(app->args.size() + 1);
+					inst.pure = mod->effects && (lemniEffectOfCall(mod->effects, app->fn) == LEMNI_EFFECT_PURE);
+
+					auto callee = lower(app->fn);
+					if(callee == noValue) return noValue;
+
+					inst.args.emplace_back(callee);
+
+					for(auto arg : app->args){
+						auto value = lower(arg);
+						if(value == noValue) return noValue;
+						inst.args.emplace_back(value);
+					}
+
+					return emit(std::move(inst));
+				}
+				else if(auto branch = dynamic_cast<LemniTypedBranchExpr>(expr)){
+					auto cond = lower(branch->cond);
+					if(cond == noValue) return noValue;
+
+					auto trueBlock = fn->addBlock();
+					auto falseBlock = fn->addBlock();
+					auto joinBlock = fn->addBlock();
+
+					{
+						auto &&block = fn->blocks[current];
+						block.term = Term::branch;
+						block.value = cond;
+						block.targets[0] = trueBlock;
+						block.targets[1] = falseBlock;
+					}
+
+					Inst phi{ Op::phi, branch->resultType };
+
+					for(auto [arm, armBlock] : { std::pair{ branch->true_, trueBlock }, std::pair{ branch->false_, falseBlock } }){
+						current = armBlock;
+
+						auto value = lower(arm);
+						if(value == noValue) return noValue;
+
+						phi.args.emplace_back(value);
+						phi.blocks.emplace_back(current);
+
+						jump(joinBlock);
+					}
+
+					current = joinBlock;
+					return emit(std::move(phi));
+				}
+				else if(auto block = dynamic_cast<LemniTypedBlockExpr>(expr)){
+					ValueId value = noValue;
+
+					for(auto blockExpr : block->exprs){
+						value = lower(blockExpr);
+						if(value == noValue) return noValue;
+					}
+
+					if(value == noValue) return fail("can not lower empty block");
+
+					return value;
+				}
+				else if(auto return_ = dynamic_cast<LemniTypedReturnExpr>(expr)){
+					auto value = lower(return_->value);
+					if(value == noValue) return noValue;
+
+					ret(value);
+
+					// anything after a return is unreachable
+					current = fn->addBlock();
+					return value;
+				}
+				else if(dynamic_cast<LemniTypedConstantExpr>(expr)){
+					Inst inst{ Op::constant, expr->type() };
+					inst.expr = expr;
+					return emit(std::move(inst));
+				}
+				else{
+					return fail(fmt::format("can not lower expression '{}'", lemni::toStdStrView(expr->toStr())));
+				}
+			}
+
+			LemniIRModule mod;
+			LemniIRFunction fn;
+			Lowerer *parent;
+			BlockId current;
+			std::unordered_map<LemniTypedExpr, ValueId> env;
+			std::unordered_map<LemniTypedExpr, ValueId> captures;
+	};
+
+	LemniIRFunction Lowerer::lowerDef(LemniTypedFnDefExpr fnDef){
+		auto res = mod->defs.find(fnDef);
+		if(res != end(mod->defs)) return res->second;
+
+		mod->fns.emplace_back(std::make_unique<LemniIRFunctionT>());
+
+		auto defFn = mod->fns.back().get();
+		defFn->name = std::string(fnDef->id());
+
+		// registered first so recursive references resolve to this function
+		mod->defs[fnDef] = defFn;
+
+		auto defLowerer = Lowerer(mod, defFn);
+		if(!defLowerer.lowerFunction(fnDef->lambda)){
+			fail(std::move(defLowerer.error));
+			return nullptr;
+		}
+
+		return defFn;
+	}
+
+	//! Lowers top-level expressions, definitions are lowered through a temporary lowerer
+	LemniIRFunction lowerTopLevel(LemniIRModule mod, LemniTypedExpr expr, std::string &error){
+		if(auto export_ = dynamic_cast<LemniTypedExportExpr>(expr)){
+			expr = export_->value;
+		}
+
+		if(dynamic_cast<LemniTypedExtFnDeclExpr>(expr)){
+			error = "external functions can not be lowered";
+			return nullptr;
+		}
+
+		std::string name;
+
+		if(auto binding = dynamic_cast<const LemniTypedNamedExprT*>(expr)) name = std::string(binding->id());
+		else name = fmt::format("$expr{}", mod->nextAnon++);
+
+		mod->fns.emplace_back(std::make_unique<LemniIRFunctionT>());
+
+		auto fn = mod->fns.back().get();
+		fn->name = std::move(name);
+
+		auto lowerer = Lowerer(mod, fn);
+
+		bool ok;
+
+		if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(expr)){
+			mod->defs[fnDef] = fn;
+			ok = lowerer.lowerFunction(fnDef->lambda);
+		}
+		else{
+			ok = lowerer.lowerValue(expr);
+		}
+
+		if(!ok){
+			error = std::move(lowerer.error);
+			return nullptr;
+		}
+
+		return fn;
+	}
+
+	std::string_view unaryOpStr(LemniUnaryOp op){
+		switch(op){
+			case LEMNI_UNARY_NEG: return "neg";
+			case LEMNI_UNARY_NOT: return "not";
+			default: return "unknown";
+		}
+	}
+
+	std::string_view binaryOpStr(LemniBinaryOp op){
+		switch(op){
+			case LEMNI_BINARY_ADD: return "add";
+			case LEMNI_BINARY_SUB: return "sub";
+			case LEMNI_BINARY_MUL: return "mul";
+			case LEMNI_BINARY_DIV: return "div";
+			case LEMNI_BINARY_MOD: return "mod";
+			case LEMNI_BINARY_POW: return "pow";
+			case LEMNI_BINARY_CONCAT: return "concat";
+			case LEMNI_BINARY_AND: return "and";
+			case LEMNI_BINARY_OR: return "or";
+			case LEMNI_BINARY_EQ: return "eq";
+			case LEMNI_BINARY_NEQ: return "neq";
+			case LEMNI_BINARY_LT: return "lt";
+			case LEMNI_BINARY_LTEQ: return "lteq";
+			case LEMNI_BINARY_GT: return "gt";
+			case LEMNI_BINARY_GTEQ: return "gteq";
+			default: return "unknown";
+		}
+	}
+
+	std::string typeStr(LemniType type){
+		if(!type) return "?";
+		return lemni::toStdStr(type->str());
+	}
+
+	std::string argsStr(const std::vector<ValueId> &args, std::size_t from = 0){
+		std::string ret;
+
+		for(auto i = from; i < args.size(); i++){
+			if(i != from) ret += ", ";
+			ret += fmt::format("%{}", args[i]);
+		}
+
+		return ret;
+	}
+
+	std::string instStr(const Inst &inst){
+		switch(inst.op){
+			case Op::constant: return fmt::format("const {}", lemni::toStdStrView(inst.expr->toStr()));
+			case Op::param: return fmt::format("param {}", inst.index);
+			case Op::capture: return fmt::format("capture {}", inst.index);
+			case Op::global: return fmt::format("global @{}", dynamic_cast<LemniTypedLValueExpr>(inst.expr)->id());
+			case Op::closure: return fmt::format("closure @{} [{}]", inst.fn->name, argsStr(inst.args));
+			case Op::copy: return fmt::format("copy %{}", inst.args[0]);
+			case Op::unary: return fmt::format("{} %{}", unaryOpStr(inst.unaryOp), inst.args[0]);
+			case Op::binary: return fmt::format("{} %{}, %{}", binaryOpStr(inst.binaryOp), inst.args[0], inst.args[1]);
+			case Op::call: return fmt::format("call{} %{}({})", inst.pure ? " pure" : "", inst.args[0], argsStr(inst.args, 1));
+			case Op::product: return fmt::format("product ({})", argsStr(inst.args));
+
+			case Op::phi:{
+				std::string ret = "phi";
+
+				for(std::size_t i = 0; i < inst.args.size(); i++){
+					ret += fmt::format("{} [%{}, bb{}]", i == 0 ? "" : ",", inst.args[i], inst.blocks[i]);
+				}
+
+				return ret;
+			}
+
+			default: return "dead";
+		}
+	}
+}
+
+LemniIRModule lemniCreateIRModule(LemniEffectState effects){
+	auto mem = std::malloc(sizeof(LemniIRModuleT));
+	auto p = new(mem) LemniIRModuleT;
+
+	p->effects = effects;
+
+	return p;
+}
+
+void lemniDestroyIRModule(LemniIRModule mod){
+	std::destroy_at(mod);
+	std::free(mod);
+}
+
+LemniIRLowerResult lemniIRLower(LemniIRModule mod, LemniTypedExpr expr){
+	LemniIRLowerResult res;
+
+	if(!expr){
+		res.hasError = true;
+		res.error.msg = LEMNICSTR("no expression to lower");
+		return res;
+	}
+
+	auto res_ = mod->defs.find(expr);
+	if(res_ != end(mod->defs)){
+		res.hasError = false;
+		res.fn = res_->second;
+		return res;
+	}
+
+	auto numFns = mod->fns.size();
+
+	std::string error;
+
+	auto fn = lowerTopLevel(mod, expr, error);
+
+	if(!fn){
+		// drop every function created for the failed expression
+		for(auto it = begin(mod->defs); it != end(mod->defs);){
+			bool created = std::any_of(
+				begin(mod->fns) + numFns, end(mod->fns),
+				[it](auto &&ptr){ return ptr.get() == it->second; }
+			);
+
+			if(created) it = mod->defs.erase(it);
+			else ++it;
+		}
+
+		mod->fns.resize(numFns);
+
+		mod->lastError = std::move(error);
+
+		res.hasError = true;
+		res.error.msg = lemni::fromStdStrView(mod->lastError);
+		return res;
+	}
+
+	res.hasError = false;
+	res.fn = fn;
+	return res;
+}
+
+LemniNat64 lemniIRModuleNumFunctions(LemniIRModuleConst mod){ return mod->fns.size(); }
+
+LemniIRFunction lemniIRModuleFunction(LemniIRModule mod, const LemniNat64 idx){
+	if(idx >= mod->fns.size()) return nullptr;
+	return mod->fns[idx].get();
+}
+
+LemniStr lemniIRFunctionName(LemniIRFunctionConst fn){ return lemni::fromStdStrView(fn->name); }
+
+LemniNat64 lemniIRFunctionNumInsts(LemniIRFunctionConst fn){
+	LemniNat64 ret = 0;
+
+	for(auto &&block : fn->blocks){
+		ret += block.insts.size();
+	}
+
+	return ret;
+}
+
+LemniNat64 lemniIRFunctionNumBlocks(LemniIRFunctionConst fn){ return fn->blocks.size(); }
+
+LemniStr lemniIRFunctionStr(LemniIRFunction fn){
+	std::string params;
+
+	for(std::size_t i = 0; i < fn->paramTypes.size(); i++){
+		if(i != 0) params += ", ";
+		params += typeStr(fn->paramTypes[i]);
+	}
+
+	auto &&str = fn->str;
+
+	str = fmt::format("fn @{}({}) -> {} {{\n", fn->name, params, typeStr(fn->resultType));
+
+	for(BlockId i = 0; i < fn->blocks.size(); i++){
+		auto &&block = fn->blocks[i];
+
+		str += fmt::format("bb{}:\n", i);
+
+		for(auto id : block.insts){
+			auto &&inst = fn->insts[id];
+			str += fmt::format("\t%{} = {} : {}\n", id, instStr(inst), typeStr(inst.type));
+		}
+
+		switch(block.term){
+			case Term::jump: str += fmt::format("\tjmp bb{}\n", block.targets[0]); break;
+			case Term::branch: str += fmt::format("\tbr %{}, bb{}, bb{}\n", block.value, block.targets[0], block.targets[1]); break;
+			case Term::ret: str += fmt::format("\tret %{}\n", block.value); break;
+			default: str += "\tunreachable\n"; break;
+		}
+	}
+
+	str += "}\n";
+
+	return lemni::fromStdStrView(str);
+}
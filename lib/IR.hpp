@@ -0,0 +1,155 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_IR_HPP
+#define LEMNI_LIB_IR_HPP 1
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "lemni/ir.h"
+#include "lemni/Operator.h"
+#include "lemni/Type.h"
+
+namespace lemni::ir{
+	using ValueId = std::uint32_t;
+	using BlockId = std::uint32_t;
+
+	inline constexpr ValueId noValue = std::numeric_limits<ValueId>::max();
+
+	enum class Op{
+		constant, //! literal ``expr``
+		param, //! parameter number ``index``
+		capture, //! captured value number ``index`` of the enclosing closure
+		global, //! top-level definition ``expr``, lowered to ``fn`` if it is a function definition
+		closure, //! closure of ``fn`` capturing ``args``
+		copy, //! value of ``args[0]``
+		unary, //! ``unaryOp`` applied to ``args[0]``
+		binary, //! ``binaryOp`` applied to ``args[0]`` and ``args[1]``
+		call, //! call of ``args[0]`` with the remaining ``args``
+		product, //! product of ``args``
+		phi, //! ``args[i]`` when entered from ``blocks[i]``
+		dead //! removed instruction
+	};
+
+	struct Inst{
+		Op op;
+		LemniType type;
+		std::vector<ValueId> args = {};
+		std::vector<BlockId> blocks = {};
+		LemniTypedExpr expr = nullptr;
+		LemniIRFunction fn = nullptr;
+		std::uint32_t index = 0;
+		LemniUnaryOp unaryOp = LEMNI_UNARY_OP_UNRECOGNIZED;
+		LemniBinaryOp binaryOp = LEMNI_BINARY_OP_UNRECOGNIZED;
+		bool pure = true; //! whether the instruction may be removed when unused
+	};
+
+	enum class Term{
+		none, jump, branch, ret
+	};
+
+	struct Block{
+		std::vector<ValueId> insts;
+		Term term = Term::none;
+		ValueId value = noValue; //! branch condition or returned value
+		BlockId targets[2] = { 0, 0 };
+
+		std::size_t numTargets() const noexcept{
+			switch(term){
+				case Term::jump: return 1;
+				case Term::branch: return 2;
+				default: return 0;
+			}
+		}
+	};
+}
+
+struct LemniIRFunctionT{
+	using ValueId = lemni::ir::ValueId;
+	using BlockId = lemni::ir::BlockId;
+
+	BlockId addBlock(){
+		blocks.emplace_back();
+		return BlockId(blocks.size() - 1);
+	}
+
+	ValueId add(BlockId block, lemni::ir::Inst inst){
+		auto id = ValueId(insts.size());
+		insts.emplace_back(std::move(inst));
+		blocks[block].insts.emplace_back(id);
+		return id;
+	}
+
+	//! Replace every use of \p from with \p to
+	void replaceUses(ValueId from, ValueId to){
+		for(auto &&inst : insts){
+			for(auto &&arg : inst.args){
+				if(arg == from) arg = to;
+			}
+		}
+
+		for(auto &&block : blocks){
+			if(block.value == from) block.value = to;
+		}
+	}
+
+	//! Remove an instruction, its uses must already be gone
+	void kill(ValueId id){
+		auto &&inst = insts[id];
+		inst.op = lemni::ir::Op::dead;
+		inst.args.clear();
+		inst.blocks.clear();
+	}
+
+	//! Get the predecessors of every block
+	std::vector<std::vector<BlockId>> predecessors() const{
+		std::vector<std::vector<BlockId>> ret(blocks.size());
+
+		for(BlockId i = 0; i < blocks.size(); i++){
+			auto &&block = blocks[i];
+			for(std::size_t j = 0; j < block.numTargets(); j++){
+				ret[block.targets[j]].emplace_back(i);
+			}
+		}
+
+		return ret;
+	}
+
+	std::string name;
+	std::vector<LemniType> paramTypes;
+	LemniType resultType = nullptr;
+	std::vector<lemni::ir::Inst> insts;
+	std::vector<lemni::ir::Block> blocks;
+	std::uint32_t numCaptures = 0;
+	std::string str;
+};
+
+struct LemniIRModuleT{
+	LemniEffectState effects = nullptr;
+	std::vector<std::unique_ptr<LemniIRFunctionT>> fns;
+	std::unordered_map<LemniTypedExpr, LemniIRFunction> defs;
+	std::size_t nextAnon = 0;
+	std::string lastError;
+};
+
+#endif // !LEMNI_LIB_IR_HPP
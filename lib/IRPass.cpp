@@ -0,0 +1,413 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <new>
+#include <optional>
+
+#include "lemni/ir.h"
+
+#include "TypedExpr.hpp"
+#include "IR.hpp"
+
+using namespace lemni::ir;
+
+struct LemniIRPassManagerT{
+	static constexpr std::size_t maxIterations = 16;
+
+	struct Pass{
+		LemniIRPassFn fn;
+		void *user;
+	};
+
+	std::vector<Pass> passes;
+};
+
+namespace {
+	std::optional<bool> boolConstant(const Inst &inst){
+		if(inst.op != Op::constant) return std::nullopt;
+
+		auto boolExpr = dynamic_cast<const LemniTypedBoolExprT*>(inst.expr);
+		if(!boolExpr) return std::nullopt;
+
+		return boolExpr->value == LEMNI_TRUE;
+	}
+
+	//! Check for a fixed size integer constant equal to \p value
+	bool isIntConstant(const Inst &inst, const int value){
+		if(inst.op != Op::constant) return false;
+
+		auto expr = inst.expr;
+
+		if(auto nat16 = dynamic_cast<const LemniTypedNat16ExprT*>(expr)) return nat16->value == LemniNat16(value);
+		if(auto nat32 = dynamic_cast<const LemniTypedNat32ExprT*>(expr)) return nat32->value == LemniNat32(value);
+		if(auto nat64 = dynamic_cast<const LemniTypedNat64ExprT*>(expr)) return nat64->value == LemniNat64(value);
+		if(auto int16 = dynamic_cast<const LemniTypedInt16ExprT*>(expr)) return int16->value == value;
+		if(auto int32 = dynamic_cast<const LemniTypedInt32ExprT*>(expr)) return int32->value == value;
+		if(auto int64 = dynamic_cast<const LemniTypedInt64ExprT*>(expr)) return int64->value == value;
+
+		return false;
+	}
+
+	//! Forget the incoming values of phis in \p target that come from \p from
+	void removeIncoming(LemniIRFunction fn, BlockId target, BlockId from){
+		for(auto id : fn->blocks[target].insts){
+			auto &&inst = fn->insts[id];
+			if(inst.op != Op::phi) continue;
+
+			for(std::size_t i = 0; i < inst.blocks.size();){
+				if(inst.blocks[i] == from){
+					inst.blocks.erase(begin(inst.blocks) + i);
+					inst.args.erase(begin(inst.args) + i);
+				}
+				else{
+					++i;
+				}
+			}
+		}
+	}
+
+	void turnIntoCopy(Inst &inst, ValueId value){
+		inst.op = Op::copy;
+		inst.args = { value };
+		inst.blocks.clear();
+		inst.pure = true;
+	}
+
+	//! Value an identity operation reduces to, if any
+	ValueId binaryIdentity(LemniIRFunction fn, const Inst &inst){
+		auto lhs = inst.args[0], rhs = inst.args[1];
+		auto &&lhsInst = fn->insts[lhs];
+		auto &&rhsInst = fn->insts[rhs];
+
+		// the identity must not change the type of the result
+		auto sameType = [&](ValueId id){ return (fn->insts[id].type == inst.type) ? id : noValue; };
+
+		switch(inst.binaryOp){
+			case LEMNI_BINARY_ADD:
+				if(isIntConstant(rhsInst, 0)) return sameType(lhs);
+				if(isIntConstant(lhsInst, 0)) return sameType(rhs);
+				break;
+
+			case LEMNI_BINARY_SUB:
+				if(isIntConstant(rhsInst, 0)) return sameType(lhs);
+				break;
+
+			case LEMNI_BINARY_MUL:
+				if(isIntConstant(rhsInst, 1)) return sameType(lhs);
+				if(isIntConstant(lhsInst, 1)) return sameType(rhs);
+				break;
+
+			case LEMNI_BINARY_DIV:
+				if(isIntConstant(rhsInst, 1)) return sameType(lhs);
+				break;
+
+			case LEMNI_BINARY_AND:
+				if(boolConstant(rhsInst) == true) return sameType(lhs);
+				if(boolConstant(lhsInst) == true) return sameType(rhs);
+				break;
+
+			case LEMNI_BINARY_OR:
+				if(boolConstant(rhsInst) == false) return sameType(lhs);
+				if(boolConstant(lhsInst) == false) return sameType(rhs);
+				break;
+
+			default: break;
+		}
+
+		return noValue;
+	}
+
+	bool simplify(LemniIRFunction fn, void*){
+		bool changed = false;
+
+		for(BlockId i = 0; i < fn->blocks.size(); i++){
+			auto &&block = fn->blocks[i];
+			if(block.term != Term::branch) continue;
+
+			if(block.targets[0] == block.targets[1]){
+				block.term = Term::jump;
+				block.value = noValue;
+				changed = true;
+				continue;
+			}
+
+			auto cond = boolConstant(fn->insts[block.value]);
+			if(!cond) continue;
+
+			auto taken = block.targets[*cond ? 0 : 1];
+			auto notTaken = block.targets[*cond ? 1 : 0];
+
+			removeIncoming(fn, notTaken, i);
+
+			block.term = Term::jump;
+			block.value = noValue;
+			block.targets[0] = taken;
+			changed = true;
+		}
+
+		auto preds = fn->predecessors();
+
+		for(BlockId i = 0; i < fn->blocks.size(); i++){
+			for(auto id : fn->blocks[i].insts){
+				auto &&inst = fn->insts[id];
+
+				if(inst.op == Op::phi){
+					for(std::size_t j = 0; j < inst.blocks.size();){
+						auto &&blockPreds = preds[i];
+						if(std::find(begin(blockPreds), end(blockPreds), inst.blocks[j]) == end(blockPreds)){
+							inst.blocks.erase(begin(inst.blocks) + j);
+							inst.args.erase(begin(inst.args) + j);
+							changed = true;
+						}
+						else{
+							++j;
+						}
+					}
+
+					ValueId unique = noValue;
+					bool isUnique = true;
+
+					for(auto arg : inst.args){
+						if(arg == id || arg == unique) continue;
+
+						if(unique != noValue){
+							isUnique = false;
+							break;
+						}
+
+						unique = arg;
+					}
+
+					if(isUnique && unique != noValue){
+						turnIntoCopy(inst, unique);
+						changed = true;
+					}
+				}
+				else if(inst.op == Op::binary){
+					auto value = binaryIdentity(fn, inst);
+
+					if(value != noValue){
+						turnIntoCopy(inst, value);
+						changed = true;
+					}
+				}
+			}
+		}
+
+		return changed;
+	}
+
+	bool copyProp(LemniIRFunction fn, void*){
+		bool changed = false;
+
+		for(auto &&block : fn->blocks){
+			for(auto it = begin(block.insts); it != end(block.insts);){
+				auto id = *it;
+				if(fn->insts[id].op != Op::copy){
+					++it;
+					continue;
+				}
+
+				auto root = fn->insts[id].args[0];
+
+				while(fn->insts[root].op == Op::copy && root != id){
+					root = fn->insts[root].args[0];
+				}
+
+				// a copy of itself only happens in unreachable loops
+				if(root == id){
+					++it;
+					continue;
+				}
+
+				fn->replaceUses(id, root);
+				fn->kill(id);
+
+				it = block.insts.erase(it);
+				changed = true;
+			}
+		}
+
+		return changed;
+	}
+
+	bool removeUnreachable(LemniIRFunction fn){
+		std::vector<bool> reachable(fn->blocks.size(), false);
+		std::vector<BlockId> work = { 0 };
+
+		reachable[0] = true;
+
+		while(!work.empty()){
+			auto &&block = fn->blocks[work.back()];
+			work.pop_back();
+
+			for(std::size_t i = 0; i < block.numTargets(); i++){
+				auto target = block.targets[i];
+				if(!reachable[target]){
+					reachable[target] = true;
+					work.emplace_back(target);
+				}
+			}
+		}
+
+		if(std::all_of(begin(reachable), end(reachable), [](bool b){ return b; })) return false;
+
+		std::vector<BlockId> remap(fn->blocks.size(), 0);
+		std::vector<Block> newBlocks;
+
+		for(BlockId i = 0; i < fn->blocks.size(); i++){
+			auto &&block = fn->blocks[i];
+
+			if(!reachable[i]){
+				for(std::size_t j = 0; j < block.numTargets(); j++){
+					if(reachable[block.targets[j]]) removeIncoming(fn, block.targets[j], i);
+				}
+
+				for(auto id : block.insts) fn->kill(id);
+				continue;
+			}
+
+			remap[i] = BlockId(newBlocks.size());
+			newBlocks.emplace_back(std::move(block));
+		}
+
+		for(auto &&block : newBlocks){
+			for(std::size_t j = 0; j < block.numTargets(); j++){
+				block.targets[j] = remap[block.targets[j]];
+			}
+
+			for(auto id : block.insts){
+				for(auto &&incoming : fn->insts[id].blocks){
+					incoming = remap[incoming];
+				}
+			}
+		}
+
+		fn->blocks = std::move(newBlocks);
+		return true;
+	}
+
+	bool dce(LemniIRFunction fn, void*){
+		bool changed = removeUnreachable(fn);
+
+		std::vector<bool> live(fn->insts.size(), false);
+		std::vector<ValueId> work;
+
+		auto markLive = [&](ValueId id){
+			if(id == noValue || live[id]) return;
+			live[id] = true;
+			work.emplace_back(id);
+		};
+
+		for(auto &&block : fn->blocks){
+			for(auto id : block.insts){
+				if(!fn->insts[id].pure) markLive(id);
+			}
+
+			if(block.term == Term::branch || block.term == Term::ret) markLive(block.value);
+		}
+
+		while(!work.empty()){
+			auto id = work.back();
+			work.pop_back();
+
+			for(auto arg : fn->insts[id].args){
+				markLive(arg);
+			}
+		}
+
+		for(auto &&block : fn->blocks){
+			auto deadBegin = std::remove_if(
+				begin(block.insts), end(block.insts),
+				[&](ValueId id){
+					if(live[id]) return false;
+					fn->kill(id);
+					return true;
+				}
+			);
+
+			if(deadBegin != end(block.insts)){
+				block.insts.erase(deadBegin, end(block.insts));
+				changed = true;
+			}
+		}
+
+		return changed;
+	}
+}
+
+LemniIRPassManager lemniCreateIRPassManager(){
+	auto mem = std::malloc(sizeof(LemniIRPassManagerT));
+	return new(mem) LemniIRPassManagerT;
+}
+
+void lemniDestroyIRPassManager(LemniIRPassManager pm){
+	std::destroy_at(pm);
+	std::free(pm);
+}
+
+void lemniIRPassManagerAdd(LemniIRPassManager pm, const LemniIRPass pass){
+	switch(pass){
+		case LEMNI_IR_PASS_SIMPLIFY: lemniIRPassManagerAddCustom(pm, simplify, nullptr); break;
+		case LEMNI_IR_PASS_COPY_PROP: lemniIRPassManagerAddCustom(pm, copyProp, nullptr); break;
+		case LEMNI_IR_PASS_DCE: lemniIRPassManagerAddCustom(pm, dce, nullptr); break;
+		default: break;
+	}
+}
+
+void lemniIRPassManagerAddCustom(LemniIRPassManager pm, LemniIRPassFn fn, void *user){
+	if(!fn) return;
+	pm->passes.emplace_back(LemniIRPassManagerT::Pass{ fn, user });
+}
+
+void lemniIRPassManagerAddDefaults(LemniIRPassManager pm){
+	lemniIRPassManagerAdd(pm, LEMNI_IR_PASS_SIMPLIFY);
+	lemniIRPassManagerAdd(pm, LEMNI_IR_PASS_COPY_PROP);
+	lemniIRPassManagerAdd(pm, LEMNI_IR_PASS_DCE);
+}
+
+bool lemniIRPassManagerRun(LemniIRPassManager pm, LemniIRFunction fn){
+	bool changed = false;
+
+	for(std::size_t i = 0; i < LemniIRPassManagerT::maxIterations; i++){
+		bool iterChanged = false;
+
+		for(auto &&pass : pm->passes){
+			if(pass.fn(fn, pass.user)) iterChanged = true;
+		}
+
+		if(!iterChanged) break;
+
+		changed = true;
+	}
+
+	return changed;
+}
+
+bool lemniIRPassManagerRunModule(LemniIRPassManager pm, LemniIRModule mod){
+	bool changed = false;
+
+	for(auto &&fn : mod->fns){
+		if(lemniIRPassManagerRun(pm, fn.get())) changed = true;
+	}
+
+	return changed;
+}
@@ -75,94 +75,108 @@ inline llvm::Type *lemniFindLLVMType(LemniLLVMState state, const LemniType type)
 }
 
 inline llvm::Type *lemniMakeLLVMType(LemniLLVMState state, const LemniType type){
-	if(lemniTypeAsUnit(type)){
-		auto unitTStruct = llvm::StructType::create(state->ctx, "UnitT");
-		auto unitTTy = unitTStruct->getPointerTo();
-		return unitTTy;
-	}
-	else if(lemniTypeAsNat(type) || lemniTypeAsInt(type)){
-		auto numBits = lemniTypeNumBits(type);
+	switch(lemniTypeKind(type)){
+		case LEMNI_TYPE_KIND_UNIT:{
+			auto unitTStruct = llvm::StructType::create(state->ctx, "UnitT");
+			auto unitTTy = unitTStruct->getPointerTo();
+			return unitTTy;
+		}
 
-		if((numBits == 0) || (numBits > 64)){
-			return nullptr;
+		case LEMNI_TYPE_KIND_NAT:
+		case LEMNI_TYPE_KIND_INT:{
+			auto numBits = lemniTypeNumBits(type);
+
+			if((numBits == 0) || (numBits > 64)){
+				return nullptr;
+			}
+
+			return llvm::Type::getIntNTy(state->ctx, numBits);
 		}
 
-		return llvm::Type::getIntNTy(state->ctx, numBits);
-	}
-	else if(lemniTypeAsRatio(type)){
-		auto numBits = lemniTypeNumBits(type);
+		case LEMNI_TYPE_KIND_RATIO:{
+			auto numBits = lemniTypeNumBits(type);
 
-		if((numBits == 0) || (numBits > 128)){
-			return nullptr;
+			if((numBits == 0) || (numBits > 128)){
+				return nullptr;
+			}
+
+			auto halfBits = numBits / 2;
+
+			std::vector<llvm::Type*> fieldTypes = {
+				llvm::Type::getIntNTy(state->ctx, halfBits),
+				llvm::Type::getIntNTy(state->ctx, halfBits)
+			};
+
+			auto ratioName = "Ratio" + std::to_string(numBits);
+
+			return llvm::StructType::create(state->ctx, fieldTypes, ratioName);
 		}
 
-		auto halfBits = numBits / 2;
+		case LEMNI_TYPE_KIND_REAL:{
+			auto numBits = lemniTypeNumBits(type);
 
-		std::vector<llvm::Type*> fieldTypes = {
-			llvm::Type::getIntNTy(state->ctx, halfBits),
-			llvm::Type::getIntNTy(state->ctx, halfBits)
-		};
+			switch(numBits){
+				case 32: return llvm::Type::getFloatTy(state->ctx);
+				case 64: return llvm::Type::getDoubleTy(state->ctx);
+				default: return nullptr;
+			}
+		}
 
-		auto ratioName = "Ratio" + std::to_string(numBits);
+		case LEMNI_TYPE_KIND_STRING_UTF8:{
+			std::vector<llvm::Type*> fieldTypes = {
+				llvm::Type::getInt8PtrTy(state->ctx),
+				llvm::Type::getIntNTy(state->ctx, 64)
+			};
 
-		return llvm::StructType::create(state->ctx, fieldTypes, ratioName);
-	}
-	else if(lemniTypeAsReal(type)){
-		auto numBits = lemniTypeNumBits(type);
+			return llvm::StructType::create(state->ctx, fieldTypes, "StringUTF8");
+		}
+
+		case LEMNI_TYPE_KIND_STRING_ASCII:{
+			std::vector<llvm::Type*> fieldTypes = {
+				llvm::Type::getInt8PtrTy(state->ctx),
+				llvm::Type::getIntNTy(state->ctx, 64)
+			};
 
-		switch(numBits){
-			case 32: return llvm::Type::getFloatTy(state->ctx);
-			case 64: return llvm::Type::getDoubleTy(state->ctx);
-			default: return nullptr;
+			return llvm::StructType::create(state->ctx, fieldTypes, "StringASCII");
 		}
-	}
-	else if(lemniTypeAsStringUTF8(type)){
-		std::vector<llvm::Type*> fieldTypes = {
-			llvm::Type::getInt8PtrTy(state->ctx),
-			llvm::Type::getIntNTy(state->ctx, 64)
-		};
 
-		return llvm::StructType::create(state->ctx, fieldTypes, "StringUTF8");
-	}
-	else if(lemniTypeAsStringASCII(type)){
-		std::vector<llvm::Type*> fieldTypes = {
-			llvm::Type::getInt8PtrTy(state->ctx),
-			llvm::Type::getIntNTy(state->ctx, 64)
-		};
+		case LEMNI_TYPE_KIND_PRODUCT:{
+			auto prod = lemniTypeAsProduct(type);
+			auto numComps = lemniProductTypeNumComponents(prod);
 
-		return llvm::StructType::create(state->ctx, fieldTypes, "StringASCII");
-	}
-	else if(auto prod = lemniTypeAsProduct(type)){
-		auto numComps = lemniProductTypeNumComponents(prod);
+			std::vector<llvm::Type*> fieldTypes;
+			fieldTypes.reserve(numComps);
 
-		std::vector<llvm::Type*> fieldTypes;
-		fieldTypes.reserve(numComps);
+			for(std::uint32_t i = 0; i < numComps; i++){
+				auto comp = lemniProductTypeComponent(prod, i);
+				auto ty = lemniLLVMType(state, comp);
+				fieldTypes.emplace_back(ty);
+			}
 
-		for(std::uint32_t i = 0; i < numComps; i++){
-			auto comp = lemniProductTypeComponent(prod, i);
-			auto ty = lemniLLVMType(state, comp);
-			fieldTypes.emplace_back(ty);
+			auto prodMangled = lemni::toStdStr(lemniTypeMangled(type));
+
+			return llvm::StructType::create(state->ctx, fieldTypes, prodMangled);
 		}
 
-		auto prodMangled = lemni::toStdStr(lemniTypeMangled(type));
+		case LEMNI_TYPE_KIND_FUNCTION:{
+			auto fn = lemniTypeAsFunction(type);
+			auto retTy = lemniLLVMType(state, lemniFunctionTypeResult(fn));
+			auto numParams = lemniFunctionTypeNumParams(fn);
 
-		return llvm::StructType::create(state->ctx, fieldTypes, prodMangled);
-	}
-	else if(auto fn = lemniTypeAsFunction(type)){
-		auto retTy = lemniLLVMType(state, lemniFunctionTypeResult(fn));
-		auto numParams = lemniFunctionTypeNumParams(fn);
+			std::vector<llvm::Type*> paramTypes;
+			paramTypes.reserve(numParams);
 
-		std::vector<llvm::Type*> paramTypes;
-		paramTypes.reserve(numParams);
+			for(std::uint32_t i = 0; i < numParams; i++){
+				paramTypes.emplace_back(lemniLLVMType(state, lemniFunctionTypeParam(fn, i)));
+			}
 
-		for(std::uint32_t i = 0; i < numParams; i++){
-			paramTypes.emplace_back(lemniLLVMType(state, lemniFunctionTypeParam(fn, i)));
+			return llvm::FunctionType::get(retTy, paramTypes, false);
 		}
 
-		return llvm::FunctionType::get(retTy, paramTypes, false);
-	}
-	else{
-		assert(!"type not representable");
+		default:{
+			assert(!"type not representable");
+			return nullptr;
+		}
 	}
 }
 
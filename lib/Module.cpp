@@ -4,19 +4,28 @@
 
 namespace fs = std::filesystem;
 
+#include "fmt/format.h"
+
 #include "lemni/lex.h"
 #include "lemni/parse.h"
 #include "lemni/typecheck.h"
+#include "lemni/optimize.h"
 #include "lemni/compile.h"
 #include "lemni/Module.h"
 
+#include "Expr.hpp"
 #include "TypedExpr.hpp"
+#include "typecheck.hpp"
 
 LEMNI_OPAQUE_T_DEF(LemniModule){
 	std::string id;
 	LemniTypecheckState state;
 	std::vector<LemniTypedExpr> exprs;
 	std::vector<std::unique_ptr<std::string>> errMsgs;
+	LemniParseState parseState = nullptr;
+	std::map<std::string, LemniExpr, std::less<>> pending;
+	std::vector<std::string> pendingOrder;
+	std::string lazyError;
 };
 
 LEMNI_OPAQUE_T_DEF(LemniModuleMap){
@@ -25,6 +34,7 @@ LEMNI_OPAQUE_T_DEF(LemniModuleMap){
 	std::map<std::string, std::string, std::less<>> aliased;
 	std::map<std::string, LemniModule, std::less<>> mapped;
 	std::map<std::string, LemniModule, std::less<>> registered;
+	bool lazy = false;
 };
 
 LEMNI_OPAQUE_T_DEF(LemniRuntime){
@@ -44,6 +54,7 @@ LemniModule lemniCreateModule(LemniModuleMap mods, const LemniStr id){
 
 void lemniDestroyModule(LemniModule module){
 	lemniDestroyTypecheckState(module->state);
+	if(module->parseState) lemniDestroyParseState(module->parseState);
 	std::destroy_at(module);
 	std::free(module);
 }
@@ -60,19 +71,115 @@ LemniTypecheckStateConst lemniModuleTypecheckState(LemniModuleConst mod){
 	return mod->state;
 }
 
+void lemniModuleSetProfiling(LemniModule mod, const bool enabled){
+	lemniTypecheckStateSetProfiling(mod->state, enabled);
+}
+
 size_t lemniModuleNumExprs(LemniModule mod){ return mod->exprs.size(); }
 
 LemniTypedExpr *lemniModuleExprs(LemniModule mod){ return mod->exprs.data(); }
 
+namespace {
+	//! Optimize a typechecked top-level expression and keep it in the module
+	LemniTypecheckResult addTypechecked(LemniModule mod, LemniTypecheckResult res){
+		if(res.hasError) return res;
+
+		res.expr = lemniOptimizeFuseChains(mod->state, res.expr);
+		res.expr = lemniOptimizeInline(mod->state, res.expr);
+		res.expr = lemniOptimizeCSE(mod->state, res.expr);
+		res.expr = lemniOptimizeFlatten(mod->state, res.expr);
+
+		mod->exprs.emplace_back(res.expr);
+		lemniTypecheckStatePin(mod->state, res.expr);
+
+		return res;
+	}
+}
+
 LemniTypecheckResult lemniModuleTypecheck(LemniModule mod, LemniExpr expr){
-	auto res = lemniTypecheck(mod->state, expr);
-	if(res.hasError) return res;
+	return addTypechecked(mod, lemniTypecheck(mod->state, expr));
+}
+
+namespace {
+	//! Typecheck a pending definition the first time its name is resolved
+	LemniTypedLValueExpr resolvePending(void *user, LemniStr name){
+		auto mod = reinterpret_cast<LemniModule>(user);
+
+		mod->lazyError.clear();
+
+		auto res = mod->pending.find(lemni::toStdStrView(name));
+		if(res == end(mod->pending)) return nullptr;
+
+		auto expr = res->second;
+
+		// removed first so references from within the definition are not resolved again
+		mod->pending.erase(res);
+
+		// resolved while another definition is mid-typecheck, so it must not reclaim that definition's nodes
+		auto typeRes = addTypechecked(mod, typecheckNested(mod->state, expr));
+		if(typeRes.hasError){
+			mod->lazyError = fmt::format(
+				"{}.{}: {}",
+				typeRes.error.loc.line, typeRes.error.loc.col, lemni::toStdStrView(typeRes.error.msg)
+			);
+
+			return nullptr;
+		}
+
+		auto lvalue = dynamic_cast<LemniTypedLValueExpr>(typeRes.expr);
+		if(!lvalue) return nullptr;
+
+		// function definitions are not added to the scope by typechecking, cache them for later lookups
+		lemniScopeSet(lemniTypecheckStateScope(mod->state), lvalue);
+
+		return lvalue;
+	}
+
+	//! Index a top-level definition by name instead of typechecking it, returns ``false`` for other expressions
+	bool deferDefinition(LemniModule mod, LemniExpr expr){
+		if(!dynamic_cast<const LemniFnDefExprT*>(expr) && !dynamic_cast<const LemniBindingExprT*>(expr)){
+			return false;
+		}
+
+		auto id = dynamic_cast<const LemniLValueExprT*>(expr)->id;
+
+		auto res = mod->pending.try_emplace(id, expr);
+		if(!res.second) return false;
+
+		mod->pendingOrder.emplace_back(std::move(id));
+		return true;
+	}
+}
+
+LemniNat64 lemniModuleNumPending(LemniModuleConst mod){ return mod->pending.size(); }
 
-	mod->exprs.emplace_back(res.expr);
+LemniTypecheckResult lemniModuleTypecheckPending(LemniModule mod){
+	LemniTypecheckResult res;
+	res.hasError = false;
+	res.expr = nullptr;
+
+	for(auto &&id : mod->pendingOrder){
+		auto pendingRes = mod->pending.find(id);
+		if(pendingRes == end(mod->pending)) continue;
+
+		auto expr = pendingRes->second;
+		mod->pending.erase(pendingRes);
+
+		auto typeRes = lemniModuleTypecheck(mod, expr);
+		if(typeRes.hasError) return typeRes;
+
+		if(auto lvalue = dynamic_cast<LemniTypedLValueExpr>(typeRes.expr)){
+			lemniScopeSet(lemniTypecheckStateScope(mod->state), lvalue);
+		}
+	}
+
+	mod->pendingOrder.clear();
 
 	return res;
 }
 
+LemniStr lemniModuleLazyError(LemniModuleConst mod){ return lemni::fromStdStrView(mod->lazyError); }
+
 LemniTypedExtFnDeclExpr lemniModuleCreateExtFn(
 	LemniModule mod, const LemniStr name, void *const ptr,
 	LemniType resultType,
@@ -85,7 +192,16 @@ LemniTypedExtFnDeclExpr lemniModuleCreateExtFn(
 }
 
 LemniCompileResult lemniModuleJITCompile(LemniModule module){
-	auto state = lemniCreateCompileState(nullptr);
+	auto pendingRes = lemniModuleTypecheckPending(module);
+	if(pendingRes.hasError){
+		LemniCompileResult res;
+		res.hasError = true;
+		res.error.loc = pendingRes.error.loc;
+		res.error.msg = pendingRes.error.msg;
+		return res;
+	}
+
+	auto state = lemniCreateCompileState(lemniModuleTypeSet(module), nullptr);
 
 	auto res = lemniCompile(state, module->exprs.data(), module->exprs.size());
 	if(res.hasError){
@@ -121,6 +237,10 @@ LemniTypeSet lemniModuleMapTypes(LemniModuleMap mods){
 	return mods->types;
 }
 
+void lemniModuleMapSetLazy(LemniModuleMap mods, const bool lazy){
+	mods->lazy = lazy;
+}
+
 // TODO: fix states holding error strings dying
 LemniModuleResult lemniLoadModule(LemniModuleMap mods, const LemniStr id){
 	LemniModuleResult res;
@@ -183,7 +303,10 @@ LemniModuleResult lemniLoadModule(LemniModuleMap mods, const LemniStr id){
 		toks.emplace_back(lexRes.token);
 	}
 
-	auto parseState = lemni::ParseState();
+	auto parseState = lemniCreateParseState();
+
+	// parsed expressions must outlive the parse state while definitions are pending
+	auto parseStateOwner = std::unique_ptr<LemniParseStateT, void(*)(LemniParseState)>(parseState, lemniDestroyParseState);
 
 	std::vector<LemniExpr> exprs;
 
@@ -205,7 +328,14 @@ LemniModuleResult lemniLoadModule(LemniModuleMap mods, const LemniStr id){
 
 	auto mod = lemniCreateModule(mods, id);
 
+	if(mods->lazy){
+		mod->parseState = parseStateOwner.release();
+		lemniScopeSetResolver(lemniTypecheckStateScope(mod->state), resolvePending, mod);
+	}
+
 	for(auto expr : exprs){
+		if(mods->lazy && deferDefinition(mod, expr)) continue;
+
 		auto typeRes = lemniModuleTypecheck(mod, expr);
 		if(typeRes.hasError){
 			res.resType = LEMNI_MODULE_TYPECHECK_ERROR;
@@ -0,0 +1,252 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_SCALAR_HPP
+#define LEMNI_LIB_SCALAR_HPP 1
+
+#include <cstdint>
+#include <typeinfo>
+
+#include "lemni/Operator.h"
+
+#include "Value.hpp"
+
+/**
+ * Unboxed system sized scalars and operators on them.
+ * The operators mirror the promotions of the value API exactly,
+ * they are shared by the bytecode machine and the specializing tree walker.
+ */
+namespace lemni::bc{
+	enum class Tag: std::uint8_t{
+		empty,
+		bool_,
+		nat16, nat32, nat64,
+		int16, int32, int64,
+		real32, real64,
+		value
+	};
+
+	struct Reg{
+		Tag tag = Tag::empty;
+		union{
+			LemniBool b;
+			LemniNat16 n16;
+			LemniNat32 n32;
+			LemniNat64 n64;
+			LemniInt16 z16;
+			LemniInt32 z32;
+			LemniInt64 z64;
+			LemniReal32 r32;
+			LemniReal64 r64;
+			LemniValue val; //! owned
+		};
+	};
+
+#define LEMNI_BC_SCALARS(f)\
+	f(LemniBool, bool_, b, LemniValueBoolT)\
+	f(LemniNat16, nat16, n16, LemniBasicValueNat<16>)\
+	f(LemniNat32, nat32, n32, LemniBasicValueNat<32>)\
+	f(LemniNat64, nat64, n64, LemniBasicValueNat<64>)\
+	f(LemniInt16, int16, z16, LemniBasicValueInt<16>)\
+	f(LemniInt32, int32, z32, LemniBasicValueInt<32>)\
+	f(LemniInt64, int64, z64, LemniBasicValueInt<64>)\
+	f(LemniReal32, real32, r32, LemniBasicValueReal<32>)\
+	f(LemniReal64, real64, r64, LemniBasicValueReal<64>)
+
+	template<typename T>
+	struct RegTraits;
+
+#define LEMNI_BC_REG_TRAITS(type, tag_, member, boxed)\
+	template<>\
+	struct RegTraits<type>{\
+		using Boxed = boxed;\
+		static constexpr Tag tag = Tag::tag_;\
+		static void set(Reg &reg, const type value) noexcept{ reg.tag = tag; reg.member = value; }\
+	};
+
+	LEMNI_BC_SCALARS(LEMNI_BC_REG_TRAITS)
+
+#undef LEMNI_BC_REG_TRAITS
+
+	template<typename T>
+	inline void set(Reg &reg, const T value) noexcept{ RegTraits<T>::set(reg, value); }
+
+	inline void clear(Reg &reg) noexcept{
+		if(reg.tag == Tag::value) lemniDestroyValue(reg.val);
+		reg.tag = Tag::empty;
+	}
+
+	//! Get an owned value for \p reg , leaving it empty
+	inline LemniValue take(Reg &reg) noexcept{
+		switch(reg.tag){
+#define LEMNI_BC_TAKE(type, tag_, member, boxed)\
+			case Tag::tag_: reg.tag = Tag::empty; return lemni::detail::createLemniValue(reg.member);
+
+			LEMNI_BC_SCALARS(LEMNI_BC_TAKE)
+
+#undef LEMNI_BC_TAKE
+
+			case Tag::value:{
+				reg.tag = Tag::empty;
+				return reg.val;
+			}
+
+			default: return lemniCreateValueUnit();
+		}
+	}
+
+	//! Store the owned \p value in the empty register \p reg , unboxing it if possible
+	inline void unbox(Reg &reg, LemniValue value) noexcept{
+		auto refed = value->deref();
+		auto &&type = typeid(*refed);
+
+#define LEMNI_BC_UNBOX(type_, tag_, member, boxed)\
+		if(type == typeid(boxed)){\
+			set(reg, static_cast<const boxed*>(refed)->value);\
+			lemniDestroyValue(value);\
+			return;\
+		}
+
+		LEMNI_BC_SCALARS(LEMNI_BC_UNBOX)
+
+#undef LEMNI_BC_UNBOX
+
+		reg.tag = Tag::value;
+		reg.val = value;
+	}
+
+	template<typename L, typename R>
+	inline bool compare(const LemniBinaryOp op, const L lhs, const R rhs, Reg &out) noexcept{
+		switch(op){
+			case LEMNI_BINARY_LT: set<LemniBool>(out, lhs < rhs); return true;
+			case LEMNI_BINARY_GT: set<LemniBool>(out, lhs > rhs); return true;
+			case LEMNI_BINARY_LTEQ: set<LemniBool>(out, lhs <= rhs); return true;
+			case LEMNI_BINARY_GTEQ: set<LemniBool>(out, lhs >= rhs); return true;
+			case LEMNI_BINARY_EQ: set<LemniBool>(out, lhs == rhs); return true;
+			case LEMNI_BINARY_NEQ: set<LemniBool>(out, lhs != rhs); return true;
+			default: return false;
+		}
+	}
+
+	/**
+	 * Mirrors the sized arithmetic of the value API:
+	 * sums and products promote to ``Sum``, differences to ``Diff`` and quotients are left to the value API.
+	 */
+	template<typename Sum, typename Diff, typename L, typename R>
+	inline bool sizedArith(const LemniBinaryOp op, const L lhs, const R rhs, Reg &out) noexcept{
+		switch(op){
+			case LEMNI_BINARY_ADD: set<Sum>(out, Sum(lhs) + Sum(rhs)); return true;
+			case LEMNI_BINARY_SUB: set<Diff>(out, Diff(Diff(lhs) - Diff(rhs))); return true;
+			case LEMNI_BINARY_MUL: set<Sum>(out, Sum(lhs) * Sum(rhs)); return true;
+			default: return compare(op, lhs, rhs, out);
+		}
+	}
+
+	inline bool realArith(const LemniBinaryOp op, const LemniReal64 lhs, const LemniReal64 rhs, Reg &out) noexcept{
+		switch(op){
+			case LEMNI_BINARY_ADD: set<LemniReal64>(out, lhs + rhs); return true;
+			case LEMNI_BINARY_SUB: set<LemniReal64>(out, lhs - rhs); return true;
+			case LEMNI_BINARY_MUL: set<LemniReal64>(out, lhs * rhs); return true;
+			case LEMNI_BINARY_DIV: set<LemniReal64>(out, lhs / rhs); return true;
+			default: return compare(op, lhs, rhs, out);
+		}
+	}
+
+	/**
+	 * Perform \p op on scalar registers without boxing.
+	 * Only pairs whose result fits a system sized scalar are handled here, returns ``false`` for everything else.
+	 */
+	inline bool fastBinary(const LemniBinaryOp op, const Reg &lhs, const Reg &rhs, Reg &out) noexcept{
+		switch(lhs.tag){
+			case Tag::bool_:{
+				if(rhs.tag != Tag::bool_) return false;
+
+				switch(op){
+					case LEMNI_BINARY_AND: set<LemniBool>(out, lhs.b && rhs.b); return true;
+					case LEMNI_BINARY_OR: set<LemniBool>(out, lhs.b || rhs.b); return true;
+					case LEMNI_BINARY_EQ: set<LemniBool>(out, lhs.b == rhs.b); return true;
+					case LEMNI_BINARY_NEQ: set<LemniBool>(out, lhs.b != rhs.b); return true;
+					default: return false;
+				}
+			}
+
+			case Tag::nat16:{
+				switch(rhs.tag){
+					case Tag::nat16: return sizedArith<LemniNat32, LemniInt32>(op, lhs.n16, rhs.n16, out);
+					case Tag::nat32: return sizedArith<LemniNat64, LemniInt64>(op, lhs.n16, rhs.n32, out);
+					default: return false;
+				}
+			}
+
+			case Tag::nat32:{
+				switch(rhs.tag){
+					case Tag::nat16: return sizedArith<LemniNat64, LemniInt64>(op, lhs.n32, rhs.n16, out);
+					case Tag::nat32: return sizedArith<LemniNat64, LemniInt64>(op, lhs.n32, rhs.n32, out);
+					default: return false;
+				}
+			}
+
+			// sized integer arithmetic promotes to naturals in the value API
+			case Tag::int16:{
+				switch(rhs.tag){
+					case Tag::int16: return sizedArith<LemniNat32, LemniNat32>(op, lhs.z16, rhs.z16, out);
+					case Tag::int32: return sizedArith<LemniNat64, LemniNat64>(op, lhs.z16, rhs.z32, out);
+					default: return false;
+				}
+			}
+
+			case Tag::int32:{
+				switch(rhs.tag){
+					case Tag::int16: return sizedArith<LemniNat64, LemniNat64>(op, lhs.z32, rhs.z16, out);
+					case Tag::int32: return sizedArith<LemniNat64, LemniNat64>(op, lhs.z32, rhs.z32, out);
+					default: return false;
+				}
+			}
+
+			case Tag::real32:{
+				if(rhs.tag != Tag::real32) return false;
+				return realArith(op, lhs.r32, rhs.r32, out);
+			}
+
+			default: return false;
+		}
+	}
+
+	inline bool fastUnary(const LemniUnaryOp op, const Reg &val, Reg &out) noexcept{
+		if(op == LEMNI_UNARY_NOT){
+			if(val.tag != Tag::bool_) return false;
+			set<LemniBool>(out, !val.b);
+			return true;
+		}
+		else if(op != LEMNI_UNARY_NEG){
+			return false;
+		}
+
+		switch(val.tag){
+			case Tag::nat16: set<LemniInt32>(out, -LemniInt32(val.n16)); return true;
+			case Tag::nat32: set<LemniInt64>(out, -LemniInt64(val.n32)); return true;
+			case Tag::int16: set<LemniInt16>(out, LemniInt16(-val.z16)); return true;
+			case Tag::int32: set<LemniInt32>(out, LemniInt32(0u - LemniNat32(val.z32))); return true;
+			case Tag::int64: set<LemniInt64>(out, LemniInt64(0u - LemniNat64(val.z64))); return true;
+			case Tag::real32: set<LemniReal64>(out, -LemniReal64(val.r32)); return true;
+			default: return false;
+		}
+	}
+}
+
+#endif // !LEMNI_LIB_SCALAR_HPP
@@ -26,6 +26,8 @@
 struct LemniScopeT{
 	LemniScopeConst parent;
 	std::unordered_map<std::string, LemniTypedLValueExpr> table;
+	LemniScopeResolveFn resolve = nullptr;
+	void *resolveUser = nullptr;
 };
 
 LemniScope lemniCreateScope(LemniScopeConst parent){
@@ -47,7 +49,12 @@ LemniTypedLValueExpr lemniScopeFind(LemniScopeConst s, LemniStr name){
 	if(res != end(s->table)){
 		return res->second;
 	}
-	else if(s->parent){
+
+	if(s->resolve){
+		if(auto resolved = s->resolve(s->resolveUser, name)) return resolved;
+	}
+
+	if(s->parent){
 		return lemniScopeFind(s->parent, name);
 	}
 	else{
@@ -64,3 +71,14 @@ bool lemniScopeSet(LemniScope s, LemniTypedLValueExpr expr){
 	auto res = s->table.try_emplace(lemni::toStdStr(id), expr);
 	return res.second;
 }
+
+void lemniScopeSetResolver(LemniScope s, LemniScopeResolveFn fn, void *user){
+	s->resolve = fn;
+	s->resolveUser = user;
+}
+
+void lemniScopeVisit(LemniScopeConst s, LemniScopeVisitFn fn, void *user){
+	for(auto &&entry : s->table){
+		fn(user, entry.second);
+	}
+}
@@ -0,0 +1,234 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <optional>
+#include <type_traits>
+#include <typeinfo>
+
+#include "lemni/Value.h"
+
+#include "Specialize.hpp"
+#include "Scalar.hpp"
+#include "Value.hpp"
+
+using namespace lemni::spec;
+
+namespace {
+	using Nat16 = LemniBasicValueNat<16>;
+	using Nat32 = LemniBasicValueNat<32>;
+	using Nat64 = LemniBasicValueNat<64>;
+	using Int16 = LemniBasicValueInt<16>;
+	using Int32 = LemniBasicValueInt<32>;
+	using Int64 = LemniBasicValueInt<64>;
+	using ANat = LemniValueANatT;
+	using AInt = LemniValueAIntT;
+
+	template<typename T>
+	using Boxed = typename lemni::bc::RegTraits<T>::Boxed;
+
+	template<typename T>
+	inline bool is(LemniValue val) noexcept{ return typeid(*val) == typeid(T); }
+
+	bool genericUnary(const LemniUnaryOp op, LemniValue val, LemniValue &out) noexcept{
+		out = lemniValueUnaryOp(op, val);
+		return true;
+	}
+
+	bool genericBinary(const LemniBinaryOp op, LemniValue lhs, LemniValue rhs, LemniValue &out) noexcept{
+		out = lemniValueBinaryOp(op, lhs, rhs);
+		return true;
+	}
+
+	//! Unary operator on a system sized scalar, see \ref lemni::bc::fastUnary
+	template<typename T>
+	bool scalarUnary(const LemniUnaryOp op, LemniValue val, LemniValue &out) noexcept{
+		auto refed = val->deref();
+		if(!is<Boxed<T>>(refed)) return false;
+
+		lemni::bc::Reg reg, res;
+		lemni::bc::set(reg, static_cast<const Boxed<T>*>(refed)->value);
+
+		out = lemni::bc::fastUnary(op, reg, res) ? lemni::bc::take(res) : lemniValueUnaryOp(op, val);
+		return true;
+	}
+
+	//! Binary operator on system sized scalars, see \ref lemni::bc::fastBinary
+	template<typename L, typename R>
+	bool scalarBinary(const LemniBinaryOp op, LemniValue lhs, LemniValue rhs, LemniValue &out) noexcept{
+		auto lhsRefed = lhs->deref(), rhsRefed = rhs->deref();
+		if(!is<Boxed<L>>(lhsRefed) || !is<Boxed<R>>(rhsRefed)) return false;
+
+		lemni::bc::Reg lhsReg, rhsReg, res;
+		lemni::bc::set(lhsReg, static_cast<const Boxed<L>*>(lhsRefed)->value);
+		lemni::bc::set(rhsReg, static_cast<const Boxed<R>*>(rhsRefed)->value);
+
+		out = lemni::bc::fastBinary(op, lhsReg, rhsReg, res) ? lemni::bc::take(res) : lemniValueBinaryOp(op, lhs, rhs);
+		return true;
+	}
+
+	//! Get \p val as an arbitrary precision integer, sized values are converted into \p tmp
+	template<typename T>
+	inline const lemni::AInt &bigOperand(LemniValue val, std::optional<lemni::AInt> &tmp) noexcept{
+		auto typed = static_cast<const T*>(val);
+
+		if constexpr(std::is_same_v<decltype(typed->value), lemni::AInt>){
+			return typed->value;
+		}
+		else{
+			using Value = decltype(typed->value);
+			using Wide = std::conditional_t<std::is_signed_v<Value>, LemniInt64, LemniNat64>;
+			return tmp.emplace(Wide(typed->value));
+		}
+	}
+
+	/**
+	 * Arbitrary precision arithmetic, as the value API does it once an operand needs 64 bits or more.
+	 * Differences are integers and quotients ratios, sums and products are naturals if \p Natural .
+	 */
+	template<bool Natural, typename L, typename R>
+	bool bigBinary(const LemniBinaryOp op, LemniValue lhs, LemniValue rhs, LemniValue &out) noexcept{
+		auto lhsRefed = lhs->deref(), rhsRefed = rhs->deref();
+		if(!is<L>(lhsRefed) || !is<R>(rhsRefed)) return false;
+
+		std::optional<lemni::AInt> lhsTmp, rhsTmp;
+		auto &&lhsVal = bigOperand<L>(lhsRefed, lhsTmp);
+		auto &&rhsVal = bigOperand<R>(rhsRefed, rhsTmp);
+
+		auto sum = [](const lemni::AInt &res){
+			return Natural ? lemniCreateValueANat(res.handle()) : lemniCreateValueAInt(res.handle());
+		};
+
+		switch(op){
+			case LEMNI_BINARY_ADD: out = sum(lhsVal + rhsVal); break;
+			case LEMNI_BINARY_SUB: out = lemniCreateValueAInt((lhsVal - rhsVal).handle()); break;
+			case LEMNI_BINARY_MUL: out = sum(lhsVal * rhsVal); break;
+			case LEMNI_BINARY_DIV: out = lemniCreateValueARatio(lemni::ARatio(lhsVal, rhsVal).handle()); break;
+			case LEMNI_BINARY_LT: out = lemniCreateValueBool(lhsVal < rhsVal); break;
+			case LEMNI_BINARY_GT: out = lemniCreateValueBool(lhsVal > rhsVal); break;
+			case LEMNI_BINARY_LTEQ: out = lemniCreateValueBool(lhsVal <= rhsVal); break;
+			case LEMNI_BINARY_GTEQ: out = lemniCreateValueBool(lhsVal >= rhsVal); break;
+			case LEMNI_BINARY_EQ: out = lemniCreateValueBool(lhsVal == rhsVal); break;
+			case LEMNI_BINARY_NEQ: out = lemniCreateValueBool(lhsVal != rhsVal); break;
+			default: out = lemniValueBinaryOp(op, lhs, rhs); break;
+		}
+
+		return true;
+	}
+
+	template<bool Natural, typename L, typename ... Rs>
+	inline BinaryFn selectBig(LemniValue rhs) noexcept{
+		BinaryFn fn = nullptr;
+		((fn = (!fn && is<Rs>(rhs)) ? bigBinary<Natural, L, Rs> : fn), ...);
+		return fn;
+	}
+
+	template<typename L>
+	BinaryFn selectBigLhs(LemniValue rhs) noexcept{
+		if constexpr(std::is_same_v<L, AInt>){
+			// arbitrary integers absorb any natural or integer operand
+			return selectBig<false, L, Nat16, Nat32, Nat64, ANat, Int16, Int32, Int64, AInt>(rhs);
+		}
+		else if constexpr(std::is_same_v<L, Nat64> || std::is_same_v<L, ANat>){
+			if(auto fn = selectBig<true, L, Nat16, Nat32, Nat64, ANat>(rhs)) return fn;
+			return selectBig<false, L, Int16, Int32, Int64, AInt>(rhs);
+		}
+		else{
+			return selectBig<true, L, Nat64, ANat>(rhs);
+		}
+	}
+
+	UnaryFn selectUnary(LemniValue val) noexcept{
+#define LEMNI_SPEC_SELECT_UNARY(type, tag, member, boxed)\
+		if(is<boxed>(val)) return scalarUnary<type>;
+
+		LEMNI_BC_SCALARS(LEMNI_SPEC_SELECT_UNARY)
+
+#undef LEMNI_SPEC_SELECT_UNARY
+
+		return genericUnary;
+	}
+
+	BinaryFn selectBinary(LemniValue lhs, LemniValue rhs) noexcept{
+		// pairs that lemni::bc::fastBinary performs unboxed
+#define LEMNI_SPEC_SCALAR_PAIRS(f)\
+		f(LemniBool, LemniBool)\
+		f(LemniNat16, LemniNat16) f(LemniNat16, LemniNat32) f(LemniNat32, LemniNat16) f(LemniNat32, LemniNat32)\
+		f(LemniInt16, LemniInt16) f(LemniInt16, LemniInt32) f(LemniInt32, LemniInt16) f(LemniInt32, LemniInt32)\
+		f(LemniReal32, LemniReal32)
+
+#define LEMNI_SPEC_SELECT_SCALAR(L, R)\
+		if(is<Boxed<L>>(lhs) && is<Boxed<R>>(rhs)) return scalarBinary<L, R>;
+
+		LEMNI_SPEC_SCALAR_PAIRS(LEMNI_SPEC_SELECT_SCALAR)
+
+#undef LEMNI_SPEC_SELECT_SCALAR
+#undef LEMNI_SPEC_SCALAR_PAIRS
+
+		BinaryFn fn = nullptr;
+
+		if(is<Nat16>(lhs)) fn = selectBigLhs<Nat16>(rhs);
+		else if(is<Nat32>(lhs)) fn = selectBigLhs<Nat32>(rhs);
+		else if(is<Nat64>(lhs)) fn = selectBigLhs<Nat64>(rhs);
+		else if(is<ANat>(lhs)) fn = selectBigLhs<ANat>(rhs);
+		else if(is<AInt>(lhs)) fn = selectBigLhs<AInt>(rhs);
+
+		return fn ? fn : genericBinary;
+	}
+}
+
+LemniValue lemni::spec::unaryOp(UnarySite &site, const LemniUnaryOp op, LemniValue val) noexcept{
+	LemniValue out;
+	if(site.fn && site.fn(op, val, out)) return out;
+
+	// first execution or a failed guard
+	if(site.fn && ++site.numRewrites >= maxRewrites) site.fn = genericUnary;
+	else site.fn = selectUnary(val->deref());
+
+	site.fn(op, val, out);
+	return out;
+}
+
+LemniValue lemni::spec::binaryOp(BinarySite &site, const LemniBinaryOp op, LemniValue lhs, LemniValue rhs) noexcept{
+	LemniValue out;
+	if(site.fn && site.fn(op, lhs, rhs, out)) return out;
+
+	// first execution or a failed guard
+	if(site.fn && ++site.numRewrites >= maxRewrites) site.fn = genericBinary;
+	else site.fn = selectBinary(lhs->deref(), rhs->deref());
+
+	site.fn(op, lhs, rhs, out);
+	return out;
+}
+
+LemniTypedFnDefExpr lemni::spec::directCallee(CallSite &site, LemniTypedExpr fn) noexcept{
+	if(site.generic) return nullptr;
+
+	auto refed = fn->deref();
+	if(refed == site.callee) return site.callee;
+
+	// first execution or the reference was retargeted
+	if(site.callee && ++site.numRewrites >= maxRewrites){
+		site.generic = true;
+		return nullptr;
+	}
+
+	site.callee = dynamic_cast<LemniTypedFnDefExpr>(refed);
+	if(!site.callee) site.generic = true;
+
+	return site.callee;
+}
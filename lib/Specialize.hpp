@@ -0,0 +1,73 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_SPECIALIZE_HPP
+#define LEMNI_LIB_SPECIALIZE_HPP 1
+
+#include <cstdint>
+
+#include "lemni/Value.h"
+#include "lemni/Operator.h"
+#include "lemni/TypedExpr.h"
+
+/**
+ * Self-specializing evaluation sites used by \ref LEMNI_EVAL_SPECIALIZING .
+ *
+ * On its first execution a site is rewritten to a handler specialized for the operands it saw.
+ * Handlers guard their assumptions, a failed guard rewrites the site for the new operands.
+ * After \ref maxRewrites failed guards the site settles on the generic value API.
+ */
+namespace lemni::spec{
+	inline constexpr std::uint8_t maxRewrites = 4;
+
+	//! Returns ``false`` without performing \p op if the operands fail the handler's guard
+	using UnaryFn = bool(*)(const LemniUnaryOp op, LemniValue val, LemniValue &out) noexcept;
+
+	//! Returns ``false`` without performing \p op if the operands fail the handler's guard
+	using BinaryFn = bool(*)(const LemniBinaryOp op, LemniValue lhs, LemniValue rhs, LemniValue &out) noexcept;
+
+	struct UnarySite{
+		UnaryFn fn = nullptr;
+		std::uint8_t numRewrites = 0;
+	};
+
+	struct BinarySite{
+		BinaryFn fn = nullptr;
+		std::uint8_t numRewrites = 0;
+	};
+
+	struct CallSite{
+		LemniTypedFnDefExpr callee = nullptr;
+		std::uint8_t numRewrites = 0;
+		bool generic = false;
+	};
+
+	//! Perform \p op through \p site , rewriting it if needed
+	LemniValue unaryOp(UnarySite &site, const LemniUnaryOp op, LemniValue val) noexcept;
+
+	//! Perform \p op through \p site , rewriting it if needed
+	LemniValue binaryOp(BinarySite &site, const LemniBinaryOp op, LemniValue lhs, LemniValue rhs) noexcept;
+
+	/**
+	 * Get the function definition that the callee expression \p fn refers to.
+	 * Returns ``nullptr`` if the callee must be evaluated and called as a value.
+	 */
+	LemniTypedFnDefExpr directCallee(CallSite &site, LemniTypedExpr fn) noexcept;
+}
+
+#endif // !LEMNI_LIB_SPECIALIZE_HPP
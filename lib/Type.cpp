@@ -16,13 +16,23 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <cstdint>
 #include <cstdlib>
 #include <new>
 #include <memory>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <optional>
 #include <algorithm>
+#include <bit>
 #include <numeric>
+#include <string_view>
 
 #include "lemni/Str.h"
 
@@ -148,99 +158,112 @@ LemniStr lemniTypeMangled(LemniType type){ return type->mangled(); }
 LemniType lemniTypeBase(LemniType type){ return type->base(); }
 LemniType lemniTypeAbstract(LemniType type){ return type->abstract(); }
 uint32_t lemniTypeNumBits(LemniType type){ return type->numBits(); }
+LemniTypeKind lemniTypeKind(LemniType type){ return type->kind(); }
 uint64_t lemniTypeInfoIndex(LemniType type){ return type->typeIdx(); }
 
-LemniTopType lemniTypeAsTop(LemniType type){ return dynamic_cast<LemniTopType>(type); }
+LemniTopType lemniTypeAsTop(LemniType type){ return lemniTypeAsKind<LemniTopTypeT>(type, LEMNI_TYPE_KIND_TOP); }
 LemniType lemniTopAsType(LemniTopType top){ return top; }
 
-LemniBottomType lemniTypeAsBottom(LemniType type){ return dynamic_cast<LemniBottomType>(type); }
+LemniExprType lemniTypeAsExpr(LemniType type){ return lemniTypeAsKind<LemniExprTypeT>(type, LEMNI_TYPE_KIND_EXPR); }
+LemniTopType lemniExprTypeBase(LemniExprType expr){ return reinterpret_cast<LemniTopType>(expr->base()); }
+LemniType lemniExprAsType(LemniExprType expr){ return expr; }
+
+LemniErrorType lemniTypeAsError(LemniType type){ return lemniTypeAsKind<LemniErrorTypeT>(type, LEMNI_TYPE_KIND_ERROR); }
+LemniTopType lemniErrorTypeBase(LemniErrorType error){ return reinterpret_cast<LemniTopType>(error->base()); }
+LemniType lemniErrorAsType(LemniErrorType error){ return error; }
+
+LemniModuleType lemniTypeAsModule(LemniType type){ return lemniTypeAsKind<LemniModuleTypeT>(type, LEMNI_TYPE_KIND_MODULE); }
+LemniTopType lemniModuleTypeBase(LemniModuleType mod){ return reinterpret_cast<LemniTopType>(mod->base()); }
+LemniType lemniModuleAsType(LemniModuleType mod){ return mod; }
+
+LemniBottomType lemniTypeAsBottom(LemniType type){ return lemniTypeAsKind<LemniBottomTypeT>(type, LEMNI_TYPE_KIND_BOTTOM); }
 LemniTopType lemniBottomTypeBase(LemniBottomType bottom){ return reinterpret_cast<LemniTopType>(bottom->base()); }
 LemniType lemniBottomAsType(LemniBottomType bottom){ return bottom; }
 
-LemniPseudoType lemniTypeAsPseudo(LemniType type){ return dynamic_cast<LemniPseudoType>(type); }
+LemniPseudoType lemniTypeAsPseudo(LemniType type){ return lemniTypeAsKind<LemniPseudoTypeT>(type, LEMNI_TYPE_KIND_PSEUDO); }
 LemniTopType lemniPseudoTypeBase(LemniPseudoType pseudo){ return reinterpret_cast<LemniTopType>(pseudo->base()); }
 LemniType lemniPseudoAsType(LemniPseudoType pseudo){ return pseudo; }
 
-LemniMetaType lemniTypeAsMeta(LemniType type){ return dynamic_cast<LemniMetaType>(type); }
+LemniMetaType lemniTypeAsMeta(LemniType type){ return lemniTypeAsKind<LemniMetaTypeT>(type, LEMNI_TYPE_KIND_META); }
 LemniTopType lemniMetaTypeBase(LemniMetaType meta){ return reinterpret_cast<LemniTopType>(meta->base()); }
 LemniType lemniMetaAsType(LemniMetaType meta){ return meta; }
 
-LemniUnitType lemniTypeAsUnit(LemniType type){ return dynamic_cast<LemniUnitType>(type); }
+LemniUnitType lemniTypeAsUnit(LemniType type){ return lemniTypeAsKind<LemniUnitTypeT>(type, LEMNI_TYPE_KIND_UNIT); }
 LemniTopType lemniUnitTypeBase(LemniUnitType unit){ return reinterpret_cast<LemniTopType>(unit->base()); }
 LemniType lemniUnitAsType(LemniUnitType unit){ return unit; }
 
-LemniBoolType lemniTypeAsBool(LemniType type){ return dynamic_cast<LemniBoolType>(type); }
+LemniBoolType lemniTypeAsBool(LemniType type){ return lemniTypeAsKind<LemniBoolTypeT>(type, LEMNI_TYPE_KIND_BOOL); }
 LemniTopType lemniBoolTypeBase(LemniBoolType bool_){ return reinterpret_cast<LemniTopType>(bool_->base()); }
 LemniType lemniBoolAsType(LemniBoolType bool_){ return bool_; }
 
-LemniNumberType lemniTypeAsNumber(LemniType type){ return dynamic_cast<LemniNumberType>(type); }
+LemniNumberType lemniTypeAsNumber(LemniType type){ return lemniTypeAsKind<LemniNumberTypeT>(type, LEMNI_TYPE_KIND_NUMBER); }
 LemniTopType lemniNumberTypeBase(LemniNumberType num){ return reinterpret_cast<LemniTopType>(num->base()); }
 LemniType lemniNumberAsType(LemniNumberType num){ return num; }
 
-LemniRealType lemniTypeAsReal(LemniType type){ return dynamic_cast<LemniRealType>(type); }
+LemniRealType lemniTypeAsReal(LemniType type){ return lemniTypeAsKind<LemniRealTypeT>(type, LEMNI_TYPE_KIND_REAL); }
 LemniNumberType lemniRealTypeBase(LemniRealType real){ return reinterpret_cast<LemniNumberType>(real->base()); }
 LemniRealType lemniRealTypeAbstract(LemniRealType real){ return reinterpret_cast<LemniRealType>(real->base()); }
 LemniType lemniRealAsType(LemniRealType real){ return real; }
 
-LemniRatioType lemniTypeAsRatio(LemniType type){ return dynamic_cast<LemniRatioType>(type); }
+LemniRatioType lemniTypeAsRatio(LemniType type){ return lemniTypeAsKind<LemniRatioTypeT>(type, LEMNI_TYPE_KIND_RATIO); }
 LemniIntType lemniRatioTypeNumerator(LemniRatioType ratio){ return ratio->numerator(); };
 LemniNatType lemniRatioTypeDenominator(LemniRatioType ratio){ return ratio->denominator(); };
 LemniRealType lemniRatioTypeBase(LemniRatioType ratio){ return reinterpret_cast<LemniRealType>(ratio->base()); }
 LemniRatioType lemniRatioTypeAbstract(LemniRatioType ratio){ return reinterpret_cast<LemniRatioType>(ratio->base()); }
 LemniType lemniRatioAsType(LemniRatioType ratio){ return ratio; }
 
-LemniIntType lemniTypeAsInt(LemniType type){ return dynamic_cast<LemniIntType>(type); }
+LemniIntType lemniTypeAsInt(LemniType type){ return lemniTypeAsKind<LemniIntTypeT>(type, LEMNI_TYPE_KIND_INT); }
 LemniRatioType lemniIntTypeBase(LemniIntType int_){ return reinterpret_cast<LemniRatioType>(int_->base()); }
 LemniIntType lemniIntTypeAbstract(LemniIntType int_){ return reinterpret_cast<LemniIntType>(int_->base()); }
 LemniType lemniIntAsType(LemniIntType int_){ return int_; }
 
-LemniNatType lemniTypeAsNat(LemniType type){ return dynamic_cast<LemniNatType>(type); }
+LemniNatType lemniTypeAsNat(LemniType type){ return lemniTypeAsKind<LemniNatTypeT>(type, LEMNI_TYPE_KIND_NAT); }
 LemniIntType lemniNatTypeBase(LemniNatType nat){ return reinterpret_cast<LemniIntType>(nat->base()); }
 LemniNatType lemniNatTypeAbstract(LemniNatType nat){ return reinterpret_cast<LemniNatType>(nat->base()); }
 LemniType lemniNatAsType(LemniNatType nat){ return nat; }
 
-LemniStringType lemniTypeAsString(LemniType type){ return dynamic_cast<LemniStringType>(type); }
+LemniStringType lemniTypeAsString(LemniType type){ return lemniTypeAsKind<LemniStringTypeT>(type, LEMNI_TYPE_KIND_STRING); }
 LemniTopType lemniStringTypeBase(LemniStringType str){ return reinterpret_cast<LemniTopType>(str->base()); }
 LemniType lemniStringAsType(LemniStringType str){ return str; }
 
-LemniStringASCIIType lemniTypeAsStringASCII(LemniType type){ return dynamic_cast<LemniStringASCIIType>(type); }
+LemniStringASCIIType lemniTypeAsStringASCII(LemniType type){ return lemniTypeAsKind<LemniStringASCIITypeT>(type, LEMNI_TYPE_KIND_STRING_ASCII); }
 LemniStringType lemniStringASCIITypeBase(LemniStringASCIIType strA){ return reinterpret_cast<LemniStringType>(strA->base()); }
 
-LemniStringUTF8Type lemniTypeAsStringUTF8(LemniType type){ return dynamic_cast<LemniStringUTF8Type>(type); }
-LemniStringASCIIType lemniStringUTF8TypeBase(LemniStringUTF8Type strU){ return dynamic_cast<LemniStringASCIIType>(strU->base()); }
+LemniStringUTF8Type lemniTypeAsStringUTF8(LemniType type){ return lemniTypeAsKind<LemniStringUTF8TypeT>(type, LEMNI_TYPE_KIND_STRING_UTF8); }
+LemniStringASCIIType lemniStringUTF8TypeBase(LemniStringUTF8Type strU){ return lemniTypeAsStringASCII(strU->base()); }
 
-LemniArrayType lemniTypeAsArray(LemniType type){ return dynamic_cast<LemniArrayType>(type); }
+LemniArrayType lemniTypeAsArray(LemniType type){ return lemniTypeAsKind<LemniArrayTypeT>(type, LEMNI_TYPE_KIND_ARRAY); }
 LemniTopType lemniArrayTypeBase(LemniArrayType arr){ return reinterpret_cast<LemniTopType>(arr->base()); }
 LemniType lemniArrayTypeElements(LemniArrayType arr){ return arr->element(); }
 uint32_t lemniArrayTypeNumElements(LemniArrayType arr){ return arr->numElements(); }
 LemniType lemniArrayTypeAsType(LemniArrayType arr){ return arr; }
 
-LemniFunctionType lemniTypeAsFunction(LemniType type){ return dynamic_cast<LemniFunctionType>(type); }
+LemniFunctionType lemniTypeAsFunction(LemniType type){ return lemniTypeAsKind<LemniFunctionTypeT>(type, LEMNI_TYPE_KIND_FUNCTION); }
 LemniTopType lemniFunctionTypeBase(LemniFunctionType fn){ return reinterpret_cast<LemniTopType>(fn->base()); }
 LemniType lemniFunctionTypeResult(LemniFunctionType fn){ return fn->result(); }
 uint32_t lemniFunctionTypeNumParams(LemniFunctionType fn){ return static_cast<uint32_t>(fn->numParams()); }
 LemniType lemniFunctionTypeParam(LemniFunctionType fn, const uint32_t idx){ return fn->param(idx); }
 LemniType lemniFunctionAsType(LemniFunctionType fn){ return fn; }
 
-LemniClosureType lemniTypeAsClosure(LemniType type){ return dynamic_cast<LemniClosureType>(type); }
+LemniClosureType lemniTypeAsClosure(LemniType type){ return lemniTypeAsKind<LemniClosureTypeT>(type, LEMNI_TYPE_KIND_CLOSURE); }
 LemniFunctionType lemniClosureTypeBase(LemniClosureType closure){ return reinterpret_cast<LemniFunctionType>(closure->base()); }
 uint32_t lemniClosureTypeNumClosed(LemniClosureType closure){ return static_cast<uint32_t>(closure->numClosed()); }
 LemniType lemniClosureTypeClosed(LemniClosureType closure, const uint32_t idx){ return closure->closed(idx); }
 LemniType lemniClosureAsType(LemniClosureType closure){ return closure; }
 
-LemniSumType lemniTypeAsSum(LemniType type){ return dynamic_cast<LemniSumType>(type); }
+LemniSumType lemniTypeAsSum(LemniType type){ return lemniTypeAsKind<LemniSumTypeT>(type, LEMNI_TYPE_KIND_SUM); }
 LemniTopType lemniSumTypeBase(LemniSumType sum){ return reinterpret_cast<LemniTopType>(sum->base()); }
 uint32_t lemniSumTypeNumCases(LemniSumType sum){ return static_cast<uint32_t>(sum->numCases()); }
 LemniType lemniSumTypeCase(LemniSumType sum, const uint32_t idx){ return sum->case_(idx); }
 LemniType lemniSumAsType(LemniSumType sum){ return sum; }
 
-LemniProductType lemniTypeAsProduct(LemniType type){ return dynamic_cast<LemniProductType>(type); }
+LemniProductType lemniTypeAsProduct(LemniType type){ return lemniTypeAsKind<LemniProductTypeT>(type, LEMNI_TYPE_KIND_PRODUCT); }
 LemniTopType lemniProductTypeBase(LemniProductType product){ return reinterpret_cast<LemniTopType>(product->base()); }
 uint32_t lemniProductTypeNumComponents(LemniProductType product){ return static_cast<uint32_t>(product->numComponents()); }
 LemniType lemniProductTypeComponent(LemniProductType product, const uint32_t idx){ return product->component(idx); }
 LemniType lemniProductAsType(LemniProductType product){ return product; }
 
-LemniRecordType lemniTypeAsRecord(LemniType type){ return dynamic_cast<LemniRecordType>(type); }
+LemniRecordType lemniTypeAsRecord(LemniType type){ return lemniTypeAsKind<LemniRecordTypeT>(type, LEMNI_TYPE_KIND_RECORD); }
 LemniTopType lemniRecordTypeBase(LemniRecordType record){ return reinterpret_cast<LemniTopType>(record->base()); }
 uint32_t lemniRecordTypeNumFields(LemniRecordType record){ return static_cast<uint32_t>(record->numFields()); }
 const LemniRecordTypeField *lemniRecordTypeField(LemniRecordType record, const uint32_t idx){ return record->field(idx); }
@@ -264,11 +287,580 @@ inline bool operator<(const LemniRecordTypeField &lhs, const LemniRecordTypeFiel
 
 std::string mangleTypeInfo(LemniTypeSet types, const LemniTypeInfo *info) noexcept;
 
+namespace {
+	/**
+	 * Append-only array whose elements never move.
+	 * Chunk ``k`` holds ``2^(k + minChunkBits)`` elements so indexing is a few bit operations,
+	 * readers may access any index below ``size()`` without locking while a writer appends.
+	 * Appends must be serialized by the caller.
+	 */
+	template<typename T>
+	class StableArray{
+		public:
+			static constexpr unsigned minChunkBits = 6;
+			static constexpr unsigned maxChunks = 48;
+
+			StableArray() = default;
+
+			StableArray(const StableArray&) = delete;
+			StableArray &operator=(const StableArray&) = delete;
+
+			~StableArray(){
+				for(auto &&chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+			}
+
+			std::size_t size() const noexcept{ return m_size.load(std::memory_order_acquire); }
+
+			T &operator[](const std::size_t idx) noexcept{
+				auto [chunk, offset] = locate(idx);
+				return chunks[chunk].load(std::memory_order_acquire)[offset];
+			}
+
+			const T &operator[](const std::size_t idx) const noexcept{
+				auto [chunk, offset] = locate(idx);
+				return chunks[chunk].load(std::memory_order_acquire)[offset];
+			}
+
+			//! Append an element initialized by \p init , it is only visible to readers once \p init returns
+			template<typename Init>
+			std::size_t append(Init &&init){
+				auto idx = m_size.load(std::memory_order_relaxed);
+				auto [chunk, offset] = locate(idx);
+
+				auto elems = chunks[chunk].load(std::memory_order_relaxed);
+				if(!elems){
+					elems = new T[std::size_t(1) << (chunk + minChunkBits)]();
+					chunks[chunk].store(elems, std::memory_order_release);
+				}
+
+				init(elems[offset]);
+				m_size.store(idx + 1, std::memory_order_release);
+				return idx;
+			}
+
+		private:
+			static std::pair<unsigned, std::size_t> locate(const std::size_t idx) noexcept{
+				auto biased = idx + (std::size_t(1) << minChunkBits);
+				auto chunk = unsigned(std::bit_width(biased)) - 1 - minChunkBits;
+				return { chunk, biased - (std::size_t(1) << (chunk + minChunkBits)) };
+			}
+
+			std::array<std::atomic<T*>, maxChunks> chunks{};
+			std::atomic<std::size_t> m_size = 0;
+	};
+
+	/**
+	 * Slab storage for type objects.
+	 * Types are bump allocated from large chunks, together with their member arrays, so a type and its members
+	 * share one block. Blocks of destroyed types go to free lists by size and are reused.
+	 * Not synchronized: every intern table shard owns one and only uses it with the shard locked.
+	 */
+	class TypeSlab{
+		public:
+			static constexpr std::size_t chunkSize = 64 * 1024;
+			static constexpr std::size_t blockAlign = alignof(std::max_align_t);
+
+			TypeSlab() = default;
+
+			TypeSlab(const TypeSlab&) = delete;
+			TypeSlab &operator=(const TypeSlab&) = delete;
+
+			~TypeSlab(){
+				for(auto chunk : chunks) ::operator delete(chunk, std::align_val_t(blockAlign));
+			}
+
+			template<typename T, typename ... Args>
+			T *create(Args &&... args){
+				static_assert(alignof(T) <= blockAlign);
+				return construct<T>(allocate(sizeof(T)), std::forward<Args>(args)...);
+			}
+
+			//! Create a type with a copy of \p elems stored right after it, the type is passed a view of the copy last
+			template<typename T, typename Elem, typename ... Args>
+			T *createWithArray(const Elem *elems, const std::size_t numElems, Args &&... args){
+				static_assert(alignof(T) <= blockAlign && alignof(Elem) <= blockAlign && std::is_trivially_copyable_v<Elem>);
+
+				constexpr auto elemsOffset = roundUp(sizeof(T), alignof(Elem));
+
+				auto mem = allocate(elemsOffset + (numElems * sizeof(Elem)));
+				auto inlineElems = reinterpret_cast<Elem*>(mem + elemsOffset);
+				std::uninitialized_copy_n(elems, numElems, inlineElems);
+
+				return construct<T>(mem, std::forward<Args>(args)..., std::span<const Elem>(inlineElems, numElems));
+			}
+
+			template<typename T>
+			void destroy(T *type) noexcept{
+				std::destroy_at(type);
+				release(reinterpret_cast<std::byte*>(type));
+			}
+
+		private:
+			// every block starts with its size, padded to keep the type aligned
+			static constexpr std::size_t headerSize = blockAlign;
+
+			static constexpr std::size_t roundUp(const std::size_t n, const std::size_t align) noexcept{
+				return ((n + align - 1) / align) * align;
+			}
+
+			template<typename T, typename ... Args>
+			T *construct(std::byte *mem, Args &&... args){
+				try{
+					return new(mem) T(std::forward<Args>(args)...);
+				}
+				catch(...){
+					release(mem);
+					throw;
+				}
+			}
+
+			std::byte *allocate(std::size_t size){
+				size = roundUp(size + headerSize, blockAlign);
+
+				std::byte *block;
+
+				if(auto res = freeBlocks.find(size); res != end(freeBlocks) && !res->second.empty()){
+					block = res->second.back();
+					res->second.pop_back();
+				}
+				else{
+					if(size > remaining){
+						auto newSize = std::max(chunkSize, size);
+						next = static_cast<std::byte*>(::operator new(newSize, std::align_val_t(blockAlign)));
+						chunks.emplace_back(next);
+						remaining = newSize;
+					}
+
+					block = next;
+					next += size;
+					remaining -= size;
+				}
+
+				std::memcpy(block, &size, sizeof(size));
+				return block + headerSize;
+			}
+
+			void release(std::byte *mem){
+				auto block = mem - headerSize;
+
+				std::size_t size;
+				std::memcpy(&size, block, sizeof(size));
+
+				freeBlocks[size].emplace_back(block);
+			}
+
+			std::vector<std::byte*> chunks;
+			std::byte *next = nullptr;
+			std::size_t remaining = 0;
+			std::unordered_map<std::size_t, std::vector<std::byte*>> freeBlocks;
+	};
+
+	/**
+	 * Concurrent hash consing table.
+	 *
+	 * Entries are keyed by a structural hash of the type so lookups can hash their arguments in place,
+	 * entries with the same hash are told apart by comparing the components of the stored type.
+	 * The table is split into shards by hash, each an open addressing array that is probed without locking.
+	 * A miss takes the lock of its shard, probes again and creates the type, so every type is created once.
+	 * Full arrays are replaced by one twice the size; replaced arrays stay alive while readers may be probing them.
+	 * Types are stored in the slab of their shard.
+	 */
+	template<typename T>
+	class InternTable{
+		public:
+			static constexpr unsigned shardBits = 4;
+			static constexpr std::size_t numShards = std::size_t(1) << shardBits;
+			static constexpr std::size_t minCapacity = 16;
+
+			InternTable() = default;
+
+			InternTable(const InternTable&) = delete;
+			InternTable &operator=(const InternTable&) = delete;
+
+			~InternTable(){
+				for(auto &&shard : shards){
+					for(auto &&entry : shard.owned) std::destroy_at(entry.second);
+				}
+			}
+
+			template<typename Eq>
+			T *find(const std::uint64_t hash, Eq &&eq) const noexcept{
+				return probe(shardOf(hash).slots.load(std::memory_order_acquire), hash, eq);
+			}
+
+			/**
+			 * Find the type matching \p eq or insert the type \p create makes in the slab it is passed.
+			 * \p create runs with the lock of a shard held, so it must not intern into the same table.
+			 */
+			template<typename Eq, typename Create>
+			T *intern(const std::uint64_t hash, Eq &&eq, Create &&create){
+				if(auto found = find(hash, eq)) return found;
+
+				auto &&shard = shardOf(hash);
+				std::lock_guard lock(shard.mutex);
+
+				if(auto found = probe(shard.slots.load(std::memory_order_relaxed), hash, eq)) return found;
+
+				T *ret = create(shard.slab);
+
+				auto slots = shard.slots.load(std::memory_order_relaxed);
+				if(!slots || ((shard.owned.size() + 1) * 2 > slots->capacity)){
+					slots = rebuild(shard, slots ? slots->capacity * 2 : minCapacity);
+				}
+
+				place(slots, hash, ret);
+				shard.owned.emplace_back(hash, ret);
+
+				return ret;
+			}
+
+			//! Size the shards for about \p n types in total, so filling the table doesn't keep growing it
+			void reserve(const std::size_t n){
+				auto perShard = (n + numShards - 1) / numShards;
+				auto capacity = std::bit_ceil(std::max(minCapacity, (perShard + 1) * 2));
+
+				for(auto &&shard : shards){
+					std::lock_guard lock(shard.mutex);
+
+					auto slots = shard.slots.load(std::memory_order_relaxed);
+					if(!slots || slots->capacity < capacity) rebuild(shard, capacity);
+				}
+			}
+
+			//! Lock every shard, no type can be interned until the returned locks are released
+			std::vector<std::unique_lock<std::mutex>> lockAll(){
+				std::vector<std::unique_lock<std::mutex>> locks;
+				locks.reserve(numShards);
+				for(auto &&shard : shards) locks.emplace_back(shard.mutex);
+				return locks;
+			}
+
+			/**
+			 * Destroy every type matching \p pred , the locks from \ref lockAll must be held.
+			 * Readers don't take locks, so this must not run concurrently with any other use of the table.
+			 */
+			template<typename Pred>
+			void eraseIf(Pred &&pred){
+				for(auto &&shard : shards){
+					auto ownedEnd = std::remove_if(
+						begin(shard.owned), end(shard.owned),
+						[&](auto &&entry){
+							if(!pred(entry.second)) return false;
+							shard.slab.destroy(entry.second);
+							return true;
+						}
+					);
+
+					if(ownedEnd == end(shard.owned)) continue;
+
+					shard.owned.erase(ownedEnd, end(shard.owned));
+
+					auto capacity = shard.slots.load(std::memory_order_relaxed)->capacity;
+					shard.generations.clear();
+					rebuild(shard, capacity);
+				}
+			}
+
+		private:
+			struct Slot{
+				std::uint64_t hash = 0;
+				std::atomic<T*> type = nullptr;
+			};
+
+			struct Slots{
+				explicit Slots(const std::size_t capacity_)
+					: capacity(capacity_), slots(std::make_unique<Slot[]>(capacity_)){}
+
+				std::size_t capacity;
+				std::unique_ptr<Slot[]> slots;
+			};
+
+			struct Shard{
+				std::mutex mutex;
+				std::atomic<Slots*> slots = nullptr;
+				std::vector<std::unique_ptr<Slots>> generations;
+				std::vector<std::pair<std::uint64_t, T*>> owned;
+				TypeSlab slab;
+			};
+
+			const Shard &shardOf(const std::uint64_t hash) const noexcept{ return shards[hash & (numShards - 1)]; }
+			Shard &shardOf(const std::uint64_t hash) noexcept{ return shards[hash & (numShards - 1)]; }
+
+			template<typename Eq>
+			static T *probe(const Slots *slots, const std::uint64_t hash, Eq &&eq) noexcept{
+				if(!slots) return nullptr;
+
+				auto mask = slots->capacity - 1;
+
+				for(auto i = (hash >> shardBits) & mask;; i = (i + 1) & mask){
+					auto &&slot = slots->slots[i];
+
+					auto type = slot.type.load(std::memory_order_acquire);
+					if(!type) return nullptr;
+					else if((slot.hash == hash) && eq(static_cast<const T*>(type))) return type;
+				}
+			}
+
+			static void place(Slots *slots, const std::uint64_t hash, T *type) noexcept{
+				auto mask = slots->capacity - 1;
+				auto i = (hash >> shardBits) & mask;
+
+				while(slots->slots[i].type.load(std::memory_order_relaxed)){
+					i = (i + 1) & mask;
+				}
+
+				slots->slots[i].hash = hash;
+				slots->slots[i].type.store(type, std::memory_order_release);
+			}
+
+			//! Publish a new slot array holding every owned type, the caller must hold the lock of \p shard
+			static Slots *rebuild(Shard &shard, std::size_t capacity){
+				while((shard.owned.size() + 1) * 2 > capacity) capacity *= 2;
+
+				auto newSlots = std::make_unique<Slots>(capacity);
+
+				for(auto &&entry : shard.owned){
+					place(newSlots.get(), entry.first, entry.second);
+				}
+
+				auto ret = newSlots.get();
+				shard.slots.store(ret, std::memory_order_release);
+				shard.generations.emplace_back(std::move(newSlots));
+				return ret;
+			}
+
+			std::array<Shard, numShards> shards;
+	};
+
+	constexpr std::uint64_t mixHash(std::uint64_t x) noexcept{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ull;
+		x ^= x >> 33;
+		return x;
+	}
+
+	constexpr std::uint64_t combineHash(const std::uint64_t seed, const std::uint64_t value) noexcept{
+		return mixHash(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+	}
+
+	inline std::uint64_t typeHash(LemniType type) noexcept{
+		return mixHash(reinterpret_cast<std::uintptr_t>(type));
+	}
+
+	//! Hash of a type sequence where order matters
+	inline std::uint64_t orderedHash(std::uint64_t seed, LemniType *const types, const std::uint64_t n) noexcept{
+		for(std::uint64_t i = 0; i < n; i++){
+			seed = combineHash(seed, typeHash(types[i]));
+		}
+
+		return combineHash(seed, n);
+	}
+
+	//! Hash of a type multiset, independent of order
+	inline std::uint64_t multisetHash(std::uint64_t seed, LemniType *const types, const std::uint64_t n) noexcept{
+		std::uint64_t acc = 0;
+
+		for(std::uint64_t i = 0; i < n; i++){
+			acc += typeHash(types[i]);
+		}
+
+		return combineHash(combineHash(seed, acc), n);
+	}
+
+	//! Hash of a type set, independent of order and repetition
+	inline std::uint64_t setHash(std::uint64_t seed, LemniType *const types, const std::uint64_t n) noexcept{
+		std::uint64_t acc = 0, numUnique = 0;
+
+		for(std::uint64_t i = 0; i < n; i++){
+			if(std::find(types, types + i, types[i]) != (types + i)) continue;
+
+			acc += typeHash(types[i]);
+			++numUnique;
+		}
+
+		return combineHash(combineHash(seed, acc), numUnique);
+	}
+
+	/**
+	 * Order of the members of sum and closure types.
+	 * Ids don't depend on where types were allocated, so names built from members are the same in restored type sets.
+	 */
+	inline bool typeIdLess(LemniType lhs, LemniType rhs) noexcept{ return lhs->typeIdx() < rhs->typeIdx(); }
+
+	//! Count occurrences of \p type in a sequence
+	inline std::uint64_t countOf(LemniType type, LemniType *const types, const std::uint64_t n) noexcept{
+		return std::uint64_t(std::count(types, types + n, type));
+	}
+
+	// seeds keeping the hashes of different kinds of interned types apart
+	enum class InternKind: std::uint64_t{
+		array = 1, function, closure, sum, product, record,
+		nat, int_, ratio, real
+	};
+
+	constexpr std::uint64_t kindSeed(const InternKind kind) noexcept{ return mixHash(std::uint64_t(kind)); }
+
+	constexpr std::uint64_t sizedHash(const InternKind kind, const std::uint32_t numBits) noexcept{
+		return combineHash(kindSeed(kind), numBits);
+	}
+
+	/**
+	 * Memoized answers to questions about pairs of scalar types.
+	 *
+	 * Scalar types get a dense index when they are created, every table is a square indexed by the indices
+	 * of both types. Entries are filled by the first query for a pair and the tables grow when sized types
+	 * are created, so after warming up promotion, arithmetic result and castability queries are array lookups.
+	 *
+	 * Entries are atomics that are only ever set to the one answer for their pair, so concurrent fills are benign.
+	 * Growing copies the known entries into new tables and publishes them, old tables stay alive for readers.
+	 */
+	class ScalarTables{
+		public:
+			static constexpr LemniNat32 noIndex = UINT32_MAX;
+			static constexpr std::size_t numOps = LEMNI_BINARY_OP_COUNT;
+
+			ScalarTables() = default;
+
+			ScalarTables(const ScalarTables&) = delete;
+			ScalarTables &operator=(const ScalarTables&) = delete;
+
+			//! Reserve an index for a new scalar type, it must be published after this returns
+			LemniNat32 add(){
+				std::lock_guard lock(mutex);
+
+				auto idx = numScalars++;
+
+				auto current = tables.load(std::memory_order_relaxed);
+				if(!current || idx >= current->stride){
+					grow(current, std::max<std::size_t>(16, current ? current->stride * 2 : 0));
+				}
+
+				return idx;
+			}
+
+			static bool isOp(LemniBinaryOp op) noexcept{
+				return std::has_single_bit(std::uint32_t(op)) && (std::uint32_t(op) < (1u << numOps));
+			}
+
+			std::optional<LemniType> promoted(LemniNat32 a, LemniNat32 b) const noexcept{
+				auto t = tablesFor(a, b);
+				return t ? fromEntry(t->promoted[(a * t->stride) + b]) : std::nullopt;
+			}
+
+			void setPromoted(LemniNat32 a, LemniNat32 b, LemniType type) noexcept{
+				if(auto t = tablesFor(a, b)) toEntry(t->promoted[(a * t->stride) + b], type);
+			}
+
+			std::optional<LemniType> result(LemniBinaryOp op, LemniNat32 a, LemniNat32 b) const noexcept{
+				auto t = tablesFor(a, b);
+				return t ? fromEntry(t->results[resultIdx(t, op, a, b)]) : std::nullopt;
+			}
+
+			void setResult(LemniBinaryOp op, LemniNat32 a, LemniNat32 b, LemniType type) noexcept{
+				if(auto t = tablesFor(a, b)) toEntry(t->results[resultIdx(t, op, a, b)], type);
+			}
+
+			std::optional<bool> castable(LemniNat32 from, LemniNat32 to) const noexcept{
+				auto t = tablesFor(from, to);
+				if(!t) return std::nullopt;
+
+				auto val = t->castable[(from * t->stride) + to].load(std::memory_order_relaxed);
+				return val < 0 ? std::nullopt : std::optional<bool>(val != 0);
+			}
+
+			void setCastable(LemniNat32 from, LemniNat32 to, const bool castable) noexcept{
+				if(auto t = tablesFor(from, to)) t->castable[(from * t->stride) + to].store(castable ? 1 : 0, std::memory_order_relaxed);
+			}
+
+		private:
+			struct Tables{
+				explicit Tables(const std::size_t stride_)
+					: stride(stride_)
+					, promoted(std::make_unique<std::atomic<LemniType>[]>(stride_ * stride_))
+					, results(std::make_unique<std::atomic<LemniType>[]>(numOps * stride_ * stride_))
+					, castable(std::make_unique<std::atomic<std::int8_t>[]>(stride_ * stride_))
+				{
+					for(std::size_t i = 0; i < stride_ * stride_; i++) castable[i].store(-1, std::memory_order_relaxed);
+				}
+
+				std::size_t stride;
+				std::unique_ptr<std::atomic<LemniType>[]> promoted, results;
+				std::unique_ptr<std::atomic<std::int8_t>[]> castable;
+			};
+
+			// stored for answers that are known to be null
+			static inline const char nullAnswerTag = 0;
+
+			static LemniType nullAnswer() noexcept{ return reinterpret_cast<LemniType>(&nullAnswerTag); }
+
+			static std::optional<LemniType> fromEntry(const std::atomic<LemniType> &entry) noexcept{
+				auto type = entry.load(std::memory_order_acquire);
+				if(!type) return std::nullopt;
+				else if(type == nullAnswer()) return nullptr;
+				else return type;
+			}
+
+			static void toEntry(std::atomic<LemniType> &entry, LemniType type) noexcept{
+				entry.store(type ? type : nullAnswer(), std::memory_order_release);
+			}
+
+			static std::size_t resultIdx(const Tables *t, LemniBinaryOp op, LemniNat32 a, LemniNat32 b) noexcept{
+				auto opIdx = std::size_t(std::countr_zero(std::uint32_t(op)));
+				return (opIdx * t->stride * t->stride) + (a * t->stride) + b;
+			}
+
+			Tables *tablesFor(LemniNat32 a, LemniNat32 b) const noexcept{
+				auto t = tables.load(std::memory_order_acquire);
+				return (t && a < t->stride && b < t->stride) ? t : nullptr;
+			}
+
+			void grow(const Tables *old, const std::size_t newStride){
+				auto newTables = std::make_unique<Tables>(newStride);
+
+				if(old){
+					for(std::size_t a = 0; a < old->stride; a++){
+						for(std::size_t b = 0; b < old->stride; b++){
+							auto from = (a * old->stride) + b, to = (a * newStride) + b;
+
+							newTables->promoted[to].store(old->promoted[from].load(std::memory_order_relaxed), std::memory_order_relaxed);
+							newTables->castable[to].store(old->castable[from].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+							for(std::size_t op = 0; op < numOps; op++){
+								newTables->results[(op * newStride * newStride) + to].store(
+									old->results[(op * old->stride * old->stride) + from].load(std::memory_order_relaxed),
+									std::memory_order_relaxed
+								);
+							}
+						}
+					}
+				}
+
+				tables.store(newTables.get(), std::memory_order_release);
+				generations.emplace_back(std::move(newTables));
+			}
+
+			std::mutex mutex;
+			LemniNat32 numScalars = 0;
+			std::atomic<Tables*> tables = nullptr;
+			std::vector<std::unique_ptr<Tables>> generations;
+	};
+
+	//! Everything a type set knows about a type id
+	struct TypeEntry{
+		LemniTypeInfo info{};
+		std::atomic<LemniType> type = nullptr;
+		std::atomic<LemniNat32> scalarIdx = ScalarTables::noIndex;
+	};
+
+	// pseudo type owners are per thread, so concurrent typechecks only ever claim their own pseudo types
+	thread_local std::unordered_map<LemniTypeSetConst, const void*> pseudoOwners;
+}
+
 struct LemniTypeSetT{
 	LemniTypeSetT()
-		: typeInfos()
-		, mangledNames()
-		, top(createTypeInfo(topTypeInfo()))
+		: top(createTypeInfo(topTypeInfo()))
 		, bottom(&top, createTypeInfo(bottomTypeInfo()))
 		, meta(&top, createTypeInfo(metaTypeInfo()))
 		, expr(&top, createTypeInfo(exprTypeInfo()))
@@ -283,19 +875,59 @@ struct LemniTypeSetT{
 		, strA(&str, createTypeInfo(strAsciiTypeInfo()))
 		, strU(&strA, createTypeInfo(strUtf8TypeInfo()))
 	{
+		for(LemniType builtin : std::initializer_list<LemniType>{ &top, &bottom, &meta, &expr }){
+			registerType(builtin);
+		}
+
+		for(LemniType scalar : std::initializer_list<LemniType>{ &unit, &bool_, &number, &nat, &int_, &ratio, &real, &str, &strA, &strU }){
+			registerScalar(scalar);
+		}
+
+		numBuiltins = entries.size();
 	}
 
 	uint64_t createTypeInfo(const LemniTypeInfo info){
-		auto ret = typeInfos.size();
+		std::lock_guard lock(entriesMutex);
+		return entries.append([&](TypeEntry &entry){ entry.info = info; });
+	}
+
+	//! Make \p type findable by its id
+	template<typename T>
+	T *registerType(T *type){
+		entries[type->typeIdx()].type.store(type, std::memory_order_release);
+		return type;
+	}
 
-		typeInfos.emplace_back(std::move(info));
+	//! Make \p type findable by its id and give it an index into the scalar tables
+	template<typename T>
+	T *registerScalar(T *type){
+		entries[type->typeIdx()].scalarIdx.store(scalarTables.add(), std::memory_order_release);
+		return registerType(type);
+	}
 
-		return ret;
+	LemniNat32 scalarIndexOf(LemniType type) const noexcept{
+		auto id = type->typeIdx();
+		return id < entries.size() ? entries[id].scalarIdx.load(std::memory_order_acquire) : ScalarTables::noIndex;
 	}
 
-	std::vector<LemniTypeInfo> typeInfos;
+	// declared before the builtin types, creating them uses these
+	std::mutex entriesMutex;
+	StableArray<TypeEntry> entries;
+	ScalarTables scalarTables;
+
+	// caches filled on demand, a racing fill keeps the first entry
+	mutable std::shared_mutex cacheMutex;
 	std::map<uint64_t, std::string> mangledNames;
 	std::vector<std::string> storedNames;
+	std::map<std::uint64_t, std::vector<std::string>> typeStrCache;
+	std::map<std::uint64_t, std::vector<std::uint64_t>> typeIndexCache;
+
+	struct LayoutEntry{
+		std::optional<LemniTypeLayout> layout; // empty for unsized types
+		std::vector<std::uint64_t> offsets;
+	};
+
+	std::map<std::uint64_t, LayoutEntry> layoutCache;
 
 	LemniTopTypeImplT top;
 	LemniBottomTypeImplT bottom;
@@ -318,26 +950,28 @@ struct LemniTypeSetT{
 		}
 	};
 
+	LemniNat64 numBuiltins = 0;
+
+	std::mutex ownedMutex;
 	std::vector<std::unique_ptr<LemniModuleTypeImplT>> moduleTys;
 	std::vector<std::unique_ptr<LemniPseudoTypeImplT>> pseudoTys;
+	std::atomic<LemniNat64> nextPseudoIdx = 0;
+	std::atomic<LemniNat64> numOwners = 0;
 	//std::map<LemniTypeInfo, std::unique_ptr<LemniPseudoTypeImplT>, TypeMemComp> pseudoTys;
 
-	std::map<uint32_t, std::unique_ptr<LemniRealTypeImplT>> realTys;
-	std::map<uint32_t, std::unique_ptr<LemniRatioTypeImplT>> ratioTys;
-	std::map<uint32_t, std::unique_ptr<LemniIntTypeImplT>> intTys;
-	std::map<uint32_t, std::unique_ptr<LemniNatTypeImplT>> natTys;
+	InternTable<LemniRealTypeImplT> realTys;
+	InternTable<LemniRatioTypeImplT> ratioTys;
+	InternTable<LemniIntTypeImplT> intTys;
+	InternTable<LemniNatTypeImplT> natTys;
 
-	std::map<LemniType, std::map<uint64_t, std::unique_ptr<LemniArrayTypeImplT>>> arrTys;
+	InternTable<LemniArrayTypeImplT> arrTys;
 
-	std::map<LemniType, std::map<std::vector<LemniType>, std::unique_ptr<LemniFunctionTypeImplT>>> fnTys;
-	std::map<LemniFunctionType, std::map<std::vector<LemniType>, std::unique_ptr<LemniClosureTypeImplT>>> closureTys;
+	InternTable<LemniFunctionTypeImplT> fnTys;
+	InternTable<LemniClosureTypeImplT> closureTys;
 
-	std::map<std::vector<LemniType>, std::unique_ptr<LemniSumTypeImplT>> sumTys;
-	std::map<std::vector<LemniType>, std::unique_ptr<LemniProductTypeImplT>> productTys;
-	std::map<std::vector<LemniRecordTypeField>, std::unique_ptr<LemniRecordTypeImplT>> recordTys;
-
-	std::map<std::uint64_t, std::vector<std::string>> typeStrCache;
-	std::map<std::uint64_t, std::vector<std::uint64_t>> typeIndexCache;
+	InternTable<LemniSumTypeImplT> sumTys;
+	InternTable<LemniProductTypeImplT> productTys;
+	InternTable<LemniRecordTypeImplT> recordTys;
 };
 
 LemniTypeSet lemniCreateTypeSet(void){
@@ -347,6 +981,7 @@ LemniTypeSet lemniCreateTypeSet(void){
 }
 
 void lemniDestroyTypeSet(LemniTypeSet types){
+	pseudoOwners.erase(types);
 	std::destroy_at(types);
 	std::free(types);
 }
@@ -482,28 +1117,32 @@ std::string mangleTypeInfo(LemniTypeSet types, const LemniTypeInfo *info) noexce
 }
 
 const LemniTypeInfo *lemniTypeSetGetTypeInfo(LemniTypeSet types, LemniType type){
-	return &types->typeInfos[type->typeIdx()];
+	return &types->entries[type->typeIdx()].info;
 }
 
 const LemniTypeInfo *lemniTypeSetGetInfo(LemniTypeSet types, const uint64_t idx){
-	if(idx >= types->typeInfos.size()) return nullptr;
-	return &types->typeInfos[idx];
+	if(idx >= types->entries.size()) return nullptr;
+	return &types->entries[idx].info;
 }
 
 LemniStr lemniTypeSetMangleInfo(LemniTypeSet types, const uint64_t idx){
-	if(idx >= types->typeInfos.size()) return {.ptr = nullptr, .len = 0};
+	if(idx >= types->entries.size()) return {.ptr = nullptr, .len = 0};
+
+	{
+		std::shared_lock lock(types->cacheMutex);
 
-	auto res = types->mangledNames.find(idx);
-	if(res != end(types->mangledNames)){
-		return {res->second.data(), res->second.size()};
+		auto res = types->mangledNames.find(idx);
+		if(res != end(types->mangledNames)){
+			return {res->second.data(), res->second.size()};
+		}
 	}
 
-	auto mangled = mangleTypeInfo(types, &types->typeInfos[idx]);
+	// mangling recurses into component types, so the lock isn't held while it runs
+	auto mangled = mangleTypeInfo(types, &types->entries[idx].info);
+
+	std::unique_lock lock(types->cacheMutex);
 
 	auto emplaceRes = types->mangledNames.try_emplace(idx, std::move(mangled));
-	if(!emplaceRes.second){
-		return {.ptr = nullptr, .len = 0};
-	}
 
 	return {emplaceRes.first->second.data(), emplaceRes.first->second.size()};
 }
@@ -518,7 +1157,7 @@ const LemniTypeInfo *lemniTypeSetDemangleInfo(LemniTypeSet types, LemniStr mangl
 	);
 
 	if(res != end(types->mangledNames))
-		return &types->typeInfos[res->first];
+		return &types->entries[res->first].info;
 
 
 }
@@ -534,10 +1173,12 @@ LemniModuleType lemniTypeSetGetModule(LemniTypeSet types){
 	auto typeIdx = types->createTypeInfo(info);
 
 	auto ptr = std::make_unique<LemniModuleTypeImplT>(&types->top, typeIdx);
+	auto ret = types->registerType(ptr.get());
 
-	auto &&res = types->moduleTys.emplace_back(std::move(ptr));
+	std::lock_guard lock(types->ownedMutex);
+	types->moduleTys.emplace_back(std::move(ptr));
 
-	return res.get();
+	return ret;
 }
 
 LemniPseudoType lemniTypeSetGetPseudo(LemniTypeSet types, const LemniTypeInfo usageInfo){
@@ -546,11 +1187,16 @@ LemniPseudoType lemniTypeSetGetPseudo(LemniTypeSet types, const LemniTypeInfo us
 
 	auto typeIdx = types->createTypeInfo(info);
 
-	auto ptr = std::make_unique<LemniPseudoTypeImplT>(&types->top, typeIdx, types->pseudoTys.size());
+	auto ownerRes = pseudoOwners.find(types);
+	auto owner = ownerRes != end(pseudoOwners) ? ownerRes->second : nullptr;
 
-	auto &&res = types->pseudoTys.emplace_back(std::move(ptr));
+	auto ptr = std::make_unique<LemniPseudoTypeImplT>(&types->top, typeIdx, types->nextPseudoIdx++, owner);
+	auto ret = types->registerType(ptr.get());
 
-	return res.get();
+	std::lock_guard lock(types->ownedMutex);
+	types->pseudoTys.emplace_back(std::move(ptr));
+
+	return ret;
 }
 
 LemniExprType lemniTypeSetGetExpr(LemniTypeSet types){ return &types->expr; }
@@ -565,72 +1211,61 @@ LemniNumberType lemniTypeSetGetNumber(LemniTypeSet types){ return &types->number
 LemniRealType lemniTypeSetGetReal(LemniTypeSet types, const uint32_t numBits){
 	if(numBits == 0) return &types->real;
 
-	auto res = types->realTys.find(numBits);
-	if(res != end(types->realTys))
-		return res->second.get();
-
-	auto typeInfo = realTypeInfo(numBits);
-	auto typeIdx = types->createTypeInfo(typeInfo);
-
-	auto ptr = std::make_unique<LemniRealTypeImplT>(&types->number, &types->real, typeIdx, numBits);
-
-	auto emplaceRes = types->realTys.try_emplace(numBits, std::move(ptr));
-
-	return emplaceRes.first->second.get();
+	return types->realTys.intern(
+		sizedHash(InternKind::real, numBits),
+		[numBits](const LemniRealTypeImplT *real){ return real->numBits() == numBits; },
+		[&](TypeSlab &slab){
+			auto typeIdx = types->createTypeInfo(realTypeInfo(numBits));
+			auto ptr = slab.create<LemniRealTypeImplT>(&types->number, &types->real, typeIdx, numBits);
+			types->registerScalar(ptr);
+			return ptr;
+		}
+	);
 }
 
 LemniRatioType lemniTypeSetGetRatio(LemniTypeSet types, const uint32_t numBits){
 	if(numBits == 0) return &types->ratio;
 
-	auto res = types->ratioTys.find(numBits);
-	if(res != end(types->ratioTys))
-		return res->second.get();
-
-	auto typeInfo = ratioTypeInfo(numBits);
-	auto typeIdx = types->createTypeInfo(typeInfo);
-
-	auto numType = lemniTypeSetGetInt(types, numBits / 2);
-	auto denType = lemniTypeSetGetNat(types, numBits / 2);
-
-	auto ptr = std::make_unique<LemniRatioTypeImplT>(lemniTypeSetGetReal(types, numBits / 2), &types->ratio, typeIdx, numBits, numType, denType);
-
-	auto emplaceRes = types->ratioTys.try_emplace(numBits, std::move(ptr));
-
-	return emplaceRes.first->second.get();
+	return types->ratioTys.intern(
+		sizedHash(InternKind::ratio, numBits),
+		[numBits](const LemniRatioTypeImplT *ratio){ return ratio->numBits() == numBits; },
+		[&](TypeSlab &slab){
+			auto typeIdx = types->createTypeInfo(ratioTypeInfo(numBits));
+			auto ptr = slab.create<LemniRatioTypeImplT>(types, lemniTypeSetGetReal(types, numBits / 2), &types->ratio, typeIdx, numBits);
+			types->registerScalar(ptr);
+			return ptr;
+		}
+	);
 }
 
 LemniIntType lemniTypeSetGetInt(LemniTypeSet types, const uint32_t numBits){
 	if(numBits == 0) return &types->int_;
 
-	auto res = types->intTys.find(numBits);
-	if(res != end(types->intTys))
-		return res->second.get();
-
-	auto typeInfo = intTypeInfo(numBits);
-	auto typeIdx = types->createTypeInfo(typeInfo);
-
-	auto ptr = std::make_unique<LemniIntTypeImplT>(lemniTypeSetGetRatio(types, numBits * 2), &types->int_, typeIdx, numBits);
-
-	auto emplaceRes = types->intTys.try_emplace(numBits, std::move(ptr));
-
-	return emplaceRes.first->second.get();
+	return types->intTys.intern(
+		sizedHash(InternKind::int_, numBits),
+		[numBits](const LemniIntTypeImplT *int_){ return int_->numBits() == numBits; },
+		[&](TypeSlab &slab){
+			auto typeIdx = types->createTypeInfo(intTypeInfo(numBits));
+			auto ptr = slab.create<LemniIntTypeImplT>(types, &types->int_, typeIdx, numBits);
+			types->registerScalar(ptr);
+			return ptr;
+		}
+	);
 }
 
 LemniNatType lemniTypeSetGetNat(LemniTypeSet types, const uint32_t numBits){
 	if(numBits == 0) return &types->nat;
 
-	auto res = types->natTys.find(numBits);
-	if(res != end(types->natTys))
-		return res->second.get();
-
-	auto typeInfo = natTypeInfo(numBits);
-	auto typeIdx = types->createTypeInfo(typeInfo);
-
-	auto ptr = std::make_unique<LemniNatTypeImplT>(lemniTypeSetGetInt(types, numBits + 1), &types->nat, typeIdx, numBits);
-
-	auto emplaceRes = types->natTys.try_emplace(numBits, std::move(ptr));
-
-	return emplaceRes.first->second.get();
+	return types->natTys.intern(
+		sizedHash(InternKind::nat, numBits),
+		[numBits](const LemniNatTypeImplT *nat){ return nat->numBits() == numBits; },
+		[&](TypeSlab &slab){
+			auto typeIdx = types->createTypeInfo(natTypeInfo(numBits));
+			auto ptr = slab.create<LemniNatTypeImplT>(types, &types->nat, typeIdx, numBits);
+			types->registerScalar(ptr);
+			return ptr;
+		}
+	);
 }
 
 LemniStringType lemniTypeSetGetString(LemniTypeSet types){ return &types->str; }
@@ -638,167 +1273,378 @@ LemniStringASCIIType lemniTypeSetGetStringASCII(LemniTypeSet types){ return &typ
 LemniStringUTF8Type lemniTypeSetGetStringUTF8(LemniTypeSet types){ return &types->strU; }
 
 LemniArrayType lemniTypeSetGetArray(LemniTypeSet types, const uint64_t numElements, LemniType elementType){
-	auto &&arrMap = types->arrTys[elementType];
+	auto hash = combineHash(combineHash(kindSeed(InternKind::array), typeHash(elementType)), numElements);
 
-	auto res = arrMap.find(numElements);
-	if(res != end(arrMap))
-		return res->second.get();
-
-	auto typeInfo = sigmaTypeInfo(elementType->typeIdx(), numElements);
-	auto typeIdx = types->createTypeInfo(typeInfo);
+	auto isSame = [&](const LemniArrayTypeImplT *arr){
+		return (arr->element() == elementType) && (arr->numElements() == numElements);
+	};
 
-	auto ptr = std::make_unique<LemniArrayTypeImplT>(&types->top, typeIdx, numElements, elementType);
+	return types->arrTys.intern(hash, isSame, [&](TypeSlab &slab){
+		auto typeInfo = sigmaTypeInfo(elementType->typeIdx(), numElements);
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	auto emplaceRes = arrMap.try_emplace(numElements, std::move(ptr));
+		auto ptr = slab.create<LemniArrayTypeImplT>(&types->top, typeIdx, numElements, elementType);
 
-	return emplaceRes.first->second.get();
+		types->registerType(ptr);
+		return ptr;
+	});
 }
 
 LemniFunctionType lemniTypeSetGetFunction(LemniTypeSet types, LemniType result, LemniType *const params, const uint32_t numParams){
 	if(!params || (numParams == 0))
 		return nullptr;
 
-	std::vector<LemniType> paramTys(params, params + numParams);
+	auto hash = orderedHash(combineHash(kindSeed(InternKind::function), typeHash(result)), params, numParams);
 
-	auto &&fnMap = types->fnTys[result];
-
-	auto res = fnMap.find(paramTys);
-	if(res != end(fnMap))
-		return res->second.get();
+	auto isSame = [&](const LemniFunctionTypeImplT *fn){
+		return (fn->m_result == result) && std::equal(begin(fn->m_params), end(fn->m_params), params, params + numParams);
+	};
 
-	std::vector<std::uint64_t> indices;
-	indices.reserve(numParams);
-	std::transform(params, params + numParams, std::back_inserter(indices), [](LemniType param){ return param->typeIdx(); });
+	return types->fnTys.intern(hash, isSame, [&](TypeSlab &slab){
+		std::vector<std::uint64_t> indices;
+		indices.reserve(numParams);
+		std::transform(params, params + numParams, std::back_inserter(indices), [](LemniType param){ return param->typeIdx(); });
 
-	auto typeInfo = functionTypeInfo(result->typeIdx(), numParams, indices.data());
-	auto typeIdx = types->createTypeInfo(typeInfo);
+		auto typeInfo = functionTypeInfo(result->typeIdx(), numParams, indices.data());
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	types->typeIndexCache[typeIdx] = std::move(indices);
+		{
+			std::unique_lock lock(types->cacheMutex);
+			types->typeIndexCache[typeIdx] = std::move(indices);
+		}
 
-	auto ptr = std::make_unique<LemniFunctionTypeImplT>(&types->top, typeIdx, result, paramTys);
 
-	auto emplaceRes = fnMap.try_emplace(std::move(paramTys), std::move(ptr));
+		auto ptr = slab.createWithArray<LemniFunctionTypeImplT>(params, numParams, &types->top, typeIdx, result);
 
-	return emplaceRes.first->second.get();
+		types->registerType(ptr);
+		return ptr;
+	});
 }
 
 LemniClosureType lemniTypeSetGetClosure(LemniTypeSet types, LemniFunctionType fn, LemniType *const closed, const uint64_t numClosed){
-	std::vector<LemniType> closedTys(closed, closed + numClosed);
-	std::sort(begin(closedTys), end(closedTys));
+	// closed types are stored sorted, so compare them as a multiset
+	auto hash = multisetHash(combineHash(kindSeed(InternKind::closure), typeHash(fn)), closed, numClosed);
+
+	auto isSame = [&](const LemniClosureTypeImplT *closure){
+		if((closure->fn() != fn) || (closure->m_closed.size() != numClosed)) return false;
 
-	auto &&closureMap = types->closureTys[fn];
+		for(auto it = begin(closure->m_closed); it != end(closure->m_closed);){
+			auto runEnd = std::upper_bound(it, end(closure->m_closed), *it, typeIdLess);
+			if(std::uint64_t(runEnd - it) != countOf(*it, closed, numClosed)) return false;
+			it = runEnd;
+		}
 
-	auto res = closureMap.find(closedTys);
-	if(res != end(closureMap))
-		return res->second.get();
+		return true;
+	};
 
-	auto numParams = fn->numParams();
+	return types->closureTys.intern(hash, isSame, [&](TypeSlab &slab){
+		std::vector<LemniType> closedTys(closed, closed + numClosed);
+		std::sort(begin(closedTys), end(closedTys), typeIdLess);
 
-	std::vector<std::uint64_t> indices;
-	indices.reserve(numParams + numClosed);
+		auto numParams = fn->numParams();
 
-	constexpr auto comp = [](LemniType ty) noexcept{ return ty->typeIdx(); };
+		std::vector<std::uint64_t> indices;
+		indices.reserve(numParams + numClosed);
 
-	for(std::size_t i = 0; i < numParams; i++){
-		auto ty = fn->param(i);
-		indices.emplace_back(ty->typeIdx());
-	}
+		constexpr auto comp = [](LemniType ty) noexcept{ return ty->typeIdx(); };
 
-	std::transform(closed, closed + numClosed, std::back_inserter(indices), comp);
+		for(std::size_t i = 0; i < numParams; i++){
+			auto ty = fn->param(i);
+			indices.emplace_back(ty->typeIdx());
+		}
+
+		std::transform(closed, closed + numClosed, std::back_inserter(indices), comp);
 
-	auto typeInfo = closureTypeInfo(fn->result()->typeIdx(), numParams, indices.data(), numClosed, indices.data() + numParams);
-	auto typeIdx = types->createTypeInfo(typeInfo);
+		auto typeInfo = closureTypeInfo(fn->result()->typeIdx(), numParams, indices.data(), numClosed, indices.data() + numParams);
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	types->typeIndexCache[typeIdx] = std::move(indices);
+		{
+			std::unique_lock lock(types->cacheMutex);
+			types->typeIndexCache[typeIdx] = std::move(indices);
+		}
 
-	auto ptr = std::make_unique<LemniClosureTypeImplT>(fn, typeIdx, closedTys);
 
-	auto emplaceRes = closureMap.try_emplace(std::move(closedTys), std::move(ptr));
+		auto ptr = slab.createWithArray<LemniClosureTypeImplT>(closedTys.data(), closedTys.size(), fn, typeIdx);
 
-	return emplaceRes.first->second.get();
+		types->registerType(ptr);
+		return ptr;
+	});
 }
 
 LemniSumType lemniTypeSetGetSum(LemniTypeSet types, LemniType *const cases, const uint64_t numCases){
-	std::vector<LemniType> caseTys(cases, cases + numCases);
-	std::sort(begin(caseTys), end(caseTys));
-	caseTys.erase(std::unique(begin(caseTys), end(caseTys)), end(caseTys));
+	// cases are stored sorted without repeats, so compare them as a set
+	auto hash = setHash(kindSeed(InternKind::sum), cases, numCases);
+
+	auto isSame = [&](const LemniSumTypeImplT *sum){
+		auto hasCase = [sum](LemniType case_){ return std::binary_search(begin(sum->cases), end(sum->cases), case_, typeIdLess); };
+		auto isCase = [&](LemniType case_){ return countOf(case_, cases, numCases) > 0; };
 
-	auto res = types->sumTys.find(caseTys);
-	if(res != end(types->sumTys))
-		return res->second.get();
+		return
+			std::all_of(cases, cases + numCases, hasCase) &&
+			std::all_of(begin(sum->cases), end(sum->cases), isCase);
+	};
+
+	return types->sumTys.intern(hash, isSame, [&](TypeSlab &slab){
+		std::vector<LemniType> caseTys(cases, cases + numCases);
+		std::sort(begin(caseTys), end(caseTys), typeIdLess);
+		caseTys.erase(std::unique(begin(caseTys), end(caseTys)), end(caseTys));
 
-	std::vector<uint64_t> indices;
-	indices.reserve(numCases);
-	std::transform(cases, cases + numCases, std::back_inserter(indices), [](LemniType t){ return t->typeIdx(); });
+		std::vector<uint64_t> indices;
+		indices.reserve(numCases);
+		std::transform(cases, cases + numCases, std::back_inserter(indices), [](LemniType t){ return t->typeIdx(); });
 
-	auto typeInfo = sumTypeInfo(numCases, indices.data());
-	auto typeIdx = types->createTypeInfo(typeInfo);
+		auto typeInfo = sumTypeInfo(numCases, indices.data());
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	auto ptr = std::make_unique<LemniSumTypeImplT>(&types->top, typeIdx, caseTys);
+		{
+			std::unique_lock lock(types->cacheMutex);
+			types->typeIndexCache[typeIdx] = std::move(indices);
+		}
 
-	auto emplaceRes = types->sumTys.try_emplace(caseTys, std::move(ptr));
+		auto ptr = slab.createWithArray<LemniSumTypeImplT>(caseTys.data(), caseTys.size(), &types->top, typeIdx);
 
-	return emplaceRes.first->second.get();
+		types->registerType(ptr);
+		return ptr;
+	});
 }
 
 LemniProductType lemniTypeSetGetProduct(LemniTypeSet types, LemniType *const components, const uint64_t numComponents){
-	std::vector<LemniType> componentTys(components, components + numComponents);
+	auto hash = orderedHash(kindSeed(InternKind::product), components, numComponents);
 
-	auto res = types->productTys.find(componentTys);
-	if(res != end(types->productTys))
-		return res->second.get();
+	auto isSame = [&](const LemniProductTypeImplT *product){
+		return std::equal(begin(product->components), end(product->components), components, components + numComponents);
+	};
 
-	std::vector<uint64_t> indices;
-	indices.reserve(numComponents);
-	std::transform(components, components + numComponents, std::back_inserter(indices), [](LemniType t){ return t->typeIdx(); });
+	return types->productTys.intern(hash, isSame, [&](TypeSlab &slab){
+		std::vector<uint64_t> indices;
+		indices.reserve(numComponents);
+		std::transform(components, components + numComponents, std::back_inserter(indices), [](LemniType t){ return t->typeIdx(); });
 
-	auto typeInfo = productTypeInfo(numComponents, indices.data());
-	auto typeIdx = types->createTypeInfo(typeInfo);
+		auto typeInfo = productTypeInfo(numComponents, indices.data());
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	auto ptr = std::make_unique<LemniProductTypeImplT>(&types->top, typeIdx, componentTys);
+		{
+			std::unique_lock lock(types->cacheMutex);
+			types->typeIndexCache[typeIdx] = std::move(indices);
+		}
 
-	auto emplaceRes = types->productTys.try_emplace(componentTys, std::move(ptr));
+		auto ptr = slab.createWithArray<LemniProductTypeImplT>(components, numComponents, &types->top, typeIdx);
 
-	return emplaceRes.first->second.get();
+		types->registerType(ptr);
+		return ptr;
+	});
 }
 
 LemniRecordType lemniTypeSetGetRecord(LemniTypeSet types, const LemniRecordTypeField *const fields, const uint64_t numFields){
-	std::vector<LemniRecordTypeField> fieldVals(fields, fields + numFields);
+	auto hash = combineHash(kindSeed(InternKind::record), numFields);
 
-	auto res = types->recordTys.find(fieldVals);
-	if(res != end(types->recordTys))
-		return res->second.get();
+	for(uint64_t i = 0; i < numFields; i++){
+		hash = combineHash(hash, typeHash(fields[i].type));
+		hash = combineHash(hash, std::hash<std::string_view>{}(lemni::toStdStrView(fields[i].name)));
+	}
 
-	std::vector<std::string> names;
-	std::vector<uint64_t> indices;
+	auto isSame = [&](const LemniRecordTypeImplT *record){
+		return std::equal(
+			begin(record->fields), end(record->fields), fields, fields + numFields,
+			[](const LemniRecordTypeField &lhs, const LemniRecordTypeField &rhs){
+				return (lhs.type == rhs.type) && (lhs.name == rhs.name);
+			}
+		);
+	};
 
-	names.reserve(numFields);
-	indices.resize(numFields * 2);
+	return types->recordTys.intern(hash, isSame, [&](TypeSlab &slab){
+		std::vector<std::string> names;
+		std::vector<uint64_t> indices;
 
-	std::transform(
-		fields, fields + numFields, std::back_inserter(names),
-		[](const LemniRecordTypeField &f){ return lemni::toStdStr(f.name); }
-	);
+		names.reserve(numFields);
+		indices.resize(numFields * 2);
 
-	std::transform(
-		fields, fields + numFields, std::begin(indices),
-		[](const LemniRecordTypeField &f){ return f.type->typeIdx(); }
-	);
+		std::transform(
+			fields, fields + numFields, std::back_inserter(names),
+			[](const LemniRecordTypeField &f){ return lemni::toStdStr(f.name); }
+		);
 
-	std::iota(std::begin(indices) + numFields, std::end(indices), 0);
+		std::transform(
+			fields, fields + numFields, std::begin(indices),
+			[](const LemniRecordTypeField &f){ return f.type->typeIdx(); }
+		);
 
-	auto typeInfo = recordTypeInfo(numFields, indices.data(), indices.data() + numFields);
-	auto typeIdx = types->createTypeInfo(typeInfo);
+		std::iota(std::begin(indices) + numFields, std::end(indices), 0);
 
-	types->typeStrCache[typeIdx] = std::move(names);
-	types->typeIndexCache[typeIdx] = std::move(indices);
+		auto typeInfo = recordTypeInfo(numFields, indices.data(), indices.data() + numFields);
+		auto typeIdx = types->createTypeInfo(typeInfo);
 
-	auto ptr = std::make_unique<LemniRecordTypeImplT>(&types->top, typeIdx, fieldVals);
+		// field names refer to the cached copies, the caller's strings may not outlive the type
+		std::vector<LemniRecordTypeField> storedFields(fields, fields + numFields);
 
-	auto emplaceRes = types->recordTys.try_emplace(fieldVals, std::move(ptr));
+		for(uint64_t i = 0; i < numFields; i++){
+			storedFields[i].name = lemni::fromStdStrView(names[i]);
+		}
 
-	return emplaceRes.first->second.get();
-}
+		{
+			std::unique_lock lock(types->cacheMutex);
+			types->typeStrCache[typeIdx] = std::move(names);
+			types->typeIndexCache[typeIdx] = std::move(indices);
+		}
+
+		auto ptr = slab.createWithArray<LemniRecordTypeImplT>(storedFields.data(), storedFields.size(), &types->top, typeIdx);
+
+		types->registerType(ptr);
+		return ptr;
+	});
+}
+
+LemniType lemniTypeSetGetById(LemniTypeSetConst types, const LemniNat64 id){
+	if(id >= types->entries.size()) return nullptr;
+	return types->entries[id].type.load(std::memory_order_acquire);
+}
+
+LemniNat64 lemniTypeSetNumPseudosCreated(LemniTypeSetConst types){
+	return types->nextPseudoIdx.load(std::memory_order_relaxed);
+}
+
+LemniNat64 lemniTypeSetAddOwner(LemniTypeSet types){
+	return ++types->numOwners;
+}
+
+LemniNat64 lemniTypeSetRemoveOwner(LemniTypeSet types){
+	return --types->numOwners;
+}
+
+LemniNat64 lemniTypeSetNumOwners(LemniTypeSetConst types){
+	return types->numOwners.load(std::memory_order_acquire);
+}
+
+const void *lemniTypeSetPseudoOwner(LemniTypeSet types, const void *owner){
+	auto res = pseudoOwners.find(types);
+	auto prev = res != end(pseudoOwners) ? res->second : nullptr;
+
+	if(owner) pseudoOwners[types] = owner;
+	else if(res != end(pseudoOwners)) pseudoOwners.erase(res);
+
+	return prev;
+}
+
+namespace {
+	void forEachComponent(LemniType type, auto &&f){
+		if(auto fn = lemniTypeAsFunction(type)){
+			f(fn->result());
+			for(LemniNat64 i = 0; i < fn->numParams(); i++) f(fn->param(i));
+		}
+		else if(auto closure = lemniTypeAsClosure(type)){
+			f(closure->fn());
+			for(LemniNat64 i = 0; i < closure->numClosed(); i++) f(closure->closed(i));
+		}
+		else if(auto sum = lemniTypeAsSum(type)){
+			for(LemniNat64 i = 0; i < sum->numCases(); i++) f(sum->case_(i));
+		}
+		else if(auto product = lemniTypeAsProduct(type)){
+			for(LemniNat64 i = 0; i < product->numComponents(); i++) f(product->component(i));
+		}
+		else if(auto record = lemniTypeAsRecord(type)){
+			for(LemniNat64 i = 0; i < record->numFields(); i++) f(record->field(i)->type);
+		}
+		else if(auto arr = lemniTypeAsArray(type)){
+			f(arr->element());
+		}
+	}
+}
+
+LemniNat64 lemniTypeSetReclaimPseudos(LemniTypeSet types, const void *owner, LemniType *const liveTypes, const LemniNat64 numLive){
+	if(!owner) return 0;
+
+	std::unordered_set<LemniType> live;
+	std::vector<LemniType> pending(liveTypes, liveTypes + numLive);
+
+	while(!pending.empty()){
+		auto type = pending.back();
+		pending.pop_back();
+
+		if(!type || !live.insert(type).second) continue;
+
+		forEachComponent(type, [&](LemniType component){ pending.emplace_back(component); });
+	}
+
+	// interning and cache fills wait for the reclaim, shards are locked first like while interning
+	auto closureLocks = types->closureTys.lockAll();
+	auto fnLocks = types->fnTys.lockAll();
+	auto arrLocks = types->arrTys.lockAll();
+	auto sumLocks = types->sumTys.lockAll();
+	auto productLocks = types->productTys.lockAll();
+	auto recordLocks = types->recordTys.lockAll();
+
+	std::scoped_lock lock(types->entriesMutex, types->ownedMutex);
+	std::unique_lock cacheLock(types->cacheMutex);
+
+	std::unordered_set<LemniType> deadPseudos;
+
+	for(auto &&pseudo : types->pseudoTys){
+		if(pseudo->owner == owner && !live.count(pseudo.get())){
+			deadPseudos.insert(pseudo.get());
+		}
+	}
+
+	if(deadPseudos.empty()) return 0;
+
+	// composite types are dead if they reference a dead pseudo type at any depth
+	std::unordered_map<LemniType, bool> deadMemo;
+
+	auto isDead = [&](auto &&self, LemniType type) -> bool{
+		if(deadPseudos.count(type)) return true;
+		else if(live.count(type)) return false;
+
+		auto memoRes = deadMemo.find(type);
+		if(memoRes != end(deadMemo)) return memoRes->second;
+
+		bool dead = false;
+		forEachComponent(type, [&](LemniType component){ dead = dead || self(self, component); });
+
+		deadMemo[type] = dead;
+		return dead;
+	};
+
+	LemniNat64 numBytes = 0;
+
+	auto dropType = [&](LemniType type, const std::size_t objSize){
+		auto idx = type->typeIdx();
+		types->entries[idx].type.store(nullptr, std::memory_order_relaxed);
+		types->mangledNames.erase(idx);
+		types->typeStrCache.erase(idx);
+		types->typeIndexCache.erase(idx);
+		types->layoutCache.erase(idx);
+		numBytes += objSize + type->str().len + type->mangled().len;
+	};
+
+	auto dropDeadIn = [&](auto &&table){
+		table.eraseIf([&](auto *type){
+			if(!isDead(isDead, type)) return false;
+			dropType(type, sizeof(*type));
+			return true;
+		});
+	};
+
+	// closures before functions, closure types reference their function type
+	dropDeadIn(types->closureTys);
+	dropDeadIn(types->fnTys);
+	dropDeadIn(types->arrTys);
+
+	dropDeadIn(types->sumTys);
+	dropDeadIn(types->productTys);
+	dropDeadIn(types->recordTys);
+
+	auto pseudoEnd = std::remove_if(
+		begin(types->pseudoTys), end(types->pseudoTys),
+		[&](const std::unique_ptr<LemniPseudoTypeImplT> &pseudo){
+			if(!deadPseudos.count(pseudo.get())) return false;
+			dropType(pseudo.get(), sizeof(LemniPseudoTypeImplT));
+			return true;
+		}
+	);
+
+	types->pseudoTys.erase(pseudoEnd, end(types->pseudoTys));
+
+	return numBytes;
+}
 
 namespace {
 	uint32_t nextPow2(uint32_t v){
@@ -1010,45 +1856,758 @@ namespace {
 }
 
 LemniType lemniTypeMakeSigned(LemniTypeSet types, LemniType type){
-	if(auto nat = dynamic_cast<LemniNatType>(type)){
-		return lemniTypeSetGetInt(types, nat->numBits() + 1);
-	}
-	else if(
-		   dynamic_cast<LemniIntType>(type) ||
-		   dynamic_cast<LemniRatioType>(type) ||
-		   dynamic_cast<LemniRealType>(type) ||
-		   dynamic_cast<LemniNumberType>(type)
-	){
-		return type;
+	switch(type->kind()){
+		case LEMNI_TYPE_KIND_NAT: return lemniTypeSetGetInt(types, type->numBits() + 1);
+
+		case LEMNI_TYPE_KIND_INT:
+		case LEMNI_TYPE_KIND_RATIO:
+		case LEMNI_TYPE_KIND_REAL:
+		case LEMNI_TYPE_KIND_NUMBER:
+			return type;
+
+		default: return nullptr;
 	}
-	else{
-		return nullptr;
+}
+
+namespace {
+	LemniType promoteUncached(LemniTypeSet types, LemniType a, LemniType b){
+		const auto aInfo = &types->entries[a->typeIdx()].info;
+		const auto bInfo = &types->entries[b->typeIdx()].info;
+
+		if(lemniTypeInfoHasClass(aInfo, LEMNI_TYPECLASS_SCALAR) && lemniTypeInfoHasClass(bInfo, LEMNI_TYPECLASS_SCALAR)){
+			if((aInfo->info.scalar.traits & LEMNI_SCALAR_UNIT) && (bInfo->info.scalar.traits & LEMNI_SCALAR_UNIT)){
+				return a;
+			}
+			else if((aInfo->info.scalar.traits & LEMNI_SCALAR_TEXTUAL) && (bInfo->info.scalar.traits & LEMNI_SCALAR_TEXTUAL)){
+				if(auto str = lemniTypeAsString(a)) return promoteString(types, str, b);
+				else if(auto utf8 = lemniTypeAsStringUTF8(a)) return promoteStringUTF8(types, utf8, b);
+				else if(auto ascii = lemniTypeAsStringASCII(a)) return promoteStringASCII(types, ascii, b);
+				else return a;
+			}
+			else if((aInfo->info.scalar.traits & LEMNI_SCALAR_RANGE) && (bInfo->info.scalar.traits & LEMNI_SCALAR_RANGE)){
+				if(auto nat = lemniTypeAsNat(a)) return promoteNat(types, nat, b);
+				else if(auto int_ = lemniTypeAsInt(a)) return promoteInt(types, int_, b);
+				else if(auto ratio = lemniTypeAsRatio(a)) return promoteRatio(types, ratio, b);
+				else if(auto real = lemniTypeAsReal(a)) return promoteReal(types, real, b);
+				else return a;
+			}
+		}
+
+		LemniType cases[] = {a, b};
+		return lemniTypeSetGetSum(types, cases, sizeof(cases)/sizeof(*cases));
+	}
+
+	LemniType arithmeticResultUncached(LemniTypeSet types, LemniType promoted, LemniBinaryOp op){
+		if(!promoted) return nullptr;
+
+		if(auto num = lemniTypeAsNumber(promoted)){
+			return num;
+		}
+		else if(auto real = lemniTypeAsReal(promoted)){
+			switch(op){
+				case LEMNI_BINARY_ADD:
+				case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, real->numBits() + 2);
+				case LEMNI_BINARY_MUL:
+				case LEMNI_BINARY_DIV: return lemniTypeSetGetNat(types, real->numBits() * 2);
+				default: return real;
+			}
+		}
+		else if(auto ratio = lemniTypeAsRatio(promoted)){
+			switch(op){
+				case LEMNI_BINARY_ADD:
+				case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, ratio->numBits() + 2);
+				case LEMNI_BINARY_MUL:
+				case LEMNI_BINARY_DIV: return lemniTypeSetGetNat(types, ratio->numBits() * 2);
+				default: return ratio;
+			}
+		}
+		else if(auto int_ = lemniTypeAsInt(promoted)){
+			switch(op){
+				case LEMNI_BINARY_ADD:
+				case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, int_->numBits() + 1);
+				case LEMNI_BINARY_MUL: return lemniTypeSetGetNat(types, int_->numBits() * 2);
+				case LEMNI_BINARY_DIV: return lemniTypeSetGetRatio(types, int_->numBits() * 2);
+				default: return int_;
+			}
+		}
+		else if(auto nat = lemniTypeAsNat(promoted)){
+			switch(op){
+				case LEMNI_BINARY_ADD: return lemniTypeSetGetNat(types, nat->numBits() + 1);
+				case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, nat->numBits() + 2);
+				case LEMNI_BINARY_MUL: return lemniTypeSetGetNat(types, nat->numBits() * 2);
+				case LEMNI_BINARY_DIV: return lemniTypeSetGetRatio(types, nat->numBits() * 2); // should probably be (n * 2) + 2
+				default: return nat;
+			}
+		}
+		else{
+			return nullptr;
+		}
 	}
 }
 
 LemniType lemniTypePromote(LemniTypeSet types, LemniType a, LemniType b){
-	const auto aInfo = &types->typeInfos[a->typeIdx()];
-	const auto bInfo = &types->typeInfos[b->typeIdx()];
+	auto aIdx = types->scalarIndexOf(a);
+	auto bIdx = types->scalarIndexOf(b);
 
-	if(lemniTypeInfoHasClass(aInfo, LEMNI_TYPECLASS_SCALAR) && lemniTypeInfoHasClass(bInfo, LEMNI_TYPECLASS_SCALAR)){
-		if((aInfo->info.scalar.traits & LEMNI_SCALAR_UNIT) && (bInfo->info.scalar.traits & LEMNI_SCALAR_UNIT)){
-			return a;
+	if((aIdx == ScalarTables::noIndex) || (bIdx == ScalarTables::noIndex)){
+		return promoteUncached(types, a, b);
+	}
+
+	if(auto known = types->scalarTables.promoted(aIdx, bIdx)){
+		return *known;
+	}
+
+	auto ret = promoteUncached(types, a, b);
+	types->scalarTables.setPromoted(aIdx, bIdx, ret);
+	return ret;
+}
+
+LemniType lemniTypeSetArithmeticResult(LemniTypeSet types, LemniType lhs, LemniType rhs, LemniBinaryOp op){
+	auto lhsIdx = types->scalarIndexOf(lhs);
+	auto rhsIdx = types->scalarIndexOf(rhs);
+
+	if((lhsIdx == ScalarTables::noIndex) || (rhsIdx == ScalarTables::noIndex) || !ScalarTables::isOp(op)){
+		return arithmeticResultUncached(types, lemniTypePromote(types, lhs, rhs), op);
+	}
+
+	if(auto known = types->scalarTables.result(op, lhsIdx, rhsIdx)){
+		return *known;
+	}
+
+	auto ret = arithmeticResultUncached(types, lemniTypePromote(types, lhs, rhs), op);
+	types->scalarTables.setResult(op, lhsIdx, rhsIdx, ret);
+	return ret;
+}
+
+bool lemniTypeSetIsCastable(LemniTypeSet types, LemniType from, LemniType to){
+	auto fromIdx = types->scalarIndexOf(from);
+	auto toIdx = types->scalarIndexOf(to);
+
+	if((fromIdx == ScalarTables::noIndex) || (toIdx == ScalarTables::noIndex)){
+		return from->isCastable(to);
+	}
+
+	if(auto known = types->scalarTables.castable(fromIdx, toIdx)){
+		return *known;
+	}
+
+	auto ret = from->isCastable(to);
+	types->scalarTables.setCastable(fromIdx, toIdx, ret);
+	return ret;
+}
+
+namespace {
+	constexpr LemniNat64 alignUp(const LemniNat64 n, const LemniNat64 alignment) noexcept{
+		return (n + alignment - 1) & ~(alignment - 1);
+	}
+
+	constexpr LemniTypeLayout scalarLayout(const LemniNat64 size, const LemniNat64 alignment) noexcept{
+		return LemniTypeLayout{ .size = size, .alignment = alignment, .padding = 0, .numFields = 0, .fieldOffsets = nullptr };
+	}
+
+	//! Integers take the smallest power of 2 bytes fitting them, wider than 128 bits they are stored as 64-bit limbs
+	std::optional<LemniTypeLayout> intLayout(const LemniNat32 numBits) noexcept{
+		if(numBits == 0) return std::nullopt;
+
+		const LemniNat64 numBytes = (numBits + 7) / 8;
+
+		if(numBytes > 16){
+			return scalarLayout(alignUp(numBytes, 8), 8);
 		}
-		else if((aInfo->info.scalar.traits & LEMNI_SCALAR_TEXTUAL) && (bInfo->info.scalar.traits & LEMNI_SCALAR_TEXTUAL)){
-			if(auto str = lemniTypeAsString(a)) return promoteString(types, str, b);
-			else if(auto utf8 = lemniTypeAsStringUTF8(a)) return promoteStringUTF8(types, utf8, b);
-			else if(auto ascii = lemniTypeAsStringASCII(a)) return promoteStringASCII(types, ascii, b);
-			else return a;
+
+		const auto size = std::bit_ceil(numBytes);
+		return scalarLayout(size, size);
+	}
+
+	//! C struct layout of \p numFields fields, \p fieldType is called with each field index
+	template<typename FieldTypeFn>
+	std::optional<LemniTypeLayout> structLayout(
+		LemniTypeSet types, const LemniNat64 numFields, FieldTypeFn &&fieldType, std::vector<std::uint64_t> &offsets
+	){
+		LemniNat64 size = 0, alignment = 1, padding = 0;
+
+		offsets.reserve(numFields);
+
+		for(LemniNat64 i = 0; i < numFields; i++){
+			auto field = lemniTypeSetGetLayout(types, fieldType(i));
+			if(!field) return std::nullopt;
+
+			const auto offset = alignUp(size, field->alignment);
+
+			padding += (offset - size) + field->padding;
+			offsets.emplace_back(offset);
+
+			size = offset + field->size;
+			alignment = std::max(alignment, field->alignment);
 		}
-		else if((aInfo->info.scalar.traits & LEMNI_SCALAR_RANGE) && (bInfo->info.scalar.traits & LEMNI_SCALAR_RANGE)){
-			if(auto nat = lemniTypeAsNat(a)) return promoteNat(types, nat, b);
-			else if(auto int_ = lemniTypeAsInt(a)) return promoteInt(types, int_, b);
-			else if(auto ratio = lemniTypeAsRatio(a)) return promoteRatio(types, ratio, b);
-			else if(auto real = lemniTypeAsReal(a)) return promoteReal(types, real, b);
-			else return a;
+
+		const auto alignedSize = alignUp(size, alignment);
+		padding += alignedSize - size;
+
+		return LemniTypeLayout{ .size = alignedSize, .alignment = alignment, .padding = padding, .numFields = numFields, .fieldOffsets = nullptr };
+	}
+
+	std::optional<LemniTypeLayout> computeLayout(LemniTypeSet types, LemniType type, std::vector<std::uint64_t> &offsets){
+		switch(type->kind()){
+			case LEMNI_TYPE_KIND_UNIT: return scalarLayout(0, 1);
+			case LEMNI_TYPE_KIND_BOOL: return scalarLayout(sizeof(LemniBool), alignof(LemniBool));
+
+			case LEMNI_TYPE_KIND_NAT:
+			case LEMNI_TYPE_KIND_INT:
+				return intLayout(type->numBits());
+
+			case LEMNI_TYPE_KIND_RATIO:{
+				// numerator and denominator of half the width each
+				auto half = intLayout(type->numBits() / 2);
+				if(!half) return std::nullopt;
+				return scalarLayout(half->size * 2, half->alignment);
+			}
+
+			case LEMNI_TYPE_KIND_REAL:{
+				switch(type->numBits()){
+					case 16: return scalarLayout(2, 2);
+					case 32: return scalarLayout(sizeof(float), alignof(float));
+					case 64: return scalarLayout(sizeof(double), alignof(double));
+					default: return std::nullopt;
+				}
+			}
+
+			case LEMNI_TYPE_KIND_STRING_ASCII:
+			case LEMNI_TYPE_KIND_STRING_UTF8:
+				// same as LemniStr
+				return scalarLayout(sizeof(LemniStr), alignof(LemniStr));
+
+			case LEMNI_TYPE_KIND_FUNCTION:
+			case LEMNI_TYPE_KIND_C_PTR:
+				return scalarLayout(sizeof(void*), alignof(void*));
+
+			case LEMNI_TYPE_KIND_C_CONST:{
+				auto qualified = lemniTypeSetGetLayout(types, static_cast<const LemniCConstTypeImplT*>(type)->qualified);
+				if(!qualified) return std::nullopt;
+				return *qualified;
+			}
+
+			case LEMNI_TYPE_KIND_ARRAY:{
+				auto arr = static_cast<LemniArrayType>(type);
+
+				auto elem = lemniTypeSetGetLayout(types, arr->element());
+				if(!elem) return std::nullopt;
+
+				const auto numElems = arr->numElements();
+				return LemniTypeLayout{
+					.size = elem->size * numElems, .alignment = elem->alignment, .padding = elem->padding * numElems,
+					.numFields = 0, .fieldOffsets = nullptr
+				};
+			}
+
+			case LEMNI_TYPE_KIND_PRODUCT:{
+				auto product = static_cast<LemniProductType>(type);
+				return structLayout(types, product->numComponents(), [product](LemniNat64 i){ return product->component(i); }, offsets);
+			}
+
+			case LEMNI_TYPE_KIND_RECORD:{
+				auto record = static_cast<LemniRecordType>(type);
+				return structLayout(types, record->numFields(), [record](LemniNat64 i){ return record->field(i)->type; }, offsets);
+			}
+
+			// abstract, arbitrary precision or only known to the evaluator
+			default: return std::nullopt;
+		}
+	}
+}
+
+const LemniTypeLayout *lemniTypeSetGetLayout(LemniTypeSet types, LemniType type){
+	if(!type) return nullptr;
+
+	const auto idx = type->typeIdx();
+
+	{
+		std::shared_lock lock(types->cacheMutex);
+		auto res = types->layoutCache.find(idx);
+		if(res != end(types->layoutCache)){
+			return res->second.layout ? &*res->second.layout : nullptr;
+		}
+	}
+
+	// computed without the lock held, fields get their layouts through this function
+	std::vector<std::uint64_t> offsets;
+	auto layout = computeLayout(types, type, offsets);
+
+	std::unique_lock lock(types->cacheMutex);
+
+	auto [it, inserted] = types->layoutCache.try_emplace(idx, LemniTypeSetT::LayoutEntry{ layout, std::move(offsets) });
+
+	auto &entry = it->second;
+	if(inserted && entry.layout && entry.layout->numFields){
+		entry.layout->fieldOffsets = entry.offsets.data();
+	}
+
+	return entry.layout ? &*entry.layout : nullptr;
+}
+
+namespace {
+	/**
+	 * Type set snapshots.
+	 *
+	 * A snapshot starts with a header of magic bytes, the format version, the number of type ids and the number of
+	 * types of each kind. Then comes one record per type id in id order: a kind byte followed by the bit width or the
+	 * ids of the type's components. Integers are LEB128 encoded and types are only ever referred to by id, so
+	 * snapshots don't depend on where anything lived in memory.
+	 *
+	 * Components are always created before the types made from them, so restoring replays the records in order
+	 * through the regular getters and every type ends up with the id it had when the snapshot was taken.
+	 */
+	constexpr std::uint8_t snapshotMagic[] = { 'L', 'M', 'T', 'S' };
+	constexpr std::uint64_t snapshotVersion = 1;
+
+	// snapshots may be corrupt, counts read from them are bounded before anything is sized by them
+	constexpr std::uint64_t snapshotMaxComponents = UINT32_MAX;
+	constexpr std::uint64_t snapshotMaxReserve = std::uint64_t(1) << 20;
+
+	enum class SnapshotKind: std::uint8_t{
+		hole, builtin, module, pseudo,
+		nat, int_, ratio, real,
+		array, function, closure, sum, product, record,
+		count
+	};
+
+	class SnapshotWriter{
+		public:
+			explicit SnapshotWriter(LemniIO *io_) noexcept: io(io_){}
+
+			void bytes(const void *ptr, const std::size_t len){
+				auto p = reinterpret_cast<const std::uint8_t*>(ptr);
+				buffer.insert(end(buffer), p, p + len);
+				if(buffer.size() >= bufferSize) flush();
+			}
+
+			void byte(const std::uint8_t b){ bytes(&b, 1); }
+
+			void varint(std::uint64_t val){
+				std::uint8_t buf[10];
+				std::size_t n = 0;
+
+				do{
+					auto b = std::uint8_t(val & 0x7f);
+					val >>= 7;
+					buf[n++] = val ? (b | 0x80) : b;
+				} while(val);
+
+				bytes(buf, n);
+			}
+
+			void type(LemniType t){ varint(t->typeIdx()); }
+
+			bool flush(){
+				if(ok && !buffer.empty()){
+					ok = io->writeCb(io->user, buffer.data(), buffer.size()) == buffer.size();
+				}
+
+				buffer.clear();
+				return ok;
+			}
+
+		private:
+			static constexpr std::size_t bufferSize = 64 * 1024;
+
+			LemniIO *io;
+			std::vector<std::uint8_t> buffer;
+			bool ok = true;
+	};
+
+	class SnapshotReader{
+		public:
+			explicit SnapshotReader(LemniIO *io_) noexcept: io(io_){}
+
+			bool bytes(void *ptr, std::size_t len){
+				auto p = reinterpret_cast<std::uint8_t*>(ptr);
+
+				while(len > 0){
+					if(pos == buffer.size() && !refill()) return false;
+
+					auto n = std::min(len, buffer.size() - pos);
+					std::memcpy(p, buffer.data() + pos, n);
+
+					pos += n;
+					p += n;
+					len -= n;
+				}
+
+				return true;
+			}
+
+			bool byte(std::uint8_t &b){ return bytes(&b, 1); }
+
+			//! Read a string of \p len bytes, growing \p str only as the bytes arrive
+			bool string(std::string &str, std::uint64_t len){
+				str.clear();
+
+				while(len > 0){
+					if(pos == buffer.size() && !refill()) return false;
+
+					auto n = std::size_t(std::min<std::uint64_t>(len, buffer.size() - pos));
+					str.append(reinterpret_cast<const char*>(buffer.data() + pos), n);
+
+					pos += n;
+					len -= n;
+				}
+
+				return true;
+			}
+
+			bool varint(std::uint64_t &val){
+				val = 0;
+
+				for(unsigned shift = 0; shift < 64; shift += 7){
+					std::uint8_t b;
+					if(!byte(b)) return false;
+
+					val |= std::uint64_t(b & 0x7f) << shift;
+					if(!(b & 0x80)) return true;
+				}
+
+				return false;
+			}
+
+			//! Read a count of at most \ref snapshotMaxComponents
+			bool count(std::uint64_t &n){ return varint(n) && n <= snapshotMaxComponents; }
+
+			//! Read the id of a type that was restored before the current one
+			bool type(LemniTypeSet types, const std::uint64_t currentId, LemniType &ret){
+				std::uint64_t id;
+				if(!varint(id) || id >= currentId) return false;
+
+				ret = lemniTypeSetGetById(types, id);
+				return ret != nullptr;
+			}
+
+			bool types(LemniTypeSet typeSet, const std::uint64_t currentId, const std::uint64_t n, std::vector<LemniType> &ret){
+				ret.clear();
+
+				for(std::uint64_t i = 0; i < n; i++){
+					LemniType t;
+					if(!type(typeSet, currentId, t)) return false;
+					ret.emplace_back(t);
+				}
+
+				return true;
+			}
+
+		private:
+			bool refill(){
+				buffer.resize(64 * 1024);
+				auto n = io->readCb(io->user, buffer.data(), buffer.size());
+				buffer.resize(n);
+				pos = 0;
+				return n > 0;
+			}
+
+			LemniIO *io;
+			std::vector<std::uint8_t> buffer;
+			std::size_t pos = 0;
+	};
+
+	SnapshotKind snapshotKindOf(LemniTypeSet types, LemniType type, const std::uint64_t id){
+		if(!type) return SnapshotKind::hole;
+		else if(id < types->numBuiltins) return SnapshotKind::builtin;
+		else if(lemniTypeAsModule(type)) return SnapshotKind::module;
+		else if(lemniTypeAsPseudo(type)) return SnapshotKind::pseudo;
+		else if(lemniTypeAsNat(type)) return SnapshotKind::nat;
+		else if(lemniTypeAsInt(type)) return SnapshotKind::int_;
+		else if(lemniTypeAsRatio(type)) return SnapshotKind::ratio;
+		else if(lemniTypeAsReal(type)) return SnapshotKind::real;
+		else if(lemniTypeAsArray(type)) return SnapshotKind::array;
+		else if(lemniTypeAsClosure(type)) return SnapshotKind::closure;
+		else if(lemniTypeAsFunction(type)) return SnapshotKind::function;
+		else if(lemniTypeAsSum(type)) return SnapshotKind::sum;
+		else if(lemniTypeAsProduct(type)) return SnapshotKind::product;
+		else if(lemniTypeAsRecord(type)) return SnapshotKind::record;
+		else return SnapshotKind::hole;
+	}
+
+	void writeSnapshotRecord(SnapshotWriter &out, LemniTypeSet types, LemniType type, const std::uint64_t id, const SnapshotKind kind){
+		out.byte(std::uint8_t(kind));
+
+		switch(kind){
+			case SnapshotKind::pseudo:{
+				// only the usage flags are kept, usage info of other classes refers to memory of the type set
+				auto info = lemniTypeSetGetInfo(types, id);
+				out.varint(info->binaryOpFlags);
+				out.varint(info->unaryOpFlags);
+				out.varint(info->typeClass);
+
+				if(info->typeClass & LEMNI_TYPECLASS_SCALAR){
+					out.varint(info->info.scalar.traits);
+					out.varint(info->info.scalar.numBits);
+				}
+
+				break;
+			}
+
+			case SnapshotKind::nat:
+			case SnapshotKind::int_:
+			case SnapshotKind::ratio:
+			case SnapshotKind::real:{
+				out.varint(type->numBits());
+				break;
+			}
+
+			case SnapshotKind::array:{
+				auto arr = lemniTypeAsArray(type);
+				out.varint(arr->numElements());
+				out.type(arr->element());
+				break;
+			}
+
+			case SnapshotKind::function:{
+				auto fn = lemniTypeAsFunction(type);
+				out.type(fn->result());
+				out.varint(fn->numParams());
+				for(LemniNat64 i = 0; i < fn->numParams(); i++) out.type(fn->param(i));
+				break;
+			}
+
+			case SnapshotKind::closure:{
+				auto closure = lemniTypeAsClosure(type);
+				out.type(closure->fn());
+				out.varint(closure->numClosed());
+				for(LemniNat64 i = 0; i < closure->numClosed(); i++) out.type(closure->closed(i));
+				break;
+			}
+
+			case SnapshotKind::sum:{
+				auto sum = lemniTypeAsSum(type);
+				out.varint(sum->numCases());
+				for(LemniNat64 i = 0; i < sum->numCases(); i++) out.type(sum->case_(i));
+				break;
+			}
+
+			case SnapshotKind::product:{
+				auto product = lemniTypeAsProduct(type);
+				out.varint(product->numComponents());
+				for(LemniNat64 i = 0; i < product->numComponents(); i++) out.type(product->component(i));
+				break;
+			}
+
+			case SnapshotKind::record:{
+				auto record = lemniTypeAsRecord(type);
+				out.varint(record->numFields());
+
+				for(LemniNat64 i = 0; i < record->numFields(); i++){
+					auto field = record->field(i);
+					out.type(field->type);
+					out.varint(field->name.len);
+					out.bytes(field->name.ptr, field->name.len);
+				}
+
+				break;
+			}
+
+			default: break;
+		}
+	}
+
+	//! Restore the type with id \p id , returns the id the record was given or ``UINT64_MAX`` if it is malformed
+	std::uint64_t readSnapshotRecord(SnapshotReader &in, LemniTypeSet types, const std::uint64_t id){
+		constexpr auto failed = UINT64_MAX;
+
+		std::uint8_t kindByte;
+		if(!in.byte(kindByte) || kindByte >= std::uint8_t(SnapshotKind::count)) return failed;
+
+		std::uint64_t n;
+		LemniType type = nullptr;
+		std::vector<LemniType> components;
+
+		auto readBits = [&](std::uint64_t &bits){ return in.varint(bits) && bits > 0 && bits <= UINT32_MAX; };
+
+		switch(SnapshotKind(kindByte)){
+			case SnapshotKind::hole: return types->createTypeInfo(zeroedTypeInfo());
+
+			case SnapshotKind::builtin:{
+				if(id >= types->numBuiltins) return failed;
+				type = lemniTypeSetGetById(types, id);
+				break;
+			}
+
+			case SnapshotKind::module:{
+				type = lemniTypeSetGetModule(types);
+				break;
+			}
+
+			case SnapshotKind::pseudo:{
+				std::uint64_t binaryOps, unaryOps, typeClass;
+				if(!in.varint(binaryOps) || !in.varint(unaryOps) || !in.varint(typeClass)) return failed;
+
+				auto info = zeroedTypeInfo();
+				info.binaryOpFlags = std::uint32_t(binaryOps);
+				info.unaryOpFlags = std::uint32_t(unaryOps);
+				info.typeClass = std::uint32_t(typeClass);
+
+				if(typeClass & LEMNI_TYPECLASS_SCALAR){
+					std::uint64_t traits, numBits;
+					if(!in.varint(traits) || !in.varint(numBits)) return failed;
+
+					info.info.scalar.traits = std::uint32_t(traits);
+					info.info.scalar.numBits = std::uint32_t(numBits);
+				}
+				else{
+					info.typeClass &= LEMNI_TYPECLASS_PSEUDO;
+				}
+
+				type = lemniTypeSetGetPseudo(types, info);
+				break;
+			}
+
+			case SnapshotKind::nat:{ if(!readBits(n)) return failed; type = lemniTypeSetGetNat(types, std::uint32_t(n)); break; }
+			case SnapshotKind::int_:{ if(!readBits(n)) return failed; type = lemniTypeSetGetInt(types, std::uint32_t(n)); break; }
+			case SnapshotKind::ratio:{ if(!readBits(n)) return failed; type = lemniTypeSetGetRatio(types, std::uint32_t(n)); break; }
+			case SnapshotKind::real:{ if(!readBits(n)) return failed; type = lemniTypeSetGetReal(types, std::uint32_t(n)); break; }
+
+			case SnapshotKind::array:{
+				LemniType elem;
+				if(!in.varint(n) || !in.type(types, id, elem)) return failed;
+				type = lemniTypeSetGetArray(types, n, elem);
+				break;
+			}
+
+			case SnapshotKind::function:{
+				LemniType result;
+				if(!in.type(types, id, result) || !in.count(n) || !in.types(types, id, n, components)) return failed;
+				type = lemniTypeSetGetFunction(types, result, components.data(), std::uint32_t(n));
+				break;
+			}
+
+			case SnapshotKind::closure:{
+				LemniType fnType;
+				if(!in.type(types, id, fnType) || !in.count(n) || !in.types(types, id, n, components)) return failed;
+
+				auto fn = lemniTypeAsFunction(fnType);
+				if(!fn) return failed;
+
+				type = lemniTypeSetGetClosure(types, fn, components.data(), n);
+				break;
+			}
+
+			case SnapshotKind::sum:{
+				if(!in.count(n) || !in.types(types, id, n, components)) return failed;
+				type = lemniTypeSetGetSum(types, components.data(), n);
+				break;
+			}
+
+			case SnapshotKind::product:{
+				if(!in.count(n) || !in.types(types, id, n, components)) return failed;
+				type = lemniTypeSetGetProduct(types, components.data(), n);
+				break;
+			}
+
+			case SnapshotKind::record:{
+				if(!in.count(n)) return failed;
+
+				std::vector<std::string> names;
+				std::vector<LemniRecordTypeField> fields;
+
+				for(std::uint64_t i = 0; i < n; i++){
+					LemniType fieldType;
+					std::uint64_t len;
+					if(!in.type(types, id, fieldType) || !in.varint(len)) return failed;
+
+					auto &&name = names.emplace_back();
+					if(!in.string(name, len)) return failed;
+
+					fields.emplace_back(LemniRecordTypeField{ .name = {}, .type = fieldType });
+				}
+
+				for(std::uint64_t i = 0; i < n; i++){
+					fields[i].name = lemni::fromStdStrView(names[i]);
+				}
+
+				type = lemniTypeSetGetRecord(types, fields.data(), n);
+				break;
+			}
+
+			default: return failed;
+		}
+
+		return type ? type->typeIdx() : failed;
+	}
+}
+
+bool lemniSerializeTypeSet(LemniTypeSet types, LemniIO *io){
+	auto numIds = types->entries.size();
+
+	std::vector<SnapshotKind> kinds(numIds);
+	std::vector<std::uint64_t> kindCounts(std::size_t(SnapshotKind::count), 0);
+
+	for(std::uint64_t id = 0; id < numIds; id++){
+		kinds[id] = snapshotKindOf(types, lemniTypeSetGetById(types, id), id);
+		++kindCounts[std::size_t(kinds[id])];
+	}
+
+	SnapshotWriter out(io);
+
+	out.bytes(snapshotMagic, sizeof(snapshotMagic));
+	out.varint(snapshotVersion);
+	out.varint(numIds);
+
+	for(auto count : kindCounts) out.varint(count);
+
+	for(std::uint64_t id = 0; id < numIds; id++){
+		writeSnapshotRecord(out, types, lemniTypeSetGetById(types, id), id, kinds[id]);
+	}
+
+	return out.flush();
+}
+
+LemniTypeSet lemniDeserializeTypeSet(LemniIO *io){
+	SnapshotReader in(io);
+
+	std::uint8_t magic[sizeof(snapshotMagic)];
+	std::uint64_t version, numIds;
+
+	if(
+		!in.bytes(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), snapshotMagic) ||
+		!in.varint(version) || version != snapshotVersion ||
+		!in.varint(numIds)
+	){
+		return nullptr;
+	}
+
+	std::vector<std::uint64_t> kindCounts(std::size_t(SnapshotKind::count));
+
+	std::uint64_t numCounted = 0;
+
+	for(auto &&count : kindCounts){
+		if(!in.varint(count) || count > numIds - numCounted) return nullptr;
+		numCounted += count;
+	}
+
+	auto types = lemniCreateTypeSet();
+
+	if(numIds < types->numBuiltins){
+		lemniDestroyTypeSet(types);
+		return nullptr;
+	}
+
+	auto countOfKind = [&](const SnapshotKind kind){ return std::min(kindCounts[std::size_t(kind)], snapshotMaxReserve); };
+
+	// size the interning tables up front, restoring then only grows them for very large snapshots
+	types->natTys.reserve(countOfKind(SnapshotKind::nat));
+	types->intTys.reserve(countOfKind(SnapshotKind::int_));
+	types->ratioTys.reserve(countOfKind(SnapshotKind::ratio));
+	types->realTys.reserve(countOfKind(SnapshotKind::real));
+	types->arrTys.reserve(countOfKind(SnapshotKind::array));
+	types->fnTys.reserve(countOfKind(SnapshotKind::function));
+	types->closureTys.reserve(countOfKind(SnapshotKind::closure));
+	types->sumTys.reserve(countOfKind(SnapshotKind::sum));
+	types->productTys.reserve(countOfKind(SnapshotKind::product));
+	types->recordTys.reserve(countOfKind(SnapshotKind::record));
+
+	for(std::uint64_t id = 0; id < numIds; id++){
+		if(readSnapshotRecord(in, types, id) != id){
+			lemniDestroyTypeSet(types);
+			return nullptr;
 		}
 	}
 
-	LemniType cases[] = {a, b};
-	return lemniTypeSetGetSum(types, cases, sizeof(cases)/sizeof(*cases));
+	return types;
 }
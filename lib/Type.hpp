@@ -21,6 +21,8 @@
 
 #include <cstring>
 
+#include <atomic>
+#include <span>
 #include <vector>
 #include <string>
 
@@ -372,18 +374,82 @@ enum class LemniModuleFlags: uint32_t{
 template<typename Enum>
 inline constexpr uint32_t enumFlag(Enum val) noexcept{ return uint32_t(1) << static_cast<uint32_t>(val); }
 
+/**
+ * Get a link to another type, resolving it with \p resolve on first use if it wasn't known on construction.
+ * Sized numeric types link to each other in cycles (Nat8 -> Int9 -> Ratio18 -> Int9 ...), so creating
+ * every link up front would never finish. Racing resolvers get the same interned type, so either store wins.
+ */
+template<typename T, typename Resolve>
+inline T lazyTypeLink(T known, std::atomic<T> &cache, Resolve &&resolve) noexcept{
+	if(known) return known;
+
+	auto ret = cache.load(std::memory_order_acquire);
+	if(!ret){
+		ret = resolve();
+		cache.store(ret, std::memory_order_release);
+	}
+
+	return ret;
+}
+
 struct LemniTypeTraitsT{
 	LemniTypeCategory category;
 	uint32_t flags;
 };
 
+//! Kind stored in types implementing the interface \p Base
+template<typename Base>
+struct LemniTypeKindOf;
+
+#define LEMNI_TYPE_KIND_OF(base, kind_)\
+	template<> struct LemniTypeKindOf<base>{ static constexpr LemniTypeKind value = kind_; }
+
+LEMNI_TYPE_KIND_OF(LemniTopTypeT, LEMNI_TYPE_KIND_TOP);
+LEMNI_TYPE_KIND_OF(LemniBottomTypeT, LEMNI_TYPE_KIND_BOTTOM);
+LEMNI_TYPE_KIND_OF(LemniPseudoTypeT, LEMNI_TYPE_KIND_PSEUDO);
+LEMNI_TYPE_KIND_OF(LemniErrorTypeT, LEMNI_TYPE_KIND_ERROR);
+LEMNI_TYPE_KIND_OF(LemniModuleTypeT, LEMNI_TYPE_KIND_MODULE);
+LEMNI_TYPE_KIND_OF(LemniExprTypeT, LEMNI_TYPE_KIND_EXPR);
+LEMNI_TYPE_KIND_OF(LemniMetaTypeT, LEMNI_TYPE_KIND_META);
+LEMNI_TYPE_KIND_OF(LemniUnitTypeT, LEMNI_TYPE_KIND_UNIT);
+LEMNI_TYPE_KIND_OF(LemniBoolTypeT, LEMNI_TYPE_KIND_BOOL);
+LEMNI_TYPE_KIND_OF(LemniNumberTypeT, LEMNI_TYPE_KIND_NUMBER);
+LEMNI_TYPE_KIND_OF(LemniRealTypeT, LEMNI_TYPE_KIND_REAL);
+LEMNI_TYPE_KIND_OF(LemniRatioTypeT, LEMNI_TYPE_KIND_RATIO);
+LEMNI_TYPE_KIND_OF(LemniIntTypeT, LEMNI_TYPE_KIND_INT);
+LEMNI_TYPE_KIND_OF(LemniNatTypeT, LEMNI_TYPE_KIND_NAT);
+LEMNI_TYPE_KIND_OF(LemniStringTypeT, LEMNI_TYPE_KIND_STRING);
+LEMNI_TYPE_KIND_OF(LemniStringASCIITypeT, LEMNI_TYPE_KIND_STRING_ASCII);
+LEMNI_TYPE_KIND_OF(LemniStringUTF8TypeT, LEMNI_TYPE_KIND_STRING_UTF8);
+LEMNI_TYPE_KIND_OF(LemniArrayTypeT, LEMNI_TYPE_KIND_ARRAY);
+LEMNI_TYPE_KIND_OF(LemniFunctionTypeT, LEMNI_TYPE_KIND_FUNCTION);
+LEMNI_TYPE_KIND_OF(LemniClosureTypeT, LEMNI_TYPE_KIND_CLOSURE);
+LEMNI_TYPE_KIND_OF(LemniSumTypeT, LEMNI_TYPE_KIND_SUM);
+LEMNI_TYPE_KIND_OF(LemniProductTypeT, LEMNI_TYPE_KIND_PRODUCT);
+LEMNI_TYPE_KIND_OF(LemniRecordTypeT, LEMNI_TYPE_KIND_RECORD);
+LEMNI_TYPE_KIND_OF(LemniCPtrTypeT, LEMNI_TYPE_KIND_C_PTR);
+LEMNI_TYPE_KIND_OF(LemniCConstTypeT, LEMNI_TYPE_KIND_C_CONST);
+LEMNI_TYPE_KIND_OF(LemniCVoidTypeT, LEMNI_TYPE_KIND_C_VOID);
+
+#undef LEMNI_TYPE_KIND_OF
+
+//! Get \p type as the interface matching \p kind , or ``nullptr`` if it is of another kind
+template<typename T>
+inline const T *lemniTypeAsKind(LemniType type, const LemniTypeKind kind) noexcept{
+	return (type && type->kind() == kind) ? static_cast<const T*>(type) : nullptr;
+}
+
 template<typename TypeBase, typename Base, typename T, typename = void>
 struct LemniTypeBaseImplT;
 
 template<typename TypeBase, typename Base, typename T>
 struct LemniTypeBaseImplT<TypeBase, Base, T, std::enable_if_t<std::is_base_of_v<TypeBase, Base>>>: Base{
 	LemniTypeBaseImplT(LemniType base_, LemniType abstract_, const LemniNat32 numBits_, const LemniNat64 typeInfoIdx_, std::string str_, std::string mangled_)
-		: m_base(base_), m_abstract(abstract_), m_numBits(numBits_), m_typeInfoIdx(typeInfoIdx_), m_str(std::move(str_)), m_mangled(std::move(mangled_)){}
+		: m_base(base_), m_abstract(abstract_), m_typeInfoIdx(typeInfoIdx_), m_str(std::move(str_)), m_mangled(std::move(mangled_))
+	{
+		this->m_kind = LemniTypeKindOf<Base>::value;
+		this->m_numBits = numBits_;
+	}
 
 	virtual ~LemniTypeBaseImplT() = default;
 
@@ -399,11 +465,9 @@ struct LemniTypeBaseImplT<TypeBase, Base, T, std::enable_if_t<std::is_base_of_v<
 	LemniStr mangled() const noexcept override{ return lemni::fromStdStrView(m_mangled); }
 	LemniType base() const noexcept override{ return m_base; }
 	LemniType abstract() const noexcept override{ return m_abstract; }
-	LemniNat32 numBits() const noexcept override{ return m_numBits; }
 	LemniNat64 typeIdx() const noexcept override{ return m_typeInfoIdx; }
 
 	LemniType m_base, m_abstract;
-	LemniNat32 m_numBits;
 	LemniNat64 m_typeInfoIdx;
 	std::string m_str, m_mangled;
 };
@@ -431,8 +495,10 @@ struct LemniModuleTypeImplT: LemniTypeImplT<LemniModuleTypeT, LemniModuleTypeImp
 };
 
 struct LemniPseudoTypeImplT: LemniTypeImplT<LemniPseudoTypeT, LemniPseudoTypeImplT>{
-	LemniPseudoTypeImplT(LemniTopType top, const LemniNat64 typeInfoIdx_, const LemniNat64 pseudoIdx)
-		: LemniTypeImplT(top, this, 0, typeInfoIdx_, "Pseudo " + std::to_string(pseudoIdx), "?" + std::to_string(pseudoIdx)){}
+	LemniPseudoTypeImplT(LemniTopType top, const LemniNat64 typeInfoIdx_, const LemniNat64 pseudoIdx, const void *owner_ = nullptr)
+		: LemniTypeImplT(top, this, 0, typeInfoIdx_, "Pseudo " + std::to_string(pseudoIdx), "?" + std::to_string(pseudoIdx)), owner(owner_){}
+
+	const void *owner;
 };
 
 struct LemniExprTypeImplT: LemniTypeImplT<LemniExprTypeT, LemniExprTypeImplT>{
@@ -492,27 +558,65 @@ struct LemniRatioTypeImplT: LemniTypeImplT<LemniRatioTypeT, LemniRatioTypeImplT>
 		: LemniTypeImplT(base, abstract, numBits, typeInfoIdx_, "Ratio" + (numBits > 0 ? std::to_string(numBits) : ""s), "q" + std::to_string(numBits))
 		, numType(numType_), denType(denType_){}
 
+	//! Sized ratio type whose numerator and denominator types are looked up in \p types on first use
+	LemniRatioTypeImplT(LemniTypeSet types_, LemniRealType base, LemniRatioType abstract, const uint64_t typeInfoIdx_, const uint32_t numBits)
+		: LemniRatioTypeImplT(base, abstract, typeInfoIdx_, numBits, LemniIntType(nullptr), LemniNatType(nullptr))
+	{ types = types_; }
+
 	bool isCastable(LemniType to) const noexcept override;
 
-	LemniIntType numerator() const noexcept override{ return numType; }
-	LemniNatType denominator() const noexcept override{ return denType; }
+	LemniIntType numerator() const noexcept override{
+		return lazyTypeLink(numType, lazyNumType, [this]{ return lemniTypeSetGetInt(types, numBits() / 2); });
+	}
+
+	LemniNatType denominator() const noexcept override{
+		return lazyTypeLink(denType, lazyDenType, [this]{ return lemniTypeSetGetNat(types, numBits() / 2); });
+	}
 
 	LemniIntType numType;
 	LemniNatType denType;
+
+	LemniTypeSet types = nullptr;
+	mutable std::atomic<LemniIntType> lazyNumType = nullptr;
+	mutable std::atomic<LemniNatType> lazyDenType = nullptr;
 };
 
 struct LemniIntTypeImplT: LemniTypeImplT<LemniIntTypeT, LemniIntTypeImplT>{
 	LemniIntTypeImplT(LemniRatioType base, LemniIntType abstract, const uint64_t typeInfoIdx_, const uint32_t numBits)
 		: LemniTypeImplT(base, abstract, numBits, typeInfoIdx_, "Int" + (numBits > 0 ? std::to_string(numBits) : ""s), "z" + std::to_string(numBits)){}
 
+	//! Sized integer type whose base is looked up in \p types on first use
+	LemniIntTypeImplT(LemniTypeSet types_, LemniIntType abstract, const uint64_t typeInfoIdx_, const uint32_t numBits)
+		: LemniIntTypeImplT(LemniRatioType(nullptr), abstract, typeInfoIdx_, numBits)
+	{ types = types_; }
+
 	bool isCastable(LemniType to) const noexcept override;
+
+	LemniType base() const noexcept override{
+		return lazyTypeLink(m_base, lazyBase, [this]() -> LemniType{ return lemniTypeSetGetRatio(types, numBits() * 2); });
+	}
+
+	LemniTypeSet types = nullptr;
+	mutable std::atomic<LemniType> lazyBase = nullptr;
 };
 
 struct LemniNatTypeImplT: LemniTypeImplT<LemniNatTypeT, LemniNatTypeImplT>{
 	LemniNatTypeImplT(LemniIntType base, LemniNatType abstract, const uint64_t typeInfoIdx_, const uint32_t numBits_)
 		: LemniTypeImplT(base, abstract, numBits_, typeInfoIdx_, "Nat" + (numBits_ > 0 ? std::to_string(numBits_) : ""s), "n" + std::to_string(numBits_)){}
 
+	//! Sized natural type whose base is looked up in \p types on first use
+	LemniNatTypeImplT(LemniTypeSet types_, LemniNatType abstract, const uint64_t typeInfoIdx_, const uint32_t numBits_)
+		: LemniNatTypeImplT(LemniIntType(nullptr), abstract, typeInfoIdx_, numBits_)
+	{ types = types_; }
+
 	bool isCastable(LemniType to) const noexcept override;
+
+	LemniType base() const noexcept override{
+		return lazyTypeLink(m_base, lazyBase, [this]() -> LemniType{ return lemniTypeSetGetInt(types, numBits() + 1); });
+	}
+
+	LemniTypeSet types = nullptr;
+	mutable std::atomic<LemniType> lazyBase = nullptr;
 };
 
 struct LemniStringTypeImplT: LemniTypeImplT<LemniStringTypeT, LemniStringTypeImplT>{
@@ -532,9 +636,9 @@ struct LemniStringUTF8TypeImplT: LemniTypeImplT<LemniStringUTF8TypeT, LemniStrin
 };
 
 struct LemniFunctionTypeImplT: LemniTypeImplT<LemniFunctionTypeT, LemniFunctionTypeImplT>{
-	LemniFunctionTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, LemniType result_, std::vector<LemniType> params_)
+	LemniFunctionTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, LemniType result_, std::span<const LemniType> params_)
 		: LemniTypeImplT(base, this, 0, typeInfoIdx_, lemni::toStdStr(result_->str()), "f" + std::to_string(params_.size()) + lemni::toStdStr(result_->mangled()))
-		, m_result(result_), m_params(std::move(params_))
+		, m_result(result_), m_params(params_)
 	{
 		std::string mangledParams;
 
@@ -554,7 +658,9 @@ struct LemniFunctionTypeImplT: LemniTypeImplT<LemniFunctionTypeT, LemniFunctionT
 	LemniType param(const LemniNat64 idx) const noexcept override{ return m_params[idx]; }
 
 	LemniType m_result;
-	std::vector<LemniType> m_params;
+
+	// member arrays of composite types are stored inline after the type, in the slab of its type set
+	std::span<const LemniType> m_params;
 };
 
 struct LemniArrayTypeImplT: LemniTypeImplT<LemniArrayTypeT, LemniArrayTypeImplT>{
@@ -575,9 +681,9 @@ struct LemniArrayTypeImplT: LemniTypeImplT<LemniArrayTypeT, LemniArrayTypeImplT>
 };
 
 struct LemniClosureTypeImplT: LemniTypeImplT<LemniClosureTypeT, LemniClosureTypeImplT>{
-	LemniClosureTypeImplT(LemniFunctionType base, const uint64_t typeInfoIdx_, std::vector<LemniType> closed_)
+	LemniClosureTypeImplT(LemniFunctionType base, const uint64_t typeInfoIdx_, std::span<const LemniType> closed_)
 		: LemniTypeImplT(base, this, 0, typeInfoIdx_, lemni::toStdStr(base->str()), "g" + std::to_string(closed_.size()) + lemni::toStdStr(base->mangled()))
-		, m_closed(std::move(closed_))
+		, m_closed(closed_)
 	{
 		// TODO: add closure environment to type string
 	}
@@ -588,13 +694,13 @@ struct LemniClosureTypeImplT: LemniTypeImplT<LemniClosureTypeT, LemniClosureType
 	LemniNat64 numClosed() const noexcept override{ return m_closed.size(); }
 	LemniType closed(const LemniNat64 idx) const noexcept override{ return m_closed[idx]; }
 
-	std::vector<LemniType> m_closed;
+	std::span<const LemniType> m_closed;
 };
 
 struct LemniSumTypeImplT: LemniTypeImplT<LemniSumTypeT, LemniSumTypeImplT>{
-	LemniSumTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::vector<LemniType> cases_)
+	LemniSumTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::span<const LemniType> cases_)
 		: LemniTypeImplT(base, this, 0, typeInfoIdx_, lemni::toStdStr(cases_[0]->str()), "u" + std::to_string(cases_.size()) + lemni::toStdStr(cases_[0]->mangled()))
-		, cases(std::move(cases_))
+		, cases(cases_)
 	{
 		for(std::size_t i = 1; i < cases.size(); i++){
 			this->m_str += " | ";
@@ -606,13 +712,13 @@ struct LemniSumTypeImplT: LemniTypeImplT<LemniSumTypeT, LemniSumTypeImplT>{
 	LemniNat64 numCases() const noexcept override{ return cases.size(); }
 	LemniType case_(const LemniNat64 idx) const noexcept override{ return cases[idx]; }
 
-	std::vector<LemniType> cases;
+	std::span<const LemniType> cases;
 };
 
 struct LemniProductTypeImplT: LemniTypeImplT<LemniProductTypeT, LemniProductTypeImplT>{
-	LemniProductTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::vector<LemniType> components_)
+	LemniProductTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::span<const LemniType> components_)
 		: LemniTypeImplT(base, this, 0, typeInfoIdx_, lemni::toStdStr(components_[0]->str()), "t" + std::to_string(components_.size()) + lemni::toStdStr(components_[0]->mangled()))
-		, components(std::move(components_))
+		, components(components_)
 	{
 		for(std::size_t i = 1; i < components.size(); i++){
 			this->m_str += " & ";
@@ -626,13 +732,13 @@ struct LemniProductTypeImplT: LemniTypeImplT<LemniProductTypeT, LemniProductType
 	LemniNat64 numComponents() const noexcept override{ return components.size(); }
 	LemniType component(const LemniNat64 idx) const noexcept override{ return components[idx]; }
 
-	std::vector<LemniType> components;
+	std::span<const LemniType> components;
 };
 
 struct LemniRecordTypeImplT: LemniTypeImplT<LemniRecordTypeT, LemniRecordTypeImplT>{
-	LemniRecordTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::vector<LemniRecordTypeField> fields_)
+	LemniRecordTypeImplT(LemniTopType base, const uint64_t typeInfoIdx_, std::span<const LemniRecordTypeField> fields_)
 		: LemniTypeImplT(base, this, 0, typeInfoIdx_, "Record", "o" + std::to_string(fields_.size()))
-		, fields(std::move(fields_))
+		, fields(fields_)
 	{
 		for(std::size_t i = 0; i < fields.size(); i++){
 			auto &&field = fields[i];
@@ -645,7 +751,7 @@ struct LemniRecordTypeImplT: LemniTypeImplT<LemniRecordTypeT, LemniRecordTypeImp
 	LemniNat64 numFields() const noexcept override{ return fields.size(); }
 	const LemniRecordTypeField *field(const LemniNat64 idx) const noexcept override{ return &fields[idx]; }
 
-	std::vector<LemniRecordTypeField> fields;
+	std::span<const LemniRecordTypeField> fields;
 };
 
 #endif // !LEMNI_LIB_TYPE_HPP
@@ -16,6 +16,8 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include "fmt/format.h"
+
 #include "TypedExpr.hpp"
 
 void lemniDestroyTypedExpr(LemniTypedExpr expr){ deleteTypedExpr(expr); }
@@ -224,3 +226,33 @@ ffi_type *lemniTypeToFFI(LemniType type){
 		return nullptr;
 	}
 }
+
+std::string typedLiteralKey(LemniTypedExpr expr){
+	if(dynamic_cast<LemniTypedUnitExpr>(expr)) return "()";
+	else if(auto boolExpr = dynamic_cast<const LemniTypedBoolExprT*>(expr)) return boolExpr->value ? "true" : "false";
+	else if(auto nat16 = dynamic_cast<LemniTypedNat16Expr>(expr)) return fmt::format("{}", nat16->value);
+	else if(auto nat32 = dynamic_cast<LemniTypedNat32Expr>(expr)) return fmt::format("{}", nat32->value);
+	else if(auto nat64 = dynamic_cast<LemniTypedNat64Expr>(expr)) return fmt::format("{}", nat64->value);
+	else if(auto int16 = dynamic_cast<LemniTypedInt16Expr>(expr)) return fmt::format("{}", int16->value);
+	else if(auto int32 = dynamic_cast<LemniTypedInt32Expr>(expr)) return fmt::format("{}", int32->value);
+	else if(auto int64 = dynamic_cast<LemniTypedInt64Expr>(expr)) return fmt::format("{}", int64->value);
+	else if(auto real32 = dynamic_cast<LemniTypedReal32Expr>(expr)) return fmt::format("{}", real32->value);
+	else if(auto real64 = dynamic_cast<LemniTypedReal64Expr>(expr)) return fmt::format("{}", real64->value);
+	else if(auto ratio32 = dynamic_cast<LemniTypedRatio32Expr>(expr)) return fmt::format("{}/{}", ratio32->value.num, ratio32->value.den);
+	else if(auto ratio64 = dynamic_cast<LemniTypedRatio64Expr>(expr)) return fmt::format("{}/{}", ratio64->value.num, ratio64->value.den);
+	else if(auto ratio128 = dynamic_cast<LemniTypedRatio128Expr>(expr)) return fmt::format("{}/{}", ratio128->value.num, ratio128->value.den);
+	else if(auto aNat = dynamic_cast<LemniTypedANatExpr>(expr)) return aNat->value.toString();
+	else if(auto aInt = dynamic_cast<LemniTypedAIntExpr>(expr)) return aInt->value.toString();
+	else if(auto str = dynamic_cast<LemniTypedStringExpr>(expr)) return std::string(str->str());
+	else if(auto natN = dynamic_cast<const LemniTypedNatNExprT*>(expr)){
+		auto ret = fmt::format("{}:", natN->numBits);
+		for(auto bits : natN->bits) ret += fmt::format("{:x},", bits);
+		return ret;
+	}
+	else if(auto intN = dynamic_cast<const LemniTypedIntNExprT*>(expr)){
+		auto ret = fmt::format("{}:", intN->numBits);
+		for(auto bits : intN->bits) ret += fmt::format("{:x},", bits);
+		return ret;
+	}
+	else return {};
+}
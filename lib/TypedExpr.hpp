@@ -20,6 +20,10 @@
 #define LEMNI_LIB_TYPEDEXPR_HPP 1
 
 #include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <ffi.h>
 
@@ -36,10 +40,14 @@
 #include "lemni/eval.h"
 #include "lemni/compile.h"
 #include "lemni/memcheck.h"
+#include "lemni/effect.h"
 
 #include "Type.hpp"
+#include "Specialize.hpp"
+#include "Frame.hpp"
 
 LEMNI_OPAQUE_T(LemniEvalBindings);
+LEMNI_OPAQUE_T(LemniEvalTailCall);
 
 namespace {
 	template<typename ExprT, typename ... Args>
@@ -79,60 +87,153 @@ struct LemniCompileContextT{
 typedef struct LemniPartialBindingsT *LemniPartialBindings;
 typedef const struct LemniPartialBindingsT *LemniPartialBindingsConst;
 
+/**
+ * Flat, scoped table of partial evaluation bindings.
+ *
+ * All scopes share a single hash table so lookups are O(1) regardless of nesting depth.
+ * Entering a scope records a mark in the undo log and every binding made afterwards
+ * remembers the value it shadowed, leaving the scope replays the log back to the mark.
+ */
 struct LemniPartialBindingsT{
-	explicit LemniPartialBindingsT(LemniPartialBindingsConst parent_ = nullptr) noexcept
-		: parent(parent_){}
+	using Mark = std::size_t;
+
+	LemniPartialBindingsT() = default;
+
+	LemniPartialBindingsT(const LemniPartialBindingsT&) = delete;
+	LemniPartialBindingsT &operator=(const LemniPartialBindingsT&) = delete;
 
-	LemniTypedExpr find(LemniTypedExpr expr) const{
+	LemniTypedExpr find(LemniTypedExpr expr) const noexcept{
 		auto res = bound.find(expr);
 		if(res != end(bound)) return res->second;
-		else if(parent) return parent->find(expr);
 		else return nullptr;
 	}
 
-	LemniType resolve(LemniPseudoType pseudo) const{
+	LemniType resolve(LemniPseudoType pseudo) const noexcept{
 		auto it = resolvedTypes.find(pseudo);
 		if(it != end(resolvedTypes)) return it->second;
-		else if(parent) return parent->resolve(pseudo);
 		else return pseudo;
 	}
 
-	LemniPartialBindingsConst parent;
-	std::map<LemniPseudoType, LemniType> resolvedTypes;
-	std::map<LemniTypedExpr, LemniTypedExpr> bound;
+	void bind(LemniTypedExpr expr, LemniTypedExpr value){
+		auto [it, inserted] = bound.try_emplace(expr, value);
+		undoLog.emplace_back(UndoEntry{ false, expr, inserted ? nullptr : it->second });
+		if(!inserted) it->second = value;
+	}
+
+	void bindType(LemniPseudoType pseudo, LemniType type){
+		auto [it, inserted] = resolvedTypes.try_emplace(pseudo, type);
+		undoLog.emplace_back(UndoEntry{ true, pseudo, inserted ? nullptr : it->second });
+		if(!inserted) it->second = type;
+	}
+
+	Mark mark() const noexcept{ return undoLog.size(); }
+
+	void rewind(const Mark m) noexcept{
+		while(undoLog.size() > m){
+			auto &&entry = undoLog.back();
+
+			if(entry.isType){
+				auto key = static_cast<LemniPseudoType>(entry.key);
+				if(entry.prev) resolvedTypes[key] = static_cast<LemniType>(entry.prev);
+				else resolvedTypes.erase(key);
+			}
+			else{
+				auto key = static_cast<LemniTypedExpr>(entry.key);
+				if(entry.prev) bound[key] = static_cast<LemniTypedExpr>(entry.prev);
+				else bound.erase(key);
+			}
+
+			undoLog.pop_back();
+		}
+	}
+
+	/** RAII helper that rewinds every binding made while it is alive */
+	struct Scope{
+		explicit Scope(LemniPartialBindingsT *bindings_) noexcept
+			: bindings(bindings_), m(bindings_->mark()){}
+
+		~Scope(){ bindings->rewind(m); }
+
+		Scope(const Scope&) = delete;
+		Scope &operator=(const Scope&) = delete;
+
+		LemniPartialBindingsT *bindings;
+		Mark m;
+	};
+
+	private:
+		struct UndoEntry{
+			bool isType;
+			const void *key;
+			const void *prev;
+		};
+
+		std::unordered_map<LemniPseudoType, LemniType> resolvedTypes;
+		std::unordered_map<LemniTypedExpr, LemniTypedExpr> bound;
+		std::vector<UndoEntry> undoLog;
 };
 
 struct LemniEvalBindingsT{
 	explicit LemniEvalBindingsT(LemniEvalBindingsConst parent_ = nullptr) noexcept
 		: parent(parent_){}
 
+	//! Bindings of a call frame whose slots are laid out by \p layout_
+	LemniEvalBindingsT(LemniEvalBindingsConst parent_, const lemni::frame::Layout *layout_, LemniValue *slots_) noexcept
+		: parent(parent_), layout(layout_), slots(slots_){}
+
 	LemniEvalBindingsT(const LemniEvalBindingsT &other)
 		: parent(other.parent)
+		, layout(other.layout)
+		, slots(other.slots)
 		, bound(other.bound){}
 
 	LemniEvalBindingsT &operator=(const LemniEvalBindingsT &other){
 		parent = other.parent;
+		layout = other.layout;
+		slots = other.slots;
 		bound = other.bound;
 		return *this;
 	}
 
-	LemniValue find(LemniTypedLValueExpr lval) const{
-		auto res = bound.find(lval);
-		if(res != end(bound)){
-			return res->second.handle();
-		}
-		else if(parent){
-			return parent->find(lval);
-		}
-		else{
-			return nullptr;
+	/**
+	 * Find the value bound to \p lval , \p slot is its frame slot hint.
+	 * Locals of a frame that haven't been evaluated yet are not looked up any further.
+	 */
+	LemniValue find(LemniTypedLValueExpr lval, const lemni::frame::SlotId slot = lemni::frame::noSlot) const{
+		for(auto bindings = this; bindings; bindings = bindings->parent){
+			if(bindings->layout){
+				auto idx = bindings->layout->find(lval, slot);
+				if(idx != lemni::frame::noSlot){
+					return bindings->slots[idx];
+				}
+			}
+
+			auto res = bindings->bound.find(lval);
+			if(res != end(bindings->bound)){
+				return res->second.handle();
+			}
 		}
+
+		return nullptr;
 	}
 
 	const LemniEvalBindingsT *parent;
+	const lemni::frame::Layout *layout = nullptr;
+	LemniValue *slots = nullptr; //!< owned by the eval state's frame stack
 	std::map<LemniTypedLValueExpr, lemni::Value> bound;
 };
 
+/**
+ * Call to a function definition left pending by an expression in tail position,
+ * performed by the calling function in place of its own frame.
+ */
+struct LemniEvalTailCallT{
+	LemniTypedFnDefExpr fn = nullptr;
+	LemniEvalBindings bindings = nullptr; //!< bindings the callee was created with
+	lemni::frame::Stack::Mark mark; //!< where the callee's frame was pushed
+	LemniValue *args = nullptr; //!< evaluated arguments at the start of the callee's frame
+};
+
 
 struct LemniTypedExprT{
 	virtual ~LemniTypedExprT() = default;
@@ -147,12 +248,28 @@ struct LemniTypedExprT{
 
 	virtual LemniTypedExpr deref() const noexcept{ return this; }
 
+	/** Append every typed expression directly referenced by this one to ``out`` */
+	virtual void children(std::vector<LemniTypedExpr> &out) const noexcept{ (void)out; }
+
 	virtual LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept;
 
 	virtual LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept = 0;
 
+	/**
+	 * Evaluate in tail position of a function body.
+	 * Calls to function definitions may be left in \p tail instead of performed,
+	 * in which case the result value is null. \p tail may be null to perform every call.
+	 */
+	virtual LemniEvalResult evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept{
+		(void)tail;
+		return eval(state, bindings);
+	}
+
 	virtual LemniMemCheckResult memcheck(LemniMemCheckState state) const noexcept;
 
+	/** Effect of evaluating the expression, defaults to the join of all children */
+	virtual LemniEffect effect(LemniEffectState state) const noexcept;
+
 	virtual LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx = nullptr) const noexcept{
 		(void)state;
 		(void)ctx;
@@ -263,9 +380,14 @@ struct LemniTypedUnaryOpExprT: LemniTypedExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(value); }
+
 	LemniType resultType;
 	LemniUnaryOp op;
 	LemniTypedExpr value;
+
+	//! Rewritten by \ref LEMNI_EVAL_SPECIALIZING evaluation
+	mutable lemni::spec::UnarySite site;
 };
 
 struct LemniTypedBinaryOpExprT: LemniTypedExprT{
@@ -282,10 +404,45 @@ struct LemniTypedBinaryOpExprT: LemniTypedExprT{
 
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{
+		out.emplace_back(lhs);
+		out.emplace_back(rhs);
+	}
+
 	LemniType resultType;
 	LemniBinaryOp op;
 	LemniTypedExpr lhs;
 	LemniTypedExpr rhs;
+
+	//! Rewritten by \ref LEMNI_EVAL_SPECIALIZING evaluation
+	mutable lemni::spec::BinarySite site;
+};
+
+/**
+ * Left-to-right application of one associative operator to two or more operands.
+ * Created by flattening chains of binary ops, evaluates by accumulating into a single value.
+ */
+struct LemniTypedNAryOpExprT: LemniTypedExprT{
+	LemniTypedNAryOpExprT(LemniType resultType_, LemniBinaryOp op_, std::vector<LemniTypedExpr> operands_) noexcept
+		: resultType(resultType_), op(op_), operands(std::move(operands_)){}
+
+	LemniTypedExpr clone() const noexcept override{ return newTypedExpr<LemniTypedNAryOpExprT>(resultType, op, operands); }
+
+	LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept override;
+
+	LemniType type() const noexcept override{ return resultType; }
+
+	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
+
+	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
+
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{
+		out.insert(end(out), begin(operands), end(operands));
+	}
+
+	LemniType resultType;
+	LemniBinaryOp op;
+	std::vector<LemniTypedExpr> operands;
 };
 
 struct LemniTypedLValueExprT: LemniTypedExprT{
@@ -311,6 +468,8 @@ struct LemniTypedUnresolvedRefExprT: LemniTypedLValueExprT{
 		return res;
 	}
 
+	LemniEffect effect(LemniEffectState) const noexcept override{ return LEMNI_EFFECT_EFFECTFUL; }
+
 	std::string m_id;
 	LemniPseudoType valueType;
 };
@@ -335,6 +494,8 @@ struct LemniTypedRefExprT: LemniTypedLValueExprT{
 		return refed->eval(state, bindings);
 	}
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(refed); }
+
 	LemniTypedLValueExpr refed;
 };
 
@@ -357,11 +518,18 @@ struct LemniTypedBindingExprT: LemniTypedNamedExprT{
 
 	LemniType type() const noexcept override{ return value->type(); }
 
+	LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept override;
+
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(value); }
+
 	LemniTypedExpr value;
+
+	//! Frame slot hint, see \ref lemni::frame::Layout
+	mutable lemni::frame::SlotId slot = lemni::frame::noSlot;
 };
 
 struct LemniTypedApplicationExprT: LemniTypedExprT{
@@ -376,11 +544,23 @@ struct LemniTypedApplicationExprT: LemniTypedExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEvalResult evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept override;
+
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	LemniEffect effect(LemniEffectState state) const noexcept override;
+
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{
+		out.emplace_back(fn);
+		out.insert(end(out), begin(args), end(args));
+	}
+
 	LemniType resultType;
 	LemniTypedExpr fn;
 	std::vector<LemniTypedExpr> args;
+
+	//! Rewritten by \ref LEMNI_EVAL_SPECIALIZING evaluation
+	mutable lemni::spec::CallSite site;
 };
 
 struct LemniTypedProductExprT: LemniTypedLiteralExprT{
@@ -413,6 +593,8 @@ struct LemniTypedProductExprT: LemniTypedLiteralExprT{
 
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.insert(end(out), begin(elems), end(elems)); }
+
 	LemniProductType productType;
 	std::vector<LemniTypedExpr> elems;
 	bool isConstant = false;
@@ -428,8 +610,16 @@ struct LemniTypedBranchExprT: LemniTypedExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEvalResult evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept override;
+
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{
+		out.emplace_back(cond);
+		out.emplace_back(true_);
+		out.emplace_back(false_);
+	}
+
 	LemniType resultType;
 	LemniTypedExpr cond, true_, false_;
 };
@@ -442,10 +632,14 @@ struct LemniTypedReturnExprT: LemniTypedExprT{
 
 	LemniType type() const noexcept override{ return value->type(); }
 
+	LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept override;
+
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
 	LemniJitResult compile(LemniCompileState state, LemniCompileContext ctx) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(value); }
+
 	LemniTypedExpr value;
 };
 
@@ -457,8 +651,14 @@ struct LemniTypedBlockExprT: LemniTypedExprT{
 
 	LemniType type() const noexcept override{ return resultType; }
 
+	LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept override;
+
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEvalResult evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept override;
+
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.insert(end(out), begin(exprs), end(exprs)); }
+
 	LemniType resultType;
 	std::vector<LemniTypedExpr> exprs;
 };
@@ -473,6 +673,8 @@ struct LemniTypedExportExprT: LemniTypedConstantExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(value); }
+
 	LemniTypedConstantExpr value;
 };
 
@@ -753,7 +955,7 @@ struct LemniTypedReal32ExprT: LemniTypedRealExprT{
 };
 
 struct LemniTypedReal64ExprT: LemniTypedRealExprT{
-	LemniTypedReal64ExprT(LemniRealType real64Type_, float value_) noexcept
+	LemniTypedReal64ExprT(LemniRealType real64Type_, LemniReal64 value_) noexcept
 		: LemniTypedRealExprT(real64Type_), value(value_){}
 
 	LemniTypedExpr clone() const noexcept override{ return newTypedExpr<LemniTypedReal64ExprT>(realType, value); }
@@ -810,6 +1012,9 @@ struct LemniTypedParamBindingExprT: LemniTypedNamedExprT{
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
 	LemniType valueType;
+
+	//! Frame slot hint, see \ref lemni::frame::Layout
+	mutable lemni::frame::SlotId slot = lemni::frame::noSlot;
 };
 
 struct LemniTypedLambdaExprT: LemniTypedLiteralExprT{
@@ -846,19 +1051,34 @@ struct LemniTypedLambdaExprT: LemniTypedLiteralExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEffect effect(LemniEffectState) const noexcept override{ return LEMNI_EFFECT_PURE; }
+
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{
+		out.insert(end(out), begin(params), end(params));
+		out.emplace_back(body);
+	}
+
+	//! Slots of the tree walker's frames for calls, prepared on the first one
+	const lemni::frame::Layout &frameLayout() const{
+		if(!layout) layout.emplace(this);
+		return *layout;
+	}
+
 	std::vector<LemniTypedParamBindingExpr> params;
 	LemniTypedExpr body;
 	LemniFunctionType fnType;
 	bool isPseudo;
+
+	mutable std::optional<lemni::frame::Layout> layout;
 };
 
 struct LemniTypedFnDefExprT: LemniTypedNamedExprT{
-	LemniTypedFnDefExprT(std::string id_, LemniTypedLambdaExpr lambda_)
-		: LemniTypedNamedExprT(std::move(id_)), lambda(lambda_){}
+	LemniTypedFnDefExprT(std::string id_, LemniTypedLambdaExpr lambda_, LemniFunctionType fnType_ = nullptr)
+		: LemniTypedNamedExprT(std::move(id_)), lambda(lambda_), fnType(fnType_ ? fnType_ : lambda_->fnType){}
 
-	LemniTypedExpr clone() const noexcept override{ return newTypedExpr<LemniTypedFnDefExprT>(m_id, lambda); }
+	LemniTypedExpr clone() const noexcept override{ return newTypedExpr<LemniTypedFnDefExprT>(m_id, lambda, fnType); }
 
-	LemniFunctionType type() const noexcept override{ return lambda->fnType; }
+	LemniFunctionType type() const noexcept override{ return fnType; }
 
 	LemniTypecheckResult partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept override;
 
@@ -866,7 +1086,12 @@ struct LemniTypedFnDefExprT: LemniTypedNamedExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEffect effect(LemniEffectState) const noexcept override{ return LEMNI_EFFECT_PURE; }
+
+	void children(std::vector<LemniTypedExpr> &out) const noexcept override{ out.emplace_back(lambda); }
+
 	LemniTypedLambdaExpr lambda;
+	LemniFunctionType fnType; //! principal type, may be more specific than the lambda's
 };
 
 ffi_type *lemniTypeToFFI(LemniType type);
@@ -883,9 +1108,14 @@ struct LemniTypedExtFnDeclExprT: LemniTypedNamedExprT{
 
 	LemniEvalResult eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept override;
 
+	LemniEffect effect(LemniEffectState) const noexcept override{ return LEMNI_EFFECT_PURE; }
+
 	void *ptr;
 	std::vector<std::string> paramNames;
 	LemniFunctionType fnType;
 };
 
+//! String uniquely identifying the value of a literal, empty if \p expr is not a comparable literal
+std::string typedLiteralKey(LemniTypedExpr expr);
+
 #endif // !LEMNI_LIB_TYPEDEXPR_HPP
@@ -0,0 +1,369 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "Unify.hpp"
+
+using namespace lemni;
+
+namespace {
+	template<typename F>
+	void forEachComponent(LemniType type, F &&f){
+		if(auto fn = lemniTypeAsFunction(type)){
+			f(fn->result());
+			for(LemniNat64 i = 0; i < fn->numParams(); i++) f(fn->param(i));
+		}
+		else if(auto product = lemniTypeAsProduct(type)){
+			for(LemniNat64 i = 0; i < product->numComponents(); i++) f(product->component(i));
+		}
+		else if(auto sum = lemniTypeAsSum(type)){
+			for(LemniNat64 i = 0; i < sum->numCases(); i++) f(sum->case_(i));
+		}
+		else if(auto arr = lemniTypeAsArray(type)){
+			f(arr->element());
+		}
+	}
+
+	//! Rebuild a type with every component passed through ``f``, returns ``type`` itself if nothing changed
+	template<typename F>
+	LemniType substitute(LemniTypeSet types, LemniType type, F &&f){
+		if(!type) return type;
+		else if(auto pseudo = lemniTypeAsPseudo(type)) return f(pseudo);
+
+		bool changed = false;
+		std::vector<LemniType> comps;
+
+		forEachComponent(type, [&](LemniType comp){
+			auto newComp = substitute(types, comp, f);
+			if(newComp != comp) changed = true;
+			comps.emplace_back(newComp);
+		});
+
+		if(!changed) return type;
+
+		if(lemniTypeAsFunction(type)){
+			return lemniTypeSetGetFunction(types, comps[0], comps.data() + 1, comps.size() - 1);
+		}
+		else if(lemniTypeAsProduct(type)){
+			return lemniTypeSetGetProduct(types, comps.data(), comps.size());
+		}
+		else if(lemniTypeAsSum(type)){
+			return lemniTypeSetGetSum(types, comps.data(), comps.size());
+		}
+		else if(auto arr = lemniTypeAsArray(type)){
+			return lemniTypeSetGetArray(types, arr->numElements(), comps[0]);
+		}
+
+		return type;
+	}
+}
+
+std::uint32_t TypeUnifier::nodeIdx(LemniPseudoType pseudo){
+	auto res = indices.find(pseudo);
+	if(res != end(indices)) return res->second;
+
+	auto info = lemniTypeSetGetTypeInfo(types, pseudo);
+
+	auto idx = std::uint32_t(nodes.size());
+	nodes.emplace_back(Node{ idx, 0, pseudo, nullptr, info->binaryOpFlags, info->unaryOpFlags });
+	indices.try_emplace(pseudo, idx);
+
+	return idx;
+}
+
+std::uint32_t TypeUnifier::findRoot(std::uint32_t idx) noexcept{
+	auto root = idx;
+	while(nodes[root].parent != root) root = nodes[root].parent;
+
+	while(nodes[idx].parent != root){
+		auto next = nodes[idx].parent;
+		nodes[idx].parent = root;
+		idx = next;
+	}
+
+	return root;
+}
+
+LemniType TypeUnifier::find(LemniType type){
+	auto pseudo = lemniTypeAsPseudo(type);
+	if(!pseudo || quantified.count(pseudo)) return type;
+
+	auto res = indices.find(pseudo);
+	if(res == end(indices)) return type;
+
+	auto &&root = nodes[findRoot(res->second)];
+	return root.bound ? root.bound : root.pseudo;
+}
+
+bool TypeUnifier::occurs(const std::uint32_t root, LemniType type){
+	bool found = false;
+
+	auto check = [&](auto &&self, LemniType t) -> void{
+		if(found || !t) return;
+
+		if(auto pseudo = lemniTypeAsPseudo(t)){
+			auto res = indices.find(pseudo);
+			if(res != end(indices) && findRoot(res->second) == root) found = true;
+			return;
+		}
+
+		forEachComponent(t, [&](LemniType comp){ self(self, find(comp)); });
+	};
+
+	check(check, type);
+
+	return found;
+}
+
+bool TypeUnifier::bind(const std::uint32_t root, LemniType type){
+	if(occurs(root, type)) return false;
+
+	auto &&node = nodes[root];
+
+	auto info = lemniTypeSetGetTypeInfo(types, type);
+	if(((info->binaryOpFlags & node.binaryOpFlags) != node.binaryOpFlags) || ((info->unaryOpFlags & node.unaryOpFlags) != node.unaryOpFlags)){
+		return false;
+	}
+
+	node.bound = type;
+	return true;
+}
+
+bool TypeUnifier::unify(LemniType a, LemniType b){
+	a = find(a);
+	b = find(b);
+
+	if(a == b) return true;
+
+	auto pa = lemniTypeAsPseudo(a);
+	auto pb = lemniTypeAsPseudo(b);
+
+	// quantified types stand for any type, nothing can be learned from them
+	if((pa && quantified.count(pa)) || (pb && quantified.count(pb))) return true;
+
+	if(pa && pb){
+		auto ra = findRoot(nodeIdx(pa));
+		auto rb = findRoot(nodeIdx(pb));
+
+		if(nodes[ra].rank < nodes[rb].rank) std::swap(ra, rb);
+
+		nodes[rb].parent = ra;
+		nodes[ra].binaryOpFlags |= nodes[rb].binaryOpFlags;
+		nodes[ra].unaryOpFlags |= nodes[rb].unaryOpFlags;
+
+		if(nodes[ra].rank == nodes[rb].rank) ++nodes[ra].rank;
+
+		return true;
+	}
+	else if(pa){
+		return bind(findRoot(nodeIdx(pa)), b);
+	}
+	else if(pb){
+		return bind(findRoot(nodeIdx(pb)), a);
+	}
+
+	if(auto fnA = lemniTypeAsFunction(a)){
+		auto fnB = lemniTypeAsFunction(b);
+		if(!fnB || (fnA->numParams() != fnB->numParams())) return false;
+
+		for(LemniNat64 i = 0; i < fnA->numParams(); i++){
+			if(!unify(fnA->param(i), fnB->param(i))) return false;
+		}
+
+		return unify(fnA->result(), fnB->result());
+	}
+	else if(auto prodA = lemniTypeAsProduct(a)){
+		auto prodB = lemniTypeAsProduct(b);
+		if(!prodB || (prodA->numComponents() != prodB->numComponents())) return false;
+
+		for(LemniNat64 i = 0; i < prodA->numComponents(); i++){
+			if(!unify(prodA->component(i), prodB->component(i))) return false;
+		}
+
+		return true;
+	}
+
+	// concrete scalars of differing width still unify through promotion
+	if(types) return lemniTypeSetIsCastable(types, a, b) || lemniTypeSetIsCastable(types, b, a);
+	else return lemniTypeIsCastable(a, b) || lemniTypeIsCastable(b, a);
+}
+
+bool TypeUnifier::requireBinaryOp(LemniType type, const LemniBinaryOp op){
+	auto t = find(type);
+
+	if(auto pseudo = lemniTypeAsPseudo(t)){
+		if(!quantified.count(pseudo)){
+			nodes[findRoot(nodeIdx(pseudo))].binaryOpFlags |= op;
+		}
+
+		return true;
+	}
+
+	return lemniTypeInfoHasBinaryOp(lemniTypeSetGetTypeInfo(types, t), op);
+}
+
+bool TypeUnifier::requireUnaryOp(LemniType type, const LemniUnaryOp op){
+	auto t = find(type);
+
+	if(auto pseudo = lemniTypeAsPseudo(t)){
+		if(!quantified.count(pseudo)){
+			nodes[findRoot(nodeIdx(pseudo))].unaryOpFlags |= op;
+		}
+
+		return true;
+	}
+
+	return lemniTypeInfoHasUnaryOp(lemniTypeSetGetTypeInfo(types, t), op);
+}
+
+LemniType TypeUnifier::resolve(LemniType type, std::unordered_map<std::uint32_t, LemniType> &fresh){
+	return substitute(types, type, [&](LemniPseudoType pseudo) -> LemniType{
+		if(quantified.count(pseudo)) return pseudo;
+
+		auto res = indices.find(pseudo);
+		if(res == end(indices)) return pseudo;
+
+		auto root = findRoot(res->second);
+		auto &&node = nodes[root];
+
+		if(node.bound) return resolve(node.bound, fresh);
+
+		auto freshRes = fresh.find(root);
+		if(freshRes != end(fresh)) return freshRes->second;
+
+		// only create a new pseudo type if the class learned usage flags the root does not carry
+		auto rootInfo = lemniTypeSetGetTypeInfo(types, node.pseudo);
+
+		LemniType ret = node.pseudo;
+
+		if((rootInfo->binaryOpFlags != node.binaryOpFlags) || (rootInfo->unaryOpFlags != node.unaryOpFlags)){
+			auto usageInfo = lemniEmptyTypeInfo();
+			usageInfo.binaryOpFlags = node.binaryOpFlags;
+			usageInfo.unaryOpFlags = node.unaryOpFlags;
+			ret = lemniTypeSetGetPseudo(types, usageInfo);
+		}
+
+		fresh.try_emplace(root, ret);
+
+		return ret;
+	});
+}
+
+LemniType TypeUnifier::generalize(LemniType type, const std::vector<LemniType> &env){
+	std::unordered_map<std::uint32_t, LemniType> fresh;
+	std::unordered_set<LemniPseudoType> monomorphic;
+
+	// classes free in the environment keep their root, so later constraints still reach them
+	auto collectFree = [this, &fresh, &monomorphic](auto &&self, LemniType t) -> void{
+		if(!t) return;
+		else if(auto pseudo = lemniTypeAsPseudo(t)){
+			if(quantified.count(pseudo)) return;
+
+			auto root = findRoot(nodeIdx(pseudo));
+			auto &&node = nodes[root];
+
+			if(node.bound) self(self, node.bound);
+			else if(fresh.try_emplace(root, node.pseudo).second) monomorphic.insert(node.pseudo);
+		}
+		else forEachComponent(t, [&](LemniType comp){ self(self, comp); });
+	};
+
+	for(auto envType : env){
+		collectFree(collectFree, envType);
+	}
+
+	auto ret = resolve(type, fresh);
+
+	auto quantify = [this, &monomorphic](auto &&self, LemniType t) -> void{
+		if(!t) return;
+		else if(auto pseudo = lemniTypeAsPseudo(t)){
+			if(!monomorphic.count(pseudo)) quantified.insert(pseudo);
+		}
+		else forEachComponent(t, [&](LemniType comp){ self(self, comp); });
+	};
+
+	quantify(quantify, ret);
+
+	return ret;
+}
+
+LemniType TypeUnifier::instantiate(LemniType type){
+	std::unordered_map<LemniPseudoType, LemniType> fresh;
+
+	return substitute(types, type, [&](LemniPseudoType pseudo) -> LemniType{
+		if(!quantified.count(pseudo)) return pseudo;
+
+		auto res = fresh.find(pseudo);
+		if(res != end(fresh)) return res->second;
+
+		auto ret = lemniTypeSetGetPseudo(types, *lemniTypeSetGetTypeInfo(types, pseudo));
+		fresh.try_emplace(pseudo, ret);
+		return ret;
+	});
+}
+
+void TypeUnifier::retainLive(std::unordered_set<LemniType> &liveTypes){
+	std::vector<LemniType> pending(begin(liveTypes), end(liveTypes));
+
+	auto keep = [&](LemniType t){
+		if(t && liveTypes.insert(t).second) pending.emplace_back(t);
+	};
+
+	while(!pending.empty()){
+		auto type = pending.back();
+		pending.pop_back();
+
+		if(auto pseudo = lemniTypeAsPseudo(type)){
+			auto res = indices.find(pseudo);
+			if(res != end(indices)){
+				auto &&root = nodes[findRoot(res->second)];
+				keep(root.pseudo);
+				keep(root.bound);
+			}
+		}
+		else{
+			forEachComponent(type, keep);
+		}
+	}
+
+	std::vector<Node> newNodes;
+	std::unordered_map<LemniPseudoType, std::uint32_t> newIndices;
+
+	for(std::uint32_t i = 0; i < nodes.size(); i++){
+		if(liveTypes.count(nodes[i].pseudo)){
+			auto newIdx = std::uint32_t(newNodes.size());
+			newNodes.emplace_back(nodes[i]);
+			newNodes.back().parent = findRoot(i);
+			newIndices.try_emplace(nodes[i].pseudo, newIdx);
+		}
+	}
+
+	// parents still hold old indices, roots are always live so they were kept
+	for(auto &&node : newNodes){
+		node.parent = newIndices[nodes[node.parent].pseudo];
+	}
+
+	nodes = std::move(newNodes);
+	indices = std::move(newIndices);
+
+	for(auto it = begin(quantified); it != end(quantified);){
+		if(liveTypes.count(*it)) ++it;
+		else it = quantified.erase(it);
+	}
+}
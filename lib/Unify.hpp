@@ -0,0 +1,94 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_UNIFY_HPP
+#define LEMNI_LIB_UNIFY_HPP 1
+
+#include <cstdint>
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "lemni/Type.h"
+#include "lemni/Operator.h"
+
+namespace lemni{
+	/**
+	 * Union-find over pseudo types.
+	 *
+	 * Pseudo types get a node the first time they take part in a constraint. Classes are merged by
+	 * rank and compressed on lookup, a class may be bound to a single concrete type. Operator use is
+	 * accumulated as ``LemniTypeInfo`` op flags on the class and checked when the class gets bound.
+	 *
+	 * Pseudo types produced by \ref generalize are quantified: they never get bound and every use
+	 * site goes through \ref instantiate to get fresh pseudo types.
+	 */
+	class TypeUnifier{
+		public:
+			explicit TypeUnifier(LemniTypeSet types_ = nullptr) noexcept
+				: types(types_){}
+
+			//! Get the representative of a type; the concrete type bound to its class or the class root
+			LemniType find(LemniType type);
+
+			//! Unify two types, returns false if they can not be made equal
+			bool unify(LemniType a, LemniType b);
+
+			//! Record that a binary op is applied to values of a type
+			bool requireBinaryOp(LemniType type, const LemniBinaryOp op);
+
+			//! Record that a unary op is applied to values of a type
+			bool requireUnaryOp(LemniType type, const LemniUnaryOp op);
+
+			/**
+			 * Substitute every class representative into a type and quantify the remaining pseudo types.
+			 * Classes still free in one of the \p env types are left unquantified.
+			 */
+			LemniType generalize(LemniType type, const std::vector<LemniType> &env = {});
+
+			//! Replace quantified pseudo types with fresh ones
+			LemniType instantiate(LemniType type);
+
+			bool isQuantified(LemniPseudoType pseudo) const noexcept{ return quantified.count(pseudo); }
+
+			//! Extend a set of live types with everything it depends on, then forget all other pseudo types
+			void retainLive(std::unordered_set<LemniType> &liveTypes);
+
+		private:
+			struct Node{
+				std::uint32_t parent, rank;
+				LemniPseudoType pseudo;
+				LemniType bound;
+				std::uint32_t binaryOpFlags, unaryOpFlags;
+			};
+
+			std::uint32_t nodeIdx(LemniPseudoType pseudo);
+			std::uint32_t findRoot(std::uint32_t idx) noexcept;
+			bool bind(const std::uint32_t root, LemniType type);
+			bool occurs(const std::uint32_t root, LemniType type);
+			LemniType resolve(LemniType type, std::unordered_map<std::uint32_t, LemniType> &fresh);
+
+			LemniTypeSet types;
+			std::vector<Node> nodes;
+			std::unordered_map<LemniPseudoType, std::uint32_t> indices;
+			std::unordered_set<LemniPseudoType> quantified;
+	};
+}
+
+#endif // !LEMNI_LIB_UNIFY_HPP
@@ -1607,6 +1607,17 @@ LemniValue LemniValueANatT::performBinaryOp(const LemniBinaryOp op, const LemniV
 	return nullptr;
 }
 
+bool LemniValueANatT::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	auto rhsN = dynamic_cast<LemniValueANat>(rhs);
+	if(!rhsN) return false;
+
+	switch(op){
+		case LEMNI_BINARY_ADD: value += rhsN->value; return true;
+		case LEMNI_BINARY_MUL: value *= rhsN->value; return true;
+		default: return false;
+	}
+}
+
 LemniValue LemniBasicValueInt<16>::performUnaryOp(const LemniUnaryOp op) const noexcept{
 	if(op != LEMNI_UNARY_NEG)
 		return nullptr;
@@ -1795,6 +1806,21 @@ LemniValue LemniValueAIntT::performBinaryOp(const LemniBinaryOp op, const LemniV
 	return nullptr;
 }
 
+bool LemniValueAIntT::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	const lemni::AInt *rhsVal = nullptr;
+
+	if(auto rhsI = dynamic_cast<LemniValueAInt>(rhs)) rhsVal = &rhsI->value;
+	else if(auto rhsN = dynamic_cast<LemniValueANat>(rhs)) rhsVal = &rhsN->value;
+	else return false;
+
+	switch(op){
+		case LEMNI_BINARY_ADD: value += *rhsVal; return true;
+		case LEMNI_BINARY_SUB: value -= *rhsVal; return true;
+		case LEMNI_BINARY_MUL: value *= *rhsVal; return true;
+		default: return false;
+	}
+}
+
 LemniValue LemniBasicValueRatio<32>::performUnaryOp(const LemniUnaryOp op) const noexcept{
 	if(op != LEMNI_UNARY_NEG)
 		return nullptr;
@@ -2063,6 +2089,18 @@ LemniValue LemniValueARatioT::performBinaryOp(const LemniBinaryOp op, const Lemn
 	return nullptr;
 }
 
+bool LemniValueARatioT::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	auto rhsQ = dynamic_cast<LemniValueARatio>(rhs);
+	if(!rhsQ) return false;
+
+	switch(op){
+		case LEMNI_BINARY_ADD: value += rhsQ->value; return true;
+		case LEMNI_BINARY_SUB: value -= rhsQ->value; return true;
+		case LEMNI_BINARY_MUL: value *= rhsQ->value; return true;
+		default: return false;
+	}
+}
+
 LemniValue LemniBasicValueReal<32>::performUnaryOp(const LemniUnaryOp op) const noexcept{
 	if(op != LEMNI_UNARY_NEG)
 		return nullptr;
@@ -2324,6 +2362,18 @@ LemniValue LemniValueARealT::performBinaryOp(const LemniBinaryOp op, const Lemni
 	return nullptr;
 }
 
+bool LemniValueARealT::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	auto rhsR = dynamic_cast<LemniValueAReal>(rhs);
+	if(!rhsR) return false;
+
+	switch(op){
+		case LEMNI_BINARY_ADD: value += rhsR->value; return true;
+		case LEMNI_BINARY_SUB: value -= rhsR->value; return true;
+		case LEMNI_BINARY_MUL: value *= rhsR->value; return true;
+		default: return false;
+	}
+}
+
 LemniValue LemniValueStrASCIIT::performUnaryOp(const LemniUnaryOp op) const noexcept{
 	(void)op;
 	return nullptr;
@@ -2349,6 +2399,14 @@ LemniValue LemniValueStrASCIIT::performBinaryOp(const LemniBinaryOp op, const Le
 	}
 }
 
+bool LemniValueStrASCIIT::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	auto rhsAscii = dynamic_cast<LemniValueStrASCII>(rhs);
+	if((op != LEMNI_BINARY_CONCAT) || !rhsAscii) return false;
+
+	value += rhsAscii->value;
+	return true;
+}
+
 LemniValue LemniValueStrUTF8T::performUnaryOp(const LemniUnaryOp op) const noexcept{
 	(void)op;
 	return nullptr;
@@ -2374,6 +2432,17 @@ LemniValue LemniValueStrUTF8T::performBinaryOp(const LemniBinaryOp op, const Lem
 	}
 }
 
+bool LemniValueStrUTF8T::accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+	if(op != LEMNI_BINARY_CONCAT) return false;
+
+	// ascii strings concatenated to utf8 strings stay utf8
+	if(auto rhsUtf8 = dynamic_cast<LemniValueStrUTF8>(rhs)) value += rhsUtf8->value;
+	else if(auto rhsAscii = dynamic_cast<LemniValueStrASCII>(rhs)) value += rhsAscii->value;
+	else return false;
+
+	return true;
+}
+
 struct LemniValueBindingsT{
 	std::unordered_map<std::string, lemni::Value> bound;
 };
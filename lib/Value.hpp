@@ -96,6 +96,16 @@ struct LemniValueT{
 		(void)rhs;
 		return nullptr;
 	}
+
+	/**
+	 * Apply \p op with \p rhs to this value in place.
+	 * Returns ``false`` if the result would not have the same type, in which case the value is unchanged.
+	 */
+	virtual bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept{
+		(void)op;
+		(void)rhs;
+		return false;
+	}
 };
 
 struct LemniValueRefT: LemniValueT{
@@ -225,7 +235,9 @@ struct LemniValueProductT: LemniValueT{
 	{
 		values.reserve(numValues_);
 		for(LemniNat64 i = 0; i < numValues_; i++){
-			values.emplace_back(values_[i]->copy());
+			// elements are owned, references may not outlive the product
+			auto elem = values_[i]->deref()->copy();
+			values.emplace_back(elem ? elem : values_[i]->copy());
 		}
 	}
 
@@ -293,6 +305,8 @@ struct LemniValueANatT: LemniValueNatT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	lemni::AInt value;
 };
 
@@ -315,6 +329,8 @@ struct LemniValueAIntT: LemniValueIntT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	lemni::AInt value;
 };
 
@@ -337,6 +353,8 @@ struct LemniValueARatioT: LemniValueRatioT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	lemni::ARatio value;
 };
 
@@ -359,6 +377,8 @@ struct LemniValueARealT: LemniValueRealT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	lemni::AReal value;
 };
 
@@ -434,6 +454,8 @@ struct LemniValueStrASCIIT: LemniValueStrT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	std::string value;
 };
 
@@ -456,6 +478,8 @@ struct LemniValueStrUTF8T: LemniValueStrT{
 
 	LemniValue performBinaryOp(const LemniBinaryOp op, const LemniValue rhs) const noexcept override;
 
+	bool accumulate(const LemniBinaryOp op, const LemniValue rhs) noexcept override;
+
 	std::string value;
 };
 
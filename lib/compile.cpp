@@ -25,14 +25,15 @@
 #include "LLVM.hpp"
 
 struct LemniCompileStateT{
-	explicit LemniCompileStateT(LemniCompileState parent_ = nullptr)
-		: parent(parent_), memState{lemniCreateMemCheckState(nullptr)}, llvmState("moduleId"){}
+	explicit LemniCompileStateT(LemniTypeSet types_, LemniCompileState parent_ = nullptr)
+		: parent(parent_), types(types_), memState{lemniCreateMemCheckState(types_, nullptr)}, llvmState("moduleId"){}
 
 	~LemniCompileStateT(){
 		lemniDestroyMemCheckState(memState);
 	}
 
 	LemniCompileState parent;
+	LemniTypeSet types;
 	LemniMemCheckState memState;
 	lemni::LLVMState llvmState;
 	std::list<std::string> errStrs;
@@ -42,11 +43,11 @@ struct LemniObjectT{
 	//gcc_jit_result *res;
 };
 
-LemniCompileState lemniCreateCompileState(LemniCompileState parent){
+LemniCompileState lemniCreateCompileState(LemniTypeSet types, LemniCompileState parent){
 	auto mem = std::malloc(sizeof(LemniCompileStateT));
 	if(!mem) return nullptr;
 
-	auto p = new(mem) LemniCompileStateT(parent);
+	auto p = new(mem) LemniCompileStateT(types, parent);
 
 	return p;
 }
@@ -503,6 +504,54 @@ LemniJitResult LemniTypedBinaryOpExprT::compile(LemniCompileState state, LemniCo
 	return ret;
 }
 
+LemniJitResult LemniTypedNAryOpExprT::compile(LemniCompileState state, LemniCompileContext ctx) const noexcept{
+	for(auto operand : operands){
+		if(!lemniTypeIsCastable(operand->type(), resultType)){
+			return strError(
+				state,
+				fmt::format(
+					"operand of type '{}' not usable as '{}'",
+					lemni::toStdStrView(operand->type()->str()), lemni::toStdStrView(resultType->str())
+				)
+			);
+		}
+	}
+
+	auto conv = llvmConv(resultType);
+	auto dispatcher = opDispatcher(op, resultType);
+
+	llvm::Value *acc = nullptr;
+
+	for(auto operand : operands){
+		auto operandRes = operand->compile(state, ctx);
+		if(operandRes.hasError) return operandRes;
+
+		auto operandVal = operandRes.rvalue;
+
+		if(operand->type() != resultType){
+			operandVal = conv(&state->llvmState, operand->type(), operandVal);
+		}
+
+		if(!acc){
+			acc = operandVal;
+			continue;
+		}
+
+		acc = dispatcher(&state->llvmState, acc, operandVal);
+		if(!acc){
+			LemniJitResult ret;
+			ret.hasError = true;
+			ret.error.msg = LEMNICSTR("operator currently unimplemented");
+			return ret;
+		}
+	}
+
+	LemniJitResult ret;
+	ret.hasError = false;
+	ret.rvalue = acc;
+	return ret;
+}
+
 LemniJitResult LemniTypedBindingExprT::compile(LemniCompileState state, LemniCompileContext ctx) const noexcept{
 	auto rvalueRes = this->value->compile(state, ctx);
 	if(rvalueRes.hasError) return rvalueRes;
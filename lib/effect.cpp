@@ -0,0 +1,189 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "lemni/effect.h"
+
+#include "TypedExpr.hpp"
+
+struct LemniEffectStateT{
+	static constexpr std::size_t noLink = std::numeric_limits<std::size_t>::max();
+
+	struct Frame{
+		LemniTypedExpr fn;
+		LemniEffect assumed;
+	};
+
+	std::unordered_map<LemniTypedExpr, LemniEffect> exprEffects;
+	std::unordered_map<LemniTypedExpr, LemniEffect> callEffects;
+	std::unordered_map<LemniTypedExpr, LemniEffect> declared;
+
+	// functions currently being analysed, recursive calls use the assumed effect
+	std::vector<Frame> stack;
+
+	// lowest stack index of any assumption read by the current computation
+	std::size_t lowLink = noLink;
+};
+
+LemniEffectState lemniCreateEffectState(){
+	auto mem = std::malloc(sizeof(LemniEffectStateT));
+	if(!mem) return nullptr;
+
+	return new(mem) LemniEffectStateT;
+}
+
+void lemniDestroyEffectState(LemniEffectState state){
+	std::destroy_at(state);
+	std::free(state);
+}
+
+void lemniEffectStateDeclare(LemniEffectState state, LemniTypedExtFnDeclExpr fn, const LemniEffect effect){
+	state->declared[fn] = effect;
+}
+
+LemniEffect lemniEffectJoin(const LemniEffect a, const LemniEffect b){
+	return std::max(a, b);
+}
+
+LemniStr lemniEffectStr(const LemniEffect effect){
+	switch(effect){
+		case LEMNI_EFFECT_PURE: return LEMNICSTR("pure");
+		case LEMNI_EFFECT_READS_EXTERNAL: return LEMNICSTR("reads-external");
+		case LEMNI_EFFECT_EFFECTFUL: return LEMNICSTR("effectful");
+		default: return LEMNICSTR("unknown");
+	}
+}
+
+LemniEffect lemniEffectOf(LemniEffectState state, LemniTypedExpr expr){
+	if(!expr) return LEMNI_EFFECT_PURE;
+
+	auto res = state->exprEffects.find(expr);
+	if(res != end(state->exprEffects)) return res->second;
+
+	const auto prevLink = state->lowLink;
+	state->lowLink = LemniEffectStateT::noLink;
+
+	const auto effect = expr->effect(state);
+
+	// results depending on an unfinished recursive call could still change
+	if(state->lowLink == LemniEffectStateT::noLink){
+		state->exprEffects[expr] = effect;
+	}
+
+	state->lowLink = std::min(prevLink, state->lowLink);
+	return effect;
+}
+
+namespace {
+	LemniEffect callEffectImpl(LemniEffectState state, LemniTypedExpr fn){
+		if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(fn)){
+			return lemniEffectOf(state, fnDef->lambda->body);
+		}
+		else if(auto lambda = dynamic_cast<LemniTypedLambdaExpr>(fn)){
+			return lemniEffectOf(state, lambda->body);
+		}
+		else if(auto extFn = dynamic_cast<LemniTypedExtFnDeclExpr>(fn)){
+			auto res = state->declared.find(extFn);
+			return res != end(state->declared) ? res->second : LEMNI_EFFECT_EFFECTFUL;
+		}
+		else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(fn)){
+			return lemniEffectOfCall(state, binding->value);
+		}
+		else{
+			// parameters and other dynamic functions
+			return LEMNI_EFFECT_EFFECTFUL;
+		}
+	}
+}
+
+LemniEffect lemniEffectOfCall(LemniEffectState state, LemniTypedExpr fn){
+	if(!fn) return LEMNI_EFFECT_EFFECTFUL;
+
+	fn = fn->deref();
+
+	auto res = state->callEffects.find(fn);
+	if(res != end(state->callEffects)) return res->second;
+
+	auto frameIt = std::find_if(
+		begin(state->stack), end(state->stack),
+		[fn](const auto &frame){ return frame.fn == fn; }
+	);
+
+	if(frameIt != end(state->stack)){
+		const auto idx = std::size_t(std::distance(begin(state->stack), frameIt));
+		state->lowLink = std::min(state->lowLink, idx);
+		return frameIt->assumed;
+	}
+
+	const auto idx = state->stack.size();
+	state->stack.emplace_back(LemniEffectStateT::Frame{ fn, LEMNI_EFFECT_PURE });
+
+	const auto prevLink = state->lowLink;
+
+	LemniEffect effect;
+	std::size_t link;
+
+	// iterate until the assumed effect of recursive calls is a fixed point
+	while(true){
+		state->lowLink = LemniEffectStateT::noLink;
+		effect = callEffectImpl(state, fn);
+		link = state->lowLink;
+
+		if(effect == state->stack[idx].assumed) break;
+
+		state->stack[idx].assumed = effect;
+	}
+
+	state->stack.pop_back();
+
+	if(link >= idx){
+		state->callEffects[fn] = effect;
+		link = LemniEffectStateT::noLink;
+	}
+
+	state->lowLink = std::min(prevLink, link);
+	return effect;
+}
+
+LemniEffect LemniTypedExprT::effect(LemniEffectState state) const noexcept{
+	std::vector<LemniTypedExpr> exprs;
+	children(exprs);
+
+	auto res = LEMNI_EFFECT_PURE;
+
+	for(auto expr : exprs){
+		res = lemniEffectJoin(res, lemniEffectOf(state, expr));
+		if(res == LEMNI_EFFECT_EFFECTFUL) break;
+	}
+
+	return res;
+}
+
+LemniEffect LemniTypedApplicationExprT::effect(LemniEffectState state) const noexcept{
+	auto res = lemniEffectOfCall(state, fn);
+
+	res = lemniEffectJoin(res, LemniTypedExprT::effect(state));
+
+	return res;
+}
@@ -19,6 +19,8 @@
 #include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+
 #include <vector>
 #include <string>
 #include <memory>
@@ -32,23 +34,12 @@
 
 #include "lemni/Value.h"
 #include "lemni/eval.h"
-#include "lemni/Scope.h"
 
 #include "TypeList.hpp"
-#include "TypedExpr.hpp"
-#include "Value.hpp"
+#include "eval.hpp"
 
 using namespace lemni::typelist;
 
-struct LemniEvalStateT{
-	std::vector<std::string> errMsgs;
-	std::map<LemniTypedExpr, lemni::Value> stored;
-	lemni::Scope globalScope;
-	LemniEvalBindingsT globalBindings;
-	LemniTypeSet types;
-	void *dlHandle;
-};
-
 LemniEvalState lemniCreateEvalState(LemniTypeSet types){
 	auto mem = std::malloc(sizeof(LemniEvalStateT));
 	auto p = new(mem) LemniEvalStateT;
@@ -72,6 +63,38 @@ void lemniDestroyEvalState(LemniEvalState state){
 	std::free(state);
 }
 
+LemniNat64 lemniEvalStateNumRoots(LemniEvalState state){
+	return state->stored.size() + state->globalBindings.bound.size() + state->machine.numRoots();
+}
+
+void lemniEvalStateRoots(LemniEvalState state, LemniTypedExpr *const out){
+	auto it = out;
+
+	for(auto &&stored : state->stored){
+		*(it++) = stored.first;
+	}
+
+	for(auto &&bound : state->globalBindings.bound){
+		*(it++) = bound.first;
+	}
+
+	state->machine.roots(it);
+}
+
+void lemniEvalStateSetBudget(LemniEvalState state, const LemniNat64 maxCalls, const LemniNat32 maxDepth){
+	state->maxCalls = maxCalls;
+	state->maxDepth = maxDepth;
+	state->numCalls = 0;
+}
+
+void lemniEvalStateSetMode(LemniEvalState state, const LemniEvalMode mode){
+	state->mode = mode;
+}
+
+LemniEvalMode lemniEvalStateMode(LemniEvalState state){
+	return state->mode;
+}
+
 namespace {
 	LemniEvalResult makeError(LemniEvalState state, std::string msg){
 		auto &&errMsg = state->errMsgs.emplace_back(std::move(msg));
@@ -94,13 +117,123 @@ namespace {
 		res.value = val;
 		return res;
 	}
+
+	//! Whether \p val is one of the arguments or locals of the call frame \p frame
+	bool isFrameLocal(LemniValue val, const LemniEvalBindingsT &frame){
+		return
+			std::find(frame.slots, frame.slots + frame.layout->numSlots(), val) != frame.slots + frame.layout->numSlots() ||
+			std::any_of(begin(frame.bound), end(frame.bound), [val](auto &&bound){ return bound.second.handle() == val; });
+	}
+
+	//! Whether the pending \p tail call can take over the frame of \p self bound in \p frame
+	bool canReuseFrame(LemniTypedFnDefExpr self, const LemniEvalBindingsT &frame, const LemniEvalTailCallT &tail){
+		// closures over the frame need it to outlive the call
+		if(tail.bindings == &frame && tail.fn != self){
+			auto &&nested = frame.layout->nested;
+			if(std::find(begin(nested), end(nested), tail.fn) != end(nested)) return false;
+		}
+
+		return std::none_of(tail.args, tail.args + tail.fn->lambda->params.size(), [&frame](LemniValue arg){
+			auto fnVal = dynamic_cast<const LemniValueFnT*>(arg->deref());
+			return fnVal && fnVal->bindings == &frame;
+		});
+	}
+
+	/**
+	 * Call the function defined by \p self in the frame pushed at \p mark , starting with the arguments at \p slots .
+	 * The frame is left for the caller to pop.
+	 */
+	LemniEvalResult callFrame(LemniTypedFnDefExpr self, LemniEvalState state, LemniEvalBindings bindings, const lemni::frame::Stack::Mark mark, LemniValue *const slots){
+		auto frame = LemniEvalBindingsT(bindings, &self->lambda->frameLayout(), slots);
+
+		LemniEvalTailCallT tail;
+
+		while(true){
+			auto retRes = self->lambda->body->evalTail(state, &frame, &tail);
+			if(retRes.hasError) return retRes;
+
+			if(tail.fn){
+				// arguments referring to this frame need a copy before it goes away
+				for(auto arg = tail.args; arg != tail.args + tail.fn->lambda->params.size(); ++arg){
+					auto refed = (*arg)->deref();
+					if(refed != *arg && isFrameLocal(refed, frame)){
+						if(auto copied = refed->copy()){
+							lemniDestroyValue(*arg);
+							*arg = copied;
+						}
+					}
+				}
+
+				if(canReuseFrame(self, frame, tail)){
+					auto &&layout = tail.fn->lambda->frameLayout();
+
+					frame.bound.clear();
+					frame.parent = tail.bindings == &frame ? bindings : tail.bindings;
+					frame.layout = &layout;
+					frame.slots = state->frames.replace(mark, tail.args, tail.fn->lambda->params.size(), layout.numSlots());
+
+					self = tail.fn;
+					tail = LemniEvalTailCallT();
+					continue;
+				}
+
+				if(state->maxDepth && (state->depth >= state->maxDepth)){
+					return litError(LEMNICSTR("maximum evaluation depth exceeded"));
+				}
+
+				++state->depth;
+				retRes = callFrame(tail.fn, state, tail.bindings, tail.mark, tail.args);
+				--state->depth;
+
+				state->frames.pop(tail.mark);
+
+				if(retRes.hasError) return retRes;
+			}
+
+			// the arguments and locals die with this call, so results referring to them need a copy
+			auto refed = retRes.value->deref();
+			if(refed != retRes.value && isFrameLocal(refed, frame)){
+				if(auto copied = refed->copy()){
+					lemniDestroyValue(retRes.value);
+					retRes.value = copied;
+				}
+			}
+
+			return retRes;
+		}
+	}
+
+	//! Call the function defined by \p self_ , a \ref LemniTypedFnDefExpr
+	LemniEvalResult callFnDef(void *const self_, LemniEvalState state, LemniEvalBindings bindings, LemniValue *const args, const LemniNat64 numArgs){
+		auto self = reinterpret_cast<LemniTypedFnDefExpr>(self_);
+
+		if(numArgs != self->lambda->params.size()){
+			return litError(LEMNICSTR("wrong number of args passed"));
+		}
+
+		auto mark = state->frames.mark();
+		auto slots = state->frames.push(self->lambda->frameLayout().numSlots());
+
+		// the arguments are owned by the caller
+		for(std::size_t i = 0; i < numArgs; i++){
+			slots[i] = lemniCreateValueRef(args[i]);
+		}
+
+		auto res = callFrame(self, state, bindings, mark, slots);
+
+		state->frames.pop(mark);
+
+		return res;
+	}
 }
 
 LemniEvalResult LemniTypedUnaryOpExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
 	auto res = value->eval(state, bindings);
 	if(res.hasError) return res;
 
-	auto retVal = lemniValueUnaryOp(this->op, res.value);
+	auto retVal = state->mode == LEMNI_EVAL_SPECIALIZING
+		? lemni::spec::unaryOp(site, this->op, res.value)
+		: lemniValueUnaryOp(this->op, res.value);
 
 	lemniDestroyValue(res.value);
 
@@ -120,13 +253,45 @@ LemniEvalResult LemniTypedBinaryOpExprT::eval(LemniEvalState state, LemniEvalBin
 
 	auto rhsVal = lemni::Value::from(res.value);
 
-	auto retVal = lemniValueBinaryOp(this->op, lhsVal.handle(), rhsVal.handle());
+	auto retVal = state->mode == LEMNI_EVAL_SPECIALIZING
+		? lemni::spec::binaryOp(site, this->op, lhsVal.handle(), rhsVal.handle())
+		: lemniValueBinaryOp(this->op, lhsVal.handle(), rhsVal.handle());
 
 	return makeResult(retVal);
 }
 
+LemniEvalResult LemniTypedNAryOpExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
+	auto res = operands[0]->eval(state, bindings);
+	if(res.hasError) return res;
+
+	auto acc = lemni::Value::from(res.value);
+
+	// references to bound values don't accumulate, so take a copy we own
+	if(acc.handle()->deref() != acc.handle()){
+		if(auto owned = acc.handle()->deref()->copy()) acc = lemni::Value::from(owned);
+	}
+
+	for(std::size_t i = 1; i < operands.size(); i++){
+		res = operands[i]->eval(state, bindings);
+		if(res.hasError) return res;
+
+		auto rhsVal = lemni::Value::from(res.value);
+
+		auto accVal = const_cast<LemniValueT*>(acc.handle());
+		if(accVal->accumulate(this->op, rhsVal.handle()->deref())) continue;
+
+		// the type changes, so fall back to allocating a new value
+		auto nextVal = lemniValueBinaryOp(this->op, acc.handle(), rhsVal.handle());
+		if(!nextVal) return litError(LEMNICSTR("invalid operands for n-ary op"));
+
+		acc = lemni::Value::from(nextVal);
+	}
+
+	return makeResult(acc.release());
+}
+
 LemniEvalResult LemniTypedBindingExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
-	auto res = bindings->find(this);
+	auto res = bindings->find(this, slot);
 	if(res){
 		return makeResult(lemniCreateValueRef(res));
 	}
@@ -144,33 +309,93 @@ LemniEvalResult LemniTypedBindingExprT::eval(LemniEvalState state, LemniEvalBind
 
 	auto valRef = lemniCreateValueRef(val.handle());
 
-	state->stored[this] = std::move(val);
+	if(bindings == &state->globalBindings){
+		state->stored[this] = std::move(val);
+	}
+	else if(auto idx = bindings->layout ? bindings->layout->find(this, slot) : lemni::frame::noSlot; idx != lemni::frame::noSlot){
+		// bindings local to a function call must not outlive it
+		bindings->slots[idx] = val.release();
+	}
+	else{
+		bindings->bound[this] = std::move(val);
+	}
 
 	return makeResult(valRef);
 }
 
 LemniEvalResult LemniTypedApplicationExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
+	return evalTail(state, bindings, nullptr);
+}
+
+LemniEvalResult LemniTypedApplicationExprT::evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept{
+	// calls to a known definition skip creating and calling a function value
+	LemniTypedFnDefExpr callee = nullptr;
+	LemniEvalBindings calleeBindings = bindings;
+
 	lemni::Value fnVal;
-	{
+
+	if(state->mode == LEMNI_EVAL_SPECIALIZING){
+		callee = lemni::spec::directCallee(site, fn);
+	}
+
+	if(!callee){
 		auto res = fn->eval(state, bindings);
 		if(res.hasError) return res;
+
 		fnVal = lemni::Value::from(res.value);
+
+		auto fnImpl = dynamic_cast<const LemniValueFnT*>(fnVal.handle()->deref());
+		if(fnImpl && fnImpl->fn == callFnDef && fnImpl->state == state){
+			callee = reinterpret_cast<LemniTypedFnDefExpr>(fnImpl->ptr);
+			calleeBindings = fnImpl->bindings;
+		}
 	}
 
-	std::vector<lemni::Value> argVals;
-	std::vector<LemniValue> argHandles;
-	argVals.reserve(args.size());
-	argHandles.reserve(args.size());
+	if(callee && (callee->lambda->params.size() != args.size())){
+		return litError(LEMNICSTR("wrong number of args passed"));
+	}
+
+	// arguments are evaluated straight into the callee's frame
+	auto mark = state->frames.mark();
+	auto argSlots = state->frames.push(callee ? callee->lambda->frameLayout().numSlots() : args.size());
+
+	for(std::size_t i = 0; i < args.size(); i++){
+		auto argRes = args[i]->eval(state, bindings);
+		if(argRes.hasError){
+			state->frames.pop(mark);
+			return argRes;
+		}
+
+		argSlots[i] = argRes.value;
+	}
+
+	if(state->maxCalls && (++state->numCalls > state->maxCalls)){
+		state->frames.pop(mark);
+		return litError(LEMNICSTR("evaluation call budget exhausted"));
+	}
 
-	for(auto arg : args){
-		auto argRes = arg->eval(state, bindings);
-		if(argRes.hasError) return argRes;
+	// calls to definitions in tail position are left for the calling function to perform in its own frame
+	if(tail && callee){
+		tail->fn = callee;
+		tail->bindings = calleeBindings;
+		tail->mark = mark;
+		tail->args = argSlots;
+		return makeResult(nullptr);
+	}
 
-		auto handle = argHandles.emplace_back(argRes.value);
-		argVals.emplace_back(lemni::Value::from(handle));
+	if(state->maxDepth && (state->depth >= state->maxDepth)){
+		state->frames.pop(mark);
+		return litError(LEMNICSTR("maximum evaluation depth exceeded"));
 	}
 
-	auto callRes = lemniValueCall(fnVal.handle(), argHandles.data(), argHandles.size());
+	++state->depth;
+	auto callRes = callee
+		? callFrame(callee, state, calleeBindings, mark, argSlots)
+		: lemniValueCall(fnVal.handle(), argSlots, args.size());
+	--state->depth;
+
+	state->frames.pop(mark);
+
 	if(callRes.hasError){
 		LemniEvalResult res;
 		res.hasError = true;
@@ -199,6 +424,10 @@ LemniEvalResult LemniTypedProductExprT::eval(LemniEvalState state, LemniEvalBind
 }
 
 LemniEvalResult LemniTypedBranchExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
+	return evalTail(state, bindings, nullptr);
+}
+
+LemniEvalResult LemniTypedBranchExprT::evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept{
 	auto condRes = cond->eval(state, bindings);
 	if(condRes.hasError) return condRes;
 
@@ -208,11 +437,11 @@ LemniEvalResult LemniTypedBranchExprT::eval(LemniEvalState state, LemniEvalBindi
 
 	if(condVal == 0){
 		// false
-		return this->false_->eval(state, bindings);
+		return this->false_->evalTail(state, bindings, tail);
 	}
 	else if(condVal == 1){
 		// true
-		return this->true_->eval(state, bindings);
+		return this->true_->evalTail(state, bindings, tail);
 	}
 	else{
 		// not a boolean condition
@@ -227,19 +456,23 @@ LemniEvalResult LemniTypedReturnExprT::eval(LemniEvalState state, LemniEvalBindi
 }
 
 LemniEvalResult LemniTypedBlockExprT::eval(LemniEvalState state, LemniEvalBindings bindings) const noexcept{
+	return evalTail(state, bindings, nullptr);
+}
+
+LemniEvalResult LemniTypedBlockExprT::evalTail(LemniEvalState state, LemniEvalBindings bindings, LemniEvalTailCall tail) const noexcept{
 	LemniValue val = nullptr;
 
-	for(auto expr : exprs){
+	for(std::size_t i = 0; i < exprs.size(); i++){
 		if(val) lemniDestroyValue(val);
 
-		if(auto retExpr = dynamic_cast<LemniTypedReturnExpr>(expr)){
-			auto exprRes = retExpr->value->eval(state, bindings);
-			if(exprRes.hasError) return exprRes;
-
-			return makeResult(exprRes.value);
+		if(auto retExpr = dynamic_cast<LemniTypedReturnExpr>(exprs[i])){
+			return retExpr->value->evalTail(state, bindings, tail);
 		}
 		else{
-			auto exprRes = expr->eval(state, bindings);
+			auto exprRes = (i + 1 == exprs.size())
+				? exprs[i]->evalTail(state, bindings, tail)
+				: exprs[i]->eval(state, bindings);
+
 			if(exprRes.hasError) return exprRes;
 
 			val = exprRes.value;
@@ -499,7 +732,7 @@ LemniEvalResult LemniTypedParamBindingExprT::eval(LemniEvalState state, LemniEva
 
 	LemniEvalResult ret;
 
-	auto res = bindings->find(this);
+	auto res = bindings->find(this, slot);
 	if(!res){
 		return litError(LEMNICSTR("no value is bound to parameter"));
 	}
@@ -517,26 +750,7 @@ LemniEvalResult LemniTypedFnDefExprT::eval(LemniEvalState state, LemniEvalBindin
 		return fnType;
 	};
 
-	auto doEval = [](void *const self_, LemniEvalState state, LemniEvalBindings bindings, LemniValue *const args, const LemniNat64 numArgs){
-		auto self = reinterpret_cast<LemniTypedFnDefExpr>(self_);
-
-		auto fnType = self->lambda->fnType;
-
-		if(numArgs != self->lambda->params.size()){
-			return litError(LEMNICSTR("wrong number of args passed"));
-		}
-
-		auto fnBindings = LemniEvalBindingsT(bindings);
-
-		for(std::size_t i = 0; i < self->lambda->params.size(); i++){
-			fnBindings.bound[self->lambda->params[i]] = lemni::Value::from(lemniCreateValueRef(args[i]));
-		}
-
-		auto retRes = self->lambda->body->eval(state, &fnBindings);
-		return retRes;
-	};
-
-	auto val = lemniCreateValueFn(doType, doEval, const_cast<LemniTypedFnDefExprT*>(this), state, bindings);
+	auto val = lemniCreateValueFn(doType, callFnDef, const_cast<LemniTypedFnDefExprT*>(this), state, bindings);
 	return makeResult(val);
 }
 
@@ -1048,5 +1262,29 @@ LemniEvalBindings lemniEvalGlobalBindings(LemniEvalState state){
 }
 
 LemniEvalResult lemniEval(LemniEvalState state, LemniTypedExpr expr){
+	if(state->mode == LEMNI_EVAL_BYTECODE){
+		auto &&machine = state->machine;
+
+		if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+			// run the bound value as bytecode but store it like the tree walker would
+			if(state->stored.find(binding) == end(state->stored)){
+				auto fn = machine.compile(binding->value);
+				if(fn != lemni::bc::noFn){
+					auto res = machine.run(state, &state->globalBindings, fn);
+					if(res.hasError) return res;
+
+					auto &&stored = state->stored[binding] = lemni::Value::from(res.value);
+					return makeResult(lemniCreateValueRef(stored.handle()));
+				}
+			}
+		}
+		else{
+			auto fn = machine.compile(expr);
+			if(fn != lemni::bc::noFn){
+				return machine.run(state, &state->globalBindings, fn);
+			}
+		}
+	}
+
 	return expr->eval(state, &state->globalBindings);
 }
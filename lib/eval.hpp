@@ -0,0 +1,48 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_EVAL_HPP
+#define LEMNI_LIB_EVAL_HPP 1
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lemni/eval.h"
+#include "lemni/Scope.h"
+
+#include "TypedExpr.hpp"
+#include "Value.hpp"
+#include "Bytecode.hpp"
+#include "Frame.hpp"
+
+struct LemniEvalStateT{
+	std::vector<std::string> errMsgs;
+	std::map<LemniTypedExpr, lemni::Value> stored;
+	lemni::Scope globalScope;
+	LemniEvalBindingsT globalBindings;
+	LemniTypeSet types;
+	void *dlHandle;
+	LemniNat64 maxCalls = 0, numCalls = 0;
+	LemniNat32 maxDepth = 0, depth = 0;
+	LemniEvalMode mode = LEMNI_EVAL_TREE;
+	lemni::bc::Machine machine;
+	lemni::frame::Stack frames;
+};
+
+#endif // !LEMNI_LIB_EVAL_HPP
@@ -20,6 +20,11 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
 
 using namespace std::string_literals;
 using namespace std::string_view_literals;
@@ -29,14 +34,44 @@ using namespace std::string_view_literals;
 #include "lemni/mangle.h"
 
 struct LemniManglerT{
-	std::vector<std::unique_ptr<std::string>> strs;
+	explicit LemniManglerT(LemniTypeSet types_) noexcept: types(types_){}
+
+	struct Symbol{
+		std::string mangled, name, qualified;
+		LemniDemangled demangled;
+	};
+
+	// views point into the stored symbol, or into the caller's arguments for lookups
+	struct Key{
+		LemniModule module;
+		std::string_view name;
+		LemniNat64 typeIdx;
+
+		bool operator==(const Key &other) const noexcept = default;
+	};
+
+	struct KeyHash{
+		std::size_t operator()(const Key &key) const noexcept{
+			auto h = std::hash<std::string_view>{}(key.name);
+			h ^= std::hash<const void*>{}(key.module) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			h ^= std::hash<LemniNat64>{}(key.typeIdx) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	LemniTypeSet types;
+
+	mutable std::shared_mutex mutex;
+	std::deque<Symbol> symbols;
+	std::unordered_map<Key, const Symbol*, KeyHash> byKey;
+	std::unordered_map<std::string_view, const Symbol*> byMangled;
 };
 
-LemniMangler lemniCreateMangler(){
+LemniMangler lemniCreateMangler(LemniTypeSet types){
 	auto mem = std::malloc(sizeof(LemniManglerT));
 	if(!mem) return nullptr;
 
-	auto p = new(mem) LemniManglerT;
+	auto p = new(mem) LemniManglerT(types);
 
 	return p;
 }
@@ -46,31 +81,93 @@ void lemniDestroyMangler(LemniMangler mangler){
 	std::free(mangler);
 }
 
-LemniStr lemniMangler(
+namespace {
+	/**
+	 * Symbols are mangled as ``_[m<len><module>]<len><name>f<numParams><result><params...>``.
+	 * The name is length prefixed so it can't run into the type names after it.
+	 */
+	std::string mangleSymbol(LemniModule module, std::string_view name, LemniFunctionType fnType){
+		auto str = "_"s;
+
+		if(module){
+			auto moduleName = lemni::toStdStrView(lemniModuleId(module));
+			str += fmt::format("m{}{}", moduleName.size(), moduleName);
+		}
+
+		const auto numParams = lemniFunctionTypeNumParams(fnType);
+
+		str += fmt::format("{}{}f{}", name.size(), name, numParams);
+		str += lemni::toStdStrView(lemniTypeMangled(lemniFunctionTypeResult(fnType)));
+
+		for(LemniNat32 i = 0; i < numParams; i++){
+			str += lemni::toStdStrView(lemniTypeMangled(lemniFunctionTypeParam(fnType, i)));
+		}
+
+		return str;
+	}
+}
+
+LemniStr lemniMangle(
 	LemniMangler mangler,
 	LemniModule module, const LemniStr name,
 	LemniType result,
 	LemniNat32 numParams, LemniType *const params
 ){
-	auto prefix = "_"s;
-	if(module){
-		auto moduleName = lemni::toStdStr(lemniModuleId(module));
-		prefix = fmt::format("_m{}{}", moduleName.size(), moduleName);
+	auto fnType = lemniTypeSetGetFunction(mangler->types, result, params, numParams);
+	return lemniMangleFn(mangler, module, name, fnType);
+}
+
+LemniStr lemniMangleFn(LemniMangler mangler, LemniModule module, const LemniStr name, LemniFunctionType fnType){
+	const LemniManglerT::Key key{ module, lemni::toStdStrView(name), lemniTypeInfoIndex(fnType) };
+
+	{
+		std::shared_lock lock(mangler->mutex);
+
+		auto res = mangler->byKey.find(key);
+		if(res != end(mangler->byKey)){
+			return lemni::fromStdStrView(res->second->mangled);
+		}
 	}
 
-	auto str = fmt::format("{}f{}{}", prefix, numParams, lemni::toStdStrView(lemniTypeMangled(result)));
+	auto mangled = mangleSymbol(module, key.name, fnType);
+
+	auto qualified = module
+		? fmt::format("{}.{}", lemni::toStdStrView(lemniModuleId(module)), key.name)
+		: std::string(key.name);
 
-	for(LemniNat32 i = 0; i < numParams; i++){
-		auto param = params[i];
-		str += lemni::toStdStrView(lemniTypeMangled(param));
+	std::unique_lock lock(mangler->mutex);
+
+	// another thread may have interned it in the meantime
+	auto res = mangler->byKey.find(key);
+	if(res != end(mangler->byKey)){
+		return lemni::fromStdStrView(res->second->mangled);
 	}
 
-	str += lemni::toStdStrView(name);
+	auto &&sym = mangler->symbols.emplace_back(LemniManglerT::Symbol{ std::move(mangled), std::string(key.name), std::move(qualified), {} });
+
+	sym.demangled = LemniDemangled{
+		.module = module,
+		.name = lemni::fromStdStrView(sym.name),
+		.qualified = lemni::fromStdStrView(sym.qualified),
+		.type = fnType
+	};
 
-	auto strPtr = std::make_unique<std::string>(std::move(str));
-	auto ret = lemni::fromStdStrView(*strPtr);
+	mangler->byKey.try_emplace(LemniManglerT::Key{ module, sym.name, key.typeIdx }, &sym);
+	mangler->byMangled.try_emplace(sym.mangled, &sym);
 
-	mangler->strs.emplace_back(std::move(strPtr));
+	return lemni::fromStdStrView(sym.mangled);
+}
+
+const LemniDemangled *lemniDemangle(LemniManglerConst mangler, const LemniStr mangled){
+	std::shared_lock lock(mangler->mutex);
+
+	auto res = mangler->byMangled.find(lemni::toStdStrView(mangled));
+	if(res == end(mangler->byMangled)) return nullptr;
+
+	return &res->second->demangled;
+}
 
-	return ret;
+LemniNat64 lemniManglerNumSymbols(LemniManglerConst mangler){
+	std::shared_lock lock(mangler->mutex);
+	return mangler->symbols.size();
 }
@@ -33,18 +33,20 @@ struct LemniMemCheckStateT{
 		}
 	}
 
+	LemniTypeSet types;
 	LemniRegion global;
 	std::vector<LemniRegion> regions;
 	std::map<LemniTypedExpr, LemniRegion> regionMap;
 	std::map<LemniTypedExpr, LemniStorage> storageMap;
 };
 
-LemniMemCheckState lemniCreateMemCheckState(LemniRegion global){
+LemniMemCheckState lemniCreateMemCheckState(LemniTypeSet types, LemniRegion global){
 	auto mem = std::malloc(sizeof(LemniMemCheckStateT));
 	if(!mem) return nullptr;
 
 	auto p = new(mem) LemniMemCheckStateT;
 
+	p->types = types;
 	p->global = global;
 
 	return p;
@@ -73,12 +75,6 @@ LemniMemCheckResult lemniMemCheck(LemniMemCheckState state, LemniTypedExpr expr)
 	}
 }
 
-namespace {
-	LemniNat64 calcSize(LemniType type){
-		auto numBits = lemniTypeNumBits(type);
-		return numBits / 8;
-	}
-}
 
 LemniMemCheckResult LemniTypedExprT::memcheck(LemniMemCheckState state) const noexcept{
 	auto region = state->global;
@@ -90,9 +86,10 @@ LemniMemCheckResult LemniTypedExprT::memcheck(LemniMemCheckState state) const no
 		);
 	}
 
-	const auto size = calcSize(type());
+	// unsized types get no storage
+	auto layout = lemniTypeSetGetLayout(state->types, type());
 
-	auto storage = lemniRegionAlloc(region, size, size);
+	auto storage = lemniRegionAlloc(region, layout ? layout->size : 0, layout ? layout->alignment : 0);
 
 	state->regionMap[this] = region;
 	state->storageMap[this] = storage;
@@ -133,7 +130,7 @@ LemniMemCheckResult LemniTypedLambdaExprT::memcheck(LemniMemCheckState state) co
 	auto paramRegion = lemniCreateRegion(fnRegion);
 	auto bodyRegion = lemniCreateRegion(fnRegion);
 
-	auto paramState = lemniCreateMemCheckState(paramRegion);
+	auto paramState = lemniCreateMemCheckState(state->types, paramRegion);
 
 	for(auto param : params){
 		auto paramRes = param->memcheck(paramState);
@@ -145,7 +142,7 @@ LemniMemCheckResult LemniTypedLambdaExprT::memcheck(LemniMemCheckState state) co
 
 	lemniDestroyMemCheckState(paramState);
 
-	auto bodyState = lemniCreateMemCheckState(bodyRegion);
+	auto bodyState = lemniCreateMemCheckState(state->types, bodyRegion);
 
 	auto bodyRes = body->memcheck(bodyState);
 
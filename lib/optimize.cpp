@@ -0,0 +1,1066 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+
+#include "fmt/format.h"
+
+#include "lemni/optimize.h"
+
+#include "typecheck.hpp"
+
+namespace {
+	/**
+	 * Rebuild \p expr with every direct child replaced by ``f(child)``.
+	 * Nodes are only reallocated if a child changed, expressions without rebuildable children are returned as-is.
+	 * Definitions are referenced by identity, so function definitions and bindings are updated in place.
+	 */
+	template<typename F>
+	LemniTypedExpr rebuild(LemniTypecheckState state, LemniTypedExpr expr, F &&f){
+		if(auto unaryOp = dynamic_cast<LemniTypedUnaryOpExpr>(expr)){
+			auto value = f(unaryOp->value);
+			if(value == unaryOp->value) return expr;
+
+			return createTypedExpr<LemniTypedUnaryOpExprT>(state, unaryOp->resultType, unaryOp->op, value);
+		}
+		else if(auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(expr)){
+			auto lhs = f(binaryOp->lhs);
+			auto rhs = f(binaryOp->rhs);
+			if((lhs == binaryOp->lhs) && (rhs == binaryOp->rhs)) return expr;
+
+			return createTypedExpr<LemniTypedBinaryOpExprT>(state, binaryOp->resultType, binaryOp->op, lhs, rhs);
+		}
+		else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)){
+			bool changed = false;
+
+			std::vector<LemniTypedExpr> operands;
+			operands.reserve(nary->operands.size());
+
+			for(auto operand : nary->operands){
+				auto newOperand = operands.emplace_back(f(operand));
+				changed = changed || (newOperand != operand);
+			}
+
+			if(!changed) return expr;
+
+			return createTypedExpr<LemniTypedNAryOpExprT>(state, nary->resultType, nary->op, std::move(operands));
+		}
+		else if(auto app = dynamic_cast<LemniTypedApplicationExpr>(expr)){
+			auto fn = f(app->fn);
+			bool changed = fn != app->fn;
+
+			std::vector<LemniTypedExpr> args;
+			args.reserve(app->args.size());
+
+			for(auto arg : app->args){
+				auto newArg = args.emplace_back(f(arg));
+				changed = changed || (newArg != arg);
+			}
+
+			if(!changed) return expr;
+
+			return createTypedExpr<LemniTypedApplicationExprT>(state, app->resultType, fn, std::move(args));
+		}
+		else if(auto product = dynamic_cast<LemniTypedProductExpr>(expr)){
+			bool changed = false;
+
+			std::vector<LemniTypedExpr> elems;
+			elems.reserve(product->elems.size());
+
+			for(auto elem : product->elems){
+				auto newElem = elems.emplace_back(f(elem));
+				changed = changed || (newElem != elem);
+			}
+
+			if(!changed) return expr;
+
+			return createTypedExpr<LemniTypedProductExprT>(state, product->productType, std::move(elems), product->isConstant);
+		}
+		else if(auto branch = dynamic_cast<LemniTypedBranchExpr>(expr)){
+			auto cond = f(branch->cond);
+			auto true_ = f(branch->true_);
+			auto false_ = f(branch->false_);
+			if((cond == branch->cond) && (true_ == branch->true_) && (false_ == branch->false_)) return expr;
+
+			return createTypedExpr<LemniTypedBranchExprT>(state, branch->resultType, cond, true_, false_);
+		}
+		else if(auto block = dynamic_cast<LemniTypedBlockExpr>(expr)){
+			bool changed = false;
+
+			std::vector<LemniTypedExpr> exprs;
+			exprs.reserve(block->exprs.size());
+
+			for(auto blockExpr : block->exprs){
+				auto newExpr = exprs.emplace_back(f(blockExpr));
+				changed = changed || (newExpr != blockExpr);
+			}
+
+			if(!changed) return expr;
+
+			return createTypedExpr<LemniTypedBlockExprT>(state, block->resultType, std::move(exprs));
+		}
+		else if(auto ret = dynamic_cast<LemniTypedReturnExpr>(expr)){
+			auto value = f(ret->value);
+			if(value == ret->value) return expr;
+
+			return createTypedExpr<LemniTypedReturnExprT>(state, value);
+		}
+		else if(auto lambda = dynamic_cast<LemniTypedLambdaExpr>(expr)){
+			auto body = f(lambda->body);
+			if(body == lambda->body) return expr;
+
+			return createTypedExpr<LemniTypedLambdaExprT>(state, lambda->params, body, lambda->fnType, lambda->isPseudo);
+		}
+		else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+			auto value = f(binding->value);
+			if(value != binding->value){
+				const_cast<LemniTypedBindingExprT*>(binding)->value = value;
+			}
+
+			return expr;
+		}
+		else if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(expr)){
+			auto lambda = dynamic_cast<LemniTypedLambdaExpr>(f(fnDef->lambda));
+			if(lambda && (lambda != fnDef->lambda)){
+				const_cast<LemniTypedFnDefExprT*>(fnDef)->lambda = lambda;
+			}
+
+			return expr;
+		}
+		else if(auto exportExpr = dynamic_cast<LemniTypedExportExpr>(expr)){
+			// exported values are definitions, which are updated in place
+			f(exportExpr->value);
+			return expr;
+		}
+		else{
+			return expr;
+		}
+	}
+
+	/**
+	 * Common subexpression elimination by value numbering.
+	 *
+	 * Every expression gets a number that is equal for structurally equal expressions. Each region (the
+	 * top level expression, a lambda body or a branch arm) counts occurrences of its candidate subtrees
+	 * without looking into nested regions, so nothing is hoisted out of a branch it was conditional on.
+	 * Candidates that occur more than once are bound at the start of their region, or right after the last
+	 * block-local binding they refer to, so temporaries never run before the locals they depend on.
+	 */
+	class CommonSubexprs{
+		public:
+			static constexpr std::uint32_t minCost = 4;
+
+			explicit CommonSubexprs(LemniTypecheckState state_) noexcept
+				: state(state_), effects(typecheckEffects(state_)){}
+
+			LemniTypedExpr region(LemniTypedExpr root){
+				if(!root) return root;
+
+				// nested regions are pushed while rewriting, so only refer to this one by index
+				const auto idx = regions.size();
+
+				regions.emplace_back();
+				count(root);
+
+				auto order = std::move(regions[idx].order);
+
+				std::vector<LemniTypedExpr> exprs;
+
+				for(auto expr : order){
+					auto num = number(expr);
+					if(regions[idx].counts[num] < 2) continue;
+
+					// bound in post-order, so nested repeats are already available as temporaries
+					auto value = rebuild(state, expr, [this](LemniTypedExpr child){ return rewrite(child); });
+
+					auto binding = createTypedExpr<LemniTypedBindingExprT>(state, fmt::format("$cse{}", nextTemp++), value);
+					regions[idx].temps[num] = binding;
+
+					if(auto local = lastLocal(expr)){
+						regions[idx].placed[{ local->block, local->index }].emplace_back(binding);
+					}
+					else{
+						exprs.emplace_back(binding);
+					}
+				}
+
+				auto body = rewrite(root);
+
+				regions.pop_back();
+
+				if(exprs.empty()) return body;
+
+				exprs.emplace_back(body);
+				return createTypedExpr<LemniTypedBlockExprT>(state, body->type(), std::move(exprs));
+			}
+
+			LemniTypedExpr rewrite(LemniTypedExpr expr){
+				if(!expr) return expr;
+
+				if(auto branch = dynamic_cast<LemniTypedBranchExpr>(expr)){
+					auto cond = rewrite(branch->cond);
+					auto true_ = region(branch->true_);
+					auto false_ = region(branch->false_);
+					if((cond == branch->cond) && (true_ == branch->true_) && (false_ == branch->false_)) return expr;
+
+					return createTypedExpr<LemniTypedBranchExprT>(state, branch->resultType, cond, true_, false_);
+				}
+				else if(auto lambda = dynamic_cast<LemniTypedLambdaExpr>(expr)){
+					return rebuild(state, lambda, [this](LemniTypedExpr body){ return region(body); });
+				}
+				else if(dynamic_cast<LemniTypedRefExpr>(expr) || dynamic_cast<LemniTypedFnDefExpr>(expr)){
+					return expr;
+				}
+				else if(auto block = dynamic_cast<LemniTypedBlockExpr>(expr)){
+					bool changed = false;
+
+					std::vector<LemniTypedExpr> exprs;
+					exprs.reserve(block->exprs.size());
+
+					for(std::size_t i = 0; i < block->exprs.size(); i++){
+						auto blockExpr = block->exprs[i];
+
+						auto newExpr = exprs.emplace_back(rewrite(blockExpr));
+						changed = changed || (newExpr != blockExpr);
+
+						// rewriting may push nested regions, so look the current one up again
+						if(regions.empty()) continue;
+
+						auto &&placed = regions.back().placed;
+
+						auto res = placed.find({ block, i });
+						if(res != end(placed)){
+							exprs.insert(end(exprs), begin(res->second), end(res->second));
+							changed = true;
+						}
+					}
+
+					if(!changed) return expr;
+
+					return createTypedExpr<LemniTypedBlockExprT>(state, block->resultType, std::move(exprs));
+				}
+
+				if(!regions.empty() && !regions.back().temps.empty()){
+					auto &&temps = regions.back().temps;
+
+					auto res = temps.find(number(expr));
+					if(res != end(temps)){
+						return createTypedExpr<LemniTypedRefExprT>(state, res->second);
+					}
+				}
+
+				return rebuild(state, expr, [this](LemniTypedExpr child){ return rewrite(child); });
+			}
+
+		private:
+			struct Key{
+				std::type_index kind;
+				std::uintptr_t identity;
+				std::uint64_t tag;
+				std::string payload;
+				std::vector<std::size_t> operands;
+
+				bool operator<(const Key &rhs) const noexcept{
+					return std::tie(kind, identity, tag, payload, operands) < std::tie(rhs.kind, rhs.identity, rhs.tag, rhs.payload, rhs.operands);
+				}
+			};
+
+			//! Where a block-local binding is made, deeper blocks are evaluated later
+			struct Local{
+				LemniTypedBlockExpr block;
+				std::size_t index;
+				std::uint32_t depth;
+			};
+
+			struct Region{
+				std::unordered_map<std::size_t, std::uint32_t> counts;
+				std::vector<LemniTypedExpr> order;
+				std::unordered_map<std::size_t, LemniTypedBindingExpr> temps;
+				std::unordered_map<LemniTypedBindingExpr, Local> locals;
+				std::map<std::pair<LemniTypedBlockExpr, std::size_t>, std::vector<LemniTypedBindingExpr>> placed;
+				std::uint32_t blockDepth = 0;
+			};
+
+			std::size_t number(LemniTypedExpr expr){
+				auto res = exprNumbers.find(expr);
+				if(res != end(exprNumbers)) return res->second;
+
+				auto key = Key{ typeid(*expr), 0, 0, {}, {} };
+
+				if(auto unaryOp = dynamic_cast<LemniTypedUnaryOpExpr>(expr)){
+					key.tag = unaryOp->op;
+					key.operands = { number(unaryOp->value) };
+				}
+				else if(auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(expr)){
+					key.tag = binaryOp->op;
+					key.operands = { number(binaryOp->lhs), number(binaryOp->rhs) };
+
+					switch(binaryOp->op){
+						case LEMNI_BINARY_ADD:
+						case LEMNI_BINARY_MUL:
+						case LEMNI_BINARY_AND:
+						case LEMNI_BINARY_OR:
+						case LEMNI_BINARY_EQ:
+						case LEMNI_BINARY_NEQ:
+							std::sort(begin(key.operands), end(key.operands));
+							break;
+
+						default: break;
+					}
+				}
+				else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)){
+					key.tag = nary->op;
+					key.operands.reserve(nary->operands.size());
+
+					for(auto operand : nary->operands){
+						key.operands.emplace_back(number(operand));
+					}
+				}
+				else if(auto app = dynamic_cast<LemniTypedApplicationExpr>(expr)){
+					key.operands.reserve(app->args.size() + 1);
+					key.operands.emplace_back(number(app->fn));
+
+					for(auto arg : app->args){
+						key.operands.emplace_back(number(arg));
+					}
+				}
+				else if(auto product = dynamic_cast<LemniTypedProductExpr>(expr)){
+					for(auto elem : product->elems){
+						key.operands.emplace_back(number(elem));
+					}
+				}
+				else if(dynamic_cast<LemniTypedRefExpr>(expr)){
+					// every reference to the same definition is the same value
+					auto num = number(expr->deref());
+					exprNumbers[expr] = num;
+					return num;
+				}
+				else if(auto literal = typedLiteralKey(expr); !literal.empty()){
+					key.payload = std::move(literal);
+				}
+				else{
+					key.identity = reinterpret_cast<std::uintptr_t>(expr);
+				}
+
+				auto num = numbers.try_emplace(std::move(key), numbers.size()).first->second;
+				exprNumbers[expr] = num;
+				return num;
+			}
+
+			std::uint32_t cost(LemniTypedExpr expr){
+				auto res = costs.find(expr);
+				if(res != end(costs)) return res->second;
+
+				std::uint32_t ret = 0;
+
+				if(dynamic_cast<LemniTypedApplicationExpr>(expr)) ret = 8;
+				else if(dynamic_cast<LemniTypedUnaryOpExpr>(expr) || dynamic_cast<LemniTypedBinaryOpExpr>(expr)) ret = 1;
+				else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)) ret = std::uint32_t(nary->operands.size() - 1);
+
+				if(ret){
+					std::vector<LemniTypedExpr> children;
+					expr->children(children);
+
+					for(auto child : children){
+						ret += cost(child);
+					}
+				}
+
+				costs[expr] = ret;
+				return ret;
+			}
+
+			//! The last binding local to the current region that \p expr refers to, ``nullptr`` if there is none
+			const Local *lastLocal(LemniTypedExpr expr){
+				auto &&locals = regions.back().locals;
+				if(locals.empty()) return nullptr;
+
+				std::unordered_set<LemniTypedBindingExpr> inner;
+				std::vector<LemniTypedBindingExpr> refs;
+				localRefs(expr, inner, refs);
+
+				const Local *ret = nullptr;
+
+				for(auto binding : refs){
+					if(inner.count(binding)) continue;
+
+					auto res = locals.find(binding);
+					if(res == end(locals)) continue;
+
+					auto local = &res->second;
+					if(!ret || (local->depth > ret->depth) || ((local->depth == ret->depth) && (local->index > ret->index))){
+						ret = local;
+					}
+				}
+
+				return ret;
+			}
+
+			//! Collect the bindings \p expr refers to and the ones it makes itself
+			static void localRefs(LemniTypedExpr expr, std::unordered_set<LemniTypedBindingExpr> &inner, std::vector<LemniTypedBindingExpr> &refs){
+				if(!expr) return;
+
+				if(dynamic_cast<LemniTypedRefExpr>(expr)){
+					if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr->deref())){
+						refs.emplace_back(binding);
+					}
+
+					return;
+				}
+				else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+					inner.insert(binding);
+				}
+
+				std::vector<LemniTypedExpr> children;
+				expr->children(children);
+
+				for(auto child : children){
+					localRefs(child, inner, refs);
+				}
+			}
+
+			bool isCandidate(LemniTypedExpr expr){
+				if(cost(expr) < minCost) return false;
+				else if(lemniTypeAsFunction(expr->type())) return false;
+				else return effects && (lemniEffectOf(effects, expr) == LEMNI_EFFECT_PURE);
+			}
+
+			void count(LemniTypedExpr expr){
+				if(!expr) return;
+
+				auto &&current = regions.back();
+
+				if(auto branch = dynamic_cast<LemniTypedBranchExpr>(expr)){
+					// only the condition is always evaluated
+					count(branch->cond);
+					return;
+				}
+				else if(auto block = dynamic_cast<LemniTypedBlockExpr>(expr)){
+					++current.blockDepth;
+
+					for(std::size_t i = 0; i < block->exprs.size(); i++){
+						if(auto binding = dynamic_cast<LemniTypedBindingExpr>(block->exprs[i])){
+							current.locals[binding] = Local{ block, i, current.blockDepth };
+						}
+
+						count(block->exprs[i]);
+					}
+
+					--current.blockDepth;
+					return;
+				}
+				else if(
+					dynamic_cast<LemniTypedLambdaExpr>(expr) ||
+					dynamic_cast<LemniTypedRefExpr>(expr) ||
+					dynamic_cast<LemniTypedFnDefExpr>(expr) ||
+					dynamic_cast<LemniTypedExportExpr>(expr)
+				){
+					return;
+				}
+
+				bool candidate = isCandidate(expr);
+
+				if(candidate && (++current.counts[number(expr)] > 1)){
+					return;
+				}
+
+				std::vector<LemniTypedExpr> children;
+				expr->children(children);
+
+				for(auto child : children){
+					count(child);
+				}
+
+				if(candidate){
+					current.order.emplace_back(expr);
+				}
+			}
+
+			LemniTypecheckState state;
+			LemniEffectState effects;
+			std::vector<Region> regions;
+			std::map<Key, std::size_t> numbers;
+			std::unordered_map<LemniTypedExpr, std::size_t> exprNumbers;
+			std::unordered_map<LemniTypedExpr, std::uint32_t> costs;
+			std::size_t nextTemp = 0;
+	};
+}
+
+namespace {
+	using Substitution = std::unordered_map<LemniTypedExpr, LemniTypedExpr>;
+
+	//! Copy \p expr replacing parameters, local bindings get fresh nodes so every copy has its own
+	LemniTypedExpr substitute(LemniTypecheckState state, LemniTypedExpr expr, Substitution &subst){
+		if(!expr) return expr;
+
+		if(dynamic_cast<LemniTypedRefExpr>(expr) || dynamic_cast<LemniTypedParamBindingExpr>(expr)){
+			auto res = subst.find(expr->deref());
+			if(res == end(subst)) return expr;
+			else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(res->second)){
+				return createTypedExpr<LemniTypedRefExprT>(state, binding);
+			}
+			else{
+				return res->second;
+			}
+		}
+		else if(auto binding = dynamic_cast<LemniTypedBindingExpr>(expr)){
+			auto res = subst.find(binding);
+			if(res != end(subst)) return res->second;
+
+			auto newBinding = createTypedExpr<LemniTypedBindingExprT>(state, std::string(binding->id()), substitute(state, binding->value, subst));
+			subst[binding] = newBinding;
+			return newBinding;
+		}
+		else if(auto unaryOp = dynamic_cast<LemniTypedUnaryOpExpr>(expr)){
+			auto value = substitute(state, unaryOp->value, subst);
+			if(value == unaryOp->value) return expr;
+
+			auto resultType = lemniUnaryOpResultType(state->types, value->type(), unaryOp->op);
+			if(!resultType) resultType = unaryOp->resultType;
+
+			return createTypedExpr<LemniTypedUnaryOpExprT>(state, resultType, unaryOp->op, value);
+		}
+		else if(auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(expr)){
+			auto lhs = substitute(state, binaryOp->lhs, subst);
+			auto rhs = substitute(state, binaryOp->rhs, subst);
+			if((lhs == binaryOp->lhs) && (rhs == binaryOp->rhs)) return expr;
+
+			// specialize the result type for the argument types
+			auto resultType = lemniBinaryOpResultType(state->types, lhs->type(), rhs->type(), binaryOp->op);
+			if(!resultType) resultType = binaryOp->resultType;
+
+			return createTypedExpr<LemniTypedBinaryOpExprT>(state, resultType, binaryOp->op, lhs, rhs);
+		}
+		else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(expr)){
+			bool changed = false;
+
+			std::vector<LemniTypedExpr> operands;
+			operands.reserve(nary->operands.size());
+
+			for(auto operand : nary->operands){
+				auto newOperand = operands.emplace_back(substitute(state, operand, subst));
+				changed = changed || (newOperand != operand);
+			}
+
+			if(!changed) return expr;
+
+			// specialize the result type for the argument types
+			auto resultType = operands[0]->type();
+
+			for(std::size_t i = 1; resultType && (i < operands.size()); i++){
+				resultType = lemniBinaryOpResultType(state->types, resultType, operands[i]->type(), nary->op);
+			}
+
+			if(!resultType) resultType = nary->resultType;
+
+			return createTypedExpr<LemniTypedNAryOpExprT>(state, resultType, nary->op, std::move(operands));
+		}
+		else{
+			return rebuild(state, expr, [state, &subst](LemniTypedExpr child){ return substitute(state, child, subst); });
+		}
+	}
+
+	//! Count the nodes of a function body, fails on anything that can not be copied by \ref substitute
+	bool measureBody(LemniTypedExpr expr, std::uint32_t &cost, const std::uint32_t maxCost){
+		if(!expr) return true;
+		else if(++cost > maxCost) return false;
+		else if(dynamic_cast<LemniTypedRefExpr>(expr)) return true;
+		else if(
+			dynamic_cast<LemniTypedLambdaExpr>(expr) ||
+			dynamic_cast<LemniTypedFnDefExpr>(expr) ||
+			dynamic_cast<LemniTypedExportExpr>(expr) ||
+			dynamic_cast<const LemniTypedUnresolvedRefExprT*>(expr)
+		){
+			return false;
+		}
+
+		std::vector<LemniTypedExpr> children;
+		expr->children(children);
+
+		for(auto child : children){
+			if(!measureBody(child, cost, maxCost)) return false;
+		}
+
+		return true;
+	}
+
+	std::uint32_t numUses(LemniTypedExpr expr, LemniTypedParamBindingExpr param){
+		if(!expr) return 0;
+		else if(expr == param) return 1;
+		else if(dynamic_cast<LemniTypedRefExpr>(expr)) return (expr->deref() == param) ? 1 : 0;
+
+		std::vector<LemniTypedExpr> children;
+		expr->children(children);
+
+		std::uint32_t ret = 0;
+
+		for(auto child : children){
+			ret += numUses(child, param);
+		}
+
+		return ret;
+	}
+
+	bool isTrivial(LemniTypedExpr expr){
+		return dynamic_cast<LemniTypedConstantExpr>(expr) || dynamic_cast<LemniTypedLValueExpr>(expr);
+	}
+
+	/**
+	 * Map \p param to \p arg for substituting into \p body.
+	 * Arguments that would be evaluated more than once are bound in \p exprs first.
+	 */
+	void bindArgument(
+		LemniTypecheckState state, LemniTypedExpr body, LemniTypedParamBindingExpr param, LemniTypedExpr arg,
+		const std::string &tempName, Substitution &subst, std::vector<LemniTypedExpr> &exprs
+	){
+		if(isTrivial(arg) || (numUses(body, param) <= 1)){
+			subst[param] = arg;
+		}
+		else{
+			auto binding = createTypedExpr<LemniTypedBindingExprT>(state, tempName, arg);
+			exprs.emplace_back(binding);
+			subst[param] = createTypedExpr<LemniTypedRefExprT>(state, binding);
+		}
+	}
+
+	//! Check if \p fnDef can reach itself, references are followed into the definitions they refer to
+	bool isRecursive(LemniTypedFnDefExpr fnDef){
+		std::unordered_set<LemniTypedExpr> visited;
+		std::vector<LemniTypedExpr> pending{ fnDef->lambda->body };
+
+		while(!pending.empty()){
+			auto expr = pending.back();
+			pending.pop_back();
+
+			if(expr == fnDef) return true;
+			else if(!expr || !visited.insert(expr).second) continue;
+
+			expr->children(pending);
+		}
+
+		return false;
+	}
+
+	/**
+	 * Inliner for calls of known function definitions.
+	 *
+	 * A definition is inlined if its body is at most \ref maxCost nodes, calling it is pure and it can not
+	 * reach itself through the call graph. Bodies containing lambdas or nested definitions are never inlined.
+	 */
+	class Inliner{
+		public:
+			static constexpr std::uint32_t maxCost = 16;
+			static constexpr std::uint32_t maxDepth = 8;
+
+			explicit Inliner(LemniTypecheckState state_) noexcept
+				: state(state_), effects(typecheckEffects(state_)){}
+
+			LemniTypedExpr run(LemniTypedExpr expr, const std::uint32_t depth = 0){
+				if(!expr) return expr;
+
+				auto rebuilt = rebuild(state, expr, [this, depth](LemniTypedExpr child){ return run(child, depth); });
+
+				if(auto app = dynamic_cast<LemniTypedApplicationExpr>(rebuilt)){
+					if(auto inlined = tryInline(app, depth)){
+						return inlined;
+					}
+				}
+
+				return rebuilt;
+			}
+
+		private:
+			LemniTypedExpr tryInline(LemniTypedApplicationExpr app, const std::uint32_t depth){
+				if(depth >= maxDepth) return nullptr;
+
+				auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(app->fn->deref());
+				if(!fnDef || !isInlinable(fnDef)) return nullptr;
+
+				auto lambda = fnDef->lambda;
+				if(app->args.size() != lambda->params.size()) return nullptr;
+
+				Substitution subst;
+				std::vector<LemniTypedExpr> exprs;
+
+				for(std::size_t i = 0; i < app->args.size(); i++){
+					bindArgument(state, lambda->body, lambda->params[i], app->args[i], fmt::format("$inl{}", nextTemp++), subst, exprs);
+				}
+
+				auto body = run(substitute(state, lambda->body, subst), depth + 1);
+
+				if(exprs.empty()) return body;
+
+				exprs.emplace_back(body);
+				return createTypedExpr<LemniTypedBlockExprT>(state, body->type(), std::move(exprs));
+			}
+
+			bool isInlinable(LemniTypedFnDefExpr fnDef){
+				auto res = inlinable.find(fnDef);
+				if(res != end(inlinable)) return res->second;
+
+				// assume not while checking, in case the callee is reached again
+				inlinable[fnDef] = false;
+
+				std::uint32_t cost = 0;
+				bool ret = measureBody(fnDef->lambda->body, cost, maxCost);
+
+				ret = ret && effects && (lemniEffectOfCall(effects, fnDef) == LEMNI_EFFECT_PURE);
+				ret = ret && !isRecursive(fnDef);
+
+				inlinable[fnDef] = ret;
+				return ret;
+			}
+
+			LemniTypecheckState state;
+			LemniEffectState effects;
+			std::unordered_map<LemniTypedFnDefExpr, bool> inlinable;
+			std::size_t nextTemp = 0;
+	};
+}
+
+namespace {
+	/**
+	 * Fusion of nested single argument calls of known functions.
+	 *
+	 * A chain such as ``f (g (h x))`` is replaced by a call of one synthesized definition ``f.g.h`` whose body
+	 * nests the bodies of every function in the chain, so evaluating the chain takes a single call.
+	 * Occurrences of the same chain share the synthesized definition.
+	 */
+	class ChainFuser{
+		public:
+			static constexpr std::uint32_t maxCost = 64;
+
+			explicit ChainFuser(LemniTypecheckState state_) noexcept
+				: state(state_), effects(typecheckEffects(state_)){}
+
+			LemniTypedExpr run(LemniTypedExpr expr){
+				if(!expr) return expr;
+
+				if(auto app = dynamic_cast<LemniTypedApplicationExpr>(expr)){
+					std::vector<LemniTypedFnDefExpr> chain;
+
+					LemniTypedExpr arg = app;
+
+					while(auto link = chainLink(arg)){
+						chain.emplace_back(link);
+						arg = dynamic_cast<LemniTypedApplicationExpr>(arg)->args[0];
+					}
+
+					if(chain.size() > 1){
+						if(auto fused = fuse(chain)){
+							auto fnRef = createTypedExpr<LemniTypedRefExprT>(state, fused);
+							return createTypedExpr<LemniTypedApplicationExprT>(state, app->resultType, fnRef, std::vector<LemniTypedExpr>{ run(arg) });
+						}
+					}
+				}
+
+				return rebuild(state, expr, [this](LemniTypedExpr child){ return run(child); });
+			}
+
+		private:
+			//! Get the function of a fusable single argument call
+			LemniTypedFnDefExpr chainLink(LemniTypedExpr expr){
+				auto app = dynamic_cast<LemniTypedApplicationExpr>(expr);
+				if(!app || (app->args.size() != 1)) return nullptr;
+
+				auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(app->fn->deref());
+				if(!fnDef || (fnDef->lambda->params.size() != 1)) return nullptr;
+
+				auto res = fusable.find(fnDef);
+				if(res != end(fusable)) return res->second ? fnDef : nullptr;
+
+				std::uint32_t cost = 0;
+
+				// components may be moved or dropped by substitution, so they must be pure
+				bool ret = measureBody(fnDef->lambda->body, cost, maxCost);
+				ret = ret && effects && (lemniEffectOfCall(effects, fnDef) == LEMNI_EFFECT_PURE);
+				ret = ret && !isRecursive(fnDef);
+
+				fusable[fnDef] = ret;
+				return ret ? fnDef : nullptr;
+			}
+
+			//! Synthesize the definition for a chain, outermost function first
+			LemniTypedFnDefExpr fuse(const std::vector<LemniTypedFnDefExpr> &chain){
+				auto res = fused.find(chain);
+				if(res != end(fused)) return res->second;
+
+				std::uint32_t cost = 0;
+
+				for(auto fnDef : chain){
+					if(!measureBody(fnDef->lambda->body, cost, maxCost)){
+						fused[chain] = nullptr;
+						return nullptr;
+					}
+				}
+
+				auto innerParam = chain.back()->lambda->params[0];
+				auto param = createTypedExpr<LemniTypedParamBindingExprT>(state, std::string(innerParam->id()), innerParam->type());
+
+				LemniTypedExpr body = createTypedExpr<LemniTypedRefExprT>(state, param);
+
+				for(auto it = rbegin(chain); it != rend(chain); ++it){
+					auto lambda = (*it)->lambda;
+
+					Substitution subst;
+					std::vector<LemniTypedExpr> exprs;
+
+					bindArgument(state, lambda->body, lambda->params[0], body, fmt::format("$fuse{}", nextTemp++), subst, exprs);
+
+					body = substitute(state, lambda->body, subst);
+
+					if(!exprs.empty()){
+						exprs.emplace_back(body);
+						body = createTypedExpr<LemniTypedBlockExprT>(state, body->type(), std::move(exprs));
+					}
+				}
+
+				std::string name(chain.front()->id());
+
+				for(auto it = std::next(begin(chain)); it != end(chain); ++it){
+					name += fmt::format(".{}", (*it)->id());
+				}
+
+				auto lambda = createTypedExpr<LemniTypedLambdaExprT>(state, state->types, std::vector<LemniTypedParamBindingExpr>{ param }, body);
+				auto fnDef = createTypedExpr<LemniTypedFnDefExprT>(state, std::move(name), lambda);
+
+				fused[chain] = fnDef;
+				return fnDef;
+			}
+
+			LemniTypecheckState state;
+			LemniEffectState effects;
+			std::unordered_map<LemniTypedFnDefExpr, bool> fusable;
+			std::map<std::vector<LemniTypedFnDefExpr>, LemniTypedFnDefExpr> fused;
+			std::size_t nextTemp = 0;
+	};
+}
+
+namespace {
+	/**
+	 * Flattening of associative operator chains.
+	 *
+	 * A chain such as ``a + b + c + d`` of one operator becomes a single n-ary op that evaluates into one
+	 * accumulator instead of allocating a value per step. Left nested chains keep their evaluation order, so
+	 * any operator flattens. Right nested chains are only reassociated, and constants only gathered, where
+	 * the result type makes the operator exact; reals are never reordered.
+	 *
+	 * Static result types widen at every level of an arithmetic chain, so exact chains gather every level
+	 * of the same numeric kind and accumulate in the outermost result type, like the n-ary op compiles.
+	 * Other chains only gather levels of exactly the outer result type.
+	 */
+	class Flattener{
+		public:
+			explicit Flattener(LemniTypecheckState state_) noexcept
+				: state(state_){}
+
+			LemniTypedExpr run(LemniTypedExpr expr){
+				if(!expr) return expr;
+
+				auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(expr);
+				if(!binaryOp || !isAssociative(binaryOp->op)){
+					return rebuild(state, expr, [this](LemniTypedExpr child){ return run(child); });
+				}
+
+				auto op = binaryOp->op;
+				auto resultType = binaryOp->resultType;
+				bool exact = isExact(op, resultType);
+
+				std::vector<LemniTypedExpr> operands;
+				gather(op, resultType, exact, binaryOp, operands);
+
+				for(auto &operand : operands){
+					operand = run(operand);
+				}
+
+				foldConstants(op, resultType, exact, operands);
+
+				if(operands.size() == 1) return operands[0];
+				else if(operands.size() == 2) return createTypedExpr<LemniTypedBinaryOpExprT>(state, resultType, op, operands[0], operands[1]);
+				else return createTypedExpr<LemniTypedNAryOpExprT>(state, resultType, op, std::move(operands));
+			}
+
+		private:
+			static bool isAssociative(LemniBinaryOp op) noexcept{
+				switch(op){
+					case LEMNI_BINARY_ADD:
+					case LEMNI_BINARY_MUL:
+					case LEMNI_BINARY_AND:
+					case LEMNI_BINARY_OR:
+					case LEMNI_BINARY_CONCAT:
+						return true;
+
+					default: return false;
+				}
+			}
+
+			static bool isCommutative(LemniBinaryOp op) noexcept{
+				return op != LEMNI_BINARY_CONCAT;
+			}
+
+			//! Whether \p op is associative for values of \p type regardless of grouping
+			static bool isExact(LemniBinaryOp op, LemniType type) noexcept{
+				switch(op){
+					case LEMNI_BINARY_ADD:
+					case LEMNI_BINARY_MUL:
+						return lemniTypeAsNat(type) || lemniTypeAsInt(type) || lemniTypeAsRatio(type);
+
+					case LEMNI_BINARY_AND:
+					case LEMNI_BINARY_OR:
+						return lemniTypeAsBool(type) || lemniTypeAsNat(type) || lemniTypeAsInt(type);
+
+					case LEMNI_BINARY_CONCAT:
+						return true;
+
+					default: return false;
+				}
+			}
+
+			static bool isSameKind(LemniType a, LemniType b) noexcept{
+				return
+					(lemniTypeAsNat(a) && lemniTypeAsNat(b)) ||
+					(lemniTypeAsInt(a) && lemniTypeAsInt(b)) ||
+					(lemniTypeAsRatio(a) && lemniTypeAsRatio(b)) ||
+					(lemniTypeAsBool(a) && lemniTypeAsBool(b));
+			}
+
+			//! Whether a level of result type \p type can be accumulated in \p resultType
+			static bool isGatherable(LemniType type, LemniType resultType, bool exact) noexcept{
+				if(type == resultType) return true;
+				return exact && isSameKind(type, resultType) && lemniTypeIsCastable(type, resultType);
+			}
+
+			//! Collect the operands of a chain in evaluation order
+			void gather(LemniBinaryOp op, LemniType resultType, bool exact, LemniTypedExpr expr, std::vector<LemniTypedExpr> &out){
+				auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(expr);
+				if(!binaryOp || (binaryOp->op != op) || !isGatherable(binaryOp->resultType, resultType, exact)){
+					out.emplace_back(expr);
+					return;
+				}
+
+				gather(op, resultType, exact, binaryOp->lhs, out);
+
+				if(exact) gather(op, resultType, exact, binaryOp->rhs, out);
+				else out.emplace_back(binaryOp->rhs);
+			}
+
+			/**
+			 * Fold constant operands at compile time.
+			 * Commutative exact operators gather every constant into the position of the first one,
+			 * other exact operators fold runs of adjacent constants and the rest only fold a leading run.
+			 */
+			void foldConstants(LemniBinaryOp op, LemniType resultType, bool exact, std::vector<LemniTypedExpr> &operands){
+				auto isConstant = [](LemniTypedExpr expr){ return dynamic_cast<LemniTypedConstantExpr>(expr) != nullptr; };
+
+				if(exact && isCommutative(op)){
+					auto first = std::find_if(begin(operands), end(operands), isConstant);
+					if(first == end(operands)) return;
+
+					// constants have no effects, so moving them next to each other can't reorder effects
+					auto constEnd = std::stable_partition(first, end(operands), isConstant);
+					foldRange(op, resultType, operands, first - begin(operands), constEnd - begin(operands));
+					return;
+				}
+
+				for(std::size_t i = 0; i < operands.size(); i++){
+					if(!isConstant(operands[i])){
+						if(!exact) return;
+						continue;
+					}
+
+					auto runEnd = i + 1;
+					while((runEnd < operands.size()) && isConstant(operands[runEnd])) ++runEnd;
+
+					if(!foldRange(op, resultType, operands, i, runEnd)) i = runEnd - 1;
+				}
+			}
+
+			//! Replace the operands ``[first, last)`` with their evaluated result if it has a literal form
+			bool foldRange(LemniBinaryOp op, LemniType resultType, std::vector<LemniTypedExpr> &operands, std::size_t first, std::size_t last){
+				if((last - first) < 2) return false;
+
+				LemniTypedExpr folded = nullptr;
+
+				if((last - first) == 2){
+					folded = createTypedExpr<LemniTypedBinaryOpExprT>(state, resultType, op, operands[first], operands[first + 1]);
+				}
+				else{
+					std::vector<LemniTypedExpr> constants(begin(operands) + first, begin(operands) + last);
+					folded = createTypedExpr<LemniTypedNAryOpExprT>(state, resultType, op, std::move(constants));
+				}
+
+				auto literal = typecheckComptimeEval(state, folded);
+				if(!literal) return false;
+
+				operands[first] = literal;
+				operands.erase(begin(operands) + first + 1, begin(operands) + last);
+				return true;
+			}
+
+			LemniTypecheckState state;
+	};
+}
+
+LemniTypedExpr lemniOptimizeCSE(LemniTypecheckState state, LemniTypedExpr expr){
+	if(!state || !expr) return expr;
+
+	auto ownerScope = PseudoOwnerScope(state);
+	auto cse = CommonSubexprs(state);
+
+	if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(expr)){
+		return rebuild(state, fnDef, [&cse](LemniTypedExpr lambda){ return cse.rewrite(lambda); });
+	}
+	else{
+		return cse.region(expr);
+	}
+}
+
+LemniTypedExpr lemniOptimizeInline(LemniTypecheckState state, LemniTypedExpr expr){
+	if(!state || !expr) return expr;
+
+	auto ownerScope = PseudoOwnerScope(state);
+	auto inliner = Inliner(state);
+
+	return inliner.run(expr);
+}
+
+LemniTypedExpr lemniOptimizeFuseChains(LemniTypecheckState state, LemniTypedExpr expr){
+	if(!state || !expr) return expr;
+
+	auto ownerScope = PseudoOwnerScope(state);
+	auto fuser = ChainFuser(state);
+
+	return fuser.run(expr);
+}
+
+LemniTypedExpr lemniOptimizeFlatten(LemniTypecheckState state, LemniTypedExpr expr){
+	if(!state || !expr) return expr;
+
+	auto ownerScope = PseudoOwnerScope(state);
+	auto flattener = Flattener(state);
+
+	return flattener.run(expr);
+}
@@ -0,0 +1,179 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "fmt/format.h"
+
+#include "lemni/typecheck.h"
+
+#include "typecheck.hpp"
+
+namespace {
+	using Profile = LemniTypecheckStateT::Profile;
+
+	std::vector<const Profile::Definition*> sortedDefs(const Profile &profile){
+		std::vector<const Profile::Definition*> ret;
+		ret.reserve(profile.defs.size());
+
+		for(auto &&def : profile.defs){
+			ret.emplace_back(&def);
+		}
+
+		std::stable_sort(begin(ret), end(ret), [](auto lhs, auto rhs){ return lhs->time > rhs->time; });
+
+		return ret;
+	}
+
+	std::vector<std::pair<std::string_view, LemniNat64>> sortedSpecializations(const Profile &profile){
+		std::vector<std::pair<std::string_view, LemniNat64>> ret(begin(profile.specializations), end(profile.specializations));
+
+		std::stable_sort(begin(ret), end(ret), [](auto &&lhs, auto &&rhs){ return lhs.second > rhs.second; });
+
+		return ret;
+	}
+
+	double toMillis(std::chrono::nanoseconds time){
+		return std::chrono::duration<double, std::milli>(time).count();
+	}
+
+	std::string jsonStr(std::string_view str){
+		std::string ret = "\"";
+
+		for(auto c : str){
+			switch(c){
+				case '"': ret += "\\\""; break;
+				case '\\': ret += "\\\\"; break;
+				case '\n': ret += "\\n"; break;
+				case '\t': ret += "\\t"; break;
+				default:
+					if(static_cast<unsigned char>(c) < 0x20) ret += fmt::format("\\u{:04x}", int(c));
+					else ret += c;
+					break;
+			}
+		}
+
+		ret += '"';
+		return ret;
+	}
+
+	std::string jsonCounters(const Profile::Counters &counters){
+		return fmt::format(
+			"\"allocs\":{},\"bytes\":{},\"pseudos\":{},\"lookups\":{},\"specializations\":{}",
+			counters.numAllocs, counters.numBytes, counters.numPseudos, counters.numLookups, counters.numSpecializations
+		);
+	}
+}
+
+void lemniTypecheckStateSetProfiling(LemniTypecheckState state, const bool enabled){
+	if(!enabled) state->profile.reset();
+	else if(!state->profile) state->profile = std::make_unique<Profile>();
+}
+
+void lemniTypecheckStateResetProfile(LemniTypecheckState state){
+	if(!state->profile) return;
+
+	auto depth = state->profile->depth;
+	auto pseudosCounted = state->profile->pseudosCounted;
+	*state->profile = Profile();
+	state->profile->depth = depth;
+	state->profile->pseudosCounted = pseudosCounted;
+}
+
+LemniStr lemniTypecheckProfileReport(LemniTypecheckStateConst state){
+	if(!state->profile) return LemniStr{ nullptr, 0 };
+
+	auto &&profile = *state->profile;
+
+	std::chrono::nanoseconds totalTime(0);
+
+	for(auto &&def : profile.defs){
+		totalTime += def.time;
+	}
+
+	auto &&report = profile.report;
+
+	report = fmt::format(
+		"{:<32} {:>12} {:>10} {:>12} {:>8} {:>8} {:>8}\n",
+		"definition", "time (ms)", "allocs", "bytes", "pseudos", "lookups", "specs"
+	);
+
+	for(auto def : sortedDefs(profile)){
+		report += fmt::format(
+			"{:<32} {:>12.3f} {:>10} {:>12} {:>8} {:>8} {:>8}\n",
+			def->name, toMillis(def->time),
+			def->counters.numAllocs, def->counters.numBytes, def->counters.numPseudos,
+			def->counters.numLookups, def->counters.numSpecializations
+		);
+	}
+
+	report += fmt::format(
+		"{:<32} {:>12.3f} {:>10} {:>12} {:>8} {:>8} {:>8}\n",
+		"total", toMillis(totalTime),
+		profile.totals.numAllocs, profile.totals.numBytes, profile.totals.numPseudos,
+		profile.totals.numLookups, profile.totals.numSpecializations
+	);
+
+	if(!profile.specializations.empty()){
+		report += fmt::format("\n{:<32} {:>8}\n", "function", "specs");
+
+		for(auto &&spec : sortedSpecializations(profile)){
+			report += fmt::format("{:<32} {:>8}\n", spec.first, spec.second);
+		}
+	}
+
+	return LemniStr{ report.c_str(), report.size() };
+}
+
+LemniStr lemniTypecheckProfileJSON(LemniTypecheckStateConst state){
+	if(!state->profile) return LemniStr{ nullptr, 0 };
+
+	auto &&profile = *state->profile;
+
+	auto &&report = profile.report;
+
+	report = "{\"definitions\":[";
+
+	bool first = true;
+
+	for(auto def : sortedDefs(profile)){
+		if(!first) report += ',';
+		first = false;
+
+		report += fmt::format(
+			"{{\"name\":{},\"timeNs\":{},{}}}",
+			jsonStr(def->name), def->time.count(), jsonCounters(def->counters)
+		);
+	}
+
+	report += "],\"specializations\":[";
+
+	first = true;
+
+	for(auto &&spec : sortedSpecializations(profile)){
+		if(!first) report += ',';
+		first = false;
+
+		report += fmt::format("{{\"function\":{},\"count\":{}}}", jsonStr(spec.first), spec.second);
+	}
+
+	report += fmt::format("],\"totals\":{{{}}}}}", jsonCounters(profile.totals));
+
+	return LemniStr{ report.c_str(), report.size() };
+}
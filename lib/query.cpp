@@ -0,0 +1,719 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "fmt/format.h"
+
+#include "lemni/lex.h"
+#include "lemni/parse.h"
+#include "lemni/query.h"
+
+#include "Expr.hpp"
+#include "typecheck.hpp"
+
+namespace {
+	using Revision = LemniNat64;
+
+	enum class QueryKind{
+		source, tokens, parsed, names, defExpr, typedDef
+	};
+
+	struct QueryKey{
+		QueryKind kind;
+		std::string file;
+		std::string name;
+
+		bool operator<(const QueryKey &rhs) const noexcept{
+			if(kind != rhs.kind) return kind < rhs.kind;
+			if(file != rhs.file) return file < rhs.file;
+			return name < rhs.name;
+		}
+
+		bool operator==(const QueryKey &rhs) const noexcept{
+			return kind == rhs.kind && file == rhs.file && name == rhs.name;
+		}
+	};
+
+	struct Slot{
+		std::shared_ptr<const void> value;
+		std::size_t fingerprint = 0;
+		Revision changedAt = 0;
+		Revision verifiedAt = 0;
+		std::vector<QueryKey> deps;
+		bool active = false;
+	};
+
+	struct QueryError{
+		LemniLocation loc = LemniLocation{ UINT32_MAX, UINT32_MAX };
+		std::string msg;
+	};
+
+	struct TokensValue{
+		std::shared_ptr<const std::string> src;
+		std::vector<LemniToken> toks;
+		std::vector<std::size_t> tokFingerprints;
+		std::unique_ptr<QueryError> error;
+	};
+
+	struct ParsedValue{
+		struct Def{
+			std::string name;
+			LemniExpr expr;
+			std::size_t fingerprint;
+		};
+
+		ParsedValue(): parseState(lemniCreateParseState(), lemniDestroyParseState){}
+
+		std::shared_ptr<const TokensValue> tokens;
+		std::unique_ptr<LemniParseStateT, void(*)(LemniParseState)> parseState;
+		std::vector<Def> defs;
+		std::unique_ptr<QueryError> error;
+	};
+
+	struct NamesValue{
+		std::vector<std::string> names;
+		std::vector<LemniStr> strs;
+		std::unique_ptr<QueryError> error;
+	};
+
+	struct DefExprValue{
+		std::shared_ptr<const ParsedValue> parsed;
+		LemniExpr expr = nullptr;
+		std::unique_ptr<QueryError> error;
+	};
+
+	struct TypedDefValue{
+		LemniTypedExpr expr = nullptr;
+		std::unique_ptr<QueryError> error;
+	};
+
+	inline std::size_t hashCombine(std::size_t seed, std::size_t value) noexcept{
+		return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+	}
+
+	inline std::size_t hashStr(std::string_view str) noexcept{ return std::hash<std::string_view>{}(str); }
+
+	std::unique_ptr<QueryError> copyError(const std::unique_ptr<QueryError> &error){
+		return std::make_unique<QueryError>(*error);
+	}
+}
+
+struct LemniQueryEngineT{
+	//! Typechecking state of a single file
+	struct FileState{
+		~FileState(){ if(state) lemniDestroyTypecheckState(state); }
+
+		LemniQueryEngine engine;
+		std::string file;
+		LemniTypecheckState state = nullptr;
+	};
+
+	LemniModuleMap mods;
+	Revision revision = 1;
+	std::map<QueryKey, Slot> slots;
+	std::vector<QueryKey> stack;
+	std::map<std::string, std::unique_ptr<FileState>, std::less<>> files;
+	std::set<std::string> superseded; //!< files with typed definitions replaced since the last reclaim
+	LemniQueryStats stats = { 0, 0, 0 };
+};
+
+namespace {
+	std::shared_ptr<const void> demand(LemniQueryEngine engine, const QueryKey &key);
+
+	template<typename T>
+	std::shared_ptr<const T> demandAs(LemniQueryEngine engine, const QueryKey &key){
+		return std::static_pointer_cast<const T>(demand(engine, key));
+	}
+
+	struct Computed{
+		std::shared_ptr<const void> value;
+		std::size_t fingerprint;
+	};
+
+	Computed computeTokens(LemniQueryEngine engine, const QueryKey &key){
+		auto ret = std::make_shared<TokensValue>();
+
+		ret->src = demandAs<std::string>(engine, QueryKey{ QueryKind::source, key.file, {} });
+
+		if(!ret->src){
+			ret->error = std::make_unique<QueryError>(QueryError{ LemniLocation{ UINT32_MAX, UINT32_MAX }, fmt::format("no source for file '{}'", key.file) });
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		auto lexState = lemni::LexState(std::string_view(*ret->src));
+
+		std::size_t fingerprint = 0;
+
+		while(lemniLexStateRemainder(lexState).len > 0){
+			auto lexRes = lemniLex(lexState);
+			if(lexRes.hasError){
+				ret->error = std::make_unique<QueryError>(QueryError{ lexRes.error.loc, lemni::toStdStr(lexRes.error.msg) });
+				return { ret, hashStr(ret->error->msg) };
+			}
+
+			// locations are left out so edits that only move tokens are cut off early
+			auto tokFingerprint = hashCombine(std::size_t(lexRes.token.type), hashStr(lemni::toStdStrView(lexRes.token.text)));
+
+			ret->toks.emplace_back(lexRes.token);
+			ret->tokFingerprints.emplace_back(tokFingerprint);
+
+			fingerprint = hashCombine(fingerprint, tokFingerprint);
+		}
+
+		return { ret, fingerprint };
+	}
+
+	Computed computeParsed(LemniQueryEngine engine, const QueryKey &key){
+		auto ret = std::make_shared<ParsedValue>();
+
+		ret->tokens = demandAs<TokensValue>(engine, QueryKey{ QueryKind::tokens, key.file, {} });
+
+		auto &&tokens = *ret->tokens;
+
+		if(tokens.error){
+			ret->error = copyError(tokens.error);
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		std::size_t fingerprint = 0;
+
+		LemniNat64 numToksRem = tokens.toks.size();
+		const LemniToken *toksRem = tokens.toks.data();
+
+		while(numToksRem > 0){
+			auto startIdx = std::size_t(toksRem - tokens.toks.data());
+
+			auto parseRes = lemniParse(ret->parseState.get(), numToksRem, toksRem);
+			if(parseRes.hasError){
+				ret->error = std::make_unique<QueryError>(QueryError{ parseRes.error.loc, lemni::toStdStr(parseRes.error.msg) });
+				return { ret, hashStr(ret->error->msg) };
+			}
+
+			numToksRem = parseRes.res.numRem;
+			toksRem = parseRes.res.rem;
+
+			auto endIdx = std::size_t(toksRem - tokens.toks.data());
+
+			std::size_t defFingerprint = 0;
+
+			for(auto i = startIdx; i < endIdx; i++){
+				defFingerprint = hashCombine(defFingerprint, tokens.tokFingerprints[i]);
+			}
+
+			auto expr = parseRes.res.expr;
+
+			std::string name;
+
+			if(dynamic_cast<const LemniFnDefExprT*>(expr) || dynamic_cast<const LemniBindingExprT*>(expr)){
+				name = dynamic_cast<const LemniLValueExprT*>(expr)->id;
+			}
+			else{
+				name = fmt::format("${}", ret->defs.size());
+			}
+
+			fingerprint = hashCombine(fingerprint, defFingerprint);
+
+			ret->defs.emplace_back(ParsedValue::Def{ std::move(name), expr, defFingerprint });
+		}
+
+		return { ret, fingerprint };
+	}
+
+	Computed computeNames(LemniQueryEngine engine, const QueryKey &key){
+		auto ret = std::make_shared<NamesValue>();
+
+		auto parsed = demandAs<ParsedValue>(engine, QueryKey{ QueryKind::parsed, key.file, {} });
+
+		if(parsed->error){
+			ret->error = copyError(parsed->error);
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		std::size_t fingerprint = 0;
+
+		ret->names.reserve(parsed->defs.size());
+
+		for(auto &&def : parsed->defs){
+			ret->names.emplace_back(def.name);
+			fingerprint = hashCombine(fingerprint, hashStr(def.name));
+		}
+
+		ret->strs.reserve(ret->names.size());
+
+		for(auto &&name : ret->names){
+			ret->strs.emplace_back(lemni::fromStdStrView(name));
+		}
+
+		return { ret, fingerprint };
+	}
+
+	Computed computeDefExpr(LemniQueryEngine engine, const QueryKey &key){
+		auto ret = std::make_shared<DefExprValue>();
+
+		ret->parsed = demandAs<ParsedValue>(engine, QueryKey{ QueryKind::parsed, key.file, {} });
+
+		if(ret->parsed->error){
+			ret->error = copyError(ret->parsed->error);
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		auto &&defs = ret->parsed->defs;
+
+		auto res = std::find_if(begin(defs), end(defs), [&key](auto &&def){ return def.name == key.name; });
+		if(res == end(defs)){
+			ret->error = std::make_unique<QueryError>(QueryError{ LemniLocation{ UINT32_MAX, UINT32_MAX }, fmt::format("no definition named '{}'", key.name) });
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		ret->expr = res->expr;
+
+		return { ret, res->fingerprint };
+	}
+
+	//! Resolve names in a file through the typed definition query, recording the dependency
+	LemniTypedLValueExpr resolveDefinition(void *user, LemniStr name){
+		auto fileState = reinterpret_cast<LemniQueryEngineT::FileState*>(user);
+
+		auto typed = demandAs<TypedDefValue>(fileState->engine, QueryKey{ QueryKind::typedDef, fileState->file, lemni::toStdStr(name) });
+		if(!typed || typed->error) return nullptr;
+
+		return dynamic_cast<LemniTypedLValueExpr>(typed->expr);
+	}
+
+	LemniQueryEngineT::FileState *fileState(LemniQueryEngine engine, const std::string &file){
+		auto res = engine->files.find(file);
+		if(res != end(engine->files)) return res->second.get();
+
+		auto ptr = std::make_unique<LemniQueryEngineT::FileState>();
+		ptr->engine = engine;
+		ptr->file = file;
+		ptr->state = lemniCreateTypecheckState(engine->mods);
+
+		// the global scope stays empty, every top-level name is resolved on demand
+		lemniScopeSetResolver(lemniTypecheckStateScope(ptr->state), resolveDefinition, ptr.get());
+
+		return engine->files.emplace(file, std::move(ptr)).first->second.get();
+	}
+
+	/**
+	 * Structural hash of a typed definition.
+	 * Pseudo types are numbered by first use and definitions are referred to by name, so typechecking the same
+	 * definition again hashes the same even though every node and pseudo type is new.
+	 */
+	class TypedFingerprint{
+		public:
+			explicit TypedFingerprint(LemniTypecheckState state_) noexcept
+				: state(state_){}
+
+			std::size_t expr(LemniTypedExpr e){
+				if(!e) return 0;
+
+				auto ret = hashCombine(hashStr(typeid(*e).name()), type(e->type()));
+
+				if(auto lvalue = dynamic_cast<LemniTypedLValueExpr>(e)){
+					ret = hashCombine(ret, hashStr(lvalue->id()));
+				}
+
+				// changes to referenced definitions are covered by their own queries
+				if(dynamic_cast<LemniTypedRefExpr>(e)) return ret;
+
+				if(auto unaryOp = dynamic_cast<LemniTypedUnaryOpExpr>(e)) ret = hashCombine(ret, unaryOp->op);
+				else if(auto binaryOp = dynamic_cast<LemniTypedBinaryOpExpr>(e)) ret = hashCombine(ret, binaryOp->op);
+				else if(auto nary = dynamic_cast<const LemniTypedNAryOpExprT*>(e)) ret = hashCombine(ret, nary->op);
+				else if(auto literal = typedLiteralKey(e); !literal.empty()) ret = hashCombine(ret, hashStr(literal));
+
+				std::vector<LemniTypedExpr> children;
+				e->children(children);
+
+				for(auto child : children){
+					ret = hashCombine(ret, expr(child));
+				}
+
+				return ret;
+			}
+
+			std::size_t type(LemniType t){
+				if(!t) return 0;
+
+				t = state->unifier.find(t);
+
+				auto res = types.find(t);
+				if(res != end(types)) return res->second;
+
+				auto str = lemni::toStdStr(t->str());
+
+				// renumber pseudo types in order of appearance
+				static constexpr std::string_view pseudoPrefix = "Pseudo ";
+
+				std::string canonical;
+				canonical.reserve(str.size());
+
+				std::size_t pos = 0;
+				while(pos < str.size()){
+					auto found = str.find(pseudoPrefix, pos);
+					if(found == std::string::npos){
+						canonical.append(str, pos);
+						break;
+					}
+
+					auto numStart = found + pseudoPrefix.size();
+					auto numEnd = str.find_first_not_of("0123456789", numStart);
+					if(numEnd == std::string::npos) numEnd = str.size();
+
+					auto idx = pseudos.try_emplace(str.substr(numStart, numEnd - numStart), pseudos.size()).first->second;
+
+					canonical.append(str, pos, numStart - pos);
+					canonical += fmt::format("#{}", idx);
+
+					pos = numEnd;
+				}
+
+				auto ret = hashStr(canonical);
+				types.emplace(t, ret);
+				return ret;
+			}
+
+		private:
+			LemniTypecheckState state;
+			std::unordered_map<std::string, std::size_t> pseudos;
+			std::unordered_map<LemniType, std::size_t> types;
+	};
+
+	/**
+	 * Give the previous node of a typed definition the contents of a newly typechecked one.
+	 * Other definitions refer to it by identity, so this keeps them valid when they are cut off early.
+	 * Returns ``false`` if the definition changed kind and can not be updated.
+	 */
+	bool updateTypedDef(LemniTypecheckState state, LemniTypedExpr prev, LemniTypedExpr next){
+		if(auto prevFnDef = dynamic_cast<LemniTypedFnDefExpr>(prev)){
+			auto nextFnDef = dynamic_cast<LemniTypedFnDefExpr>(next);
+			if(!nextFnDef) return false;
+
+			auto fnDef = const_cast<LemniTypedFnDefExprT*>(prevFnDef);
+			fnDef->lambda = nextFnDef->lambda;
+			fnDef->fnType = nextFnDef->fnType;
+		}
+		else if(auto prevBinding = dynamic_cast<LemniTypedBindingExpr>(prev)){
+			auto nextBinding = dynamic_cast<LemniTypedBindingExpr>(next);
+			if(!nextBinding) return false;
+
+			const_cast<LemniTypedBindingExprT*>(prevBinding)->value = nextBinding->value;
+		}
+		else{
+			return false;
+		}
+
+		// evaluation and effect caches are keyed by definition, drop them so nothing stale is used
+		if(state->comptime){
+			lemniDestroyEvalState(state->comptime);
+			state->comptime = nullptr;
+		}
+
+		if(state->effects){
+			lemniDestroyEffectState(state->effects);
+			state->effects = nullptr;
+		}
+
+		return true;
+	}
+
+	Computed computeTypedDef(LemniQueryEngine engine, const QueryKey &key){
+		auto ret = std::make_shared<TypedDefValue>();
+
+		auto defExpr = demandAs<DefExprValue>(engine, QueryKey{ QueryKind::defExpr, key.file, key.name });
+
+		if(defExpr->error){
+			ret->error = copyError(defExpr->error);
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		auto state = fileState(engine, key.file)->state;
+
+		auto ownerScope = PseudoOwnerScope(state);
+
+		// bindings made by the definition go into its own scope so later lookups still go through the resolver
+		auto defScope = lemni::Scope(lemniTypecheckStateScope(state));
+
+		auto res = defExpr->expr->typecheck(state, defScope);
+		if(res.hasError){
+			ret->error = std::make_unique<QueryError>(QueryError{ res.error.loc, lemni::toStdStr(res.error.msg) });
+			return { ret, hashStr(ret->error->msg) };
+		}
+
+		ret->expr = res.expr;
+
+		auto &&prevValue = engine->slots[key].value;
+		if(prevValue){
+			auto prev = std::static_pointer_cast<const TypedDefValue>(prevValue);
+			if(prev->expr && updateTypedDef(state, prev->expr, res.expr)){
+				ret->expr = prev->expr;
+			}
+		}
+
+		auto fingerprint = TypedFingerprint(state);
+
+		return { ret, hashCombine(fingerprint.type(ret->expr->type()), fingerprint.expr(ret->expr)) };
+	}
+
+	Computed compute(LemniQueryEngine engine, const QueryKey &key){
+		switch(key.kind){
+			case QueryKind::tokens: return computeTokens(engine, key);
+			case QueryKind::parsed: return computeParsed(engine, key);
+			case QueryKind::names: return computeNames(engine, key);
+			case QueryKind::defExpr: return computeDefExpr(engine, key);
+			case QueryKind::typedDef: return computeTypedDef(engine, key);
+			default: return { nullptr, 0 };
+		}
+	}
+
+	void refresh(LemniQueryEngine engine, const QueryKey &key, Slot &slot);
+
+	//! Check that no dependency of \p slot changed since it was last verified
+	bool depsUnchanged(LemniQueryEngine engine, Slot &slot){
+		for(auto &&dep : slot.deps){
+			auto &&depSlot = engine->slots[dep];
+			if(depSlot.active) return false;
+
+			refresh(engine, dep, depSlot);
+
+			if(depSlot.changedAt > slot.verifiedAt) return false;
+		}
+
+		return true;
+	}
+
+	void refresh(LemniQueryEngine engine, const QueryKey &key, Slot &slot){
+		if(slot.verifiedAt == engine->revision) return;
+
+		// inputs are only changed by lemniQuerySetSource
+		if(key.kind == QueryKind::source){
+			slot.verifiedAt = engine->revision;
+			return;
+		}
+
+		// marked active while verifying too, so cyclic dependencies end the check instead of recursing
+		slot.active = true;
+		bool unchanged = slot.value && depsUnchanged(engine, slot);
+		slot.active = false;
+
+		if(unchanged){
+			slot.verifiedAt = engine->revision;
+			++engine->stats.numReused;
+			return;
+		}
+
+		slot.active = true;
+		slot.deps.clear();
+
+		engine->stack.emplace_back(key);
+		auto computed = compute(engine, key);
+		engine->stack.pop_back();
+
+		slot.active = false;
+
+		++engine->stats.numExecuted;
+
+		// either the new or the previous typed definition is dropped
+		if(slot.value && (key.kind == QueryKind::typedDef)){
+			engine->superseded.insert(key.file);
+		}
+
+		if(slot.value && (computed.fingerprint == slot.fingerprint)){
+			// early cutoff: keep the previous value so dependents stay valid
+			++engine->stats.numCutoff;
+		}
+		else{
+			slot.value = std::move(computed.value);
+			slot.fingerprint = computed.fingerprint;
+			slot.changedAt = engine->revision;
+		}
+
+		slot.verifiedAt = engine->revision;
+	}
+
+	/**
+	 * Free typed expressions and pseudo types of superseded typed definitions.
+	 * Only done once no query is running, so nothing still being typechecked can be reclaimed.
+	 * Cut off definitions may keep referring to previous results, so everything reachable from a cached
+	 * typed definition of the file is kept.
+	 */
+	void reclaimSuperseded(LemniQueryEngine engine){
+		for(auto &&file : engine->superseded){
+			auto fileRes = engine->files.find(file);
+			if(fileRes == end(engine->files)) continue;
+
+			std::vector<LemniTypedExpr> roots;
+
+			for(
+				auto it = engine->slots.lower_bound(QueryKey{ QueryKind::typedDef, file, {} });
+				(it != end(engine->slots)) && (it->first.kind == QueryKind::typedDef) && (it->first.file == file);
+				++it
+			){
+				if(!it->second.value) continue;
+
+				auto typed = std::static_pointer_cast<const TypedDefValue>(it->second.value);
+				if(typed->expr) roots.emplace_back(typed->expr);
+			}
+
+			lemniTypecheckReclaim(fileRes->second->state, roots.data(), roots.size());
+		}
+
+		engine->superseded.clear();
+	}
+
+	std::shared_ptr<const void> demand(LemniQueryEngine engine, const QueryKey &key){
+		if(!engine->stack.empty() && !(engine->stack.back() == key)){
+			auto &&deps = engine->slots[engine->stack.back()].deps;
+			if(std::find(begin(deps), end(deps), key) == end(deps)) deps.emplace_back(key);
+		}
+
+		auto &&slot = engine->slots[key];
+
+		// cyclic demand, e.g. a recursive definition resolving itself
+		if(slot.active) return nullptr;
+
+		refresh(engine, key, slot);
+
+		if(engine->stack.empty() && !engine->superseded.empty()){
+			reclaimSuperseded(engine);
+		}
+
+		return slot.value;
+	}
+
+	LemniQueryError toQueryError(const QueryError &error){
+		return LemniQueryError{ error.loc, lemni::fromStdStrView(error.msg) };
+	}
+}
+
+LemniQueryEngine lemniCreateQueryEngine(LemniModuleMap mods){
+	auto mem = std::malloc(sizeof(LemniQueryEngineT));
+	auto p = new(mem) LemniQueryEngineT;
+
+	p->mods = mods;
+
+	return p;
+}
+
+void lemniDestroyQueryEngine(LemniQueryEngine engine){
+	// cached values reference typed expressions owned by the file states
+	engine->slots.clear();
+
+	std::destroy_at(engine);
+	std::free(engine);
+}
+
+void lemniQuerySetSource(LemniQueryEngine engine, const LemniStr file, const LemniStr src){
+	auto &&slot = engine->slots[QueryKey{ QueryKind::source, lemni::toStdStr(file), {} }];
+
+	auto srcView = lemni::toStdStrView(src);
+	auto fingerprint = hashStr(srcView);
+
+	if(slot.value && (slot.fingerprint == fingerprint) && (*std::static_pointer_cast<const std::string>(slot.value) == srcView)){
+		return;
+	}
+
+	++engine->revision;
+
+	slot.value = std::make_shared<const std::string>(srcView);
+	slot.fingerprint = fingerprint;
+	slot.changedAt = engine->revision;
+	slot.verifiedAt = engine->revision;
+}
+
+LemniNat64 lemniQueryRevision(LemniQueryEngineConst engine){ return engine->revision; }
+
+LemniQueryStats lemniQueryEngineStats(LemniQueryEngineConst engine){ return engine->stats; }
+
+LemniQueryTokensResult lemniQueryTokens(LemniQueryEngine engine, const LemniStr file){
+	LemniQueryTokensResult res;
+
+	auto tokens = demandAs<TokensValue>(engine, QueryKey{ QueryKind::tokens, lemni::toStdStr(file), {} });
+
+	if(tokens->error){
+		res.hasError = true;
+		res.error = toQueryError(*tokens->error);
+		return res;
+	}
+
+	res.hasError = false;
+	res.numTokens = tokens->toks.size();
+	res.tokens = tokens->toks.data();
+	return res;
+}
+
+LemniQueryNamesResult lemniQueryDefinitionNames(LemniQueryEngine engine, const LemniStr file){
+	LemniQueryNamesResult res;
+
+	auto names = demandAs<NamesValue>(engine, QueryKey{ QueryKind::names, lemni::toStdStr(file), {} });
+
+	if(names->error){
+		res.hasError = true;
+		res.error = toQueryError(*names->error);
+		return res;
+	}
+
+	res.hasError = false;
+	res.numNames = names->strs.size();
+	res.names = names->strs.data();
+	return res;
+}
+
+LemniQueryExprResult lemniQueryDefinitionExpr(LemniQueryEngine engine, const LemniStr file, const LemniStr name){
+	LemniQueryExprResult res;
+
+	auto defExpr = demandAs<DefExprValue>(engine, QueryKey{ QueryKind::defExpr, lemni::toStdStr(file), lemni::toStdStr(name) });
+
+	if(defExpr->error){
+		res.hasError = true;
+		res.error = toQueryError(*defExpr->error);
+		return res;
+	}
+
+	res.hasError = false;
+	res.expr = defExpr->expr;
+	return res;
+}
+
+LemniTypecheckResult lemniQueryTypedDefinition(LemniQueryEngine engine, const LemniStr file, const LemniStr name){
+	LemniTypecheckResult res;
+
+	auto typed = demandAs<TypedDefValue>(engine, QueryKey{ QueryKind::typedDef, lemni::toStdStr(file), lemni::toStdStr(name) });
+
+	if(typed->error){
+		res.hasError = true;
+		res.error.loc = typed->error->loc;
+		res.error.msg = lemni::fromStdStrView(typed->error->msg);
+		return res;
+	}
+
+	res.hasError = false;
+	res.expr = typed->expr;
+	return res;
+}
@@ -21,7 +21,9 @@
 
 #include <new>
 #include <memory>
+#include <optional>
 #include <vector>
+#include <unordered_set>
 
 #include "fmt/format.h"
 
@@ -31,30 +33,12 @@
 
 #include "Expr.hpp"
 #include "TypedExpr.hpp"
+#include "Value.hpp"
+#include "typecheck.hpp"
 
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
-struct LemniTypecheckStateT{
-	~LemniTypecheckStateT(){
-		for(auto expr : alloced){
-			deleteTypedExpr(expr);
-		}
-	}
-
-	LemniModuleMap mods;
-	LemniTypeSet types;
-	LemniScope globalScope;
-	LemniTypedPlaceholderExpr placeholder;
-
-	//std::vector<std::unique_ptr<LemniExprT>> exprs;
-	std::vector<LemniExpr> stored;
-	std::vector<LemniTypedExpr> alloced;
-	std::vector<std::unique_ptr<std::string>> errStrs;
-	//std::map<LemniLValueExpr, LemniTypedExpr> bindings;
-	//std::map<LemniLValueExpr, LemniTypedLiteralExpr> literalBindings;
-};
-
 namespace {
 	inline LemniTypecheckResult litError(LemniLocation loc, LemniStr str){
 		LemniTypecheckResult ret;
@@ -82,17 +66,6 @@ namespace {
 		ret.expr = expr;
 		return ret;
 	}
-
-	template<typename T, typename ... Args>
-	inline T *createTypedExpr(LemniTypecheckState state, Args &&... args){
-		auto p = newTypedExpr<T>(std::forward<Args>(args)...);
-		if(!p) return nullptr;
-
-		auto res = std::upper_bound(begin(state->alloced), end(state->alloced), p);
-		state->alloced.insert(res, p);
-
-		return p;
-	}
 }
 
 LemniTypecheckState lemniCreateTypecheckState(LemniModuleMap mods){
@@ -101,12 +74,17 @@ LemniTypecheckState lemniCreateTypecheckState(LemniModuleMap mods){
 	p->mods = mods;
 	p->types = lemniModuleMapTypes(mods);
 	p->globalScope = lemniCreateScope(nullptr);
+	p->unifier = lemni::TypeUnifier(p->types);
+	lemniTypeSetAddOwner(p->types);
+
+	auto ownerScope = PseudoOwnerScope(p);
 	p->placeholder = createTypedExpr<LemniTypedPlaceholderExprT>(p, lemniTypeSetGetPseudo(p->types, lemniEmptyTypeInfo()));
 	return p;
 }
 
 void lemniDestroyTypecheckState(LemniTypecheckState state){
 	lemniDestroyScope(state->globalScope);
+	lemniTypeSetRemoveOwner(state->types);
 	std::destroy_at(state);
 	std::free(state);
 }
@@ -123,7 +101,112 @@ LemniTypedPlaceholderExpr lemniTypecheckPlaceholder(LemniTypecheckState state){
 	return state->placeholder;
 }
 
+void lemniTypecheckStatePin(LemniTypecheckState state, LemniTypedExpr expr){
+	if(!expr) return;
+	++state->pinned[expr];
+}
+
+void lemniTypecheckStateUnpin(LemniTypecheckState state, LemniTypedExpr expr){
+	auto res = state->pinned.find(expr);
+	if(res == end(state->pinned)) return;
+	else if(--res->second == 0) state->pinned.erase(res);
+}
+
+void lemniTypecheckStateSetReclaimThreshold(LemniTypecheckState state, const LemniNat64 numBytes){
+	state->reclaimThreshold = numBytes;
+}
+
+void lemniTypecheckStateDeclareEffect(LemniTypecheckState state, LemniTypedExtFnDeclExpr fn, const LemniEffect effect){
+	state->declaredEffects[fn] = effect;
+
+	if(state->effects){
+		lemniEffectStateDeclare(state->effects, fn, effect);
+	}
+}
+
+void lemniTypecheckStateSetComptimeBudget(LemniTypecheckState state, const LemniNat64 maxCalls, const LemniNat32 maxDepth){
+	state->comptimeMaxCalls = maxCalls;
+	state->comptimeMaxDepth = maxDepth;
+}
+
+LemniTypecheckReclaimStats lemniTypecheckReclaim(LemniTypecheckState state, LemniTypedExpr *const roots, const LemniNat64 numRoots){
+	std::vector<LemniTypedExpr> pending(roots, roots + numRoots);
+	pending.emplace_back(state->placeholder);
+
+	for(auto &&pin : state->pinned){
+		pending.emplace_back(pin.first);
+	}
+
+	if(state->comptime){
+		auto numComptimeRoots = pending.size();
+		pending.resize(numComptimeRoots + lemniEvalStateNumRoots(state->comptime));
+		lemniEvalStateRoots(state->comptime, pending.data() + numComptimeRoots);
+	}
+
+	// cached effects are keyed by address, which may be reused after reclaiming
+	if(state->effects){
+		lemniDestroyEffectState(state->effects);
+		state->effects = nullptr;
+	}
+
+	lemniScopeVisit(
+		state->globalScope,
+		[](void *user, LemniTypedLValueExpr expr){ reinterpret_cast<std::vector<LemniTypedExpr>*>(user)->emplace_back(expr); },
+		&pending
+	);
+
+	std::unordered_set<LemniTypedExpr> live;
+	std::unordered_set<LemniType> liveTypes;
+
+	while(!pending.empty()){
+		auto expr = pending.back();
+		pending.pop_back();
+
+		if(!expr || !live.insert(expr).second) continue;
+
+		liveTypes.insert(expr->type());
+
+		if(auto typeExpr = dynamic_cast<LemniTypedTypeExpr>(expr)){
+			liveTypes.insert(typeExpr->value);
+		}
+
+		expr->children(pending);
+	}
+
+	LemniTypecheckReclaimStats stats{ 0, 0 };
+
+	std::vector<LemniTypecheckStateT::Alloc> keep;
+	keep.reserve(state->alloced.size());
+
+	for(auto &&alloc : state->alloced){
+		if(live.count(alloc.expr)){
+			keep.emplace_back(alloc);
+		}
+		else{
+			deleteTypedExpr(alloc.expr);
+			++stats.numExprs;
+			stats.numBytes += alloc.size;
+		}
+	}
+
+	state->alloced = std::move(keep);
+	state->allocedSinceReclaim = 0;
+
+	for(auto it = begin(state->declaredEffects); it != end(state->declaredEffects);){
+		if(live.count(it->first)) ++it;
+		else it = state->declaredEffects.erase(it);
+	}
+
+	state->unifier.retainLive(liveTypes);
+
+	std::vector<LemniType> liveTypeVec(begin(liveTypes), end(liveTypes));
+	stats.numBytes += lemniTypeSetReclaimPseudos(state->types, state, liveTypeVec.data(), liveTypeVec.size());
+
+	return stats;
+}
+
 LemniTypecheckResult lemniTypecheckEval(LemniTypecheckState state, LemniTypedExpr expr, const LemniNat64 numArgs, LemniTypedExpr *const args){
+	auto ownerScope = PseudoOwnerScope(state);
 	auto nullBindings = LemniPartialBindingsT();
 
 	if(numArgs != 0){
@@ -145,6 +228,186 @@ LemniTypecheckResult lemniTypecheckEval(LemniTypecheckState state, LemniTypedExp
 	return expr->partialEval(state, &nullBindings, 0, nullptr);
 }
 
+namespace {
+	//! Create a typed literal from an evaluated value, returns ``nullptr`` if there is no literal form
+	LemniTypedExpr comptimeLiteral(LemniTypecheckState state, LemniValue value){
+		value = value->deref();
+
+		auto types = state->types;
+
+		if(dynamic_cast<LemniValueUnit>(value)){
+			return createTypedExpr<LemniTypedUnitExprT>(state, lemniTypeSetGetUnit(types));
+		}
+		else if(auto boolVal = dynamic_cast<LemniValueBool>(value)){
+			return createTypedExpr<LemniTypedBoolExprT>(state, lemniTypeSetGetBool(types), boolVal->value);
+		}
+		else if(auto nat16 = dynamic_cast<LemniValueNat16>(value)){
+			return createTypedExpr<LemniTypedNat16ExprT>(state, lemniTypeSetGetNat(types, 16), nat16->value);
+		}
+		else if(auto nat32 = dynamic_cast<LemniValueNat32>(value)){
+			return createTypedExpr<LemniTypedNat32ExprT>(state, lemniTypeSetGetNat(types, 32), nat32->value);
+		}
+		else if(auto nat64 = dynamic_cast<LemniValueNat64>(value)){
+			return createTypedExpr<LemniTypedNat64ExprT>(state, lemniTypeSetGetNat(types, 64), nat64->value);
+		}
+		else if(auto aNat = dynamic_cast<LemniValueANat>(value)){
+			return createTypedExpr<LemniTypedANatExprT>(state, lemniTypeSetGetNat(types, 0), aNat->value);
+		}
+		else if(auto int16 = dynamic_cast<LemniValueInt16>(value)){
+			return createTypedExpr<LemniTypedInt16ExprT>(state, lemniTypeSetGetInt(types, 16), int16->value);
+		}
+		else if(auto int32 = dynamic_cast<LemniValueInt32>(value)){
+			return createTypedExpr<LemniTypedInt32ExprT>(state, lemniTypeSetGetInt(types, 32), int32->value);
+		}
+		else if(auto int64 = dynamic_cast<LemniValueInt64>(value)){
+			return createTypedExpr<LemniTypedInt64ExprT>(state, lemniTypeSetGetInt(types, 64), int64->value);
+		}
+		else if(auto aInt = dynamic_cast<LemniValueAInt>(value)){
+			return createTypedExpr<LemniTypedAIntExprT>(state, lemniTypeSetGetInt(types, 0), aInt->value);
+		}
+		else if(auto ratio32 = dynamic_cast<LemniValueRatio32>(value)){
+			return createTypedExpr<LemniTypedRatio32ExprT>(state, lemniTypeSetGetRatio(types, 32), ratio32->value);
+		}
+		else if(auto ratio64 = dynamic_cast<LemniValueRatio64>(value)){
+			return createTypedExpr<LemniTypedRatio64ExprT>(state, lemniTypeSetGetRatio(types, 64), ratio64->value);
+		}
+		else if(auto ratio128 = dynamic_cast<LemniValueRatio128>(value)){
+			return createTypedExpr<LemniTypedRatio128ExprT>(state, lemniTypeSetGetRatio(types, 128), ratio128->value);
+		}
+		else if(auto aRatio = dynamic_cast<LemniValueARatio>(value)){
+			return createTypedExpr<LemniTypedARatioExprT>(state, lemniTypeSetGetRatio(types, 0), aRatio->value);
+		}
+		else if(auto real32 = dynamic_cast<LemniValueReal32>(value)){
+			return createTypedExpr<LemniTypedReal32ExprT>(state, lemniTypeSetGetReal(types, 32), real32->value);
+		}
+		else if(auto real64 = dynamic_cast<LemniValueReal64>(value)){
+			return createTypedExpr<LemniTypedReal64ExprT>(state, lemniTypeSetGetReal(types, 64), real64->value);
+		}
+		else if(auto aReal = dynamic_cast<LemniValueAReal>(value)){
+			return createTypedExpr<LemniTypedARealExprT>(state, lemniTypeSetGetReal(types, 0), aReal->value);
+		}
+		else if(auto strASCII = dynamic_cast<LemniValueStrASCII>(value)){
+			return createTypedExpr<LemniTypedStringASCIIExprT>(state, lemniTypeSetGetStringASCII(types), strASCII->value);
+		}
+		else if(auto strUTF8 = dynamic_cast<LemniValueStrUTF8>(value)){
+			return createTypedExpr<LemniTypedStringUTF8ExprT>(state, lemniTypeSetGetStringUTF8(types), strUTF8->value);
+		}
+		else if(auto typeVal = dynamic_cast<const LemniValueTypeT*>(value)){
+			return createTypedExpr<LemniTypedTypeExprT>(state, lemniTypeSetGetMeta(types), typeVal->value);
+		}
+		else if(auto product = dynamic_cast<const LemniValueProductT*>(value)){
+			std::vector<LemniTypedExpr> elems;
+			elems.reserve(product->values.size());
+
+			for(auto elemVal : product->values){
+				auto elem = comptimeLiteral(state, elemVal);
+				if(!elem) return nullptr;
+
+				elems.emplace_back(elem);
+			}
+
+			return createTypedExpr<LemniTypedProductExprT>(state, types, std::move(elems));
+		}
+		else{
+			return nullptr;
+		}
+	}
+
+	//! Get the value of a natural or integer, returns ``std::nullopt`` for any other value
+	std::optional<lemni::AInt> comptimeInteger(LemniValue value){
+		value = value->deref();
+
+		if(auto nat16 = dynamic_cast<LemniValueNat16>(value)) return lemni::AInt(LemniNat32(nat16->value));
+		else if(auto nat32 = dynamic_cast<LemniValueNat32>(value)) return lemni::AInt(nat32->value);
+		else if(auto nat64 = dynamic_cast<LemniValueNat64>(value)) return lemni::AInt(nat64->value);
+		else if(auto aNat = dynamic_cast<LemniValueANat>(value)) return aNat->value;
+		else if(auto int16 = dynamic_cast<LemniValueInt16>(value)) return lemni::AInt(LemniInt32(int16->value));
+		else if(auto int32 = dynamic_cast<LemniValueInt32>(value)) return lemni::AInt(int32->value);
+		else if(auto int64 = dynamic_cast<LemniValueInt64>(value)) return lemni::AInt(int64->value);
+		else if(auto aInt = dynamic_cast<LemniValueAInt>(value)) return aInt->value;
+		else return std::nullopt;
+	}
+
+	/**
+	 * Create a typed literal of type \p type from an evaluated value.
+	 * The value API promotes differently from static typing, so naturals and integers are converted to \p type ;
+	 * returns ``nullptr`` if the value doesn't fit or has no literal form of that type.
+	 */
+	LemniTypedExpr comptimeLiteral(LemniTypecheckState state, LemniValue value, LemniType type){
+		if(auto natType = lemniTypeAsNat(type)){
+			auto val = comptimeInteger(value);
+			if(!val || (*val < lemni::AInt(LemniNat64(0)))) return nullptr;
+
+			const auto numBits = lemniTypeNumBits(natType);
+
+			if(numBits == 0){
+				return createTypedExpr<LemniTypedANatExprT>(state, natType, std::move(*val));
+			}
+			else if((numBits <= 64) && (val->numBitsUnsigned() <= numBits)){
+				return createTypedExpr<LemniTypedNatNExprT>(state, natType, numBits, LemniNat64(val->toULong()));
+			}
+			else{
+				return nullptr;
+			}
+		}
+		else if(auto intType = lemniTypeAsInt(type)){
+			auto val = comptimeInteger(value);
+			if(!val) return nullptr;
+
+			const auto numBits = lemniTypeNumBits(intType);
+
+			if(numBits == 0){
+				return createTypedExpr<LemniTypedAIntExprT>(state, intType, std::move(*val));
+			}
+			else if((numBits <= 64) && (val->numBits() <= numBits)){
+				auto intVal = val->toLong();
+				LemniNat64 bits = 0;
+				std::memcpy(&bits, &intVal, sizeof(intVal));
+				return createTypedExpr<LemniTypedIntNExprT>(state, intType, numBits, bits);
+			}
+			else{
+				return nullptr;
+			}
+		}
+
+		auto literal = comptimeLiteral(state, value);
+		if(!literal || (literal->type() != type)) return nullptr;
+
+		return literal;
+	}
+
+	/**
+	 * Fully evaluate a pure expression, returns ``nullptr`` if it can not be evaluated within the comptime budget.
+	 * Any evaluation errors are left for runtime to report.
+	 */
+	LemniTypedExpr comptimeEval(LemniTypecheckState state, LemniTypedExpr expr){
+		if(!state->comptimeMaxCalls || dynamic_cast<LemniTypedConstantExpr>(expr)) return nullptr;
+
+		if(lemniTypeAsFunction(expr->type())) return nullptr;
+
+		auto effects = typecheckEffects(state);
+		if(!effects || (lemniEffectOf(effects, expr) != LEMNI_EFFECT_PURE)) return nullptr;
+
+		if(!state->comptime){
+			state->comptime = lemniCreateEvalState(state->types);
+			if(!state->comptime) return nullptr;
+		}
+
+		lemniEvalStateSetBudget(state->comptime, state->comptimeMaxCalls, state->comptimeMaxDepth);
+
+		auto res = lemniEval(state->comptime, expr);
+		if(res.hasError) return nullptr;
+
+		// the literal replaces the expression, so it keeps the static type
+		auto val = lemni::Value::from(res.value);
+		return comptimeLiteral(state, val.handle(), expr->type());
+	}
+}
+
+LemniTypedExpr typecheckComptimeEval(LemniTypecheckState state, LemniTypedExpr expr){
+	return comptimeEval(state, expr);
+}
+
 namespace {
 	template<typename ... Fs> struct Overload: Fs...{ using Fs::operator()...; };
 	template<typename ... Fs> Overload(Fs...) -> Overload<Fs...>;
@@ -492,6 +755,39 @@ LemniTypecheckResult LemniTypedBinaryOpExprT::partialEval(
 	}
 }
 
+LemniTypecheckResult LemniTypedNAryOpExprT::partialEval(
+	LemniTypecheckState state, LemniPartialBindings bindings,
+	const LemniNat64 numArgs, LemniTypedExpr *const args
+) const noexcept{
+	(void)args;
+
+	if(numArgs > 0) return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("arguments passed to non-function n-ary op expression"));
+
+	bool changed = false;
+
+	std::vector<LemniTypedExpr> newOperands;
+	newOperands.reserve(operands.size());
+
+	for(auto operand : operands){
+		auto found = bindings->find(operand->deref());
+		if(!found) found = operand;
+
+		newOperands.emplace_back(found);
+		changed = changed || (found != operand);
+	}
+
+	if(!changed) return makeResult(this);
+
+	auto resultType = newOperands[0]->type();
+
+	for(std::size_t i = 1; i < newOperands.size(); i++){
+		resultType = lemniBinaryOpResultType(state->types, resultType, newOperands[i]->type(), op);
+	}
+
+	auto nary = createTypedExpr<LemniTypedNAryOpExprT>(state, resultType, op, std::move(newOperands));
+	return makeResult(nary);
+}
+
 LemniTypecheckResult LemniTypedUnresolvedRefExprT::partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept{
 	if(auto bound = bindings->find(this)){ return bound->partialEval(state, bindings, numArgs, args); }
 	else if(numArgs > 0){ return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("arguments passed to unresolved reference")); }
@@ -524,7 +820,24 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 
 	LemniTypedExpr appExpr = this;
 
-	if(numEvalArgs > 0){
+	auto fnParam = dynamic_cast<LemniTypedParamBindingExpr>(fn->deref());
+
+	if(numEvalArgs > 0 && fnParam && !bindings->find(fnParam)){
+		// nothing is known about a function passed as an unbound parameter, only the arguments are evaluated
+		std::vector<LemniTypedExpr> residualArgs;
+		residualArgs.reserve(this->args.size());
+
+		for(std::size_t i = 0; i < this->args.size(); i++){
+			residualArgs.emplace_back((i < evalArgs.size() && evalArgs[i]) ? evalArgs[i] : this->args[i]);
+		}
+
+		appExpr = createTypedExpr<LemniTypedApplicationExprT>(state, resultType, fn, std::move(residualArgs));
+	}
+	else if(numEvalArgs > 0){
+		if(auto fnDef = dynamic_cast<LemniTypedFnDefExpr>(fn->deref())){
+			profileSpecialization(state, fnDef->id());
+		}
+
 		auto fnEvalRes = fn->partialEval(state, bindings, numEvalArgs, evalArgs.data());
 		if(fnEvalRes.hasError) return fnEvalRes;
 
@@ -538,10 +851,10 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 
 			LemniType newResultType = resultType;
 
-			if(auto fn_ = dynamic_cast<LemniFunctionType>(newFnType)){
+			if(auto fn_ = lemniTypeAsFunction(newFnType)){
 				newResultType = fn_->result();
 			}
-			else if(auto pseudo_ = dynamic_cast<LemniPseudoType>(newFnType)){
+			else if(auto pseudo_ = lemniTypeAsPseudo(newFnType)){
 				newResultType = lemniTypeSetGetPseudo(state->types, lemniEmptyTypeInfo());
 			}
 			else{
@@ -557,7 +870,7 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 
 		auto appArgs = std::vector<LemniTypedExpr>(args_, args_ + numArgs);
 
-		if(auto fn_ = dynamic_cast<LemniFunctionType>(appExprType)){
+		if(auto fn_ = lemniTypeAsFunction(appExprType)){
 			for(std::size_t i = 0; i < numArgs; i++){
 				appArgs.emplace_back(args_[i]);
 
@@ -566,7 +879,7 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 				auto paramType = fn_->param(i);
 				auto argType = args_[i]->type();
 
-				if(!lemniTypeIsCastable(argType, paramType)){
+				if(!lemniTypeSetIsCastable(state->types, argType, paramType)){
 					return makeError(
 						state, LemniLocation{ UINT32_MAX, UINT32_MAX },
 						fmt::format(
@@ -580,7 +893,7 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 			auto retExpr = createTypedExpr<LemniTypedApplicationExprT>(state, fn_->result(), appExpr, std::move(appArgs));
 			return makeResult(retExpr);
 		}
-		else if(auto pseudo_ = dynamic_cast<LemniPseudoType>(appExprType)){
+		else if(auto pseudo_ = lemniTypeAsPseudo(appExprType)){
 			auto newResultType = lemniTypeSetGetPseudo(state->types, lemniEmptyTypeInfo());
 			auto retExpr = createTypedExpr<LemniTypedApplicationExprT>(state, newResultType, appExpr, std::move(appArgs));
 			return makeResult(retExpr);
@@ -593,6 +906,56 @@ LemniTypecheckResult LemniTypedApplicationExprT::partialEval(LemniTypecheckState
 	return makeResult(appExpr);
 }
 
+LemniTypecheckResult LemniTypedBindingExprT::partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept{
+	if(auto bound = bindings->find(this)) return bound->partialEval(state, bindings, numArgs, args);
+
+	auto valueRes = value->partialEval(state, bindings, 0, nullptr);
+	if(valueRes.hasError) return valueRes;
+	else if(valueRes.expr == value) return LemniTypedExprT::partialEval(state, bindings, numArgs, args);
+	else if(numArgs > 0) return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("arguments passed to non-function binding"));
+
+	// later references to this binding get the specialized one
+	auto newBinding = createTypedExpr<LemniTypedBindingExprT>(state, m_id, valueRes.expr);
+	bindings->bind(this, newBinding);
+
+	return makeResult(newBinding);
+}
+
+LemniTypecheckResult LemniTypedReturnExprT::partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept{
+	(void)args;
+
+	if(numArgs > 0) return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("arguments passed to return expression"));
+
+	auto valueRes = value->partialEval(state, bindings, 0, nullptr);
+	if(valueRes.hasError) return valueRes;
+	else if(valueRes.expr == value) return makeResult(this);
+
+	return makeResult(createTypedExpr<LemniTypedReturnExprT>(state, valueRes.expr));
+}
+
+LemniTypecheckResult LemniTypedBlockExprT::partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept{
+	(void)args;
+
+	if(numArgs > 0) return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("arguments passed to non-function block expression"));
+
+	bool changed = false;
+
+	std::vector<LemniTypedExpr> newExprs;
+	newExprs.reserve(exprs.size());
+
+	for(auto expr : exprs){
+		auto exprRes = expr->partialEval(state, bindings, 0, nullptr);
+		if(exprRes.hasError) return exprRes;
+
+		changed = changed || (exprRes.expr != expr);
+		newExprs.emplace_back(exprRes.expr);
+	}
+
+	if(!changed) return makeResult(this);
+
+	return makeResult(createTypedExpr<LemniTypedBlockExprT>(state, resultType, std::move(newExprs)));
+}
+
 LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState state, LemniPartialBindings bindings, const LemniNat64 numArgs, LemniTypedExpr *const args) const noexcept{
 	if(numArgs > params.size()){
 		if(numArgs == 1 && params.size() == 0 && args[0]->type() == lemniTypeSetGetUnit(state->types)){
@@ -638,7 +1001,7 @@ LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState stat
 		return newLambda->partialEval(state, bindings, numArgs, args);
 	}
 
-	auto fnBound = LemniPartialBindingsT(bindings);
+	auto fnScope = LemniPartialBindingsT::Scope(bindings);
 
 	auto passedBits = std::bitset<64>(0x0);
 
@@ -647,7 +1010,7 @@ LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState stat
 		if(arg && !dynamic_cast<LemniTypedPlaceholderExpr>(arg)){
 			auto param = params[i];
 
-			if(!lemniTypeIsCastable(arg->type(), param->type())){
+			if(!lemniTypeSetIsCastable(state->types, arg->type(), param->type())){
 				return makeError(
 					state, LemniLocation{ UINT32_MAX, UINT32_MAX },
 					fmt::format(
@@ -658,7 +1021,7 @@ LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState stat
 				);
 			}
 
-			fnBound.bound[param] = arg;
+			bindings->bind(param, arg);
 			passedBits.set(i);
 		}
 	}
@@ -668,7 +1031,7 @@ LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState stat
 	LemniNat64 newArity = params.size() - numPassed;
 
 	if(newArity == 0){
-		return body->partialEval(state, &fnBound, 0, nullptr);
+		return body->partialEval(state, bindings, 0, nullptr);
 	}
 	else{
 		std::vector<LemniTypedParamBindingExpr> newParams;
@@ -680,7 +1043,7 @@ LemniTypecheckResult LemniTypedLambdaExprT::partialEval(LemniTypecheckState stat
 			}
 		}
 
-		auto newBodyRes = body->partialEval(state, &fnBound, 0, nullptr);
+		auto newBodyRes = body->partialEval(state, bindings, 0, nullptr);
 		if(newBodyRes.hasError) return newBodyRes;
 
 		auto newLambda = createTypedExpr<LemniTypedLambdaExprT>(state, state->types, std::move(newParams), newBodyRes.expr);
@@ -714,6 +1077,8 @@ LemniTypecheckResult LemniTypedFnDefExprT::partialEval(LemniTypecheckState state
 			return litError(LemniLocation{ UINT32_MAX, UINT32_MAX }, LEMNICSTR("could not partially eval lambda"));
 		}
 		else{
+			profileSpecialization(state, this->m_id);
+
 			auto newFnDef = createTypedExpr<LemniTypedFnDefExprT>(state, this->m_id, newLambda);
 			return makeResult(newFnDef);
 		}
@@ -890,7 +1255,7 @@ LemniTypecheckResult LemniApplicationExprT::typecheck(LemniTypecheckState state,
 	auto fnRes = fn->typecheck(state, scope);
 	if(fnRes.hasError) return fnRes;
 
-	auto fnExprType = fnRes.expr->type();
+	auto fnExprType = state->unifier.instantiate(fnRes.expr->type());
 
 	if(auto fnType = lemniTypeAsFunction(fnExprType)){
 		auto numParams = lemniFunctionTypeNumParams(fnType);
@@ -911,7 +1276,18 @@ LemniTypecheckResult LemniApplicationExprT::typecheck(LemniTypecheckState state,
 
 			auto argType = argRes.expr->type();
 
-			if(!argType->isCastable(paramType)){
+			// instantiated parameters are fresh pseudo types, bind them so the result type follows the arguments
+			if(lemniTypeAsPseudo(state->unifier.find(argType)) || lemniTypeAsPseudo(state->unifier.find(paramType))){
+				if(!state->unifier.unify(argType, paramType)){
+					auto errStr = fmt::format(
+						"can not unify argument {} of type `{}` with `{}`",
+						i + 1, lemni::toStdStrView(argType->str()), lemni::toStdStrView(paramType->str())
+					);
+
+					return makeError(state, loc, std::move(errStr));
+				}
+			}
+			else if(!lemniTypeSetIsCastable(state->types, argType, paramType)){
 				auto errStr = fmt::format(
 					"can not cast argument {} from `{}` to `{}`",
 					i + 1, lemni::toStdStrView(argType->str()), lemni::toStdStrView(paramType->str())
@@ -929,8 +1305,10 @@ LemniTypecheckResult LemniApplicationExprT::typecheck(LemniTypecheckState state,
 
 		auto numEvaled = evaledArgs.count();
 
+		auto resultType = state->unifier.find(fnType->result());
+
 		if(numEvaled == 0){
-			auto appExpr = createTypedExpr<LemniTypedApplicationExprT>(state, fnType->result(), fnRes.expr, std::move(argExprs));
+			auto appExpr = createTypedExpr<LemniTypedApplicationExprT>(state, resultType, fnRes.expr, std::move(argExprs));
 			return makeResult(appExpr);
 		}
 		else{
@@ -946,6 +1324,14 @@ LemniTypecheckResult LemniApplicationExprT::typecheck(LemniTypecheckState state,
 				}
 			}
 
+			if((numEvaled == numParams) && (args.size() == numParams)){
+				auto appExpr = createTypedExpr<LemniTypedApplicationExprT>(state, resultType, fnRes.expr, argExprs);
+
+				if(auto literal = comptimeEval(state, appExpr)){
+					return makeResult(literal);
+				}
+			}
+
 			auto evaled = lemniTypecheckEval(state, fnRes.expr, evalArgs.size(), evalArgs.data());
 			if(evaled.hasError) return evaled;
 
@@ -998,15 +1384,21 @@ LemniTypecheckResult LemniAccessExprT::typecheck(LemniTypecheckState state, Lemn
 	if(auto rhsRef = dynamic_cast<LemniRefExpr>(access)){
 		auto modState = lemniModuleTypecheckState(module);
 		auto modScope = lemniTypecheckStateScope(modState);
+		if(state->profile) ++state->profile->totals.numLookups;
+
 		auto resolved = lemniScopeFind(modScope, lemni::fromStdStrView(rhsRef->id));
-		if(!resolved)
+		if(!resolved){
+			auto lazyError = lemni::toStdStrView(lemniModuleLazyError(module));
+
 			return makeError(
 				state, loc,
 				fmt::format(
-					"could not resolve '{}' in module '{}'",
-					rhsRef->id, lemni::toStdStrView(lemniModuleId(module))
+					"could not resolve '{}' in module '{}'{}{}",
+					rhsRef->id, lemni::toStdStrView(lemniModuleId(module)),
+					lazyError.empty() ? "" : ": ", lazyError
 				)
 			);
+		}
 
 		return makeResult(createTypedExpr<LemniTypedRefExprT>(state, resolved));
 	}
@@ -1208,7 +1600,24 @@ LemniTypecheckResult LemniUnaryOpExprT::typecheck(LemniTypecheckState state, Lem
 	if(valueChecked.hasError)
 		return valueChecked;
 
-	auto resultType = lemniUnaryOpResultType(state->types, valueChecked.expr->type(), op);
+	auto valueType = state->unifier.find(valueChecked.expr->type());
+
+	LemniType resultType = nullptr;
+
+	if(lemniTypeAsPseudo(valueType)){
+		if(op == LEMNI_UNARY_NOT){
+			if(state->unifier.unify(valueType, lemniTypeSetGetBool(state->types))){
+				resultType = lemniTypeSetGetBool(state->types);
+			}
+		}
+		else if(state->unifier.requireUnaryOp(valueType, op)){
+			resultType = lemniTypeSetGetPseudo(state->types, lemniEmptyTypeInfo());
+			state->unifier.requireUnaryOp(resultType, op);
+		}
+	}
+	else{
+		resultType = lemniUnaryOpResultType(state->types, valueType, op);
+	}
 
 	if(!resultType){
 		return makeError(state, loc, "unary operation undefined on value type");
@@ -1228,7 +1637,43 @@ LemniTypecheckResult LemniBinaryOpExprT::typecheck(LemniTypecheckState state, Le
 	if(rhsChecked.hasError)
 		return rhsChecked;
 
-	auto resultType = lemniBinaryOpResultType(state->types, lhsChecked.expr->type(), rhsChecked.expr->type(), op);
+	auto lhsType = state->unifier.find(lhsChecked.expr->type());
+	auto rhsType = state->unifier.find(rhsChecked.expr->type());
+
+	auto lhsPseudo = lemniTypeAsPseudo(lhsType);
+	auto rhsPseudo = lemniTypeAsPseudo(rhsType);
+
+	if(lhsPseudo || rhsPseudo){
+		bool constrained;
+
+		if((op == LEMNI_BINARY_AND) || (op == LEMNI_BINARY_OR)){
+			auto boolType = lemniTypeSetGetBool(state->types);
+			constrained = state->unifier.unify(lhsType, boolType) && state->unifier.unify(rhsType, boolType);
+		}
+		else{
+			constrained = state->unifier.requireBinaryOp(lhsType, op) && state->unifier.requireBinaryOp(rhsType, op);
+
+			// concrete operands are left alone, literals are sized to their value and would over-constrain
+			if(constrained && lhsPseudo && rhsPseudo){
+				constrained = state->unifier.unify(lhsType, rhsType);
+			}
+		}
+
+		if(!constrained){
+			return makeError(state, loc, "binary operation undefined on value types");
+		}
+	}
+
+	LemniType resultType = nullptr;
+
+	if((lhsPseudo || rhsPseudo) && lemniBinaryOpIsLogic(op)){
+		resultType = lemniTypeSetGetBool(state->types);
+	}
+	else{
+		resultType = lemniBinaryOpResultType(state->types, lhsType, rhsType, op);
+		if(resultType && lemniTypeAsPseudo(resultType)) state->unifier.requireBinaryOp(resultType, op);
+	}
+
 	if(!resultType){
 		return makeError(state, loc, "binary operation undefined on value types");
 	}
@@ -1264,9 +1709,20 @@ LemniTypecheckResult LemniLambdaExprT::typecheck(LemniTypecheckState state, Lemn
 
 		auto newParam = createTypedExpr<LemniTypedParamBindingExprT>(state, param->id, paramType);
 		typedParams.emplace_back(newParam);
+
+		lemniScopeSet(innerScope, newParam);
+	}
+
+	// the parameters stay monomorphic in definitions nested in the body
+	const auto envSize = state->envTypes.size();
+	for(auto param : typedParams){
+		state->envTypes.emplace_back(param->type());
 	}
 
 	auto typedBodyRes = body->typecheck(state, innerScope);
+
+	state->envTypes.resize(envSize);
+
 	if(typedBodyRes.hasError)
 		return typedBodyRes;
 
@@ -1279,6 +1735,11 @@ LemniTypecheckResult LemniBranchExprT::typecheck(LemniTypecheckState state, Lemn
 	auto condRes = cond->typecheck(state, scope);
 	if(condRes.hasError) return condRes;
 
+	auto condType = condRes.expr->type();
+	if(lemniTypeAsPseudo(condType) && !state->unifier.unify(condType, lemniTypeSetGetBool(state->types))){
+		return makeError(state, loc, "branch condition can not be a boolean value");
+	}
+
 	auto trueRes = true_->typecheck(state, scope);
 	if(trueRes.hasError) return trueRes;
 
@@ -1357,6 +1818,8 @@ LemniTypecheckResult LemniRefExprT::typecheck(LemniTypecheckState state, LemniSc
 		return makeResult(falseExpr);
 	}
 
+	if(state->profile) ++state->profile->totals.numLookups;
+
 	auto res = lemniScopeFind(scope, lemni::fromStdStrView(id));
 	if(res){
 		auto refExpr = createTypedExpr<LemniTypedRefExprT>(state, res);
@@ -1374,6 +1837,11 @@ LemniTypecheckResult LemniBindingExprT::typecheck(LemniTypecheckState state, Lem
 
 	auto bindingExpr = createTypedExpr<LemniTypedBindingExprT>(state, this->id, valRes.expr);
 
+	// locals of an enclosing function are part of the environment until it is done
+	if(!state->envTypes.empty()){
+		state->envTypes.emplace_back(bindingExpr->type());
+	}
+
 	lemniScopeSet(scope, bindingExpr);
 
 	return makeResult(bindingExpr);
@@ -1422,17 +1890,135 @@ LemniTypecheckResult LemniFnDefExprT::typecheck(LemniTypecheckState state, Lemni
 
 	auto lambdaExpr = dynamic_cast<LemniTypedLambdaExpr>(lambdaRes.expr);
 
-	auto fnDef = createTypedExpr<LemniTypedFnDefExprT>(state, this->id, lambdaExpr);
+	auto principalType = lemniTypeAsFunction(state->unifier.generalize(lambdaExpr->fnType, state->envTypes));
+
+	auto fnDef = createTypedExpr<LemniTypedFnDefExprT>(state, this->id, lambdaExpr, principalType);
 
 	return makeResult(fnDef);
 }
 
-LemniTypecheckResult lemniTypecheck(LemniTypecheckState state, LemniExpr expr){
-	if(!expr){
-		return makeResult(nullptr);
+namespace {
+	/**
+	 * Typecheck a top-level expression, reclaiming only if \p mayReclaim and no other top-level expression is in progress.
+	 * Type sets shared with other states are never reclaimed from automatically, the other states may be in use.
+	 */
+	LemniTypecheckResult typecheckTopLevel(LemniTypecheckState state, LemniExpr expr, const bool mayReclaim){
+		++state->topLevelDepth;
+		auto res = expr->typecheck(state, state->globalScope);
+		--state->topLevelDepth;
+
+		if(
+			mayReclaim && !res.hasError && (state->topLevelDepth == 0) && (lemniTypeSetNumOwners(state->types) == 1) &&
+			state->reclaimThreshold && (state->allocedSinceReclaim >= state->reclaimThreshold)
+		){
+			auto resExpr = res.expr;
+			lemniTypecheckReclaim(state, &resExpr, 1);
+		}
+
+		return res;
+	}
+
+	//! Records the time and counters of typechecking a top-level expression, excluding nested definitions
+	struct ProfileScope{
+		using Clock = std::chrono::steady_clock;
+		using Counters = LemniTypecheckStateT::Profile::Counters;
+
+		ProfileScope(LemniTypecheckState state_, LemniExpr expr_) noexcept
+			: state(state_), expr(expr_)
+		{
+			auto profile = state->profile.get();
+
+			countPseudos(profile, profile->depth != 0);
+			++profile->depth;
+
+			counters = profile->totals;
+			nested = profile->nested;
+			nestedTime = profile->nestedTime;
+			start = Clock::now();
+		}
+
+		~ProfileScope(){
+			auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+			auto profile = state->profile.get();
+			if(!profile) return;
+
+			--profile->depth;
+
+			countPseudos(profile, true);
+
+			auto total = diff(profile->totals, counters);
+			auto inner = diff(profile->nested, nested);
+			auto innerTime = profile->nestedTime - nestedTime;
+
+			auto &&def = profile->defs.emplace_back();
+			def.name = definitionName();
+			def.time = time - innerTime;
+			def.counters = diff(total, inner);
+
+			// the enclosing definition excludes all of this one, nested definitions included
+			profile->nested = sum(nested, total);
+			profile->nestedTime = nestedTime + time;
+		}
+
+		//! Bring the pseudo type total up to date, pseudo types created outside of any definition are not counted
+		void countPseudos(LemniTypecheckStateT::Profile *profile, const bool add) const noexcept{
+			auto created = lemniTypeSetNumPseudosCreated(state->types);
+			if(add) profile->totals.numPseudos += created - profile->pseudosCounted;
+			profile->pseudosCounted = created;
+		}
+
+		static Counters diff(const Counters &lhs, const Counters &rhs) noexcept{
+			return Counters{
+				lhs.numAllocs - rhs.numAllocs, lhs.numBytes - rhs.numBytes, lhs.numPseudos - rhs.numPseudos,
+				lhs.numLookups - rhs.numLookups, lhs.numSpecializations - rhs.numSpecializations
+			};
+		}
+
+		static Counters sum(const Counters &lhs, const Counters &rhs) noexcept{
+			return Counters{
+				lhs.numAllocs + rhs.numAllocs, lhs.numBytes + rhs.numBytes, lhs.numPseudos + rhs.numPseudos,
+				lhs.numLookups + rhs.numLookups, lhs.numSpecializations + rhs.numSpecializations
+			};
+		}
+
+		std::string definitionName() const{
+			if(auto lvalue = dynamic_cast<const LemniLValueExprT*>(expr)){
+				return lvalue->id;
+			}
+
+			return fmt::format("<expr {}.{}>", expr->loc.line, expr->loc.col);
+		}
+
+		LemniTypecheckState state;
+		LemniExpr expr;
+		Counters counters, nested;
+		std::chrono::nanoseconds nestedTime;
+		Clock::time_point start;
+	};
+
+	LemniTypecheckResult typecheckDefinition(LemniTypecheckState state, LemniExpr expr, const bool mayReclaim){
+		if(!expr){
+			return makeResult(nullptr);
+		}
+
+		auto ownerScope = PseudoOwnerScope(state);
+
+		if(state->profile){
+			auto profileScope = ProfileScope(state, expr);
+			return typecheckTopLevel(state, expr, mayReclaim);
+		}
+
+		return typecheckTopLevel(state, expr, mayReclaim);
 	}
+}
 
-	return expr->typecheck(state, state->globalScope);
+LemniTypecheckResult typecheckNested(LemniTypecheckState state, LemniExpr expr){
+	return typecheckDefinition(state, expr, false);
+}
+
+LemniTypecheckResult lemniTypecheck(LemniTypecheckState state, LemniExpr expr){
+	return typecheckDefinition(state, expr, true);
 }
 
 LemniType lemniUnaryOpResultType(LemniTypeSet types, LemniType value, LemniUnaryOp op){
@@ -1454,18 +2040,6 @@ LemniType lemniUnaryOpResultType(LemniTypeSet types, LemniType value, LemniUnary
 	return nullptr;
 }
 
-namespace {
-	template<typename F, typename ... Args>
-	auto typeApply(LemniType t, F &&f, Args &&... args){
-		if(auto num = lemniTypeAsNumber(t)) return std::forward<F>(f)(num, std::forward<Args>(args)...);
-		if(auto real = lemniTypeAsReal(t)) return std::forward<F>(f)(real, std::forward<Args>(args)...);
-		if(auto ratio = lemniTypeAsRatio(t)) return std::forward<F>(f)(ratio, std::forward<Args>(args)...);
-		if(auto int_ = lemniTypeAsInt(t)) return std::forward<F>(f)(int_, std::forward<Args>(args)...);
-		if(auto nat = lemniTypeAsNat(t)) return std::forward<F>(f)(nat, std::forward<Args>(args)...);
-		else return std::forward<F>(f)(t, std::forward<Args>(args)...);
-	}
-}
-
 LemniType lemniBinaryOpResultType(LemniTypeSet types, LemniType lhs, LemniType rhs, LemniBinaryOp op){
 	if(lemniTypeAsPseudo(lhs) || lemniTypeAsPseudo(rhs)){
 		// TODO: OR usage flags
@@ -1475,51 +2049,7 @@ LemniType lemniBinaryOpResultType(LemniTypeSet types, LemniType lhs, LemniType r
 		return lemniTypeSetGetBool(types);
 	}
 	else{
-		return typeApply(lemniTypePromote(types, lhs, rhs),
-			Overload{
-				[](LemniType) -> LemniType{ return nullptr; },
-				[](LemniNumberType num) -> LemniType{ return num; },
-				[&](LemniNatType nat) -> LemniType{
-					switch(op){
-						case LEMNI_BINARY_ADD: return lemniTypeSetGetNat(types, nat->numBits() + 1);
-						case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, nat->numBits() + 2);
-						case LEMNI_BINARY_MUL: return lemniTypeSetGetNat(types, nat->numBits() * 2);
-						case LEMNI_BINARY_DIV: return lemniTypeSetGetRatio(types, nat->numBits() * 2); // should probably be (n * 2) + 2
-						default: return nat;
-					}
-				},
-				[&](LemniIntType int_) -> LemniType{
-					switch(op){
-						case LEMNI_BINARY_ADD:
-						case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, int_->numBits() + 1);
-						case LEMNI_BINARY_MUL: return lemniTypeSetGetNat(types, int_->numBits() * 2);
-						case LEMNI_BINARY_DIV: return lemniTypeSetGetRatio(types, int_->numBits() * 2);
-						default: return int_;
-					}
-				},
-				[&](LemniRatioType ratio) -> LemniType{
-					switch(op){
-						case LEMNI_BINARY_ADD:
-						case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, ratio->numBits() + 2);
-						case LEMNI_BINARY_MUL:
-						case LEMNI_BINARY_DIV: return lemniTypeSetGetNat(types, ratio->numBits() * 2);
-						default: return ratio;
-					}
-				},
-				[&](LemniRealType real) -> LemniType{
-					switch(op){
-						case LEMNI_BINARY_ADD:
-						case LEMNI_BINARY_SUB: return lemniTypeSetGetInt(types, real->numBits() + 2);
-						case LEMNI_BINARY_MUL:
-						case LEMNI_BINARY_DIV: return lemniTypeSetGetNat(types, real->numBits() * 2);
-						default: return real;
-					}
-				}
-			}
-		);
+		// TODO: implement sum type results
+		return lemniTypeSetArithmeticResult(types, lhs, rhs, op);
 	}
-
-	// TODO: implement sum type results
-
-	return nullptr;
 }
@@ -0,0 +1,165 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LEMNI_LIB_TYPECHECK_HPP
+#define LEMNI_LIB_TYPECHECK_HPP 1
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lemni/typecheck.h"
+#include "lemni/effect.h"
+#include "lemni/eval.h"
+
+#include "TypedExpr.hpp"
+#include "Unify.hpp"
+
+struct LemniTypecheckStateT{
+	~LemniTypecheckStateT(){
+		if(comptime) lemniDestroyEvalState(comptime);
+		if(effects) lemniDestroyEffectState(effects);
+
+		for(auto &&alloc : alloced){
+			deleteTypedExpr(alloc.expr);
+		}
+	}
+
+	struct Alloc{
+		LemniTypedExpr expr;
+		std::size_t size;
+
+		bool operator<(const Alloc &rhs) const noexcept{ return expr < rhs.expr; }
+	};
+
+	//! Opt-in profiling data, only collected while profiling is enabled
+	struct Profile{
+		struct Counters{
+			LemniNat64 numAllocs = 0;
+			LemniNat64 numBytes = 0;
+			LemniNat64 numPseudos = 0;
+			LemniNat64 numLookups = 0;
+			LemniNat64 numSpecializations = 0;
+		};
+
+		struct Definition{
+			std::string name;
+			std::chrono::nanoseconds time;
+			Counters counters;
+		};
+
+		Counters totals;
+		Counters nested; //!< inclusive counters of nested definitions, excluded from the enclosing one
+		std::chrono::nanoseconds nestedTime = {};
+		std::vector<Definition> defs;
+		std::map<std::string, LemniNat64> specializations;
+		LemniNat64 pseudosCounted = 0; //!< pseudo types created as of the last update of ``totals``
+		LemniNat32 depth = 0;
+		std::string report;
+	};
+
+	LemniModuleMap mods;
+	LemniTypeSet types;
+	LemniScope globalScope;
+	LemniTypedPlaceholderExpr placeholder;
+
+	//std::vector<std::unique_ptr<LemniExprT>> exprs;
+	std::vector<LemniExpr> stored;
+	std::vector<Alloc> alloced;
+	std::vector<std::unique_ptr<std::string>> errStrs;
+	std::map<LemniTypedExpr, LemniNat64> pinned;
+	LemniNat64 reclaimThreshold = 0;
+	LemniNat64 allocedSinceReclaim = 0;
+	LemniNat32 topLevelDepth = 0; //!< top-level expressions currently being typechecked
+	lemni::TypeUnifier unifier;
+	std::vector<LemniType> envTypes; //!< types of the enclosing parameters and locals, never generalized
+	LemniEvalState comptime = nullptr;
+	LemniEffectState effects = nullptr;
+	std::map<LemniTypedExtFnDeclExpr, LemniEffect> declaredEffects;
+	LemniNat64 comptimeMaxCalls = 4096;
+	LemniNat32 comptimeMaxDepth = 256;
+	std::unique_ptr<Profile> profile;
+	//std::map<LemniLValueExpr, LemniTypedExpr> bindings;
+	//std::map<LemniLValueExpr, LemniTypedLiteralExpr> literalBindings;
+};
+
+namespace {
+	template<typename T, typename ... Args>
+	inline T *createTypedExpr(LemniTypecheckState state, Args &&... args){
+		auto p = newTypedExpr<T>(std::forward<Args>(args)...);
+		if(!p) return nullptr;
+
+		auto alloc = LemniTypecheckStateT::Alloc{ p, sizeof(T) };
+
+		auto res = std::upper_bound(begin(state->alloced), end(state->alloced), alloc);
+		state->alloced.insert(res, alloc);
+
+		state->allocedSinceReclaim += sizeof(T);
+
+		if(state->profile){
+			++state->profile->totals.numAllocs;
+			state->profile->totals.numBytes += sizeof(T);
+		}
+
+		return p;
+	}
+
+	//! Get the effect analysis state, creating it if needed
+	inline LemniEffectState typecheckEffects(LemniTypecheckState state){
+		if(!state->effects){
+			state->effects = lemniCreateEffectState();
+			if(!state->effects) return nullptr;
+
+			for(auto &&declared : state->declaredEffects){
+				lemniEffectStateDeclare(state->effects, declared.first, declared.second);
+			}
+		}
+
+		return state->effects;
+	}
+
+	//! Count a specialization of the function named \p name if profiling is enabled
+	inline void profileSpecialization(LemniTypecheckState state, std::string_view name){
+		if(!state->profile) return;
+
+		++state->profile->totals.numSpecializations;
+		++state->profile->specializations[std::string(name)];
+	}
+
+	//! Attributes pseudo types created during its lifetime to a typecheck state
+	struct PseudoOwnerScope{
+		explicit PseudoOwnerScope(LemniTypecheckState state_) noexcept
+			: state(state_), prevOwner(lemniTypeSetPseudoOwner(state_->types, state_)){}
+
+		~PseudoOwnerScope(){ lemniTypeSetPseudoOwner(state->types, prevOwner); }
+
+		LemniTypecheckState state;
+		const void *prevOwner;
+	};
+}
+
+//! Typecheck a top-level expression while another may be mid-typecheck, never reclaims and is profiled on its own
+LemniTypecheckResult typecheckNested(LemniTypecheckState state, LemniExpr expr);
+
+//! Evaluate a pure expression at compile time into a literal, returns ``nullptr`` if that isn't possible
+LemniTypedExpr typecheckComptimeEval(LemniTypecheckState state, LemniTypedExpr expr);
+
+#endif // !LEMNI_LIB_TYPECHECK_HPP
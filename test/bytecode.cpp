@@ -0,0 +1,96 @@
+/*
+	The Lemni Programming Language - Functional computer speak
+	Copyright (C) 2020  Keith Hammond
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "lemni/eval.h"
+
+#include "TypedExpr.hpp"
+
+namespace {
+	bool evalStr(LemniEvalState state, LemniTypedExpr expr, std::string &out){
+		auto res = lemniEval(state, expr);
+		if(res.hasError){
+			out.assign(res.error.msg.ptr, res.error.msg.len);
+			return false;
+		}
+
+		out.clear();
+		lemniValueStr(res.value, &out, [](void *user, const LemniStr str){ static_cast<std::string*>(user)->append(str.ptr, str.len); });
+		lemniDestroyValue(res.value);
+		return true;
+	}
+}
+
+/**
+ * A function defined within another closes over the parameters of the outer one.
+ * The bytecode compiler can't see the frame from tree fallbacks, so the result must match the tree walker's.
+ *
+ * adder x y = (add z = x + z) y
+ */
+int main(){
+	auto types = lemniCreateTypeSet();
+	auto natTy = lemniTypeSetGetNat(types, 16);
+
+	auto ref = [](LemniTypedLValueExpr lval){ return newTypedExpr<LemniTypedRefExprT>(lval); };
+	auto lambda = [&](std::vector<LemniTypedParamBindingExpr> params, LemniTypedExpr body){
+		return newTypedExpr<LemniTypedLambdaExprT>(types, std::move(params), body);
+	};
+
+	auto x = newTypedExpr<LemniTypedParamBindingExprT>("x", natTy);
+	auto y = newTypedExpr<LemniTypedParamBindingExprT>("y", natTy);
+	auto z = newTypedExpr<LemniTypedParamBindingExprT>("z", natTy);
+
+	auto add = newTypedExpr<LemniTypedFnDefExprT>("add", lambda({ z }, newTypedExpr<LemniTypedBinaryOpExprT>(natTy, LEMNI_BINARY_ADD, ref(x), ref(z))));
+	auto addY = newTypedExpr<LemniTypedApplicationExprT>(natTy, ref(add), std::vector<LemniTypedExpr>{ ref(y) });
+	auto adder = newTypedExpr<LemniTypedFnDefExprT>("adder", lambda({ x, y }, newTypedExpr<LemniTypedBlockExprT>(natTy, std::vector<LemniTypedExpr>{ add, addY })));
+
+	std::vector<LemniTypedExpr> args{
+		newTypedExpr<LemniTypedNat16ExprT>(natTy, LemniNat16(2)),
+		newTypedExpr<LemniTypedNat16ExprT>(natTy, LemniNat16(3))
+	};
+
+	auto call = newTypedExpr<LemniTypedApplicationExprT>(natTy, ref(adder), std::move(args));
+
+	int ret = 0;
+
+	for(auto mode : { LEMNI_EVAL_TREE, LEMNI_EVAL_BYTECODE }){
+		auto state = lemniCreateEvalState(types);
+		lemniEvalStateSetMode(state, mode);
+
+		std::string str;
+
+		if(!evalStr(state, call, str)){
+			std::fprintf(stderr, "mode %d: error: %s\n", int(mode), str.c_str());
+			ret = 1;
+		}
+		else if(str != "5"){
+			std::fprintf(stderr, "mode %d: expected 5, got %s\n", int(mode), str.c_str());
+			ret = 1;
+		}
+
+		lemniDestroyEvalState(state);
+	}
+
+	lemniDestroyTypeSet(types);
+
+	return ret;
+}